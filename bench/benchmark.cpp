@@ -0,0 +1,582 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "basicimage.h"
+#include "blendmodes.h"
+#include "colortransform.h"
+#include "compare.h"
+#include "composite.h"
+#include "filter.h"
+#include "image.h"
+#include "imageprocessing.h"
+#include "imageview.h"
+#include "kernels.h"
+#include "mosaic.h"
+#include "planarimage.h"
+#include "resample.h"
+#include "rgbaimage.h"
+#include "statistics.h"
+#include "threadpool.h"
+#include "transform.h"
+
+#ifndef IMAGEPROCESSING_VERSION
+#define IMAGEPROCESSING_VERSION "unknown"
+#endif
+
+namespace
+{
+    /// @brief Dimensions of a synthetic benchmark image.
+    struct Size
+    {
+        int width;
+        int height;
+    };
+
+    /// @brief Timing statistics of one benchmark at one size.
+    struct Result
+    {
+        std::string name;
+        Size size;
+        std::size_t pixels; // Pixels produced (or loaded/written) per run
+        std::size_t bytes;  // Bytes read plus bytes written per run
+        int repeat;
+        int warmup;
+        double min;    // Seconds
+        double median; // Seconds
+        double mean;   // Seconds
+        double stddev; // Seconds
+    };
+
+    /// @brief Settings parsed from the command line.
+    struct Options
+    {
+        std::vector<Size> sizes{{512, 512}, {1920, 1080}, {3840, 2160}, {7680, 4320}};
+        int repeat = 10;
+        int warmup = 2;
+        std::string filter;
+        std::string format = "text";
+        std::string output;
+    };
+
+    constexpr Size LARGE_SIZE{15360, 8640}; // 16K, added by --large
+
+    void printUsage(std::ostream &out)
+    {
+        out << "Usage: ImageProcessingBenchmark [options]\n\n"
+            << "Options:\n"
+            << "  --sizes WxH[,WxH...]  Image sizes (default: 512x512,1920x1080,3840x2160,7680x4320)\n"
+            << "  --large               Also run 15360x8640\n"
+            << "  --repeat N            Timed runs per benchmark (default: 10)\n"
+            << "  --warmup N            Untimed runs before timing (default: 2)\n"
+            << "  --filter TEXT         Only run benchmarks whose name contains TEXT\n"
+            << "  --threads N           Threads used by the operations (default: all hardware threads)\n"
+            << "  --scalar              Disable the SIMD kernels\n"
+            << "  --format text|json|csv  Output format (default: text)\n"
+            << "  --output FILE         Write the results to FILE instead of standard output\n";
+    }
+
+    Size parseSize(const std::string &text)
+    {
+        std::size_t separator = text.find('x');
+        try
+        {
+            if (separator != std::string::npos)
+            {
+                int width = std::stoi(text.substr(0, separator));
+                int height = std::stoi(text.substr(separator + 1));
+                if (width > 0 && height > 0 && width <= 65535 && height <= 65535)
+                    return {width, height};
+            }
+        }
+        catch (const std::exception &)
+        {
+        }
+        throw std::runtime_error("ERROR: Invalid size \"" + text + "\" (expected WxH, at most 65535x65535).");
+    }
+
+    int parseCount(const std::string &option, const std::string &value)
+    {
+        try
+        {
+            std::size_t used;
+            int count = std::stoi(value, &used);
+            if (used == value.size() && count >= 0)
+                return count;
+        }
+        catch (const std::exception &)
+        {
+        }
+        throw std::runtime_error("ERROR: Option " + option + " expects a non-negative number.");
+    }
+
+    Options parseOptions(int argc, char *argv[])
+    {
+        Options options;
+        bool customSizes = false;
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string argument = argv[i];
+            auto value = [&]() -> std::string
+            {
+                if (i + 1 >= argc)
+                    throw std::runtime_error("ERROR: Option " + argument + " expects a value.");
+                return argv[++i];
+            };
+
+            if (argument == "--sizes")
+            {
+                if (!customSizes)
+                    options.sizes.clear();
+                customSizes = true;
+                std::stringstream list{value()};
+                std::string size;
+                while (std::getline(list, size, ','))
+                    options.sizes.push_back(parseSize(size));
+            }
+            else if (argument == "--large")
+                options.sizes.push_back(LARGE_SIZE);
+            else if (argument == "--repeat")
+                options.repeat = std::max(1, parseCount(argument, value()));
+            else if (argument == "--warmup")
+                options.warmup = parseCount(argument, value());
+            else if (argument == "--filter")
+                options.filter = value();
+            else if (argument == "--threads")
+                setThreadCount(static_cast<unsigned int>(parseCount(argument, value())));
+            else if (argument == "--scalar")
+                setSimdLevel(SimdLevel::Scalar);
+            else if (argument == "--format")
+            {
+                options.format = value();
+                if (options.format != "text" && options.format != "json" && options.format != "csv")
+                    throw std::runtime_error("ERROR: Unknown format \"" + options.format + "\".");
+            }
+            else if (argument == "--output")
+                options.output = value();
+            else if (argument == "-h" || argument == "--help")
+            {
+                printUsage(std::cout);
+                std::exit(0);
+            }
+            else
+                throw std::runtime_error("ERROR: Unknown option " + argument + ".");
+        }
+        return options;
+    }
+
+    /// @brief Create an image with smooth gradients plus noise, so compression and blends see realistic data.
+    Image syntheticImage(Size size, unsigned int seed)
+    {
+        Header header{};
+        header.dataTypeCode = 2;
+        header.bitsPerPixel = 24;
+        header.width = static_cast<short>(size.width);
+        header.height = static_cast<short>(size.height);
+        Image image{header};
+
+        unsigned int state = seed * 2654435761u + 1;
+        for (int y = 0; y < size.height; ++y)
+        {
+            for (int x = 0; x < size.width; ++x)
+            {
+                // xorshift32
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                int noise = static_cast<int>(state & 15) - 8;
+                auto channel = [&](int value)
+                { return static_cast<unsigned char>(std::min(255, std::max(0, value + noise))); };
+
+                image.pixels[static_cast<std::size_t>(y) * size.width + x].update(
+                    channel(x * 255 / size.width), channel(y * 255 / size.height), channel(((x + y) * 255 / (size.width + size.height) + seed * 64) & 255));
+            }
+        }
+        return image;
+    }
+
+    std::string sizeName(Size size)
+    {
+        return std::to_string(size.width) + "x" + std::to_string(size.height);
+    }
+
+    std::string simdName(SimdLevel level)
+    {
+        switch (level)
+        {
+        case SimdLevel::AVX2:
+            return "AVX2";
+        case SimdLevel::SSE2:
+            return "SSE2";
+        default:
+            return "Scalar";
+        }
+    }
+
+    /// @brief Run `body` warmup + repeat times and collect statistics over the timed runs.
+    Result measure(const std::string &name, Size size, std::size_t pixels, std::size_t bytes,
+                   const Options &options, const std::function<void()> &body)
+    {
+        for (int i = 0; i < options.warmup; ++i)
+            body();
+
+        std::vector<double> times;
+        for (int i = 0; i < options.repeat; ++i)
+        {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        std::sort(times.begin(), times.end());
+        double mean = 0.0;
+        for (double time : times)
+            mean += time;
+        mean /= times.size();
+        double variance = 0.0;
+        for (double time : times)
+            variance += (time - mean) * (time - mean);
+
+        std::size_t middle = times.size() / 2;
+        double median = times.size() % 2 ? times[middle] : (times[middle - 1] + times[middle]) / 2;
+        return {name, size, pixels, bytes, options.repeat, options.warmup,
+                times.front(), median, mean, std::sqrt(variance / times.size())};
+    }
+
+    double megapixelsPerSecond(const Result &result)
+    {
+        return result.pixels / result.median / 1e6;
+    }
+
+    double gigabytesPerSecond(const Result &result)
+    {
+        return result.bytes / result.median / 1e9;
+    }
+
+    /// @brief Benchmark every operation and the file I/O at one size.
+    void runSize(Size size, const Options &options, std::vector<Result> &results, std::ostream &progress)
+    {
+        std::size_t pixels = static_cast<std::size_t>(size.width) * size.height;
+        std::size_t imageBytes = pixels * sizeof(Pixel);
+
+        Image first = syntheticImage(size, 1);
+        Image second = syntheticImage(size, 2);
+        Image third = syntheticImage(size, 3);
+        Image result{first.header};
+
+        // Quadrant inputs are a quarter of the size so the combined image matches the others
+        Size quarter{std::max(1, size.width / 2), std::max(1, size.height / 2)};
+        std::vector<Image> quadrants;
+        for (unsigned int seed = 1; seed <= 4; ++seed)
+            quadrants.push_back(syntheticImage(quarter, seed));
+        std::size_t quadrantPixels = static_cast<std::size_t>(quarter.width) * quarter.height * 4;
+
+        // A 16x16 contact sheet of thumbnails covering the same area
+        Size thumbnail{std::max(1, size.width / 16), std::max(1, size.height / 16)};
+        std::vector<Image> thumbnails;
+        std::vector<const Image *> sheet;
+        for (unsigned int seed = 0; seed < 256; ++seed)
+            thumbnails.push_back(syntheticImage(thumbnail, seed));
+        for (const Image &image : thumbnails)
+            sheet.push_back(&image);
+        MosaicLayout sheetLayout = gridLayout(sheet, 16);
+        Image sheetCanvas{mosaicHeader(sheetLayout.width, sheetLayout.height)};
+        std::size_t sheetPixels = sheetCanvas.pixels.size();
+
+        Image firstCopy = first;
+        PlanarImage planarFirst{first};
+        PlanarImage planarSecond{second};
+        PlanarImage planarThird{third};
+        PlanarImage planarResult{first.header};
+
+        // The centre quarter of the frame, processed where it lies
+        ConstImageView firstRegion = view(first, size.width / 4, size.height / 4, size.width / 2, size.height / 2);
+        ImageView resultRegion = view(result, size.width / 4, size.height / 4, size.width / 2, size.height / 2);
+        std::size_t regionPixels = firstRegion.size();
+
+        // Transparent layers, their coverage taken from another image
+        ImageRGBA layerFirst = withAlpha(first, second);
+        ImageRGBA layerSecond = withAlpha(second, third);
+        ImageRGBA layerThird = withAlpha(third, first);
+        ImageRGBA layerResult{first.header};
+        std::size_t layerBytes = pixels * sizeof(PixelRGBA);
+
+        // The same frames with 16-bit and float channels
+        Image16 deepFirst{first};
+        Image16 deepSecond{second};
+        Image16 deepResult{first.header};
+        ImageFloat floatFirst{first};
+        ImageFloat floatSecond{second};
+        ImageFloat floatResult{first.header};
+        std::size_t deepBytes = pixels * sizeof(BasicPixel<std::uint16_t>);
+        std::size_t floatBytes = pixels * sizeof(BasicPixel<float>);
+
+        // A color correction of five per-channel steps (one lookup pass) and a sepia tone (one matrix pass)
+        ColorTransform correction;
+        correction.add(10, 0, -10).scale(1.1, 1.0, 0.9).gamma(1.2).invert().invert();
+        ColorTransform sepia;
+        sepia.matrix({{{0.393, 0.769, 0.189}, {0.349, 0.686, 0.168}, {0.272, 0.534, 0.131}}}).gamma(0.9);
+
+        std::string file = (std::filesystem::temp_directory_path() / "imageprocessing-benchmark.tga").string();
+        std::string rleFile = (std::filesystem::temp_directory_path() / "imageprocessing-benchmark-rle.tga").string();
+        first.write(file);
+        first.write(rleFile, TgaEncoding::TrueColorRle);
+        std::size_t rleBytes = std::filesystem::file_size(rleFile);
+
+        struct Benchmark
+        {
+            std::string name;
+            std::size_t pixels;
+            std::size_t bytes;
+            std::function<void()> body;
+        };
+        std::vector<Benchmark> benchmarks{
+            {"multiplyMode", pixels, 3 * imageBytes, [&]
+             { multiplyMode(first, second, result); }},
+            {"screenMode", pixels, 3 * imageBytes, [&]
+             { screenMode(first, second, result); }},
+            {"overlayMode", pixels, 3 * imageBytes, [&]
+             { overlayMode(first, second, result); }},
+            {"subtractMode", pixels, 3 * imageBytes, [&]
+             { subtractMode(first, second, result); }},
+            {"darkenMode", pixels, 3 * imageBytes, [&]
+             { darkenMode(first, second, result); }},
+            {"softLightMode", pixels, 3 * imageBytes, [&]
+             { softLightMode(first, second, result); }},
+            {"multiply table", pixels, 3 * imageBytes, [&]
+             { blendMode(blendTable("multiply"), first, second, result); }},
+            {"overMode (RGBA)", pixels, 3 * layerBytes, [&]
+             { overMode(layerFirst, layerSecond, layerResult); }},
+            {"multiplyMode (RGBA)", pixels, 3 * layerBytes, [&]
+             { multiplyMode(layerFirst, layerSecond, layerResult); }},
+            {"overlayMode (RGBA)", pixels, 3 * layerBytes, [&]
+             { overlayMode(layerFirst, layerSecond, layerResult); }},
+            {"overMode (RGBA onto RGB)", pixels, layerBytes + 2 * imageBytes, [&]
+             { overMode(layerFirst, second, result); }},
+            {"compositeLayers (3 layers)", pixels, 5 * layerBytes, [&]
+             { ImageRGBA stack = compositeLayers(layerFirst, {{&layerSecond}, {&layerThird, CompositeMode::Multiply},
+                                                              {&layerFirst, CompositeMode::Screen}}); }},
+            {"multiplyMode (16-bit)", pixels, 3 * deepBytes, [&]
+             { multiplyMode(deepFirst, deepSecond, deepResult); }},
+            {"multiplyMode (float)", pixels, 3 * floatBytes, [&]
+             { multiplyMode(floatFirst, floatSecond, floatResult); }},
+            {"overlayMode (float)", pixels, 3 * floatBytes, [&]
+             { overlayMode(floatFirst, floatSecond, floatResult); }},
+            {"quantize (float to 8-bit)", pixels, floatBytes + imageBytes, [&]
+             { floatFirst.toImage(result); }},
+            {"add", pixels, 2 * imageBytes, [&]
+             { add(first, result, 0, 200, 0); }},
+            {"scale", pixels, 2 * imageBytes, [&]
+             { scale(first, result, 4, 1, 0); }},
+            {"extractRed", pixels, 2 * imageBytes, [&]
+             { extractRed(first, result); }},
+            {"add region", regionPixels, 2 * regionPixels * sizeof(Pixel), [&]
+             { add(firstRegion, resultRegion, 0, 200, 0); }},
+            {"crop", regionPixels, 2 * regionPixels * sizeof(Pixel), [&]
+             { crop(firstRegion); }},
+            {"colorTransform lut", pixels, 2 * imageBytes, [&]
+             { correction.apply(first, result); }},
+            {"colorTransform matrix", pixels, 2 * imageBytes, [&]
+             { sepia.apply(first, result); }},
+            {"extractGreen", pixels, 2 * imageBytes, [&]
+             { extractGreen(first, result); }},
+            {"extractBlue", pixels, 2 * imageBytes, [&]
+             { extractBlue(first, result); }},
+            {"combineChannels", pixels, 4 * imageBytes, [&]
+             { combineChannels(first, second, third, result); }},
+            {"rotate180", pixels, 2 * imageBytes, [&]
+             { rotate180(first, result); }},
+            {"flipHorizontal", pixels, 2 * imageBytes, [&]
+             { flipHorizontal(first, result); }},
+            {"flipVertical", pixels, 2 * imageBytes, [&]
+             { flipVertical(first, result); }},
+            {"rotate90", pixels, 2 * imageBytes, [&]
+             { rotate90(first, result); }},
+            {"rotate270", pixels, 2 * imageBytes, [&]
+             { rotate270(first, result); }},
+            {"transpose", pixels, 2 * imageBytes, [&]
+             { transpose(first, result); }},
+            {"combineQuadrants", quadrantPixels, 2 * quadrantPixels * sizeof(Pixel), [&]
+             { combineQuadrants(quadrants[0], quadrants[1], quadrants[2], quadrants[3], result); }},
+            {"composeMosaic (256 tiles)", sheetPixels, 2 * sheetPixels * sizeof(Pixel), [&]
+             { composeMosaic(sheetLayout.tiles, sheetCanvas); }},
+            {"boxBlur (r=8)", pixels, 2 * imageBytes, [&]
+             { boxBlur(first, result, 8); }},
+            {"gaussianBlur (sigma=1.5)", pixels, 2 * imageBytes, [&]
+             { gaussianBlur(first, result, 1.5); }},
+            {"gaussianBlur (sigma=8)", pixels, 2 * imageBytes, [&]
+             { gaussianBlur(first, result, 8); }},
+            {"unsharpMask (sigma=2)", pixels, 2 * imageBytes, [&]
+             { unsharpMask(first, result, 2, 1); }},
+            {"resize (1/2, Lanczos)", pixels, imageBytes + imageBytes / 4, [&]
+             { resize(first, result, size.width / 2, size.height / 2); }},
+            {"resize (1/3, area)", pixels, imageBytes + imageBytes / 9, [&]
+             { resize(first, result, size.width / 3, size.height / 3, ResampleFilter::Area); }},
+            {"resize (x1.5, bilinear)", pixels, imageBytes + imageBytes * 9 / 4, [&]
+             { resize(first, result, size.width * 3 / 2, size.height * 3 / 2, ResampleFilter::Bilinear); }},
+            {"downscale2x", pixels, imageBytes + imageBytes / 4, [&]
+             { downscale2x(first, result); }},
+            {"buildMipmaps", pixels, imageBytes + imageBytes / 3, [&]
+             { std::vector<Image> levels = buildMipmaps(first); }},
+            {"thumbnail (256)", pixels, imageBytes, [&]
+             { Image small = ::thumbnail(first, 256, 256); }},
+            {"imagesEqual", pixels, 2 * imageBytes, [&]
+             { imagesEqual(first, firstCopy); }},
+            {"compareImages", pixels, 2 * imageBytes, [&]
+             { compareImages(first, second); }},
+            {"compareImages (heatmap)", pixels, 3 * imageBytes, [&]
+             { compareImages(first, second, result); }},
+            {"imageStatistics", pixels, imageBytes, [&]
+             { imageStatistics(first); }},
+            {"autoLevels", pixels, 3 * imageBytes, [&]
+             { autoLevels(first, result); }},
+            {"equalize", pixels, 3 * imageBytes, [&]
+             { equalize(first, result); }},
+            {"multiplyMode (value)", pixels, 3 * imageBytes, [&]
+             { Image value = multiplyMode(first, second); }},
+            {"deinterleave", pixels, 2 * imageBytes, [&]
+             { deinterleave(first, planarResult); }},
+            {"interleave", pixels, 2 * imageBytes, [&]
+             { interleave(planarFirst, result); }},
+            {"planar multiplyMode", pixels, 3 * imageBytes, [&]
+             { multiplyMode(planarFirst, planarSecond, planarResult); }},
+            {"planar add", pixels, 2 * imageBytes, [&]
+             { add(planarFirst, planarResult, 0, 200, 0); }},
+            {"planar extractRed", pixels, 2 * imageBytes, [&]
+             { extractRed(planarFirst, planarResult); }},
+            {"planar combineChannels", pixels, 4 * imageBytes, [&]
+             { combineChannels(planarFirst, planarSecond, planarThird, planarResult); }},
+            {"planar rotate180", pixels, 2 * imageBytes, [&]
+             { rotate180(planarFirst, planarResult); }},
+            {"Image::load", pixels, HEADER_SIZE + imageBytes, [&]
+             { Image loaded{file}; }},
+            {"Image::load (RLE)", pixels, rleBytes + imageBytes, [&]
+             { Image loaded{rleFile}; }},
+            {"Image::write", pixels, HEADER_SIZE + imageBytes, [&]
+             { first.write(file); }},
+            {"Image::write (RLE)", pixels, imageBytes + rleBytes, [&]
+             { first.write(rleFile, TgaEncoding::TrueColorRle); }},
+        };
+
+        for (const Benchmark &benchmark : benchmarks)
+        {
+            if (benchmark.name.find(options.filter) == std::string::npos)
+                continue;
+            progress << "  " << std::left << std::setw(26) << benchmark.name << sizeName(size) << "..." << std::flush;
+            results.push_back(measure(benchmark.name, size, benchmark.pixels, benchmark.bytes, options, benchmark.body));
+            progress << " " << std::fixed << std::setprecision(3) << results.back().median * 1e3 << " ms" << std::endl;
+        }
+
+        std::remove(file.c_str());
+        std::remove(rleFile.c_str());
+    }
+
+    std::string jsonString(const std::string &text)
+    {
+        std::string escaped = "\"";
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped + "\"";
+    }
+
+    void writeText(std::ostream &out, const std::vector<Result> &results)
+    {
+        out << std::left << std::setw(26) << "benchmark" << std::setw(12) << "size"
+            << std::right << std::setw(12) << "median ms" << std::setw(12) << "min ms" << std::setw(12) << "stddev ms"
+            << std::setw(12) << "MP/s" << std::setw(10) << "GB/s" << "\n";
+        for (const Result &result : results)
+        {
+            out << std::left << std::setw(26) << result.name << std::setw(12) << sizeName(result.size) << std::right
+                << std::fixed << std::setprecision(3)
+                << std::setw(12) << result.median * 1e3 << std::setw(12) << result.min * 1e3 << std::setw(12) << result.stddev * 1e3
+                << std::setprecision(1) << std::setw(12) << megapixelsPerSecond(result)
+                << std::setprecision(2) << std::setw(10) << gigabytesPerSecond(result) << "\n";
+        }
+    }
+
+    void writeCsv(std::ostream &out, const std::vector<Result> &results)
+    {
+        out << "benchmark,width,height,repeat,warmup,min_ms,median_ms,mean_ms,stddev_ms,mpixels_per_s,gbytes_per_s\n";
+        out << std::setprecision(6);
+        for (const Result &result : results)
+            out << result.name << "," << result.size.width << "," << result.size.height << ","
+                << result.repeat << "," << result.warmup << ","
+                << result.min * 1e3 << "," << result.median * 1e3 << "," << result.mean * 1e3 << "," << result.stddev * 1e3 << ","
+                << megapixelsPerSecond(result) << "," << gigabytesPerSecond(result) << "\n";
+    }
+
+    void writeJson(std::ostream &out, const std::vector<Result> &results)
+    {
+        out << std::setprecision(6);
+        out << "{\n"
+            << "  \"version\": " << jsonString(IMAGEPROCESSING_VERSION) << ",\n"
+            << "  \"threads\": " << threadCount() << ",\n"
+            << "  \"simd\": " << jsonString(simdName(activeSimdLevel())) << ",\n"
+            << "  \"results\": [";
+        for (std::size_t i = 0; i < results.size(); ++i)
+        {
+            const Result &result = results[i];
+            out << (i ? "," : "") << "\n    {"
+                << "\"benchmark\": " << jsonString(result.name)
+                << ", \"width\": " << result.size.width << ", \"height\": " << result.size.height
+                << ", \"repeat\": " << result.repeat << ", \"warmup\": " << result.warmup
+                << ", \"min_ms\": " << result.min * 1e3 << ", \"median_ms\": " << result.median * 1e3
+                << ", \"mean_ms\": " << result.mean * 1e3 << ", \"stddev_ms\": " << result.stddev * 1e3
+                << ", \"mpixels_per_s\": " << megapixelsPerSecond(result)
+                << ", \"gbytes_per_s\": " << gigabytesPerSecond(result) << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    try
+    {
+        Options options = parseOptions(argc, argv);
+
+        std::cerr << "ImageProcessing " << IMAGEPROCESSING_VERSION << " benchmarks (" << threadCount() << " thread(s), "
+                  << simdName(activeSimdLevel()) << ", " << options.warmup << " warmup + " << options.repeat << " runs)" << std::endl;
+
+        std::vector<Result> results;
+        for (Size size : options.sizes)
+            runSize(size, options, results, std::cerr);
+
+        std::ofstream file;
+        if (!options.output.empty())
+        {
+            file.open(options.output);
+            if (!file.is_open())
+                throw std::runtime_error("ERROR: Could not write \"" + options.output + "\".");
+        }
+        std::ostream &out = options.output.empty() ? std::cout : file;
+
+        if (options.format == "json")
+            writeJson(out, results);
+        else if (options.format == "csv")
+            writeCsv(out, results);
+        else
+            writeText(out, results);
+    }
+    catch (const std::exception &error)
+    {
+        std::cerr << error.what() << std::endl;
+        printUsage(std::cerr);
+        return 1;
+    }
+    return 0;
+}
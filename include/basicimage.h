@@ -0,0 +1,293 @@
+#ifndef BASICIMAGE_H
+#define BASICIMAGE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bufferpool.h"
+#include "header.h"
+#include "image.h"
+#include "tga.h"
+
+/// @brief The range of a channel type and its conversions to and from 8-bit values.
+template <typename T>
+struct ChannelTraits;
+
+/// @brief 16-bit channels: 0...65535, with 8-bit values widened exactly (`v * 257`).
+template <>
+struct ChannelTraits<std::uint16_t>
+{
+    static constexpr std::uint16_t max = 0xFFFF;  // Full intensity
+    static constexpr std::uint16_t half = 0x8000; // Where overlay switches from multiply to screen
+
+    static constexpr std::uint16_t fromByte(unsigned char value) { return static_cast<std::uint16_t>(value * 257); }
+
+    static constexpr unsigned char toByte(std::uint16_t value)
+    {
+        return static_cast<unsigned char>((value * 255u + 32767u) / 65535u);
+    }
+
+    /// @return The value rounded and clamped to the channel range.
+    static constexpr std::uint16_t clamp(float value)
+    {
+        return !(value > 0.0f) ? 0 : value >= 65535.0f ? max : static_cast<std::uint16_t>(value + 0.5f);
+    }
+};
+
+/// @brief Floating-point channels: 0...1, with 8-bit values divided by 255.
+template <>
+struct ChannelTraits<float>
+{
+    static constexpr float max = 1.0f;  // Full intensity
+    static constexpr float half = 0.5f; // Where overlay switches from multiply to screen
+
+    static constexpr float fromByte(unsigned char value) { return value / 255.0f; }
+
+    static constexpr unsigned char toByte(float value)
+    {
+        return static_cast<unsigned char>(clamp(value) * 255.0f + 0.5f);
+    }
+
+    /// @return The value clamped to the channel range (NaN becomes 0).
+    /// @note Written as min/max, which vectorize (`std::max(0.0f, NaN)` is 0).
+    static constexpr float clamp(float value)
+    {
+        return std::min(std::max(0.0f, value), max);
+    }
+};
+
+static_assert(ChannelTraits<std::uint16_t>::toByte(ChannelTraits<std::uint16_t>::fromByte(0x80)) == 0x80 &&
+                  ChannelTraits<float>::toByte(ChannelTraits<float>::fromByte(0x80)) == 0x80,
+              "Widening an 8-bit value and quantizing it back must be lossless");
+
+/// @brief Represents the RGB values of a single pixel with channels of type `T`.
+/// @note The order of fields (b, g, r) matches Pixel.
+template <typename T>
+struct BasicPixel
+{
+    T b; // Blue component of pixel
+    T g; // Green component of pixel
+    T r; // Red component of pixel
+
+    /// @brief Constructs a BasicPixel object from the provided RGB values.
+    /// @param red The red value.
+    /// @param green The green value.
+    /// @param blue The blue value.
+    BasicPixel(T red = T{}, T green = T{}, T blue = T{}) : b{blue}, g{green}, r{red} {}
+
+    /// @return `true` if two pixels do not share the same RGB values; otherwise `false`.
+    bool operator!=(const BasicPixel &rhs) const { return r != rhs.r || g != rhs.g || b != rhs.b; }
+};
+
+/// @brief Pixel storage drawn from the shared buffer pool.
+template <typename T>
+using BasicPixelBuffer = std::vector<BasicPixel<T>, PoolAllocator<BasicPixel<T>>>;
+
+/// @brief Manages the header and pixel data of an image with more precise channels than Image.
+/// @note Chaining operations on an Image rounds every intermediate result back to 8 bits. Widening the inputs
+///       once, running the chain on a BasicImage and quantizing once at the end keeps the rounding error of the
+///       whole chain within half an 8-bit step. Results are still clamped to the channel range after every
+///       operation, exactly like the 8-bit ones. 8-bit images stay Image, whose operations keep their SIMD
+///       kernels; BasicImage is instantiated for `std::uint16_t` (Image16) and `float` (ImageFloat).
+template <typename T>
+struct BasicImage
+{
+    Header header;              // The header data for the image (that of its 24-bit .tga file)
+    BasicPixelBuffer<T> pixels; // The pixels in the image
+
+    /// @brief Constructs an image from a .tga image file, widening its 8-bit values.
+    /// @param file The path to the .tga file to read an image from.
+    explicit BasicImage(const std::string &file);
+
+    /// @brief Constructs a blank (black) image described by a header.
+    /// @param header The header data; its width and height determine the number of pixels.
+    explicit BasicImage(const Header &header);
+
+    /// @brief Constructs an image by widening the values of an 8-bit image (lossless).
+    /// @param image The 8-bit image.
+    explicit BasicImage(const Image &image);
+
+    /// @brief Quantize the image to 8 bits, rounding every value to the nearest byte.
+    /// @return The 8-bit image.
+    Image toImage() const;
+
+    /// @brief Quantize into a caller-provided image (no allocation once `result` has the right size).
+    /// @param result The image receiving the output; resized to match if needed.
+    void toImage(Image &result) const;
+
+    /// @brief Quantize the image to 8 bits and write it to a .tga file.
+    /// @param file The path to the .tga file to write an image to.
+    /// @param encoding The pixel encoding of the file.
+    void write(const std::string &file, TgaEncoding encoding = TgaEncoding::TrueColor) const;
+};
+
+using Image16 = BasicImage<std::uint16_t>;
+using ImageFloat = BasicImage<float>;
+
+/// @brief Multiply blend (see the 8-bit multiplyMode).
+/// @param foreground The foreground image.
+/// @param background The background image.
+/// @return The multiplied image.
+template <typename T>
+BasicImage<T> multiplyMode(const BasicImage<T> &foreground, const BasicImage<T> &background);
+
+/// @brief Multiply blend into a caller-provided image.
+/// @note `result` may be `foreground` or `background` for an in-place operation.
+/// @param foreground The foreground image.
+/// @param background The background image.
+/// @param result The image receiving the output; resized to match if needed.
+template <typename T>
+void multiplyMode(const BasicImage<T> &foreground, const BasicImage<T> &background, BasicImage<T> &result);
+
+/// @brief Screen blend (see the 8-bit screenMode).
+/// @param foreground The foreground image.
+/// @param background The background image.
+/// @return The screened image.
+template <typename T>
+BasicImage<T> screenMode(const BasicImage<T> &foreground, const BasicImage<T> &background);
+
+/// @brief Screen blend into a caller-provided image.
+/// @note `result` may be `foreground` or `background` for an in-place operation.
+/// @param foreground The foreground image.
+/// @param background The background image.
+/// @param result The image receiving the output; resized to match if needed.
+template <typename T>
+void screenMode(const BasicImage<T> &foreground, const BasicImage<T> &background, BasicImage<T> &result);
+
+/// @brief Overlay blend (see the 8-bit overlayMode).
+/// @param foreground The foreground image.
+/// @param background The background image.
+/// @return The overlayed image.
+template <typename T>
+BasicImage<T> overlayMode(const BasicImage<T> &foreground, const BasicImage<T> &background);
+
+/// @brief Overlay blend into a caller-provided image.
+/// @note `result` may be `foreground` or `background` for an in-place operation.
+/// @param foreground The foreground image.
+/// @param background The background image.
+/// @param result The image receiving the output; resized to match if needed.
+template <typename T>
+void overlayMode(const BasicImage<T> &foreground, const BasicImage<T> &background, BasicImage<T> &result);
+
+/// @brief Subtracts the top layer from the bottom layer (see the 8-bit subtractMode).
+/// @param topLayer The top layer image.
+/// @param bottomLayer The bottom layer image.
+/// @return The subtracted image.
+template <typename T>
+BasicImage<T> subtractMode(const BasicImage<T> &topLayer, const BasicImage<T> &bottomLayer);
+
+/// @brief Subtraction into a caller-provided image.
+/// @note `result` may be `topLayer` or `bottomLayer` for an in-place operation.
+/// @param topLayer The top layer image.
+/// @param bottomLayer The bottom layer image.
+/// @param result The image receiving the output; resized to match if needed.
+template <typename T>
+void subtractMode(const BasicImage<T> &topLayer, const BasicImage<T> &bottomLayer, BasicImage<T> &result);
+
+/// @brief Add to the image the passed in values.
+/// @note The values are in 8-bit units (255 is full intensity), so they mean the same as for an Image.
+/// @param image The image to add to.
+/// @param r The red value.
+/// @param g The green value.
+/// @param b The blue value.
+/// @return The added image.
+template <typename T>
+BasicImage<T> add(const BasicImage<T> &image, double r = 1.0, double g = 1.0, double b = 1.0);
+
+/// @brief Addition into a caller-provided image.
+/// @note `result` may be `image` for an in-place operation.
+/// @param image The image to add to.
+/// @param result The image receiving the output; resized to match if needed.
+/// @param r The red value (8-bit units).
+/// @param g The green value (8-bit units).
+/// @param b The blue value (8-bit units).
+template <typename T>
+void add(const BasicImage<T> &image, BasicImage<T> &result, double r = 1.0, double g = 1.0, double b = 1.0);
+
+/// @brief Scale the image by the passed in values.
+/// @param image The image to scale.
+/// @param r The red factor.
+/// @param g The green factor.
+/// @param b The blue factor.
+/// @return The scaled image.
+template <typename T>
+BasicImage<T> scale(const BasicImage<T> &image, double r = 1.0, double g = 1.0, double b = 1.0);
+
+/// @brief Scaling into a caller-provided image.
+/// @note `result` may be `image` for an in-place operation.
+/// @param image The image to scale.
+/// @param result The image receiving the output; resized to match if needed.
+/// @param r The red factor.
+/// @param g The green factor.
+/// @param b The blue factor.
+template <typename T>
+void scale(const BasicImage<T> &image, BasicImage<T> &result, double r = 1.0, double g = 1.0, double b = 1.0);
+
+/// @brief Extract the red channel from an image into every channel.
+/// @param image The image.
+/// @return The red channel image.
+template <typename T>
+BasicImage<T> extractRed(const BasicImage<T> &image);
+
+/// @brief Red channel extraction into a caller-provided image (`result` may be `image`).
+/// @param image The image.
+/// @param result The image receiving the output; resized to match if needed.
+template <typename T>
+void extractRed(const BasicImage<T> &image, BasicImage<T> &result);
+
+/// @brief Extract the green channel from an image into every channel.
+/// @param image The image.
+/// @return The green channel image.
+template <typename T>
+BasicImage<T> extractGreen(const BasicImage<T> &image);
+
+/// @brief Green channel extraction into a caller-provided image (`result` may be `image`).
+/// @param image The image.
+/// @param result The image receiving the output; resized to match if needed.
+template <typename T>
+void extractGreen(const BasicImage<T> &image, BasicImage<T> &result);
+
+/// @brief Extract the blue channel from an image into every channel.
+/// @param image The image.
+/// @return The blue channel image.
+template <typename T>
+BasicImage<T> extractBlue(const BasicImage<T> &image);
+
+/// @brief Blue channel extraction into a caller-provided image (`result` may be `image`).
+/// @param image The image.
+/// @param result The image receiving the output; resized to match if needed.
+template <typename T>
+void extractBlue(const BasicImage<T> &image, BasicImage<T> &result);
+
+/// @brief Combine the red, green and blue channels of three images into one.
+/// @param red The image whose red channel is used.
+/// @param green The image whose green channel is used.
+/// @param blue The image whose blue channel is used.
+/// @return The combined image.
+template <typename T>
+BasicImage<T> combineChannels(const BasicImage<T> &red, const BasicImage<T> &green, const BasicImage<T> &blue);
+
+/// @brief Channel combination into a caller-provided image (`result` may be any of the inputs).
+/// @param red The image whose red channel is used.
+/// @param green The image whose green channel is used.
+/// @param blue The image whose blue channel is used.
+/// @param result The image receiving the output; resized to match if needed.
+template <typename T>
+void combineChannels(const BasicImage<T> &red, const BasicImage<T> &green, const BasicImage<T> &blue,
+                     BasicImage<T> &result);
+
+/// @brief Rotate an image by 180 degrees.
+/// @param image The image.
+/// @return The rotated image.
+template <typename T>
+BasicImage<T> rotate180(const BasicImage<T> &image);
+
+/// @brief Rotation into a caller-provided image (`result` may be `image`).
+/// @param image The image.
+/// @param result The image receiving the output; resized to match if needed.
+template <typename T>
+void rotate180(const BasicImage<T> &image, BasicImage<T> &result);
+
+#endif // BASICIMAGE_H
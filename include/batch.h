@@ -0,0 +1,114 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "image.h"
+#include "pipeline.h"
+#include "rgbaimage.h"
+
+/// @brief A pipeline of operations parsed from a textual description.
+/// @note The description is a comma-separated list of steps, each `name[:argument...]`:
+///       - `multiply:FILE`, `screen:FILE`, `overlay:FILE`, `subtract:FILE`: blend with FILE, the processed
+///         image being the top layer (append `:bottom` to make it the bottom layer instead)
+///       - `blend:MODE:FILE[:bottom]`: blend with FILE using any registered blend mode (see blendModeNames)
+///       - `over:FILE`: place FILE, with its alpha channel, over the processed image
+///       - `add:R:G:B`, `scale:R:G:B`: per-channel addition / scaling
+///       - `extract:red`, `extract:green`, `extract:blue`: channel extraction
+///       - `invert`, `gamma:G`, `threshold:LEVEL`: negative, gamma curve, per-channel threshold
+///       - `swizzle:ORDER`: channel rearrangement, ORDER naming the sources of red, green and blue (e.g. `bgr`)
+///       - `matrix:M11:M12:...:M33`: 3x3 channel matrix, row by row in RGB order
+///       Consecutive color steps (add through matrix, and levels) are compiled into one ColorTransform.
+///       - `rotate90`, `rotate180`, `rotate270`: clockwise rotation
+///       - `transpose`, `flipH`, `flipV`: axis swap, horizontal and vertical mirroring
+///       - `blur:SIGMA`, `box:RADIUS`, `sharpen:SIGMA:AMOUNT[:THRESHOLD]`: Gaussian / box blur, unsharp mask
+///       - `levels:BLACK:WHITE[:GAMMA]`, `autolevels[:CLIP[:linked]]`, `equalize`: tone adjustments
+///       - `crop:X:Y:WIDTH:HEIGHT`: keep a region (X, Y being its bottom-left corner)
+///       - `resize:WIDTH:HEIGHT[:FILTER]`, `thumbnail:WIDTH:HEIGHT`: resampling
+///       - `quadrants:SECOND:THIRD:FOURTH`: combine with three images (processed image is the first quadrant)
+///       Images named by the steps are loaded once and shared by every run of the pipeline.
+class PipelineSpec
+{
+public:
+    /// @brief Parses a pipeline description and loads the images it refers to.
+    /// @param spec The pipeline description.
+    explicit PipelineSpec(const std::string &spec);
+
+    /// @brief Runs the pipeline on an image.
+    /// @param input The image to process.
+    /// @param result The image receiving the output.
+    void apply(const Image &input, Image &result) const;
+
+    /// @return The textual description the pipeline was parsed from.
+    const std::string &description() const { return spec; }
+
+private:
+    std::string spec;
+    std::vector<std::unique_ptr<Image>> operands;         // Images referenced by the steps
+    std::vector<std::unique_ptr<ImageRGBA>> layers;       // Transparent layers referenced by the steps
+    std::vector<std::function<void(Pipeline &)>> steps;   // Recorders, applied in order
+};
+
+/// @brief Settings of a batch run.
+struct BatchOptions
+{
+    std::vector<std::string> inputs;   // Files to process (see expandInputs)
+    std::string pipeline;              // Pipeline description (see PipelineSpec)
+    std::string outputDirectory = "."; // Directory receiving one output per input, named after it
+    unsigned int ioThreads = 2;        // Threads decoding and (separately) encoding files
+    std::size_t queueDepth = 8;        // Maximum number of decoded or processed images in flight per stage
+    TgaEncoding encoding = TgaEncoding::TrueColor; // Encoding of the output files
+};
+
+/// @brief Outcome of a batch run.
+struct BatchResult
+{
+    std::size_t succeeded = 0; // Files written
+    std::size_t skipped = 0;   // Files whose output already existed (resumed queue runs)
+    std::size_t failed = 0;    // Files that could not be read, processed or written
+    double seconds = 0.0;      // Wall-clock time of the run
+};
+
+/// @brief Names the output of an input: its file name in the output directory.
+/// @param input The input file.
+/// @param outputDirectory The directory receiving the outputs.
+/// @return The path of the output file.
+std::string outputPath(const std::string &input, const std::string &outputDirectory);
+
+/// @brief Checks that files can be processed together without losing data.
+/// @note Throws if two inputs would be written to the same output (e.g. equal file names in different
+///       directories) or if an output would overwrite one of the inputs. Paths are compared after resolving
+///       them, so `in/a.tga` and `./in/a.tga` are the same file.
+/// @param inputs The input files.
+/// @param outputs The output of each input, in the same order.
+void checkOutputPaths(const std::vector<std::string> &inputs, const std::vector<std::string> &outputs);
+
+/// @brief Expands command-line inputs into a list of .tga files.
+/// @note A directory contributes every .tga file inside it (sorted), `@FILE` contributes the paths listed
+///       in FILE (one per line, blank lines and lines starting with `#` ignored) and anything else is taken
+///       as a file path.
+/// @param arguments The inputs.
+/// @return The files.
+std::vector<std::string> expandInputs(const std::vector<std::string> &arguments);
+
+/// @brief Processes many files through a pipeline, overlapping decode, compute and encode.
+/// @note Decoding and encoding run on `ioThreads` threads each; processing runs on the shared thread pool.
+///       Bounded queues between the stages cap memory at roughly `2 * queueDepth` images. Colliding outputs
+///       (see checkOutputPaths) fail the run before any file is read.
+/// @param options The settings of the run.
+/// @param log Receives one line per failed file and a summary.
+/// @return The outcome of the run.
+BatchResult runBatch(const BatchOptions &options, std::ostream &log);
+
+/// @brief Entry point of the command-line driver (`ImageProcessing run ...`).
+/// @param argc The number of arguments.
+/// @param argv The arguments.
+/// @return The process exit code.
+int runCommandLine(int argc, char *argv[]);
+
+#endif // BATCH_H
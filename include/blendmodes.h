@@ -0,0 +1,214 @@
+#ifndef BLENDMODES_H
+#define BLENDMODES_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "image.h"
+#include "imageview.h"
+
+/* Per-channel blend formulas (0...255 bytes in and out, rounded like the double-precision originals) */
+
+/// @brief Exact integer equivalent of `static_cast<unsigned char>(x / 255.0 + 0.5)` for 0 <= x <= 65025.
+constexpr unsigned char div255(unsigned int x)
+{
+    return static_cast<unsigned char>(((x + 128) + ((x + 128) >> 8)) >> 8);
+}
+
+/// @brief Multiply: `top * bottom / 255`.
+constexpr unsigned char multiplyBlend(unsigned char top, unsigned char bottom)
+{
+    return div255(top * bottom);
+}
+
+/// @brief Screen: `255 - (255 - top) * (255 - bottom) / 255`.
+constexpr unsigned char screenBlend(unsigned char top, unsigned char bottom)
+{
+    return 0xFF - div255((0xFF - top) * (0xFF - bottom));
+}
+
+/// @brief Overlay: multiply (doubled) below 50% gray background, screen (doubled) above.
+constexpr unsigned char overlayBlend(unsigned char top, unsigned char bottom)
+{
+    return bottom < 0x80 ? div255(2 * top * bottom) : 0xFF - div255(2 * (0xFF - top) * (0xFF - bottom));
+}
+
+/// @brief Subtract: `max(bottom - top, 0)`.
+constexpr unsigned char subtractBlend(unsigned char top, unsigned char bottom)
+{
+    return bottom < top ? 0 : bottom - top;
+}
+
+/// @brief Darken: the darker of the two channels.
+constexpr unsigned char darkenBlend(unsigned char top, unsigned char bottom)
+{
+    return top < bottom ? top : bottom;
+}
+
+/// @brief Lighten: the lighter of the two channels.
+constexpr unsigned char lightenBlend(unsigned char top, unsigned char bottom)
+{
+    return top < bottom ? bottom : top;
+}
+
+/// @brief Difference: `|top - bottom|`.
+constexpr unsigned char differenceBlend(unsigned char top, unsigned char bottom)
+{
+    return top < bottom ? bottom - top : top - bottom;
+}
+
+/// @brief Soft light (Pegtop formula): `(1 - 2 * top) * bottom^2 + 2 * top * bottom` on the domain 0...1.
+/// @note Continuous everywhere, unlike the piecewise Photoshop variant.
+constexpr unsigned char softLightBlend(unsigned char top, unsigned char bottom)
+{
+    return static_cast<unsigned char>((bottom * (0xFF * bottom + 2 * top * (0xFF - bottom)) + 32512) / 65025);
+}
+
+/// @brief Precomputed results of a blend formula for all 65,536 (top, bottom) byte pairs (64 KB).
+struct BlendTable
+{
+    unsigned char values[256 * 256]; // Indexed by `top * 256 + bottom`
+
+    /// @return The blended channel.
+    constexpr unsigned char operator()(unsigned char top, unsigned char bottom) const
+    {
+        return values[top << 8 | bottom];
+    }
+};
+
+/// @brief Tabulate a blend formula (usable at compile time: `constexpr BlendTable t = makeBlendTable(f);`).
+/// @param function Callable as `unsigned char function(unsigned char top, unsigned char bottom)`.
+/// @return The table.
+template <typename Function>
+constexpr BlendTable makeBlendTable(Function function)
+{
+    BlendTable table{};
+    for (unsigned int i = 0; i < 256 * 256; ++i)
+        table.values[i] = function(static_cast<unsigned char>(i >> 8), static_cast<unsigned char>(i & 0xFF));
+    return table;
+}
+
+/// @brief Blend interleaved 8-bit channels through a table.
+/// @param table The blend mode's table.
+/// @param top The top (foreground) channels.
+/// @param bottom The bottom (background) channels.
+/// @param out The destination channels (may alias either input).
+/// @param count The number of channels (bytes) to process.
+void blendTableKernel(const BlendTable &table, const unsigned char *top, const unsigned char *bottom, unsigned char *out,
+                      std::size_t count);
+
+/// @brief Register (or replace) a named blend mode.
+/// @note Modes are evaluated through their table. The built-in modes "multiply", "screen", "overlay",
+///       "subtract", "darken", "lighten", "difference" and "softLight" are always registered; the first four
+///       keep dispatching to their SIMD kernels when blended by name. Replacing a built-in mode drops that.
+/// @param name The name of the mode.
+/// @param table The table of the mode (copied).
+void registerBlendMode(const std::string &name, const BlendTable &table);
+
+/// @brief Register (or replace) a named blend mode from its per-channel formula, tabulated once here.
+/// @param name The name of the mode.
+/// @param function The formula, called once for each of the 65,536 (top, bottom) pairs.
+void registerBlendMode(const std::string &name, unsigned char (*function)(unsigned char top, unsigned char bottom));
+
+/// @brief How a registered mode is evaluated.
+struct BlendModeEntry
+{
+    const BlendTable *table; // The table of the mode; valid for the rest of the program
+    void (*kernel)(const unsigned char *, const unsigned char *, unsigned char *, std::size_t); // SIMD kernel or nullptr
+};
+
+/// @note Only the built-in multiply, screen, overlay and subtract modes have a SIMD kernel.
+/// @param name The name of a registered mode.
+/// @return The table and kernel of the mode.
+BlendModeEntry findBlendMode(const std::string &name);
+
+/// @param name The name of a registered mode.
+/// @return The table of the mode; valid for the rest of the program even if the mode is replaced later.
+const BlendTable &blendTable(const std::string &name);
+
+/// @return The names of all registered modes, sorted.
+std::vector<std::string> blendModeNames();
+
+/// @brief Blend two images with a registered mode.
+/// @param mode The name of the mode.
+/// @param top The top (foreground) image.
+/// @param bottom The bottom (background) image.
+/// @return The blended image.
+Image blendMode(const std::string &mode, const Image &top, const Image &bottom);
+
+/// @brief Blend two images with a registered mode into a caller-provided image.
+/// @note `result` may be `top` or `bottom` for an in-place operation.
+/// @param mode The name of the mode.
+/// @param top The top (foreground) image.
+/// @param bottom The bottom (background) image.
+/// @param result The image receiving the output; resized to match if needed.
+void blendMode(const std::string &mode, const Image &top, const Image &bottom, Image &result);
+
+/// @brief Blend two images through a table.
+/// @param table The table of the mode.
+/// @param top The top (foreground) image.
+/// @param bottom The bottom (background) image.
+/// @return The blended image.
+Image blendMode(const BlendTable &table, const Image &top, const Image &bottom);
+
+/// @brief Blend two images through a table into a caller-provided image.
+/// @note `result` may be `top` or `bottom` for an in-place operation.
+/// @param table The table of the mode.
+/// @param top The top (foreground) image.
+/// @param bottom The bottom (background) image.
+/// @param result The image receiving the output; resized to match if needed.
+void blendMode(const BlendTable &table, const Image &top, const Image &bottom, Image &result);
+
+/// @brief Blend two regions with a registered mode into a third (see imageview.h).
+/// @note The views must have the same size; `result` may be one of the inputs but must not partially overlap them.
+/// @param mode The name of the mode.
+/// @param top The top (foreground) region.
+/// @param bottom The bottom (background) region.
+/// @param result The region receiving the output.
+void blendMode(const std::string &mode, ConstImageView top, ConstImageView bottom, ImageView result);
+
+/// @brief Blend two regions through a table into a third (see imageview.h).
+/// @param table The table of the mode.
+/// @param top The top (foreground) region.
+/// @param bottom The bottom (background) region.
+/// @param result The region receiving the output.
+void blendMode(const BlendTable &table, ConstImageView top, ConstImageView bottom, ImageView result);
+
+/// @brief Keep the darker of the fore- and background's channels.
+/// @param foreground The foreground image.
+/// @param background The background image.
+/// @return The darkened image.
+Image darkenMode(const Image &foreground, const Image &background);
+
+/// @brief Darken blend into a caller-provided image (`result` may be either input).
+void darkenMode(const Image &foreground, const Image &background, Image &result);
+
+/// @brief Keep the lighter of the fore- and background's channels.
+/// @param foreground The foreground image.
+/// @param background The background image.
+/// @return The lightened image.
+Image lightenMode(const Image &foreground, const Image &background);
+
+/// @brief Lighten blend into a caller-provided image (`result` may be either input).
+void lightenMode(const Image &foreground, const Image &background, Image &result);
+
+/// @brief Absolute difference of the fore- and background's channels.
+/// @param foreground The foreground image.
+/// @param background The background image.
+/// @return The difference image.
+Image differenceMode(const Image &foreground, const Image &background);
+
+/// @brief Difference blend into a caller-provided image (`result` may be either input).
+void differenceMode(const Image &foreground, const Image &background, Image &result);
+
+/// @brief Soft light: a gentler overlay that darkens or lightens the background depending on the foreground.
+/// @param foreground The foreground image.
+/// @param background The background image.
+/// @return The blended image.
+Image softLightMode(const Image &foreground, const Image &background);
+
+/// @brief Soft light blend into a caller-provided image (`result` may be either input).
+void softLightMode(const Image &foreground, const Image &background, Image &result);
+
+#endif // BLENDMODES_H
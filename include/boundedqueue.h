@@ -0,0 +1,69 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+/// @brief A blocking multi-producer, multi-consumer FIFO with a fixed capacity.
+/// @note Producers block while the queue is full, which bounds the number of items in flight
+///       between pipeline stages.
+template <typename T>
+class BoundedQueue
+{
+public:
+    /// @brief Creates an empty queue.
+    /// @param capacity The maximum number of queued items (at least 1).
+    explicit BoundedQueue(std::size_t capacity) : capacity{capacity > 0 ? capacity : 1} {}
+
+    /// @brief Appends an item, waiting for room if the queue is full.
+    /// @param item The item to append.
+    /// @return `false` if the queue was closed (the item is dropped).
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        notFull.wait(lock, [this]
+                     { return closed || items.size() < capacity; });
+        if (closed)
+            return false;
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /// @brief Removes the oldest item, waiting for one if the queue is empty.
+    /// @return The item, or nothing once the queue is closed and drained.
+    std::optional<T> pop()
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        notEmpty.wait(lock, [this]
+                      { return closed || !items.empty(); });
+        if (items.empty())
+            return std::nullopt;
+        T item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return item;
+    }
+
+    /// @brief Stops accepting items; consumers drain what is left and then receive nothing.
+    void close()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+private:
+    std::size_t capacity;
+    std::deque<T> items;
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+};
+
+#endif // BOUNDEDQUEUE_H
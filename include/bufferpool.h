@@ -0,0 +1,86 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <cstddef>
+#include <new>
+
+/// @brief Counters of the shared buffer pool.
+struct BufferPoolStats
+{
+    std::size_t hits = 0;           // Allocations served from a recycled buffer
+    std::size_t misses = 0;         // Allocations that went to the system allocator
+    std::size_t bytesInUse = 0;     // Bytes currently handed out (rounded up to their size class)
+    std::size_t peakBytesInUse = 0; // Largest bytesInUse so far
+    std::size_t bytesCached = 0;    // Bytes of released buffers kept for reuse
+    std::size_t peakFootprint = 0;  // Largest bytesInUse + bytesCached so far
+
+    /// @return The fraction of allocations served from recycled buffers (0 before any allocation).
+    double hitRate() const;
+};
+
+/// @brief Alignment of every pool buffer in bytes (a cache line, and enough for any SIMD load).
+constexpr std::size_t BUFFER_ALIGNMENT = 64;
+
+/// @brief Get a buffer of at least `bytes` bytes from the shared pool.
+/// @note Sizes are rounded up to a size class (multiples of 64 bytes, at most 25% larger than asked for), so
+///       the bytes up to the next 64-byte boundary are always readable. Thread-safe.
+/// @param bytes The number of bytes needed.
+/// @return A BUFFER_ALIGNMENT-aligned buffer with indeterminate contents.
+void *acquireBuffer(std::size_t bytes);
+
+/// @brief Give a buffer back to the shared pool for reuse.
+/// @note Buffers beyond the cache limit go back to the system allocator. Thread-safe.
+/// @param buffer A buffer returned by acquireBuffer.
+/// @param bytes The size passed to acquireBuffer.
+void releaseBuffer(void *buffer, std::size_t bytes) noexcept;
+
+/// @return A snapshot of the pool counters.
+BufferPoolStats bufferPoolStats();
+
+/// @brief Reset the hit and miss counts, and the peaks to the current values.
+void resetBufferPoolStats();
+
+/// @brief Set how many bytes of released buffers the pool keeps for reuse (256 MB by default).
+/// @param bytes The limit; 0 disables recycling.
+void setBufferPoolLimit(std::size_t bytes);
+
+/// @brief Free every cached buffer.
+void trimBufferPool();
+
+/// @brief Standard allocator handing out buffers from the shared pool.
+template <typename T>
+struct PoolAllocator
+{
+    using value_type = T;
+
+    PoolAllocator() noexcept = default;
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &) noexcept {}
+
+    T *allocate(std::size_t count)
+    {
+        if (count > static_cast<std::size_t>(-1) / sizeof(T))
+            throw std::bad_array_new_length{};
+        return static_cast<T *>(acquireBuffer(count * sizeof(T)));
+    }
+
+    void deallocate(T *buffer, std::size_t count) noexcept
+    {
+        releaseBuffer(buffer, count * sizeof(T));
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T> &, const PoolAllocator<U> &) noexcept
+{
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T> &, const PoolAllocator<U> &) noexcept
+{
+    return false;
+}
+
+#endif // BUFFERPOOL_H
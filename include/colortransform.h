@@ -0,0 +1,146 @@
+#ifndef COLORTRANSFORM_H
+#define COLORTRANSFORM_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "image.h"
+#include "imageview.h"
+#include "kernels.h"
+
+/// @brief A channel of a pixel.
+enum class Channel
+{
+    Blue,
+    Green,
+    Red
+};
+
+/// @brief A 3x3 channel matrix. Row i gives output channel i (red, green, blue) as a weighted sum of the
+///        input red, green and blue channels.
+using ColorMatrix = std::array<std::array<double, 3>, 3>;
+
+/// @brief A chain of point operations compiled into as few passes over the pixels as possible.
+/// @note Every operation rounds and clamps to bytes, exactly as if it were applied to an image on its own,
+///       so a chain gives the same pixels as running its operations one after another. Operations are
+///       folded together as they are recorded:
+///       - per-channel operations (add, scale, gamma, invert, threshold, lut) compose into one lookup table
+///         per channel, and swizzles into the channel each table reads;
+///       - a matrix absorbs the tables before it into its weights, and the operations after it into its
+///         output tables.
+///       A chain without a matrix therefore costs one table lookup per channel, and each matrix costs one
+///       more pass over a cache-resident chunk, never another sweep over memory.
+class ColorTransform
+{
+public:
+    /// @brief Starts from the identity.
+    ColorTransform() = default;
+
+    /// @brief Appends an addition (see add), clamped to 255.
+    /// @param r The red byte value.
+    /// @param g The green byte value.
+    /// @param b The blue byte value.
+    /// @return The transform, for chaining.
+    ColorTransform &add(double r, double g, double b);
+
+    /// @brief Appends a scaling (see scale), clamped to 255.
+    /// @param r The red scale factor.
+    /// @param g The green scale factor.
+    /// @param b The blue scale factor.
+    /// @return The transform, for chaining.
+    ColorTransform &scale(double r, double g, double b);
+
+    /// @brief Appends a gamma curve `255 * (v / 255)^(1 / exponent)` on every channel.
+    /// @param exponent The gamma: above 1 brightens, below 1 darkens.
+    /// @return The transform, for chaining.
+    ColorTransform &gamma(double exponent);
+
+    /// @brief Appends a negative: every channel becomes `255 - v`.
+    /// @return The transform, for chaining.
+    ColorTransform &invert();
+
+    /// @brief Appends a threshold on every channel: values from `level` up become 255, the others 0.
+    /// @param level The lowest value that becomes 255 (0...256).
+    /// @return The transform, for chaining.
+    ColorTransform &threshold(int level);
+
+    /// @brief Appends a mapping of every channel through its own lookup table.
+    /// @param luts The lookup tables.
+    /// @return The transform, for chaining.
+    ColorTransform &lut(const ChannelLuts &luts);
+
+    /// @brief Appends a rearrangement of the channels.
+    /// @param r The channel the red output is taken from.
+    /// @param g The channel the green output is taken from.
+    /// @param b The channel the blue output is taken from.
+    /// @return The transform, for chaining.
+    ColorTransform &swizzle(Channel r, Channel g, Channel b);
+
+    /// @brief Appends a channel extraction (see extractRed): the channel is copied into all three.
+    /// @param channel The channel to keep.
+    /// @return The transform, for chaining.
+    ColorTransform &extract(Channel channel);
+
+    /// @brief Appends a channel matrix, rounded and clamped to bytes.
+    /// @note Coefficients are rounded to 16 fractional bits and must lie within [-16, 16].
+    /// @param matrix The matrix.
+    /// @return The transform, for chaining.
+    ColorTransform &matrix(const ColorMatrix &matrix);
+
+    /// @brief Appends another transform.
+    /// @param next The transform applied after this one.
+    /// @return The transform, for chaining.
+    ColorTransform &then(const ColorTransform &next);
+
+    /// @return `true` if the operations cancelled out to nothing (the transform copies pixels); otherwise `false`.
+    bool isIdentity() const { return stages.empty(); }
+
+    /// @return The number of stages each chunk of pixels goes through (one more per matrix after the first).
+    std::size_t stageCount() const { return stages.size(); }
+
+    /// @brief Transforms interleaved BGR pixels.
+    /// @param in The source pixels.
+    /// @param out The destination pixels (may alias `in`).
+    /// @param pixelCount The number of pixels to process.
+    void apply(const unsigned char *in, unsigned char *out, std::size_t pixelCount) const;
+
+    /// @brief Transforms an image into a caller-provided image, in parallel bands.
+    /// @note `result` may be `image` for an in-place operation.
+    /// @param image The image to transform.
+    /// @param result The image receiving the output; resized to match if needed.
+    void apply(const Image &image, Image &result) const;
+
+    /// @brief Transforms a region into another of the same size, row by row in parallel bands.
+    /// @note `result` may be `image` but must not partially overlap it.
+    /// @param image The region to transform.
+    /// @param result The region receiving the output.
+    void apply(ConstImageView image, ImageView result) const;
+
+    /// @brief Transforms an image.
+    /// @param image The image to transform.
+    /// @return The transformed image.
+    Image apply(const Image &image) const;
+
+private:
+    /// @brief One pass of the compiled transform: an optional channel matrix, then one table per output.
+    ///        Outputs and matrix columns are indexed in BGR order.
+    struct Stage
+    {
+        int sources[3] = {0, 1, 2};  // Input channel read by each output, or by each matrix column
+        bool mixes = false;          // Whether the stage has a matrix
+        ChannelLuts inputs;          // Mapping of each matrix column before mixing
+        std::int32_t matrix[9] = {}; // Coefficients in 16.16 fixed point (see matrixKernel)
+        ChannelLuts tables;          // Final mapping of each output
+        bool plainInputs = true;     // Whether the columns read the input channels unmapped (cached)
+        bool plainTables = false;    // Whether the final tables are the identity (cached)
+    };
+
+    /// @brief Appends a stage, folding it into the last one when possible.
+    void append(const Stage &stage);
+
+    std::vector<Stage> stages;
+};
+
+#endif // COLORTRANSFORM_H
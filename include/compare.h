@@ -0,0 +1,43 @@
+#ifndef COMPARE_H
+#define COMPARE_H
+
+#include "image.h"
+
+/// @brief How much two images differ.
+/// @note Images of different sizes are not compared pixel by pixel: they count as completely different
+///       (every pixel mismatched, maximum error 255, PSNR 0).
+struct ImageDifference
+{
+    bool sameSize = true;              // Whether the widths and heights match
+    std::size_t mismatchedPixels = 0;  // Pixels with at least one differing channel
+    int maxAbsError = 0;               // Largest absolute difference of any channel (0...255)
+    double meanSquaredError = 0.0;     // Mean of the squared channel differences
+    double psnr = 0.0;                 // Peak signal-to-noise ratio in dB (infinite when identical)
+
+    /// @return `true` if the images have the same size and pixels; otherwise `false`.
+    bool identical() const { return sameSize && mismatchedPixels == 0; }
+};
+
+/// @return `true` if the images have the same size and pixels; otherwise `false`.
+/// @note Compares raw memory in parallel bands and stops at the first differing band.
+bool imagesEqual(const Image &first, const Image &second);
+
+/// @brief Measure how much an image differs from a reference.
+/// @note Identical images are recognised with a memory comparison; otherwise every statistic is gathered in
+///       one parallel pass.
+/// @param actual The image to check.
+/// @param expected The reference image.
+/// @return The difference.
+ImageDifference compareImages(const Image &actual, const Image &expected);
+
+/// @brief Measure how much an image differs from a reference, and draw where.
+/// @note The heatmap has the size of `actual` and maps the largest channel difference of each pixel to a
+///       color: black where the pixels match, then blue, red, yellow and white as the difference grows
+///       towards 255. Images of different sizes give an all-white heatmap.
+/// @param actual The image to check.
+/// @param expected The reference image.
+/// @param heatmap The image receiving the heatmap; resized to match if needed.
+/// @return The difference.
+ImageDifference compareImages(const Image &actual, const Image &expected, Image &heatmap);
+
+#endif // COMPARE_H
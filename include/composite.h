@@ -0,0 +1,156 @@
+#ifndef COMPOSITE_H
+#define COMPOSITE_H
+
+#include <vector>
+
+#include "blendmodes.h"
+#include "image.h"
+#include "kernels.h"
+#include "rgbaimage.h"
+
+/* Per-channel compositing formulas on premultiplied values (alpha composites with the same formula)
+   Each blend mode B uses the separable formula `top * (1 - bottomAlpha) + bottom * (1 - topAlpha) +
+   topAlpha * bottomAlpha * B(top / topAlpha, bottom / bottomAlpha)`, with the division by alpha cancelled out so
+   it stays in integers. Between opaque pixels they give exactly the bytes of the blendmodes.h formulas. */
+
+/// @brief Over: `top + bottom * (255 - topAlpha) / 255`.
+constexpr unsigned char overComposite(unsigned char top, unsigned char bottom, unsigned char topAlpha, unsigned char)
+{
+    unsigned int sum = top + div255(bottom * (0xFF - topAlpha));
+    return static_cast<unsigned char>(sum > 0xFF ? 0xFF : sum);
+}
+
+/// @brief In: `top * bottomAlpha / 255`.
+constexpr unsigned char inComposite(unsigned char top, unsigned char, unsigned char, unsigned char bottomAlpha)
+{
+    return div255(top * bottomAlpha);
+}
+
+/// @brief Out: `top * (255 - bottomAlpha) / 255`.
+constexpr unsigned char outComposite(unsigned char top, unsigned char, unsigned char, unsigned char bottomAlpha)
+{
+    return div255(top * (0xFF - bottomAlpha));
+}
+
+/// @brief Multiply: `top * (255 - bottomAlpha) + bottom * (255 - topAlpha) + top * bottom`, divided by 255.
+constexpr unsigned char multiplyComposite(unsigned char top, unsigned char bottom, unsigned char topAlpha,
+                                          unsigned char bottomAlpha)
+{
+    return div255(top * (0xFF - bottomAlpha) + bottom * (0xFF - topAlpha) + top * bottom);
+}
+
+/// @brief Screen: `255 * (top + bottom) - top * bottom`, divided by 255.
+constexpr unsigned char screenComposite(unsigned char top, unsigned char bottom, unsigned char, unsigned char)
+{
+    return div255(0xFF * (top + bottom) - top * bottom);
+}
+
+/// @brief Overlay: multiply (doubled) where the background is below half its alpha, screen (doubled) above.
+constexpr unsigned char overlayComposite(unsigned char top, unsigned char bottom, unsigned char topAlpha,
+                                         unsigned char bottomAlpha)
+{
+    return div255(top * (0xFF - bottomAlpha) + bottom * (0xFF - topAlpha) +
+                  (2 * bottom <= bottomAlpha ? 2 * top * bottom
+                                             : topAlpha * bottomAlpha - 2 * (bottomAlpha - bottom) * (topAlpha - top)));
+}
+
+/// @brief Composite two images with a Porter-Duff operator or an alpha-aware blend mode.
+/// @param mode The operator.
+/// @param top The top (source) image.
+/// @param bottom The bottom (destination) image.
+/// @return The composited image.
+ImageRGBA composite(CompositeMode mode, const ImageRGBA &top, const ImageRGBA &bottom);
+
+/// @brief Composite two images into a caller-provided image.
+/// @note `result` may be `top` or `bottom` for an in-place operation.
+/// @param mode The operator.
+/// @param top The top (source) image.
+/// @param bottom The bottom (destination) image.
+/// @param result The image receiving the output; resized to match if needed.
+void composite(CompositeMode mode, const ImageRGBA &top, const ImageRGBA &bottom, ImageRGBA &result);
+
+/// @brief Place the top image over the bottom one (the bottom shows through where the top is transparent).
+/// @param top The top image.
+/// @param bottom The bottom image.
+/// @return The composited image.
+ImageRGBA overMode(const ImageRGBA &top, const ImageRGBA &bottom);
+
+/// @brief Over composite into a caller-provided image (`result` may be either input).
+void overMode(const ImageRGBA &top, const ImageRGBA &bottom, ImageRGBA &result);
+
+/// @brief Keep the top image where the bottom one is opaque (its alpha masks the top).
+/// @param top The top image.
+/// @param bottom The mask.
+/// @return The masked image.
+ImageRGBA inMode(const ImageRGBA &top, const ImageRGBA &bottom);
+
+/// @brief In composite into a caller-provided image (`result` may be either input).
+void inMode(const ImageRGBA &top, const ImageRGBA &bottom, ImageRGBA &result);
+
+/// @brief Keep the top image where the bottom one is transparent (its alpha cuts the top out).
+/// @param top The top image.
+/// @param bottom The mask.
+/// @return The masked image.
+ImageRGBA outMode(const ImageRGBA &top, const ImageRGBA &bottom);
+
+/// @brief Out composite into a caller-provided image (`result` may be either input).
+void outMode(const ImageRGBA &top, const ImageRGBA &bottom, ImageRGBA &result);
+
+/// @brief Multiply blend honouring the alpha of both layers (see multiplyMode(const Image &, const Image &)).
+/// @param top The top layer.
+/// @param bottom The bottom layer.
+/// @return The blended image.
+ImageRGBA multiplyMode(const ImageRGBA &top, const ImageRGBA &bottom);
+
+/// @brief Alpha-aware multiply blend into a caller-provided image (`result` may be either input).
+void multiplyMode(const ImageRGBA &top, const ImageRGBA &bottom, ImageRGBA &result);
+
+/// @brief Screen blend honouring the alpha of both layers (see screenMode(const Image &, const Image &)).
+/// @param top The top layer.
+/// @param bottom The bottom layer.
+/// @return The blended image.
+ImageRGBA screenMode(const ImageRGBA &top, const ImageRGBA &bottom);
+
+/// @brief Alpha-aware screen blend into a caller-provided image (`result` may be either input).
+void screenMode(const ImageRGBA &top, const ImageRGBA &bottom, ImageRGBA &result);
+
+/// @brief Overlay blend honouring the alpha of both layers (see overlayMode(const Image &, const Image &)).
+/// @param top The top layer.
+/// @param bottom The bottom layer.
+/// @return The blended image.
+ImageRGBA overlayMode(const ImageRGBA &top, const ImageRGBA &bottom);
+
+/// @brief Alpha-aware overlay blend into a caller-provided image (`result` may be either input).
+void overlayMode(const ImageRGBA &top, const ImageRGBA &bottom, ImageRGBA &result);
+
+/// @brief Place a transparent layer over an opaque image.
+/// @param top The layer.
+/// @param bottom The image.
+/// @return The opaque composited image.
+Image overMode(const ImageRGBA &top, const Image &bottom);
+
+/// @brief Over composite onto an opaque image into a caller-provided image (`result` may be `bottom`).
+void overMode(const ImageRGBA &top, const Image &bottom, Image &result);
+
+/// @brief Composite an image over a solid background and drop its alpha channel.
+/// @param image The image.
+/// @param background The color showing through transparent pixels.
+/// @return The opaque image.
+Image flatten(const ImageRGBA &image, const Pixel &background = Pixel{});
+
+/// @brief One layer of a stack composited by compositeLayers.
+struct CompositeLayer
+{
+    const ImageRGBA *image;                  // The layer; must have the size of the stack
+    CompositeMode mode = CompositeMode::Over; // How the layer combines with everything below it
+};
+
+/// @brief Composite a stack of layers, bottom to top, in a single pass.
+/// @note Each strip of pixels goes through every layer while it is in cache, so the stack costs one read of
+///       each layer and one write of the result instead of a full pass per layer.
+/// @param base The bottom of the stack.
+/// @param layers The layers above it, bottom first.
+/// @return The composited image.
+ImageRGBA compositeLayers(const ImageRGBA &base, const std::vector<CompositeLayer> &layers);
+
+#endif // COMPOSITE_H
@@ -0,0 +1,91 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <vector>
+
+#include "image.h"
+
+/// @brief How neighbourhood filters read pixels beyond the image borders.
+enum class EdgeMode
+{
+    Clamp,  // Repeat the border pixel: ... a a | a b c
+    Reflect // Mirror at the border, the border pixel included: ... c b a | a b c
+};
+
+/// @brief Convolve the image with a separable kernel: first along rows, then along columns.
+/// @note Kernels have an odd number of taps centered on the pixel; weights are used as given (normalize them
+///       for a brightness-preserving blur). Intermediate values keep float precision and the output is rounded
+///       and clamped to 0...255. `result` may be `image`.
+/// @param image The image to filter.
+/// @param result The image receiving the output; resized to match if needed.
+/// @param horizontal The weights applied along each row.
+/// @param vertical The weights applied along each column.
+/// @param edges How pixels beyond the borders are read.
+void convolveSeparable(const Image &image, Image &result, const std::vector<float> &horizontal,
+                       const std::vector<float> &vertical, EdgeMode edges = EdgeMode::Clamp);
+
+/// @brief Convolve the image with a separable kernel.
+/// @param image The image to filter.
+/// @param horizontal The weights applied along each row.
+/// @param vertical The weights applied along each column.
+/// @param edges How pixels beyond the borders are read.
+/// @return The filtered image.
+Image convolveSeparable(const Image &image, const std::vector<float> &horizontal, const std::vector<float> &vertical,
+                        EdgeMode edges = EdgeMode::Clamp);
+
+/// @brief Build normalized Gaussian weights.
+/// @param sigma The standard deviation in pixels (must be positive).
+/// @return `2 * ceil(3 * sigma) + 1` weights summing to 1.
+std::vector<float> gaussianKernel(double sigma);
+
+/// @brief Average every pixel with its (2 * radius + 1)^2 neighbourhood.
+/// @note Running sums make the cost independent of the radius; integer arithmetic keeps the result exact.
+///       `result` may be `image`.
+/// @param image The image to blur.
+/// @param result The image receiving the output; resized to match if needed.
+/// @param radius The number of pixels on each side of the center (0 copies the image).
+/// @param edges How pixels beyond the borders are read.
+void boxBlur(const Image &image, Image &result, int radius, EdgeMode edges = EdgeMode::Clamp);
+
+/// @brief Average every pixel with its (2 * radius + 1)^2 neighbourhood.
+/// @param image The image to blur.
+/// @param radius The number of pixels on each side of the center.
+/// @param edges How pixels beyond the borders are read.
+/// @return The blurred image.
+Image boxBlur(const Image &image, int radius, EdgeMode edges = EdgeMode::Clamp);
+
+/// @brief Gaussian blur.
+/// @note Small sigmas (below 2) convolve with exact Gaussian weights; larger ones run three box blurs sized to
+///       match the Gaussian's variance, which keeps the cost independent of sigma. `result` may be `image`.
+/// @param image The image to blur.
+/// @param result The image receiving the output; resized to match if needed.
+/// @param sigma The standard deviation in pixels (0 copies the image).
+/// @param edges How pixels beyond the borders are read.
+void gaussianBlur(const Image &image, Image &result, double sigma, EdgeMode edges = EdgeMode::Clamp);
+
+/// @brief Gaussian blur.
+/// @param image The image to blur.
+/// @param sigma The standard deviation in pixels.
+/// @param edges How pixels beyond the borders are read.
+/// @return The blurred image.
+Image gaussianBlur(const Image &image, double sigma, EdgeMode edges = EdgeMode::Clamp);
+
+/// @brief Sharpen by adding back the difference between the image and a Gaussian blur of it.
+/// @note `out = image + amount * (image - blurred)` per channel, clamped; channels whose difference is below
+///       `threshold` are left unchanged so flat areas do not gain noise. `result` may be `image`.
+/// @param image The image to sharpen.
+/// @param result The image receiving the output; resized to match if needed.
+/// @param sigma The standard deviation of the blur in pixels.
+/// @param amount The strength of the sharpening (1 doubles the local contrast).
+/// @param threshold The smallest channel difference that gets sharpened.
+void unsharpMask(const Image &image, Image &result, double sigma, double amount, int threshold = 0);
+
+/// @brief Sharpen by adding back the difference between the image and a Gaussian blur of it.
+/// @param image The image to sharpen.
+/// @param sigma The standard deviation of the blur in pixels.
+/// @param amount The strength of the sharpening.
+/// @param threshold The smallest channel difference that gets sharpened.
+/// @return The sharpened image.
+Image unsharpMask(const Image &image, double sigma, double amount, int threshold = 0);
+
+#endif // FILTER_H
@@ -1,6 +1,8 @@
 #ifndef HEADER_H
 #define HEADER_H
 
+#include <cstddef>
+
 /// @brief TGA file format header which stores pieces of information describing the image content.
 struct Header
 {
@@ -18,4 +20,29 @@ struct Header
     char imageDescriptor; // Image Descriptor
 };
 
+/// @brief Size of the header as stored in a .tga file (the struct itself is padded).
+constexpr std::size_t HEADER_SIZE = 18;
+
+/// @return The width of the image in pixels (the field is an unsigned 16-bit value in the file).
+inline int imageWidth(const Header &header)
+{
+    return static_cast<unsigned short>(header.width);
+}
+
+/// @return The height of the image in pixels (the field is an unsigned 16-bit value in the file).
+inline int imageHeight(const Header &header)
+{
+    return static_cast<unsigned short>(header.height);
+}
+
+/// @brief Decode a header from its 18-byte little-endian file representation.
+/// @param bytes The first HEADER_SIZE bytes of a .tga file.
+/// @return The decoded header.
+Header parseHeader(const unsigned char *bytes);
+
+/// @brief Encode a header into its 18-byte little-endian file representation.
+/// @param header The header to encode.
+/// @param bytes The destination (at least HEADER_SIZE bytes).
+void serializeHeader(const Header &header, unsigned char *bytes);
+
 #endif
\ No newline at end of file
@@ -4,23 +4,47 @@
 #include <vector>
 #include <string>
 
+#include "bufferpool.h"
 #include "header.h"
 #include "pixel.h"
+#include "tga.h"
+
+/// @brief Pixel storage drawn from the shared buffer pool: 64-byte aligned and recycled when released.
+using PixelBuffer = std::vector<Pixel, PoolAllocator<Pixel>>;
 
 /// @brief Manages the header and pixel data of an image.
-/// @note The files will be 24-bit true color, uncompressed images.
+/// @note Pixels are held as 24-bit BGR, bottom row first. Files of any supported .tga format (color-mapped,
+///       true color or grayscale, raw or run-length encoded, any origin) are converted on load, and the
+///       header is normalized to describe the in-memory layout (uncompressed 24-bit, bottom-left origin).
 struct Image
 {
     Header header;             // The header data for the image
-    std::vector<Pixel> pixels; // The pixels in the image
+    PixelBuffer pixels;        // The pixels in the image
 
-    /// @brief Constructs an Image object from from a .vga image file.
-    /// @param file The path to the .vga file to read an image from.
+    /// @brief Constructs an Image object from from a .tga image file.
+    /// @note Alpha channels are discarded and grayscale values are copied to all three channels.
+    /// @param file The path to the .tga file to read an image from.
     Image(const std::string &file);
 
-    /// @brief Write an image to a .vga file.
-    /// @param file The path to the .vga file to write an image to.
-    void write(const std::string &file);
+    /// @brief Constructs a blank (black) image described by a header.
+    /// @param header The header data; its width and height determine the number of pixels.
+    explicit Image(const Header &header);
+
+    /// @brief Write an image to an uncompressed 24-bit .tga file.
+    /// @param file The path to the .tga file to write an image to.
+    void write(const std::string &file) const;
+
+    /// @brief Write an image to a .tga file with the given encoding.
+    /// @note Grayscale encodings store the luminance of each pixel.
+    /// @param file The path to the .tga file to write an image to.
+    /// @param encoding The pixel encoding of the file.
+    void write(const std::string &file, TgaEncoding encoding) const;
 };
 
+/// @brief Give `result` the header and pixel count of `source`, reusing its buffer when large enough.
+/// @note Used by the operations writing into a caller-provided image; does nothing when `result` is `source`.
+/// @param source The image whose size to take.
+/// @param result The image to resize; its pixel values are left to be overwritten.
+void prepareResult(const Image &source, Image &result);
+
 #endif // IMAGE_H
\ No newline at end of file
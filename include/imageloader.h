@@ -0,0 +1,107 @@
+#ifndef IMAGELOADER_H
+#define IMAGELOADER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "image.h"
+
+/// @brief A decoded image shared between an ImageLoader's cache and its users.
+using SharedImage = std::shared_ptr<const Image>;
+
+/// @brief Counters of an ImageLoader.
+struct ImageLoaderStats
+{
+    std::size_t hits = 0;         // Loads answered by an image already decoded, being decoded or read ahead
+    std::size_t misses = 0;       // Loads that had to queue a decode
+    std::size_t evictions = 0;    // Decoded images dropped to stay within the cache limit
+    std::size_t imagesCached = 0; // Decoded images held by the cache
+    std::size_t bytesCached = 0;  // Pixel bytes of the decoded images held by the cache
+};
+
+/// @brief Decodes .tga images on background I/O threads and keeps recently used ones.
+/// @note load() returns at once with a future, so reading and decoding overlap with whatever the caller does
+///       until it needs the pixels. Files requested with load() are decoded before files that were only
+///       prefetched. Decoded images stay in a least-recently-used cache bounded by their pixel bytes; evicting one
+///       only drops the cache's reference, so images still held by users stay valid. Failed loads are not
+///       cached: their future rethrows the error and the next load tries again. Thread-safe.
+class ImageLoader
+{
+public:
+    /// @brief Starts the I/O threads.
+    /// @param cacheLimit The most pixel bytes of decoded images the cache keeps (256 MB by default).
+    /// @param ioThreads The number of threads reading and decoding files (at least 1).
+    explicit ImageLoader(std::size_t cacheLimit = std::size_t{256} << 20, unsigned int ioThreads = 1);
+
+    /// @brief Waits for the decodes in progress; loads still queued fail with an error.
+    ~ImageLoader();
+
+    ImageLoader(const ImageLoader &) = delete;
+    ImageLoader &operator=(const ImageLoader &) = delete;
+
+    /// @brief Requests an image, decoding it in the background unless it is cached.
+    /// @param file The path to the .tga file.
+    /// @return The future image; `get()` waits for it (and rethrows if the file could not be loaded).
+    std::shared_future<SharedImage> load(const std::string &file);
+
+    /// @brief Reads an image ahead, once the files requested with load() are done.
+    /// @param file The path to the .tga file.
+    void prefetch(const std::string &file);
+
+    /// @brief Reads several images ahead, in order.
+    /// @param files The paths to the .tga files.
+    void prefetch(const std::vector<std::string> &files);
+
+    /// @brief Changes the cache limit, evicting the least recently used images beyond it.
+    /// @param bytes The most pixel bytes of decoded images to keep; 0 keeps nothing after it is delivered.
+    void setCacheLimit(std::size_t bytes);
+
+    /// @brief Drops every decoded image from the cache (decodes in progress are unaffected).
+    void clear();
+
+    /// @return A snapshot of the counters.
+    ImageLoaderStats stats() const;
+
+private:
+    enum class State
+    {
+        Queued,  // Waiting for an I/O thread
+        Loading, // Being read and decoded
+        Ready    // Decoded and in the cache
+    };
+
+    struct Entry
+    {
+        State state = State::Queued;
+        std::promise<SharedImage> promise;       // Fulfilled by the I/O thread (moved out when it starts)
+        std::shared_future<SharedImage> future;  // Handed to every load of the file
+        std::size_t bytes = 0;                   // Pixel bytes once decoded
+        std::list<std::string>::iterator recent; // Position in the recency list once decoded
+    };
+
+    Entry &request(const std::string &file, bool &created);
+    void workerLoop();
+    void evict();
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::unordered_map<std::string, Entry> entries;
+    std::deque<std::string> demanded;  // Files requested with load(), decoded first
+    std::deque<std::string> readAhead; // Files requested with prefetch()
+    std::list<std::string> recent;     // Decoded files, most recently used first
+    std::size_t limit;
+    ImageLoaderStats counters;
+    std::vector<std::thread> workers;
+};
+
+#endif // IMAGELOADER_H
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "image.h"
+#include "imageview.h"
 
 /// @brief Multiply the standardized (based on the domain 0...1) tonal values
 ///        of the fore- and background's pixels.
@@ -11,6 +12,18 @@
 /// @return The multiplied image.
 Image multiplyMode(const Image &foreground, const Image &background);
 
+/// @brief Multiply blend into a caller-provided image (no allocation once `result` has the right size).
+/// @note `result` may be `foreground` or `background` for an in-place operation.
+/// @param foreground The foreground image.
+/// @param background The background image.
+/// @param result The image receiving the output; resized to match if needed.
+void multiplyMode(const Image &foreground, const Image &background, Image &result);
+
+/// @brief Move-aware overloads of multiplyMode that reuse the buffer of an expiring input for the output.
+Image multiplyMode(Image &&foreground, const Image &background);
+Image multiplyMode(const Image &foreground, Image &&background);
+Image multiplyMode(Image &&foreground, Image &&background);
+
 /// @brief The opposite of multiply. Fore- and background are negatively multiplied
 ///        and lighten each other.
 /// @note  The effect can be compared to two slides projected with different projectors onto the same screen.
@@ -19,6 +32,18 @@ Image multiplyMode(const Image &foreground, const Image &background);
 /// @return The screened image.
 Image screenMode(const Image &foreground, const Image &background);
 
+/// @brief Screen blend into a caller-provided image (no allocation once `result` has the right size).
+/// @note `result` may be `foreground` or `background` for an in-place operation.
+/// @param foreground The foreground image.
+/// @param background The background image.
+/// @param result The image receiving the output; resized to match if needed.
+void screenMode(const Image &foreground, const Image &background, Image &result);
+
+/// @brief Move-aware overloads of screenMode that reuse the buffer of an expiring input for the output.
+Image screenMode(Image &&foreground, const Image &background);
+Image screenMode(const Image &foreground, Image &&background);
+Image screenMode(Image &&foreground, Image &&background);
+
 /// @brief A combination of the modes Multiply and Screen, dependent on the background's tonal value.
 /// @note If the background is darker than 50% gray, the tonal values get multiplied,
 ///       otherwise they get screened (and afterwards they are doubled in both cases).
@@ -27,12 +52,36 @@ Image screenMode(const Image &foreground, const Image &background);
 /// @return The overlayed image.
 Image overlayMode(const Image &foreground, const Image &background);
 
+/// @brief Overlay blend into a caller-provided image (no allocation once `result` has the right size).
+/// @note `result` may be `foreground` or `background` for an in-place operation.
+/// @param foreground The foreground image.
+/// @param background The background image.
+/// @param result The image receiving the output; resized to match if needed.
+void overlayMode(const Image &foreground, const Image &background, Image &result);
+
+/// @brief Move-aware overloads of overlayMode that reuse the buffer of an expiring input for the output.
+Image overlayMode(Image &&foreground, const Image &background);
+Image overlayMode(const Image &foreground, Image &&background);
+Image overlayMode(Image &&foreground, Image &&background);
+
 /// @brief Subtracts the top layer from the bottom layer.
 /// @param topLayer The top layer image.
 /// @param bottomLayer The bottom layer image.
 /// @return The subtracted image.
 Image subtractMode(const Image &topLayer, const Image &bottomLayer);
 
+/// @brief Subtraction into a caller-provided image (no allocation once `result` has the right size).
+/// @note `result` may be `topLayer` or `bottomLayer` for an in-place operation.
+/// @param topLayer The top layer image.
+/// @param bottomLayer The bottom layer image.
+/// @param result The image receiving the output; resized to match if needed.
+void subtractMode(const Image &topLayer, const Image &bottomLayer, Image &result);
+
+/// @brief Move-aware overloads of subtractMode that reuse the buffer of an expiring input for the output.
+Image subtractMode(Image &&topLayer, const Image &bottomLayer);
+Image subtractMode(const Image &topLayer, Image &&bottomLayer);
+Image subtractMode(Image &&topLayer, Image &&bottomLayer);
+
 /// @brief Common mathematical addition. Add to the image the passed in values.
 /// @param image The image to add to.
 /// @param r The red byte value.
@@ -41,6 +90,18 @@ Image subtractMode(const Image &topLayer, const Image &bottomLayer);
 /// @return The added image.
 Image add(const Image &image, double r = 1.0, double g = 1.0, double b = 1.0);
 
+/// @brief Addition into a caller-provided image (no allocation once `result` has the right size).
+/// @note `result` may be `image` for an in-place operation.
+/// @param image The image to add to.
+/// @param result The image receiving the output; resized to match if needed.
+/// @param r The red byte value.
+/// @param g The green byte value.
+/// @param b The blue byte value.
+void add(const Image &image, Image &result, double r = 1.0, double g = 1.0, double b = 1.0);
+
+/// @brief Move-aware overload of add that reuses the buffer of an expiring input for the output.
+Image add(Image &&image, double r = 1.0, double g = 1.0, double b = 1.0);
+
 /// @brief Common mathematical multiplication. Scale the image by the passed in values.
 /// @param image The image to scale.
 /// @param r The red byte value.
@@ -49,24 +110,63 @@ Image add(const Image &image, double r = 1.0, double g = 1.0, double b = 1.0);
 /// @return The scaled image.
 Image scale(const Image &image, double r = 1.0, double g = 1.0, double b = 1.0);
 
+/// @brief Scaling into a caller-provided image (no allocation once `result` has the right size).
+/// @note `result` may be `image` for an in-place operation.
+/// @param image The image to scale.
+/// @param result The image receiving the output; resized to match if needed.
+/// @param r The red byte value.
+/// @param g The green byte value.
+/// @param b The blue byte value.
+void scale(const Image &image, Image &result, double r = 1.0, double g = 1.0, double b = 1.0);
+
+/// @brief Move-aware overload of scale that reuses the buffer of an expiring input for the output.
+Image scale(Image &&image, double r = 1.0, double g = 1.0, double b = 1.0);
+
 /// @brief Extract the red channel from an image.
 /// @note Each channel contains the red channel value.
 /// @param image The image.
 /// @return The red channel image.
 Image extractRed(const Image &image);
 
+/// @brief Red channel extraction into a caller-provided image (no allocation once `result` has the right size).
+/// @note `result` may be `image` for an in-place operation.
+/// @param image The image.
+/// @param result The image receiving the output; resized to match if needed.
+void extractRed(const Image &image, Image &result);
+
+/// @brief Move-aware overload of extractRed that reuses the buffer of an expiring input for the output.
+Image extractRed(Image &&image);
+
 /// @brief Extract the green channel from an image.
 /// @note Each channel contains the green channel value.
 /// @param image The image.
 /// @return The green channel image.
 Image extractGreen(const Image &image);
 
+/// @brief Green channel extraction into a caller-provided image (no allocation once `result` has the right size).
+/// @note `result` may be `image` for an in-place operation.
+/// @param image The image.
+/// @param result The image receiving the output; resized to match if needed.
+void extractGreen(const Image &image, Image &result);
+
+/// @brief Move-aware overload of extractGreen that reuses the buffer of an expiring input for the output.
+Image extractGreen(Image &&image);
+
 /// @brief Extract the blue channel from an image.
 /// @note Each channel contains the blue channel value.
 /// @param image The image.
 /// @return The blue channel image.
 Image extractBlue(const Image &image);
 
+/// @brief Blue channel extraction into a caller-provided image (no allocation once `result` has the right size).
+/// @note `result` may be `image` for an in-place operation.
+/// @param image The image.
+/// @param result The image receiving the output; resized to match if needed.
+void extractBlue(const Image &image, Image &result);
+
+/// @brief Move-aware overload of extractBlue that reuses the buffer of an expiring input for the output.
+Image extractBlue(Image &&image);
+
 /// @brief Combine three red, green, and blue channels into one image.
 /// @param red The red channel image.
 /// @param green The green channel image.
@@ -74,15 +174,83 @@ Image extractBlue(const Image &image);
 /// @return The combined image.
 Image combineChannels(const Image &red, const Image &green, const Image &blue);
 
+/// @brief Channel combination into a caller-provided image (no allocation once `result` has the right size).
+/// @note `result` may be any of the channel images for an in-place operation.
+/// @param red The red channel image.
+/// @param green The green channel image.
+/// @param blue The blue channel image.
+/// @param result The image receiving the output; resized to match if needed.
+void combineChannels(const Image &red, const Image &green, const Image &blue, Image &result);
+
+/// @brief Move-aware overload of combineChannels that reuses the buffer of the expiring red channel image.
+Image combineChannels(Image &&red, const Image &green, const Image &blue);
+
 /// @brief Rotate an image by 180 degrees.
 /// @param image The image to rotate.
 /// @return The rotated image.
 Image rotate180(const Image &image);
 
+/// @brief Rotation by 180 degrees into a caller-provided image (no allocation once `result` has the right size).
+/// @note `result` may be `image` for an in-place operation.
+/// @param image The image.
+/// @param result The image receiving the output; resized to match if needed.
+void rotate180(const Image &image, Image &result);
+
+/// @brief Move-aware overload of rotate180 that reuses the buffer of an expiring input for the output.
+Image rotate180(Image &&image);
+
 /// @brief Combines four images where each is a quadrant in the final image.
+/// @note Built on composeMosaic (see mosaic.h): quadrants may differ in size, each column being as wide as its
+///       widest image and each row as tall as its tallest, with uncovered pixels left black.
 /// @param first The first quadrant image (top left).
 /// @param second The second quadrant image (top right).
 /// @param third The third quadrant image (bottom right).
 /// @param fourth The fourth quadrant image (bottom left).
 /// @return The combined image.
-Image combineQuadrants(const Image &first, const Image &second, const Image &third, const Image &fourth);
\ No newline at end of file
+Image combineQuadrants(const Image &first, const Image &second, const Image &third, const Image &fourth);
+
+/// @brief Quadrant combination into a caller-provided image (no allocation once `result` has the right size).
+/// @note `result` must not be one of the quadrant images.
+/// @param first The first quadrant image (top left).
+/// @param second The second quadrant image (top right).
+/// @param third The third quadrant image (bottom right).
+/// @param fourth The fourth quadrant image (bottom left).
+/// @param result The image receiving the output; resized to match if needed.
+void combineQuadrants(const Image &first, const Image &second, const Image &third, const Image &fourth, Image &result);
+
+/* Region overloads: the same operations reading and writing views (see imageview.h), so a region of a larger
+   image is processed where it lies, without copies. All views of a call must have the same size. `result`
+   may be one of the inputs but must not partially overlap them. */
+
+/// @brief Multiply blend of two regions into a third (see multiplyMode).
+void multiplyMode(ConstImageView foreground, ConstImageView background, ImageView result);
+
+/// @brief Screen blend of two regions into a third (see screenMode).
+void screenMode(ConstImageView foreground, ConstImageView background, ImageView result);
+
+/// @brief Overlay blend of two regions into a third (see overlayMode).
+void overlayMode(ConstImageView foreground, ConstImageView background, ImageView result);
+
+/// @brief Subtraction of two regions into a third (see subtractMode).
+void subtractMode(ConstImageView topLayer, ConstImageView bottomLayer, ImageView result);
+
+/// @brief Addition over a region (see add).
+void add(ConstImageView image, ImageView result, double r = 1.0, double g = 1.0, double b = 1.0);
+
+/// @brief Scaling over a region (see scale).
+void scale(ConstImageView image, ImageView result, double r = 1.0, double g = 1.0, double b = 1.0);
+
+/// @brief Red channel extraction over a region (see extractRed).
+void extractRed(ConstImageView image, ImageView result);
+
+/// @brief Green channel extraction over a region (see extractGreen).
+void extractGreen(ConstImageView image, ImageView result);
+
+/// @brief Blue channel extraction over a region (see extractBlue).
+void extractBlue(ConstImageView image, ImageView result);
+
+/// @brief Channel combination of three regions into a fourth (see combineChannels).
+void combineChannels(ConstImageView red, ConstImageView green, ConstImageView blue, ImageView result);
+
+/// @brief Rotation of a region by 180 degrees (see rotate180); `result` may be `image` to rotate in place.
+void rotate180(ConstImageView image, ImageView result);
@@ -0,0 +1,123 @@
+#ifndef IMAGEVIEW_H
+#define IMAGEVIEW_H
+
+#include <cstddef>
+
+#include "image.h"
+#include "mappedimage.h"
+#include "pixel.h"
+
+/// @brief A writable window onto pixels owned by something else (an Image, a MappedImage, a buffer).
+/// @note Rows are bottom-up like Image and `stride` pixels apart, so a view of a region is just a pointer
+///       into its parent: creating one copies nothing, and writing through it edits the parent in place.
+///       A view must not outlive the pixels it points to, and resizing an Image invalidates its views.
+struct ImageView
+{
+    Pixel *data = nullptr;      // Bottom-left pixel of the region
+    int width = 0;              // Width of the region in pixels
+    int height = 0;             // Height of the region in pixels
+    std::ptrdiff_t stride = 0;  // Pixels between the starts of consecutive rows
+
+    /// @param y The row, counted from the bottom.
+    /// @return The first pixel of the row.
+    Pixel *row(int y) const { return data + y * stride; }
+
+    /// @return The pixel at column `x` of row `y` (counted from the bottom).
+    Pixel &at(int x, int y) const { return row(y)[x]; }
+
+    /// @return The number of pixels in the region.
+    std::size_t size() const { return static_cast<std::size_t>(width) * height; }
+
+    /// @return `true` if the rows follow each other without gaps (the region is one run of pixels).
+    bool contiguous() const { return stride == width || height <= 1; }
+};
+
+/// @brief A read-only window onto pixels owned by something else (see ImageView).
+struct ConstImageView
+{
+    const Pixel *data = nullptr; // Bottom-left pixel of the region
+    int width = 0;               // Width of the region in pixels
+    int height = 0;              // Height of the region in pixels
+    std::ptrdiff_t stride = 0;   // Pixels between the starts of consecutive rows
+
+    ConstImageView() = default;
+
+    /// @brief Constructs a read-only view of the pixels of an arbitrary buffer.
+    /// @param data The bottom-left pixel.
+    /// @param width The width in pixels.
+    /// @param height The height in pixels.
+    /// @param stride The pixels between the starts of consecutive rows.
+    ConstImageView(const Pixel *data, int width, int height, std::ptrdiff_t stride)
+        : data{data}, width{width}, height{height}, stride{stride} {}
+
+    /// @brief Every writable view can be read.
+    ConstImageView(const ImageView &view) : data{view.data}, width{view.width}, height{view.height}, stride{view.stride} {}
+
+    /// @param y The row, counted from the bottom.
+    /// @return The first pixel of the row.
+    const Pixel *row(int y) const { return data + y * stride; }
+
+    /// @return The pixel at column `x` of row `y` (counted from the bottom).
+    const Pixel &at(int x, int y) const { return row(y)[x]; }
+
+    /// @return The number of pixels in the region.
+    std::size_t size() const { return static_cast<std::size_t>(width) * height; }
+
+    /// @return `true` if the rows follow each other without gaps (the region is one run of pixels).
+    bool contiguous() const { return stride == width || height <= 1; }
+};
+
+/// @return A view of the whole image.
+ImageView view(Image &image);
+ConstImageView view(const Image &image);
+
+/// @return A view of the whole mapped image.
+/// @note The writable overload throws for read-only mappings (see MappedImage::mutablePixels).
+ImageView view(MappedImage &image);
+ConstImageView view(const MappedImage &image);
+
+/// @brief Views a rectangular region of an image.
+/// @note Throws if the region does not lie inside the image.
+/// @param image The image.
+/// @param x The left column of the region.
+/// @param y The bottom row of the region (rows count from the bottom, like the pixels).
+/// @param width The width of the region.
+/// @param height The height of the region.
+/// @return The view.
+ImageView view(Image &image, int x, int y, int width, int height);
+ConstImageView view(const Image &image, int x, int y, int width, int height);
+
+/// @brief Views a rectangular region of a mapped image (see view(Image &, int, int, int, int)).
+ImageView view(MappedImage &image, int x, int y, int width, int height);
+ConstImageView view(const MappedImage &image, int x, int y, int width, int height);
+
+/// @brief Views a rectangular region of another view (see view(Image &, int, int, int, int)).
+ImageView view(const ImageView &parent, int x, int y, int width, int height);
+ConstImageView view(const ConstImageView &parent, int x, int y, int width, int height);
+
+/// @brief Copies the pixels of a view into a new, owning image.
+/// @param region The pixels to copy.
+/// @return The cropped image.
+Image crop(ConstImageView region);
+
+/// @brief Copies the pixels of a region of an image into a new image.
+/// @param image The image.
+/// @param x The left column of the region.
+/// @param y The bottom row of the region.
+/// @param width The width of the region.
+/// @param height The height of the region.
+/// @return The cropped image.
+Image crop(const Image &image, int x, int y, int width, int height);
+
+/// @brief Copies pixels from one view into another of the same size, row by row.
+/// @note The views may belong to the same image. They may only overlap if they cover the same rows.
+/// @param source The pixels to copy.
+/// @param target The pixels to overwrite.
+void paste(ConstImageView source, ImageView target);
+
+/// @brief Sets every pixel of a view to one color.
+/// @param target The pixels to overwrite.
+/// @param color The color.
+void fill(ImageView target, const Pixel &color);
+
+#endif // IMAGEVIEW_H
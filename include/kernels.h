@@ -0,0 +1,137 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+/// @brief Instruction sets the blend kernels can be dispatched to.
+enum class SimdLevel
+{
+    Scalar, // Portable integer fallback
+    SSE2,   // 16 channels per instruction
+    AVX2    // 32 channels per instruction
+};
+
+/// @return The best instruction set supported by the running CPU.
+SimdLevel detectSimdLevel();
+
+/// @return The instruction set the blend kernels currently dispatch to.
+SimdLevel activeSimdLevel();
+
+/// @brief Force the blend kernels to a specific instruction set (e.g. to compare against the scalar path).
+/// @note Requests above what the CPU supports are lowered to the detected level.
+/// @param level The instruction set to use.
+void setSimdLevel(SimdLevel level);
+
+/// @brief Multiply blend over interleaved 8-bit channels: `out = round(top * bottom / 255)`.
+/// @note All kernels accept `out` aliasing either input.
+/// @param top The top (foreground) channels.
+/// @param bottom The bottom (background) channels.
+/// @param out The destination channels.
+/// @param count The number of channels (bytes) to process.
+void multiplyKernel(const unsigned char *top, const unsigned char *bottom, unsigned char *out, std::size_t count);
+
+/// @brief Screen blend over interleaved 8-bit channels: `out = 255 - round((255 - top) * (255 - bottom) / 255)`.
+/// @param top The top (foreground) channels.
+/// @param bottom The bottom (background) channels.
+/// @param out The destination channels.
+/// @param count The number of channels (bytes) to process.
+void screenKernel(const unsigned char *top, const unsigned char *bottom, unsigned char *out, std::size_t count);
+
+/// @brief Overlay blend over interleaved 8-bit channels (multiply below 50% gray background, screen above).
+/// @param top The top (foreground) channels.
+/// @param bottom The bottom (background) channels.
+/// @param out The destination channels.
+/// @param count The number of channels (bytes) to process.
+void overlayKernel(const unsigned char *top, const unsigned char *bottom, unsigned char *out, std::size_t count);
+
+/// @brief Subtract blend over interleaved 8-bit channels: `out = max(bottom - top, 0)`.
+/// @param top The top channels (subtrahend).
+/// @param bottom The bottom channels (minuend).
+/// @param out The destination channels.
+/// @param count The number of channels (bytes) to process.
+void subtractKernel(const unsigned char *top, const unsigned char *bottom, unsigned char *out, std::size_t count);
+
+/// @brief Per-channel lookup tables describing a point operation on BGR pixels.
+struct ChannelLuts
+{
+    unsigned char b[256]; // Blue channel mapping
+    unsigned char g[256]; // Green channel mapping
+    unsigned char r[256]; // Red channel mapping
+};
+
+/// @brief Build the lookup tables of `add` (clamped to 255) for the passed in values.
+/// @param r The red byte value.
+/// @param g The green byte value.
+/// @param b The blue byte value.
+/// @return The addition lookup tables.
+ChannelLuts makeAddLuts(double r, double g, double b);
+
+/// @brief Build the lookup tables of `scale` (clamped to 255) for the passed in values.
+/// @param r The red scale factor.
+/// @param g The green scale factor.
+/// @param b The blue scale factor.
+/// @return The scaling lookup tables.
+ChannelLuts makeScaleLuts(double r, double g, double b);
+
+/// @brief Map every channel of BGR pixels through its lookup table.
+/// @param in The source pixels (interleaved BGR bytes).
+/// @param out The destination pixels (may alias `in`).
+/// @param pixelCount The number of pixels to process.
+/// @param luts The lookup tables to apply.
+void lutKernel(const unsigned char *in, unsigned char *out, std::size_t pixelCount, const ChannelLuts &luts);
+
+/// @brief Copy one channel of BGR pixels into all three channels.
+/// @param in The source pixels (interleaved BGR bytes).
+/// @param out The destination pixels (may alias `in`).
+/// @param pixelCount The number of pixels to process.
+/// @param channel The channel to broadcast (0 = blue, 1 = green, 2 = red).
+void extractKernel(const unsigned char *in, unsigned char *out, std::size_t pixelCount, int channel);
+
+/// @brief Mix the channels of BGR pixels with a 3x3 matrix in 16.16 fixed point, rounded and clamped to bytes.
+/// @note Vectorized for AVX2; the other levels run the scalar loop.
+/// @param in The source pixels (interleaved BGR bytes).
+/// @param out The destination pixels (may alias `in`).
+/// @param pixelCount The number of pixels to process.
+/// @param matrix The nine coefficients in BGR order, row by row (`out[c] = sum of matrix[3c + k] * in[k]`),
+///        each within [-2^20, 2^20].
+void matrixKernel(const unsigned char *in, unsigned char *out, std::size_t pixelCount, const std::int32_t *matrix);
+
+/// @brief Porter-Duff operators and alpha-aware blend modes on premultiplied pixels (see composite.h).
+enum class CompositeMode
+{
+    Over,     // Top over bottom
+    In,       // Top where bottom is opaque
+    Out,      // Top where bottom is transparent
+    Multiply, // Multiply blend where both are opaque, each layer alone elsewhere
+    Screen,   // Screen blend where both are opaque, each layer alone elsewhere
+    Overlay   // Overlay blend where both are opaque, each layer alone elsewhere
+};
+
+/// @brief Composite premultiplied BGRA pixels, alpha included: `out = top MODE bottom`.
+/// @note Every 16-bit intermediate fits for valid premultiplied pixels (no channel above its alpha); other
+///       inputs give unspecified bytes. `out` may alias either input.
+/// @param mode The operator.
+/// @param top The top (source) pixels (interleaved BGRA bytes).
+/// @param bottom The bottom (destination) pixels (interleaved BGRA bytes).
+/// @param out The composited pixels.
+/// @param pixelCount The number of pixels to process.
+void compositeKernel(CompositeMode mode, const unsigned char *top, const unsigned char *bottom, unsigned char *out,
+                     std::size_t pixelCount);
+
+/// @brief Composite premultiplied BGRA pixels over opaque BGR pixels (the result is opaque).
+/// @note Vectorized for AVX2; the other levels run the scalar loop.
+/// @param top The top pixels (interleaved BGRA bytes).
+/// @param bottom The bottom pixels (interleaved BGR bytes).
+/// @param out The composited pixels (interleaved BGR bytes, may alias `bottom`).
+/// @param pixelCount The number of pixels to process.
+void overOpaqueKernel(const unsigned char *top, const unsigned char *bottom, unsigned char *out, std::size_t pixelCount);
+
+/// @brief Quantize floating-point channels (0...1) to bytes, clamping and rounding to the nearest value.
+/// @note Gives the bytes of `ChannelTraits<float>::toByte` (NaN becomes 0).
+/// @param in The channels.
+/// @param out The quantized channels.
+/// @param count The number of channels to process.
+void quantizeKernel(const float *in, unsigned char *out, std::size_t count);
+
+#endif // KERNELS_H
@@ -0,0 +1,61 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/// @brief How a file is mapped into memory.
+enum class MapMode
+{
+    ReadOnly,    // Pages are shared with the file and may not be written
+    CopyOnWrite, // Writes go to private copies of the touched pages; the file is never modified
+    ReadWrite    // Writes go straight to the file
+};
+
+/// @brief Owns a memory mapping of a whole file.
+/// @note On platforms without mmap the file is read into (and, for ReadWrite, written back from) a buffer.
+class MappedFile
+{
+public:
+    /// @brief Maps an existing file.
+    /// @param file The path to the file.
+    /// @param mode How the file is mapped.
+    MappedFile(const std::string &file, MapMode mode = MapMode::ReadOnly);
+
+    /// @brief Creates (or truncates) a file of the given size and maps it for writing.
+    /// @param file The path to the file.
+    /// @param size The size of the file in bytes.
+    MappedFile(const std::string &file, std::size_t size);
+
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /// @brief Unmaps the file (flushing pending writes for ReadWrite mappings).
+    ~MappedFile();
+
+    /// @return The first byte of the mapping.
+    unsigned char *data() { return bytes; }
+
+    /// @return The first byte of the mapping.
+    const unsigned char *data() const { return bytes; }
+
+    /// @return The size of the mapping in bytes.
+    std::size_t size() const { return length; }
+
+    /// @return How the file is mapped.
+    MapMode mode() const { return mapMode; }
+
+private:
+    void release();
+
+    std::string path;
+    unsigned char *bytes = nullptr;
+    std::size_t length = 0;
+    MapMode mapMode = MapMode::ReadOnly;
+    std::vector<unsigned char> fallback; // Backing store when mmap is unavailable
+};
+
+#endif // MAPPEDFILE_H
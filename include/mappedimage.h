@@ -0,0 +1,59 @@
+#ifndef MAPPEDIMAGE_H
+#define MAPPEDIMAGE_H
+
+#include <cstddef>
+#include <string>
+
+#include "header.h"
+#include "image.h"
+#include "mappedfile.h"
+#include "pixel.h"
+
+/// @brief An image whose pixels point directly into a memory-mapped .tga file (no stream reads, no copies).
+/// @note Only uncompressed 24-bit true color files can be mapped, since their payload is already laid out
+///       as BGR Pixels. Pages are loaded on first access.
+/// @note The operations run on the mapped pixels through `view(mapped)` (imageview.h) and their view overloads,
+///       e.g. `add(view(input), view(output), 0, 200, 0)`; only toImage() copies.
+struct MappedImage
+{
+    Header header; // The header data for the image
+
+    /// @brief Maps an existing .tga image file.
+    /// @param file The path to the .tga file.
+    /// @param mode ReadOnly (default), CopyOnWrite (writable pixels, file untouched) or ReadWrite (edits the file).
+    MappedImage(const std::string &file, MapMode mode = MapMode::ReadOnly);
+
+    /// @brief Creates a pre-sized .tga file for the header and maps it for writing.
+    /// @note The header is written immediately; the pixels can then be produced directly into the file. It is
+    ///       normalized to an uncompressed 24-bit header without image ID or color map (see tgaHeader), so the
+    ///       header of any mapped or decoded image can be passed.
+    /// @param file The path to the .tga file to create.
+    /// @param header The header of the image; its width and height determine the file size.
+    MappedImage(const std::string &file, const Header &header);
+
+    /// @return The first pixel of the mapped payload.
+    const Pixel *pixels() const { return data; }
+
+    /// @return The first pixel of the mapped payload, for writing.
+    /// @note Throws for read-only mappings.
+    Pixel *mutablePixels();
+
+    /// @return The number of pixels in the image.
+    std::size_t size() const { return count; }
+
+    /// @brief Copies the mapped pixels into an owning Image.
+    /// @return The image.
+    Image toImage() const;
+
+private:
+    MappedFile file;
+    Pixel *data = nullptr;
+    std::size_t count = 0;
+};
+
+/// @brief Write an image to a .tga file through a memory mapping of the pre-sized output file.
+/// @param image The image to write.
+/// @param file The path to the .tga file to write the image to.
+void writeMapped(const Image &image, const std::string &file);
+
+#endif // MAPPEDIMAGE_H
@@ -0,0 +1,60 @@
+#ifndef MOSAIC_H
+#define MOSAIC_H
+
+#include <vector>
+
+#include "header.h"
+#include "image.h"
+#include "pixel.h"
+
+/// @brief One image placed on a mosaic canvas.
+struct MosaicTile
+{
+    const Image *image; // The image to draw (not owned)
+    int x;              // Column of the image's left edge on the canvas
+    int y;              // Row of the image's bottom edge on the canvas (rows are bottom-up like Image)
+};
+
+/// @brief Tiles together with the canvas size they were laid out for.
+struct MosaicLayout
+{
+    std::vector<MosaicTile> tiles;
+    int width = 0;  // Canvas width in pixels
+    int height = 0; // Canvas height in pixels
+};
+
+/// @brief Lay images out on a grid, row by row from the top left (like reading text).
+/// @note Each column is as wide as its widest image and each row as tall as its tallest; images sit in the
+///       top left corner of their cell.
+/// @param images The images, in reading order.
+/// @param columns The number of grid columns (at least 1).
+/// @param spacing The number of pixels left between neighbouring cells.
+/// @return The layout.
+MosaicLayout gridLayout(const std::vector<const Image *> &images, int columns, int spacing = 0);
+
+/// @return The header of a width x height canvas (uncompressed 24-bit true color, bottom-left origin).
+Header mosaicHeader(int width, int height);
+
+/// @brief Draw tiles onto a preallocated canvas, one contiguous scanline copy per tile row.
+/// @note Tiles are clipped to the canvas; pixels no tile covers are left untouched. Tile rows are spread over
+///       the thread pool, so overlapping tiles are drawn in an unspecified order. `result` cannot be one of
+///       the tile images.
+/// @param tiles The tiles to draw.
+/// @param result The canvas, already sized by the caller.
+void composeMosaic(const std::vector<MosaicTile> &tiles, Image &result);
+
+/// @brief Draw a layout onto a new canvas filled with a background color.
+/// @param layout The tiles and canvas size.
+/// @param background The color of pixels no tile covers.
+/// @return The mosaic.
+Image composeMosaic(const MosaicLayout &layout, const Pixel &background = Pixel{});
+
+/// @brief Build a contact sheet: a grid of images on a background.
+/// @param images The images, in reading order.
+/// @param columns The number of grid columns (at least 1).
+/// @param spacing The number of pixels left between neighbouring cells.
+/// @param background The color of the spacing and of cells not filled by their image.
+/// @return The contact sheet.
+Image contactSheet(const std::vector<const Image *> &images, int columns, int spacing = 0, const Pixel &background = Pixel{});
+
+#endif // MOSAIC_H
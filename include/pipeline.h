@@ -0,0 +1,164 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "colortransform.h"
+#include "image.h"
+#include "kernels.h"
+
+struct BlendTable;
+
+/// @brief Which layer the pipeline's current image takes in a two-input blend.
+enum class Layer
+{
+    Top,   // The current image is the foreground / top layer
+    Bottom // The current image is the background / bottom layer
+};
+
+/// @brief Lazily records a chain of image operations and evaluates it on demand.
+/// @note Consecutive point-wise steps (blend modes, blendMode, add, scale, lut, extract*, transform) are fused: evaluation
+///       walks the pixels once, running every step on a small cache-resident chunk before moving on, so no
+///       intermediate images are created. Consecutive color steps are further compiled into one
+///       ColorTransform as they are recorded. Non point-wise steps (rotate180, combineQuadrants, then)
+///       materialize the fused steps before them.
+/// @note The pipeline only stores references to its input images; they must outlive every call to evaluate.
+class Pipeline
+{
+public:
+    /// @brief Starts a pipeline whose initial value is the source image.
+    /// @param source The source image.
+    explicit Pipeline(const Image &source);
+
+    /// @brief Records a multiply blend (see multiplyMode) with another image.
+    /// @param other The other image.
+    /// @param current The layer the current image takes in the blend.
+    /// @return The pipeline, for chaining.
+    Pipeline &multiplyMode(const Image &other, Layer current = Layer::Top);
+
+    /// @brief Records a screen blend (see screenMode) with another image.
+    /// @param other The other image.
+    /// @param current The layer the current image takes in the blend.
+    /// @return The pipeline, for chaining.
+    Pipeline &screenMode(const Image &other, Layer current = Layer::Top);
+
+    /// @brief Records an overlay blend (see overlayMode) with another image.
+    /// @param other The other image.
+    /// @param current The layer the current image takes in the blend.
+    /// @return The pipeline, for chaining.
+    Pipeline &overlayMode(const Image &other, Layer current = Layer::Top);
+
+    /// @brief Records a subtraction (see subtractMode) with another image.
+    /// @param other The other image.
+    /// @param current The layer the current image takes in the subtraction.
+    /// @return The pipeline, for chaining.
+    Pipeline &subtractMode(const Image &other, Layer current = Layer::Top);
+
+    /// @brief Records a blend with a registered mode (see blendMode) with another image.
+    /// @note The mode is looked up now. Built-in modes with a SIMD kernel keep it; the others run through their
+    ///       table. Both fuse with the neighbouring point-wise steps.
+    /// @param mode The name of the mode.
+    /// @param other The other image.
+    /// @param current The layer the current image takes in the blend.
+    /// @return The pipeline, for chaining.
+    Pipeline &blendMode(const std::string &mode, const Image &other, Layer current = Layer::Top);
+
+    /// @brief Records an addition (see add).
+    /// @param r The red byte value.
+    /// @param g The green byte value.
+    /// @param b The blue byte value.
+    /// @return The pipeline, for chaining.
+    Pipeline &add(double r = 1.0, double g = 1.0, double b = 1.0);
+
+    /// @brief Records a scaling (see scale).
+    /// @param r The red byte value.
+    /// @param g The green byte value.
+    /// @param b The blue byte value.
+    /// @return The pipeline, for chaining.
+    Pipeline &scale(double r = 1.0, double g = 1.0, double b = 1.0);
+
+    /// @brief Records a mapping of every channel through its own lookup table.
+    /// @param luts The lookup tables (copied).
+    /// @return The pipeline, for chaining.
+    Pipeline &lut(const ChannelLuts &luts);
+
+    /// @brief Records a red channel extraction (see extractRed).
+    /// @return The pipeline, for chaining.
+    Pipeline &extractRed();
+
+    /// @brief Records a green channel extraction (see extractGreen).
+    /// @return The pipeline, for chaining.
+    Pipeline &extractGreen();
+
+    /// @brief Records a blue channel extraction (see extractBlue).
+    /// @return The pipeline, for chaining.
+    Pipeline &extractBlue();
+
+    /// @brief Records a color transform.
+    /// @param transform The transform (copied).
+    /// @return The pipeline, for chaining.
+    Pipeline &transform(const ColorTransform &transform);
+
+    /// @brief Records a 180 degree rotation (see rotate180). Materializes the preceding steps.
+    /// @return The pipeline, for chaining.
+    Pipeline &rotate180();
+
+    /// @brief Records a quadrant combination with the current image as the first quadrant (see combineQuadrants).
+    ///        Materializes the preceding steps.
+    /// @param second The second quadrant image (top right).
+    /// @param third The third quadrant image (bottom right).
+    /// @param fourth The fourth quadrant image (bottom left).
+    /// @return The pipeline, for chaining.
+    Pipeline &combineQuadrants(const Image &second, const Image &third, const Image &fourth);
+
+    /// @brief Records an arbitrary whole-image operation. Materializes the preceding steps.
+    /// @param operation The operation, called with the current image.
+    /// @return The pipeline, for chaining.
+    Pipeline &then(std::function<Image(const Image &)> operation);
+
+    /// @brief Runs the recorded steps.
+    /// @return The resulting image.
+    Image evaluate() const;
+
+    /// @brief Runs the recorded steps into a caller-provided image (no allocation once `result` has the
+    ///        right size, unless a materializing step is recorded).
+    /// @note `result` may be the source image, but not an image passed to a blend step.
+    /// @param result The image receiving the output; resized to match if needed.
+    void evaluate(Image &result) const;
+
+private:
+    /// @brief A single recorded step.
+    struct Step
+    {
+        enum class Kind
+        {
+            Blend,      // Two-input point-wise kernel
+            Color,      // Compiled color transform
+            Materialize // Whole-image operation
+        };
+
+        explicit Step(Kind kind) : kind{kind} {}
+
+        Kind kind;
+        void (*blend)(const unsigned char *, const unsigned char *, unsigned char *, std::size_t) = nullptr;
+        const BlendTable *table = nullptr; // Used when a blend has no kernel
+        const Image *other = nullptr;
+        Layer current = Layer::Top;
+        std::shared_ptr<const ColorTransform> color;
+        std::function<Image(const Image &)> operation;
+    };
+
+    /// @brief Evaluates the fused point-wise steps [first, last) over the source in a single pass.
+    void fuse(const Image &source, std::size_t first, std::size_t last, Image &result) const;
+
+    Pipeline &blendStep(void (*kernel)(const unsigned char *, const unsigned char *, unsigned char *, std::size_t),
+                        const Image &other, Layer current, const BlendTable *table = nullptr);
+
+    const Image *source;
+    std::vector<Step> steps;
+};
+
+#endif // PIPELINE_H
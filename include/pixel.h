@@ -22,7 +22,7 @@ struct Pixel
     void update(unsigned char red, unsigned char green, unsigned char blue);
 
     /// @return `true` if two pixels do not share the same RGB values; otherwise `false`.
-    bool operator!=(const Pixel &rhs);
+    bool operator!=(const Pixel &rhs) const;
 };
 
 #endif
\ No newline at end of file
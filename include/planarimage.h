@@ -0,0 +1,174 @@
+#ifndef PLANARIMAGE_H
+#define PLANARIMAGE_H
+
+#include <cstddef>
+#include <memory>
+
+#include "header.h"
+#include "image.h"
+
+/// @brief Alignment (in bytes) of every plane row of a PlanarImage.
+constexpr std::size_t PLANE_ALIGNMENT = 64;
+
+/// @brief An image stored as three separate channel planes instead of interleaved BGR Pixels.
+/// @note Planes are indexed like the bytes of a Pixel (0 = blue, 1 = green, 2 = red) and stored back to back
+///       in one allocation. Each row is padded to a multiple of PLANE_ALIGNMENT bytes and starts on such a
+///       boundary; whole-plane operations may overwrite the padding, which is never read as pixels.
+///       Rows are bottom-up like Image.
+class PlanarImage
+{
+public:
+    /// @brief Creates a zero-filled image of the size described by the header.
+    /// @param header The header of the image; its width and height determine the plane sizes.
+    explicit PlanarImage(const Header &header);
+
+    /// @brief Creates a planar copy of an interleaved image.
+    /// @param image The image to split into planes.
+    explicit PlanarImage(const Image &image);
+
+    PlanarImage(const PlanarImage &other);
+    PlanarImage &operator=(const PlanarImage &other);
+
+    /// @note A moved-from image is empty (0x0, no allocation) and can be reshaped or assigned again.
+    PlanarImage(PlanarImage &&other) noexcept;
+    PlanarImage &operator=(PlanarImage &&other) noexcept;
+
+    /// @return The header data for the image.
+    const Header &header() const { return imageHeader; }
+
+    /// @return The width of the image in pixels.
+    int width() const { return imageWidth(imageHeader); }
+
+    /// @return The height of the image in pixels.
+    int height() const { return imageHeight(imageHeader); }
+
+    /// @return The number of bytes between the starts of consecutive rows of a plane.
+    std::size_t stride() const { return rowStride; }
+
+    /// @return The number of bytes of one plane, padding included.
+    std::size_t planeSize() const { return rowStride * height(); }
+
+    /// @param channel 0 (blue), 1 (green) or 2 (red).
+    /// @return The first byte of the bottom row of the plane.
+    unsigned char *plane(int channel) { return storage.get() + channel * planeSize(); }
+    const unsigned char *plane(int channel) const { return storage.get() + channel * planeSize(); }
+
+    /// @param channel 0 (blue), 1 (green) or 2 (red).
+    /// @param y The row, counted from the bottom.
+    /// @return The first byte of the row.
+    unsigned char *row(int channel, int y) { return plane(channel) + y * rowStride; }
+    const unsigned char *row(int channel, int y) const { return plane(channel) + y * rowStride; }
+
+    /// @return All three planes as one contiguous run of `3 * planeSize()` bytes.
+    unsigned char *data() { return storage.get(); }
+    const unsigned char *data() const { return storage.get(); }
+
+    /// @brief Changes the size of the image, keeping the allocation when it is large enough.
+    /// @note Pixel contents are unspecified afterwards.
+    /// @param header The new header.
+    void reshape(const Header &header);
+
+    /// @brief Interleaves the planes into a new Image.
+    /// @return The image.
+    Image toImage() const;
+
+private:
+    struct AlignedDelete
+    {
+        void operator()(unsigned char *bytes) const;
+    };
+
+    Header imageHeader;
+    std::size_t rowStride = 0;
+    std::size_t capacity = 0; // Allocated bytes
+    std::unique_ptr<unsigned char[], AlignedDelete> storage;
+};
+
+/// @brief Split an interleaved image into planes.
+/// @param image The image to split.
+/// @param result The planar image receiving the channels (resized to match).
+void deinterleave(const Image &image, PlanarImage &result);
+
+/// @brief Merge planes back into an interleaved image.
+/// @param image The planar image to merge.
+/// @param result The image receiving the pixels (resized to match).
+void interleave(const PlanarImage &image, Image &result);
+
+/// @brief Planar version of multiplyMode(const Image &, const Image &).
+PlanarImage multiplyMode(const PlanarImage &foreground, const PlanarImage &background);
+
+/// @brief Planar version of multiplyMode(const Image &, const Image &, Image &).
+/// @note `result` may be either input; the same holds for every planar operation unless noted.
+void multiplyMode(const PlanarImage &foreground, const PlanarImage &background, PlanarImage &result);
+
+/// @brief Planar version of screenMode(const Image &, const Image &).
+PlanarImage screenMode(const PlanarImage &foreground, const PlanarImage &background);
+
+/// @brief Planar version of screenMode(const Image &, const Image &, Image &).
+void screenMode(const PlanarImage &foreground, const PlanarImage &background, PlanarImage &result);
+
+/// @brief Planar version of overlayMode(const Image &, const Image &).
+PlanarImage overlayMode(const PlanarImage &foreground, const PlanarImage &background);
+
+/// @brief Planar version of overlayMode(const Image &, const Image &, Image &).
+void overlayMode(const PlanarImage &foreground, const PlanarImage &background, PlanarImage &result);
+
+/// @brief Planar version of subtractMode(const Image &, const Image &).
+PlanarImage subtractMode(const PlanarImage &topLayer, const PlanarImage &bottomLayer);
+
+/// @brief Planar version of subtractMode(const Image &, const Image &, Image &).
+void subtractMode(const PlanarImage &topLayer, const PlanarImage &bottomLayer, PlanarImage &result);
+
+/// @brief Planar version of add(const Image &, double, double, double).
+PlanarImage add(const PlanarImage &image, double r = 1.0, double g = 1.0, double b = 1.0);
+
+/// @brief Planar version of add(const Image &, Image &, double, double, double).
+void add(const PlanarImage &image, PlanarImage &result, double r = 1.0, double g = 1.0, double b = 1.0);
+
+/// @brief Planar version of scale(const Image &, double, double, double).
+PlanarImage scale(const PlanarImage &image, double r = 1.0, double g = 1.0, double b = 1.0);
+
+/// @brief Planar version of scale(const Image &, Image &, double, double, double).
+void scale(const PlanarImage &image, PlanarImage &result, double r = 1.0, double g = 1.0, double b = 1.0);
+
+/// @brief Planar version of extractRed(const Image &): the red plane is copied into the other two.
+PlanarImage extractRed(const PlanarImage &image);
+
+/// @brief Planar version of extractRed(const Image &, Image &).
+void extractRed(const PlanarImage &image, PlanarImage &result);
+
+/// @brief Planar version of extractGreen(const Image &): the green plane is copied into the other two.
+PlanarImage extractGreen(const PlanarImage &image);
+
+/// @brief Planar version of extractGreen(const Image &, Image &).
+void extractGreen(const PlanarImage &image, PlanarImage &result);
+
+/// @brief Planar version of extractBlue(const Image &): the blue plane is copied into the other two.
+PlanarImage extractBlue(const PlanarImage &image);
+
+/// @brief Planar version of extractBlue(const Image &, Image &).
+void extractBlue(const PlanarImage &image, PlanarImage &result);
+
+/// @brief Planar version of combineChannels(const Image &, const Image &, const Image &): one plane copy per channel.
+PlanarImage combineChannels(const PlanarImage &red, const PlanarImage &green, const PlanarImage &blue);
+
+/// @brief Planar version of combineChannels(const Image &, const Image &, const Image &, Image &).
+void combineChannels(const PlanarImage &red, const PlanarImage &green, const PlanarImage &blue, PlanarImage &result);
+
+/// @brief Planar version of rotate180(const Image &).
+PlanarImage rotate180(const PlanarImage &image);
+
+/// @brief Planar version of rotate180(const Image &, Image &).
+void rotate180(const PlanarImage &image, PlanarImage &result);
+
+/// @brief Planar version of combineQuadrants(const Image &, const Image &, const Image &, const Image &).
+/// @note Quadrants are placed geometrically: first top-left, second top-right, third bottom-right and fourth
+///       bottom-left (the same layout combineQuadrants produces for square images).
+PlanarImage combineQuadrants(const PlanarImage &first, const PlanarImage &second, const PlanarImage &third, const PlanarImage &fourth);
+
+/// @brief Planar version of combineQuadrants(const Image &, const Image &, const Image &, const Image &, Image &).
+/// @note `result` cannot be one of the inputs. Throws if the combined image would exceed 65535x65535 pixels.
+void combineQuadrants(const PlanarImage &first, const PlanarImage &second, const PlanarImage &third, const PlanarImage &fourth,
+                      PlanarImage &result);
+
+#endif // PLANARIMAGE_H
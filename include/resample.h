@@ -0,0 +1,68 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <vector>
+
+#include "image.h"
+
+/// @brief The reconstruction filter used when resizing.
+enum class ResampleFilter
+{
+    Nearest,  // Copy the closest source pixel (no blending; fastest)
+    Bilinear, // Triangle filter, widened when shrinking so every source pixel contributes
+    Area,     // Average the source pixels under each output pixel, weighted by the area they cover
+    Lanczos   // Windowed sinc with three lobes (sharpest; may ring slightly at hard edges)
+};
+
+/// @brief Resize an image to width x height pixels.
+/// @note Rows and columns are resampled separately with weights computed once per output row and column and
+///       applied in fixed-point integer arithmetic. Shrinking with `Area` by a power of two on both axes takes
+///       an exact block-averaging path. `result` gets the header of `image` with the new size; it cannot be
+///       `image` unless the size is unchanged.
+/// @param image The image to resize.
+/// @param result The image receiving the output; resized to match if needed.
+/// @param width The width of the output (1...65535).
+/// @param height The height of the output (1...65535).
+/// @param filter The reconstruction filter.
+void resize(const Image &image, Image &result, int width, int height, ResampleFilter filter = ResampleFilter::Lanczos);
+
+/// @brief Resize an image to width x height pixels.
+/// @param image The image to resize.
+/// @param width The width of the output (1...65535).
+/// @param height The height of the output (1...65535).
+/// @param filter The reconstruction filter.
+/// @return The resized image.
+Image resize(const Image &image, int width, int height, ResampleFilter filter = ResampleFilter::Lanczos);
+
+/// @brief Halve both dimensions by averaging 2x2 blocks.
+/// @note Sizes round down (an odd last row or column is dropped) and a dimension of 1 stays 1, averaging
+///       pairs along the other axis only. `result` cannot be `image`.
+/// @param image The image to shrink.
+/// @param result The image receiving the output; resized to match if needed.
+void downscale2x(const Image &image, Image &result);
+
+/// @brief Halve both dimensions by averaging 2x2 blocks.
+/// @param image The image to shrink.
+/// @return The half-size image.
+Image downscale2x(const Image &image);
+
+/// @brief Build a mipmap pyramid: successive 2x2-block averages down to 1x1.
+/// @note Level i is `downscale2x` of level i - 1 (level -1 being `image` itself), bit for bit. Several levels
+///       are produced per pass over a band of source rows while the band is still in cache, so the source is
+///       read once rather than once per level.
+/// @param image The full-size image.
+/// @param levels The number of levels to build (0 builds all of them, down to 1x1).
+/// @return The levels below `image`, half size first.
+std::vector<Image> buildMipmaps(const Image &image, int levels = 0);
+
+/// @brief Shrink an image to fit within maxWidth x maxHeight, keeping its aspect ratio.
+/// @note Images that already fit are copied. Large reductions first average power-of-two blocks and then
+///       resample the remaining factor (between 2 and 4) with `filter`, which keeps the filter short.
+/// @param image The image to shrink.
+/// @param maxWidth The largest width of the thumbnail.
+/// @param maxHeight The largest height of the thumbnail.
+/// @param filter The reconstruction filter for the final step.
+/// @return The thumbnail.
+Image thumbnail(const Image &image, int maxWidth, int maxHeight, ResampleFilter filter = ResampleFilter::Area);
+
+#endif // RESAMPLE_H
@@ -0,0 +1,82 @@
+#ifndef RGBAIMAGE_H
+#define RGBAIMAGE_H
+
+#include <string>
+#include <vector>
+
+#include "bufferpool.h"
+#include "header.h"
+#include "image.h"
+#include "pixel.h"
+#include "tga.h"
+
+/// @brief Represents the color and coverage of a single pixel with premultiplied alpha.
+/// @note Each color channel is already scaled by `a / 255`, so a valid pixel never has a channel above its alpha
+///       (0, 0, 0, 0 is fully transparent). The byte order (b, g, r, a) is the one of 32-bit .tga files.
+struct PixelRGBA
+{
+    unsigned char b; // Premultiplied blue component of pixel
+    unsigned char g; // Premultiplied green component of pixel
+    unsigned char r; // Premultiplied red component of pixel
+    unsigned char a; // Alpha (coverage) of pixel, 255 being opaque
+
+    /// @brief Constructs a PixelRGBA object from premultiplied values.
+    /// @param red The premultiplied red byte value.
+    /// @param green The premultiplied green byte value.
+    /// @param blue The premultiplied blue byte value.
+    /// @param alpha The alpha byte value.
+    PixelRGBA(unsigned char red = 0, unsigned char green = 0, unsigned char blue = 0, unsigned char alpha = 0)
+        : b{blue}, g{green}, r{red}, a{alpha} {}
+
+    /// @return `true` if two pixels do not share the same values; otherwise `false`.
+    bool operator!=(const PixelRGBA &rhs) const { return r != rhs.r || g != rhs.g || b != rhs.b || a != rhs.a; }
+};
+
+/// @brief Premultiply a straight (unassociated) color by its alpha.
+/// @param red The red byte value.
+/// @param green The green byte value.
+/// @param blue The blue byte value.
+/// @param alpha The alpha byte value.
+/// @return The premultiplied pixel.
+PixelRGBA premultiply(unsigned char red, unsigned char green, unsigned char blue, unsigned char alpha);
+
+/// @brief Pixel storage drawn from the shared buffer pool (see PixelBuffer).
+using PixelBufferRGBA = std::vector<PixelRGBA, PoolAllocator<PixelRGBA>>;
+
+/// @brief Manages the header and pixel data of an image with an alpha channel.
+/// @note Pixels are held as premultiplied 32-bit BGRA, bottom row first; the header describes that layout
+///       (uncompressed 32-bit, bottom-left origin). Files store straight alpha, so colors are premultiplied on
+///       load and divided back out on write.
+struct ImageRGBA
+{
+    Header header;          // The header data for the image
+    PixelBufferRGBA pixels; // The premultiplied pixels in the image
+
+    /// @brief Constructs an ImageRGBA object from a .tga image file.
+    /// @note Files without an alpha channel load as opaque.
+    /// @param file The path to the .tga file to read an image from.
+    ImageRGBA(const std::string &file);
+
+    /// @brief Constructs a fully transparent image described by a header.
+    /// @param header The header data; its width and height determine the number of pixels.
+    explicit ImageRGBA(const Header &header);
+
+    /// @brief Constructs an opaque copy of an image.
+    /// @param image The image.
+    explicit ImageRGBA(const Image &image);
+
+    /// @brief Write an image to a 32-bit .tga file with straight alpha.
+    /// @param file The path to the .tga file to write an image to.
+    /// @param rle Whether to run-length encode the pixels.
+    void write(const std::string &file, bool rle = false) const;
+};
+
+/// @brief Builds a layer from a color image and a coverage mask.
+/// @note The alpha of each pixel is the luma of the mask, e.g. `withAlpha(text, text)` makes the black
+///       background of white text transparent.
+/// @param color The straight colors.
+/// @param mask The coverage; must have the same size as `color`.
+/// @return The premultiplied layer.
+ImageRGBA withAlpha(const Image &color, const Image &mask);
+
+#endif // RGBAIMAGE_H
@@ -0,0 +1,96 @@
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <array>
+#include <cstdint>
+
+#include "image.h"
+#include "kernels.h"
+
+/// @brief The distribution of one channel's values.
+struct ChannelStatistics
+{
+    std::array<std::uint64_t, 256> histogram{}; // Number of pixels with each value
+    std::uint64_t count = 0;                    // Number of pixels
+    int min = 0;                                // Smallest value (0 for an empty image)
+    int max = 0;                                // Largest value (0 for an empty image)
+    double mean = 0.0;                          // Average value
+    double standardDeviation = 0.0;             // Population standard deviation of the values
+
+    /// @param percent The percentage of pixels (0...100).
+    /// @return The smallest value that at least `percent`% of the pixels do not exceed.
+    int percentile(double percent) const;
+
+    /// @return The 50th percentile.
+    int median() const { return percentile(50.0); }
+};
+
+/// @brief Statistics of every channel of an image.
+struct ImageStatistics
+{
+    ChannelStatistics red;
+    ChannelStatistics green;
+    ChannelStatistics blue;
+    ChannelStatistics luma; // Rec. 601 luminance, as written by the grayscale encodings
+};
+
+/// @brief Compute the histograms and statistics of every channel in one pass.
+/// @note Bands of pixels are counted into per-thread histograms on the thread pool and merged at the end;
+///       every other statistic is derived from the histograms.
+/// @param image The image to measure.
+/// @return The statistics.
+ImageStatistics imageStatistics(const Image &image);
+
+/// @brief Build the lookup tables of a levels adjustment, identical for every channel.
+/// @param black The input value mapped to 0 (and everything below it).
+/// @param white The input value mapped to 255 (and everything above it); must be greater than `black`.
+/// @param gamma The midtone exponent: above 1 brightens, below 1 darkens.
+/// @return The lookup tables.
+ChannelLuts makeLevelsLuts(int black, int white, double gamma = 1.0);
+
+/// @brief Remap every channel so `black` becomes 0 and `white` 255, with a gamma curve in between.
+/// @note `result` may be `image`.
+/// @param image The image to adjust.
+/// @param result The image receiving the output; resized to match if needed.
+/// @param black The input value mapped to 0.
+/// @param white The input value mapped to 255.
+/// @param gamma The midtone exponent.
+void levels(const Image &image, Image &result, int black, int white, double gamma = 1.0);
+
+/// @brief Remap every channel so `black` becomes 0 and `white` 255, with a gamma curve in between.
+/// @param image The image to adjust.
+/// @param black The input value mapped to 0.
+/// @param white The input value mapped to 255.
+/// @param gamma The midtone exponent.
+/// @return The adjusted image.
+Image levels(const Image &image, int black, int white, double gamma = 1.0);
+
+/// @brief Stretch the contrast so that the darkest and brightest `clip` percent of values saturate.
+/// @note Unlinked, each channel is stretched on its own, which also neutralizes color casts; linked, the
+///       three channels share the limits measured on their combined values, which keeps the color balance.
+///       Channels without spread are left unchanged. `result` may be `image`.
+/// @param image The image to adjust.
+/// @param result The image receiving the output; resized to match if needed.
+/// @param clip The percentage of values clipped at each end (0...50).
+/// @param linked Whether the channels share their limits.
+void autoLevels(const Image &image, Image &result, double clip = 0.1, bool linked = false);
+
+/// @brief Stretch the contrast so that the darkest and brightest `clip` percent of values saturate.
+/// @param image The image to adjust.
+/// @param clip The percentage of values clipped at each end (0...50).
+/// @param linked Whether the channels share their limits.
+/// @return The adjusted image.
+Image autoLevels(const Image &image, double clip = 0.1, bool linked = false);
+
+/// @brief Equalize the histogram of every channel, spreading its values evenly over 0...255.
+/// @note `result` may be `image`.
+/// @param image The image to adjust.
+/// @param result The image receiving the output; resized to match if needed.
+void equalize(const Image &image, Image &result);
+
+/// @brief Equalize the histogram of every channel, spreading its values evenly over 0...255.
+/// @param image The image to adjust.
+/// @return The adjusted image.
+Image equalize(const Image &image);
+
+#endif // STATISTICS_H
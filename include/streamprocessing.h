@@ -0,0 +1,94 @@
+#ifndef STREAMPROCESSING_H
+#define STREAMPROCESSING_H
+
+#include <string>
+
+/// @brief Default number of scanlines held in memory per input by the streaming operations.
+constexpr int STREAM_ROWS = 16;
+
+/*
+ * Streaming versions of the point-wise operations in imageprocessing.h. Each reads its inputs and writes
+ * its output a chunk of scanlines at a time, so memory use is `rows * width` pixels per file no matter how
+ * large the images are. The results are identical to the in-memory operations.
+ */
+
+/// @brief Streaming multiplyMode of two .tga files.
+/// @param foreground The path to the foreground image.
+/// @param background The path to the background image.
+/// @param output The path to write the multiplied image to.
+/// @param rows The number of scanlines processed per chunk.
+void streamMultiplyMode(const std::string &foreground, const std::string &background, const std::string &output,
+                        int rows = STREAM_ROWS);
+
+/// @brief Streaming screenMode of two .tga files.
+/// @param foreground The path to the foreground image.
+/// @param background The path to the background image.
+/// @param output The path to write the screened image to.
+/// @param rows The number of scanlines processed per chunk.
+void streamScreenMode(const std::string &foreground, const std::string &background, const std::string &output,
+                      int rows = STREAM_ROWS);
+
+/// @brief Streaming overlayMode of two .tga files.
+/// @param foreground The path to the foreground image.
+/// @param background The path to the background image.
+/// @param output The path to write the overlayed image to.
+/// @param rows The number of scanlines processed per chunk.
+void streamOverlayMode(const std::string &foreground, const std::string &background, const std::string &output,
+                       int rows = STREAM_ROWS);
+
+/// @brief Streaming subtractMode of two .tga files.
+/// @param topLayer The path to the top layer image.
+/// @param bottomLayer The path to the bottom layer image.
+/// @param output The path to write the subtracted image to.
+/// @param rows The number of scanlines processed per chunk.
+void streamSubtractMode(const std::string &topLayer, const std::string &bottomLayer, const std::string &output,
+                        int rows = STREAM_ROWS);
+
+/// @brief Streaming add of a .tga file.
+/// @param input The path to the image to add to.
+/// @param output The path to write the added image to.
+/// @param r The red byte value.
+/// @param g The green byte value.
+/// @param b The blue byte value.
+/// @param rows The number of scanlines processed per chunk.
+void streamAdd(const std::string &input, const std::string &output, double r = 1.0, double g = 1.0, double b = 1.0,
+               int rows = STREAM_ROWS);
+
+/// @brief Streaming scale of a .tga file.
+/// @param input The path to the image to scale.
+/// @param output The path to write the scaled image to.
+/// @param r The red byte value.
+/// @param g The green byte value.
+/// @param b The blue byte value.
+/// @param rows The number of scanlines processed per chunk.
+void streamScale(const std::string &input, const std::string &output, double r = 1.0, double g = 1.0, double b = 1.0,
+                 int rows = STREAM_ROWS);
+
+/// @brief Streaming extractRed of a .tga file.
+/// @param input The path to the image.
+/// @param output The path to write the red channel image to.
+/// @param rows The number of scanlines processed per chunk.
+void streamExtractRed(const std::string &input, const std::string &output, int rows = STREAM_ROWS);
+
+/// @brief Streaming extractGreen of a .tga file.
+/// @param input The path to the image.
+/// @param output The path to write the green channel image to.
+/// @param rows The number of scanlines processed per chunk.
+void streamExtractGreen(const std::string &input, const std::string &output, int rows = STREAM_ROWS);
+
+/// @brief Streaming extractBlue of a .tga file.
+/// @param input The path to the image.
+/// @param output The path to write the blue channel image to.
+/// @param rows The number of scanlines processed per chunk.
+void streamExtractBlue(const std::string &input, const std::string &output, int rows = STREAM_ROWS);
+
+/// @brief Streaming combineChannels of three .tga files.
+/// @param red The path to the red channel image.
+/// @param green The path to the green channel image.
+/// @param blue The path to the blue channel image.
+/// @param output The path to write the combined image to.
+/// @param rows The number of scanlines processed per chunk.
+void streamCombineChannels(const std::string &red, const std::string &green, const std::string &blue,
+                           const std::string &output, int rows = STREAM_ROWS);
+
+#endif // STREAMPROCESSING_H
@@ -0,0 +1,112 @@
+#ifndef TGA_H
+#define TGA_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "header.h"
+
+/// @brief Pixel encodings an image can be written with.
+enum class TgaEncoding
+{
+    TrueColor,    // Uncompressed color (data type 2)
+    TrueColorRle, // Run-length encoded color (data type 10)
+    Grayscale,    // Uncompressed 8-bit luminance (data type 3)
+    GrayscaleRle  // Run-length encoded 8-bit luminance (data type 11)
+};
+
+/// @brief The decoded pixels of a .tga file.
+/// @note Rows are stored bottom-up and left-to-right (the layout of an uncompressed file with the
+///       default origin), whatever the origin of the source file was.
+struct TgaRaster
+{
+    Header header;                   // Normalized header describing `data` (no image ID or color map)
+    int channels = 0;                // 1 (gray), 3 (BGR) or 4 (BGRA) bytes per pixel
+    std::vector<unsigned char> data; // Interleaved channel bytes
+};
+
+/// @brief Incremental decoder for the pixel payload of a .tga file.
+/// @note Handles data types 1/2/3 and their run-length encoded variants 9/10/11 with 8 (indexed or gray),
+///       15/16, 24 and 32 bits per pixel. Pixels are produced in file order.
+class TgaDecoder
+{
+public:
+    /// @brief Prepares decoding for a file.
+    /// @param header The header of the file.
+    /// @param colorMap The raw color map bytes following the image ID (empty when there is none).
+    TgaDecoder(const Header &header, const unsigned char *colorMap = nullptr);
+
+    /// @return The number of channels of each decoded pixel (1, 3 or 4).
+    int channels() const { return outputChannels; }
+
+    /// @brief Decodes pixels from a span of payload bytes, keeping run-length state between calls.
+    /// @param in The next undecoded payload byte; advanced past the consumed bytes.
+    /// @param inEnd The end of the available payload bytes.
+    /// @param out Receives `channels()` bytes per decoded pixel.
+    /// @param pixels The maximum number of pixels to decode.
+    /// @return The number of pixels decoded; less than `pixels` when more input is needed.
+    std::size_t decode(const unsigned char *&in, const unsigned char *inEnd, unsigned char *out, std::size_t pixels);
+
+private:
+    void convert(const unsigned char *in, unsigned char *out, std::size_t count) const;
+
+    bool compressed;
+    int filePixelSize;  // Bytes per pixel in the payload
+    int outputChannels; // Bytes per decoded pixel
+    int bitsPerPixel;
+    bool indexed;
+    std::vector<unsigned char> palette; // Color map converted to decoded pixels
+
+    std::size_t runLeft = 0;       // Pixels left in the current run-length packet
+    std::size_t rawLeft = 0;       // Pixels left in the current raw packet
+    unsigned char runValue[4]{};   // Decoded pixel of the current run-length packet
+};
+
+/// @return The number of bytes between the header and the pixel payload (image ID plus color map).
+/// @param header The header of the file.
+std::size_t tgaPayloadOffset(const Header &header);
+
+/// @return `true` if the pixels are stored top row first.
+/// @param header The header of the file.
+bool tgaTopOrigin(const Header &header);
+
+/// @return `true` if the pixels of each row are stored right to left.
+/// @param header The header of the file.
+bool tgaRightOrigin(const Header &header);
+
+/// @brief Builds the header of an uncompressed or run-length encoded image written by this library.
+/// @param base The header to take the dimensions and origin coordinates from.
+/// @param channels The number of channels (1, 3 or 4).
+/// @param rle Whether the payload is run-length encoded.
+/// @return The header.
+Header tgaHeader(const Header &base, int channels, bool rle);
+
+/// @brief Decodes a .tga file held in memory.
+/// @param bytes The file contents.
+/// @param size The size of the file contents in bytes.
+/// @param name The name of the file (for error messages).
+/// @return The decoded pixels.
+TgaRaster decodeTga(const unsigned char *bytes, std::size_t size, const std::string &name = "<memory>");
+
+/// @brief Reads and decodes a .tga image file.
+/// @param file The path to the .tga file.
+/// @return The decoded pixels.
+TgaRaster readTga(const std::string &file);
+
+/// @brief Run-length encodes one row of pixels (packets never cross rows).
+/// @param row The interleaved channel bytes of the row.
+/// @param width The number of pixels in the row.
+/// @param channels The number of bytes per pixel.
+/// @param out Receives the encoded packets (appended).
+void encodeRleRow(const unsigned char *row, int width, int channels, std::vector<unsigned char> &out);
+
+/// @brief Writes bottom-up, left-to-right pixel data to a .tga image file.
+/// @param file The path to the .tga file.
+/// @param header The header to take the dimensions from (see tgaHeader).
+/// @param data The interleaved channel bytes.
+/// @param channels The number of channels (1, 3 or 4).
+/// @param rle Whether to run-length encode the payload.
+void writeTga(const std::string &file, const Header &header, const unsigned char *data, int channels, bool rle);
+
+#endif // TGA_H
@@ -0,0 +1,90 @@
+#ifndef TGASTREAM_H
+#define TGASTREAM_H
+
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "header.h"
+#include "pixel.h"
+#include "tga.h"
+
+/// @brief Reads the pixels of a .tga file a few scanlines at a time, so memory use is bounded by the
+///        chunk size rather than the image size.
+/// @note Any format supported by TgaDecoder is accepted and converted to BGR Pixels. Scanlines are returned
+///       in file order (see topOrigin); each scanline is returned left to right.
+class TgaReader
+{
+public:
+    /// @brief Opens a .tga image file and reads its header.
+    /// @param file The path to the .tga file.
+    explicit TgaReader(const std::string &file);
+
+    /// @return The header describing the returned scanlines (uncompressed 24-bit, origin bit kept).
+    const Header &header() const { return imageHeader; }
+
+    /// @return The number of pixels per scanline.
+    int width() const;
+
+    /// @return The number of scanlines.
+    int height() const;
+
+    /// @return `true` if the file stores (and the reader returns) the top scanline first.
+    bool topOrigin() const { return tgaTopOrigin(imageHeader); }
+
+    /// @return The number of scanlines not read yet.
+    int rowsRemaining() const { return height() - rowsRead; }
+
+    /// @brief Reads the next scanlines, in file order.
+    /// @param destination Receives `width() * rows` pixels.
+    /// @param rows The maximum number of scanlines to read.
+    /// @return The number of scanlines read (0 once the image is exhausted).
+    int readRows(Pixel *destination, int rows);
+
+private:
+    /// @brief Decodes `count` pixels into `out`, refilling the input buffer as needed.
+    void decode(unsigned char *out, std::size_t count);
+
+    std::string path;
+    std::ifstream stream;
+    Header imageHeader;
+    bool rightOrigin = false;
+    std::unique_ptr<TgaDecoder> decoder;
+    std::vector<unsigned char> input;   // Buffered payload bytes
+    std::size_t inputBegin = 0;         // First unconsumed byte of `input`
+    std::vector<unsigned char> decoded; // Scratch scanlines for non-BGR formats
+    int rowsRead = 0;
+};
+
+/// @brief Writes a .tga file a few scanlines at a time.
+class TgaWriter
+{
+public:
+    /// @brief Creates a .tga image file and writes its header.
+    /// @note The file is written as 24-bit true color; the origin bit of `header` is kept so that
+    ///       scanlines can be written in the same order they were read.
+    /// @param file The path to the .tga file.
+    /// @param header The header of the image.
+    /// @param rle Whether to run-length encode the scanlines.
+    TgaWriter(const std::string &file, const Header &header, bool rle = false);
+
+    /// @brief Appends scanlines to the image, in file order.
+    /// @param source Holds `width * rows` pixels.
+    /// @param rows The number of scanlines to write.
+    void writeRows(const Pixel *source, int rows);
+
+    /// @brief Flushes the file and checks that every scanline of the image was written.
+    void close();
+
+private:
+    std::string path;
+    std::ofstream stream;
+    Header imageHeader;
+    bool rle;
+    std::vector<unsigned char> packets; // Staging buffer for encoded scanlines
+    int rowsWritten = 0;
+};
+
+#endif // TGASTREAM_H
@@ -0,0 +1,68 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <cstddef>
+#include <type_traits>
+
+/// @brief Set the number of threads used by the image operations (including the calling thread).
+/// @note A count of 0 selects the number of hardware threads. A count of 1 runs everything serially.
+/// @param count The number of threads.
+void setThreadCount(unsigned int count);
+
+/// @return The number of threads used by the image operations.
+unsigned int threadCount();
+
+/// @brief Type-erased entry point of parallelFor (use parallelFor instead).
+/// @param count The number of items to process.
+/// @param grain The minimum number of items per band.
+/// @param body Invoked as `body(context, begin, end)` for each band.
+/// @param context The callable passed to parallelFor.
+void parallelForBands(std::size_t count, std::size_t grain,
+                      void (*body)(void *, std::size_t, std::size_t), void *context);
+
+/// @brief Split the range [0, count) into contiguous bands and process them on the shared thread pool.
+/// @note Bands never overlap and every item is visited exactly once, so point-wise operations produce
+///       the same output as a serial loop. Calls made from inside a band run serially on that thread.
+///       No heap allocation takes place per call. If a band throws, the bands not yet started are skipped and
+///       the first exception is rethrown on the calling thread once every running band has returned.
+/// @param count The number of items (pixels, rows, ...) to process.
+/// @param grain The minimum number of items per band; small ranges run on the calling thread only.
+/// @param body Callable invoked as `body(begin, end)` for each band.
+template <typename Body>
+void parallelFor(std::size_t count, std::size_t grain, Body &&body)
+{
+    using Callable = std::remove_reference_t<Body>;
+    parallelForBands(
+        count, grain,
+        [](void *context, std::size_t begin, std::size_t end)
+        { (*static_cast<Callable *>(context))(begin, end); },
+        const_cast<void *>(static_cast<const void *>(&body)));
+}
+
+/// @brief Minimum number of pixels the image operations hand to one thread (keeps small images on the calling
+///        thread).
+constexpr std::size_t PIXEL_GRAIN = 16384;
+
+/// @param width The width of the rows in pixels.
+/// @return The minimum number of rows per band, so a band holds at least PIXEL_GRAIN pixels (and one row).
+constexpr std::size_t rowGrain(int width)
+{
+    return width > 1 ? (PIXEL_GRAIN + static_cast<std::size_t>(width) - 1) / static_cast<std::size_t>(width)
+                     : PIXEL_GRAIN;
+}
+
+/// @brief Run `body(y)` for every row of a region, in parallel bands of whole rows (see parallelFor).
+/// @param width The width of the region in pixels.
+/// @param height The number of rows.
+/// @param body Callable invoked as `body(y)` for each row.
+template <typename Body>
+void parallelForRows(int width, int height, Body &&body)
+{
+    parallelFor(static_cast<std::size_t>(height > 0 ? height : 0), rowGrain(width),
+                [&](std::size_t begin, std::size_t end)
+                {
+                    for (std::size_t y = begin; y < end; ++y)
+                        body(static_cast<int>(y)); });
+}
+
+#endif // THREADPOOL_H
@@ -0,0 +1,82 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/// @brief Quantities accumulated while tracing.
+enum class TraceCounter
+{
+    BytesRead,       // Bytes of .tga files read
+    BytesWritten,    // Bytes of .tga files written
+    PixelsProcessed, // Output pixels produced by image operations
+    Allocations      // Pixel buffers allocated for new images
+};
+
+/// @brief Records the time spent between its construction and destruction as one trace event.
+/// @note Use through IP_TRACE_SCOPE so it disappears from builds without tracing. Nothing is recorded while
+///       tracing is off, beyond checking a flag.
+class TraceScope
+{
+public:
+    /// @param name The event name; must outlive the trace (a string literal).
+    explicit TraceScope(const char *name);
+    ~TraceScope();
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *name;
+    std::uint64_t start; // Nanoseconds since the trace epoch, or 0 when tracing was off at construction
+};
+
+/// @brief Start or stop recording events and counters (off by default).
+/// @param enabled Whether to record.
+void setTracing(bool enabled);
+
+/// @return Whether events and counters are being recorded.
+bool tracingEnabled();
+
+/// @brief Discard all recorded events and reset the counters.
+void clearTrace();
+
+/// @brief Add to a counter (only while tracing is on).
+/// @param counter The counter.
+/// @param amount The amount to add.
+void traceCount(TraceCounter counter, std::uint64_t amount);
+
+/// @return The current value of a counter.
+std::uint64_t traceCounter(TraceCounter counter);
+
+/// @brief Write the recorded events and counters in the Chrome trace event format.
+/// @note The output loads in chrome://tracing and Perfetto: one complete ("X") event per scope on its thread's
+///       track, followed by the final counter values.
+/// @param out The stream to write the JSON to.
+void writeChromeTrace(std::ostream &out);
+
+/// @brief Write the recorded events and counters to a Chrome trace file.
+/// @param file The path of the .json file to write.
+void writeChromeTrace(const std::string &file);
+
+/// @brief Whether the instrumentation hooks are compiled in (the IMAGEPROCESSING_TRACING option).
+/// @note Without them a trace holds no events and all counters stay 0.
+#ifdef IMAGEPROCESSING_TRACING
+constexpr bool TRACING_COMPILED = true;
+#else
+constexpr bool TRACING_COMPILED = false;
+#endif
+
+// Instrumentation hooks, compiled out entirely unless the IMAGEPROCESSING_TRACING option is on
+#ifdef IMAGEPROCESSING_TRACING
+#define IP_TRACE_JOIN_(a, b) a##b
+#define IP_TRACE_JOIN(a, b) IP_TRACE_JOIN_(a, b)
+#define IP_TRACE_SCOPE(name) TraceScope IP_TRACE_JOIN(traceScope, __LINE__) { name }
+#define IP_TRACE_COUNT(counter, amount) traceCount(TraceCounter::counter, static_cast<std::uint64_t>(amount))
+#else
+#define IP_TRACE_SCOPE(name) static_cast<void>(0)
+#define IP_TRACE_COUNT(counter, amount) static_cast<void>(0)
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,60 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "image.h"
+
+/// @brief Mirror the image left to right.
+/// @param image The image to mirror.
+/// @return The mirrored image.
+Image flipHorizontal(const Image &image);
+
+/// @brief Mirror the image left to right into a caller-provided image.
+/// @note `result` may be `image`, which mirrors it in place without extra memory.
+/// @param image The image to mirror.
+/// @param result The image receiving the output; resized to match if needed.
+void flipHorizontal(const Image &image, Image &result);
+
+/// @brief Mirror the image top to bottom.
+/// @param image The image to mirror.
+/// @return The mirrored image.
+Image flipVertical(const Image &image);
+
+/// @brief Mirror the image top to bottom into a caller-provided image.
+/// @note `result` may be `image`, which mirrors it in place without extra memory.
+/// @param image The image to mirror.
+/// @param result The image receiving the output; resized to match if needed.
+void flipVertical(const Image &image, Image &result);
+
+/// @brief Rotate the image by 90 degrees clockwise (width and height are swapped).
+/// @param image The image to rotate.
+/// @return The rotated image.
+Image rotate90(const Image &image);
+
+/// @brief Rotate the image by 90 degrees clockwise into a caller-provided image.
+/// @note Processed in square tiles so both images are walked cache-line by cache-line.
+///       `result` cannot be `image`.
+/// @param image The image to rotate.
+/// @param result The image receiving the output; resized to match if needed.
+void rotate90(const Image &image, Image &result);
+
+/// @brief Rotate the image by 270 degrees clockwise (90 degrees counterclockwise).
+/// @param image The image to rotate.
+/// @return The rotated image.
+Image rotate270(const Image &image);
+
+/// @brief Rotate the image by 270 degrees clockwise into a caller-provided image (tiled; `result` cannot be `image`).
+/// @param image The image to rotate.
+/// @param result The image receiving the output; resized to match if needed.
+void rotate270(const Image &image, Image &result);
+
+/// @brief Swap the x and y axes (mirror across the bottom-left to top-right diagonal).
+/// @param image The image to transpose.
+/// @return The transposed image.
+Image transpose(const Image &image);
+
+/// @brief Transpose the image into a caller-provided image (tiled; `result` cannot be `image`).
+/// @param image The image to transpose.
+/// @param result The image receiving the output; resized to match if needed.
+void transpose(const Image &image, Image &result);
+
+#endif // TRANSFORM_H
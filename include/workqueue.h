@@ -0,0 +1,105 @@
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "batch.h"
+#include "tga.h"
+
+/// @brief One unit of work: run a pipeline on an input file and write the result to an output file.
+struct BatchJob
+{
+    std::string pipeline; // Pipeline description (see PipelineSpec)
+    std::string input;    // The .tga file to process
+    std::string output;   // The .tga file to write
+};
+
+/// @brief Settings of a run spread over worker processes.
+/// @note The queue is a directory shared by the coordinator and its workers:
+///       - `pending/`: shards waiting for a worker, named `SHARD.ATTEMPT`
+///       - `claimed/`: shards being processed, named `SHARD.ATTEMPT.PID` after the worker holding them. The
+///         worker keeps the file locked (flock) as a lease, which the system drops when the worker dies
+///       - `done/`: one report per finished shard (files written, skipped and failed, then the failures)
+///       - `failed/`: shards given up after their workers died `maxAttempts` times
+///       A shard is a text file of jobs, one `PIPELINE<TAB>INPUT<TAB>OUTPUT` line each. Every move between the
+///       directories is a rename, which is atomic, so each shard has exactly one owner at any time.
+struct QueueOptions
+{
+    std::string queueDirectory;      // Root of the queue
+    unsigned int workers = 0;        // Worker processes (0: one per hardware thread)
+    unsigned int computeThreads = 1; // Thread pool size of each worker
+    std::size_t shardSize = 64;      // Jobs per shard
+    unsigned int maxAttempts = 3;    // Tries per job, and worker deaths per shard, before giving up
+    TgaEncoding encoding = TgaEncoding::TrueColor; // Encoding of the output files
+};
+
+/// @brief How far a queue has got, from its directories.
+struct QueueProgress
+{
+    std::size_t pending = 0; // Shards waiting for a worker
+    std::size_t claimed = 0; // Shards being processed
+    std::size_t done = 0;    // Shards finished
+    std::size_t failed = 0;  // Shards given up
+    std::size_t written = 0; // Outputs written by the finished shards
+    std::size_t skipped = 0; // Outputs of the finished shards that already existed
+    std::size_t errors = 0;  // Jobs of the finished shards that failed every attempt
+
+    /// @return The number of shards in the queue.
+    std::size_t total() const { return pending + claimed + done + failed; }
+};
+
+/// @brief Reads jobs from a manifest, one `PIPELINE<TAB>INPUT<TAB>OUTPUT` line each.
+/// @note Blank lines and lines starting with `#` are ignored, as in input manifests.
+/// @param file The path to the manifest.
+/// @return The jobs.
+std::vector<BatchJob> readJobManifest(const std::string &file);
+
+/// @brief Creates a queue holding jobs, split into shards of `shardSize` jobs.
+/// @note Does nothing if the directory already holds a queue, so rerunning a command resumes it. A queue whose
+///       creation was interrupted is created again from scratch. Jobs with colliding outputs are rejected
+///       (see checkOutputPaths).
+/// @param queueDirectory The root of the queue.
+/// @param jobs The jobs.
+/// @param shardSize The number of jobs per shard.
+/// @return `true` if the queue was created; `false` if it already existed.
+bool createQueue(const std::string &queueDirectory, const std::vector<BatchJob> &jobs, std::size_t shardSize);
+
+/// @brief Counts the shards in each state and sums the reports of the finished ones.
+/// @param queueDirectory The root of the queue.
+/// @return The progress.
+QueueProgress queueProgress(const std::string &queueDirectory);
+
+/// @brief Returns the shards whose worker no longer holds their lease to `pending/`.
+/// @note Leases, unlike PIDs, cannot outlive their worker: a claim left by a crash or a reboot is returned
+///       even if its PID has been reused. Shards whose workers already died `maxAttempts` times move to
+///       `failed/` instead.
+/// @param queueDirectory The root of the queue.
+/// @param maxAttempts The number of worker deaths a shard may cause.
+/// @param pid The process whose shards to return, or 0 for the shards of every worker that is gone.
+/// @return The number of shards returned to `pending/`.
+std::size_t requeueClaims(const std::string &queueDirectory, unsigned int maxAttempts, long pid = 0);
+
+/// @brief Claims shards from a queue and processes their jobs until no shard is pending.
+/// @note Jobs whose output exists are skipped, and outputs are written under a temporary name and renamed, so
+///       an output exists only once it is complete. A failing job is tried `maxAttempts` times before it is
+///       reported as failed.
+/// @param options The settings of the run (`workers` is ignored).
+/// @param log Receives one line per failed job.
+/// @return The outcome of the jobs this worker processed.
+BatchResult runWorker(const QueueOptions &options, std::ostream &log);
+
+/// @brief Processes a queue with worker processes, reporting progress until every shard is done or failed.
+/// @note Starts `workers` copies of `executable` in worker mode. A worker that dies has its shards returned
+///       to the queue and is replaced. Returned shards count towards `maxAttempts`. Shards left by workers of
+///       an earlier interrupted run are returned as well; those whose workers are still running are waited
+///       for, and logged.
+/// @param options The settings of the run.
+/// @param executable The path to the ImageProcessing executable.
+/// @param log Receives the progress and a summary.
+/// @return The outcome of the whole queue, including the shards finished by earlier runs.
+BatchResult runCoordinator(const QueueOptions &options, const std::string &executable, std::ostream &log);
+
+#endif // WORKQUEUE_H
@@ -0,0 +1,421 @@
+#include "basicimage.h"
+
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "kernels.h"
+#include "threadpool.h"
+#include "trace.h"
+
+// The operations treat the pixel vector as a flat run of interleaved BGR channels
+static_assert(sizeof(BasicPixel<std::uint16_t>) == 3 * sizeof(std::uint16_t) &&
+                  sizeof(BasicPixel<float>) == 3 * sizeof(float),
+              "BasicPixel must be tightly packed BGR channels");
+
+namespace
+{
+    /// @return `top * bottom / max`, rounded to the nearest 16-bit value.
+    std::uint16_t product(std::uint16_t top, std::uint16_t bottom)
+    {
+        return static_cast<std::uint16_t>((std::uint32_t{top} * bottom + 32767u) / 65535u);
+    }
+
+    /// @return `top * bottom` (1 being full intensity).
+    float product(float top, float bottom)
+    {
+        return top * bottom;
+    }
+
+    template <typename T>
+    T multiplyChannel(T top, T bottom)
+    {
+        return product(top, bottom);
+    }
+
+    template <typename T>
+    T screenChannel(T top, T bottom)
+    {
+        constexpr T max = ChannelTraits<T>::max;
+        return static_cast<T>(max - product(static_cast<T>(max - top), static_cast<T>(max - bottom)));
+    }
+
+    template <typename T>
+    T overlayChannel(T top, T bottom)
+    {
+        // Doubling the halved range stays within 0...max, as in overlayBlend
+        constexpr T max = ChannelTraits<T>::max;
+        return bottom < ChannelTraits<T>::half
+                   ? static_cast<T>(2 * product(top, bottom))
+                   : static_cast<T>(max - 2 * product(static_cast<T>(max - top), static_cast<T>(max - bottom)));
+    }
+
+    template <typename T>
+    T subtractChannel(T top, T bottom)
+    {
+        return bottom < top ? T{} : static_cast<T>(bottom - top);
+    }
+
+    template <typename T>
+    const T *channels(const BasicImage<T> &image)
+    {
+        return reinterpret_cast<const T *>(image.pixels.data());
+    }
+
+    template <typename T>
+    T *channels(BasicImage<T> &image)
+    {
+        return reinterpret_cast<T *>(image.pixels.data());
+    }
+
+    template <typename T>
+    void checkSameSize(const BasicImage<T> &first, const BasicImage<T> &second)
+    {
+        if (first.pixels.size() != second.pixels.size())
+            throw std::runtime_error("ERROR: Images must have the same number of pixels.");
+    }
+
+    /// @brief Give `result` the header and pixel count of `source` (reusing its buffer when large enough).
+    template <typename T>
+    void prepare(const BasicImage<T> &source, BasicImage<T> &result)
+    {
+        if (&source == &result)
+            return;
+        result.header = source.header;
+        result.pixels.resize(source.pixels.size());
+    }
+
+    /// @brief Apply `op(top, bottom)` to every channel of two images, in parallel.
+    /// @note The loop runs over flat channels, so the compiler vectorizes it for float.
+    template <typename T, typename Op>
+    void blend(const BasicImage<T> &top, const BasicImage<T> &bottom, BasicImage<T> &result, Op op)
+    {
+        IP_TRACE_COUNT(PixelsProcessed, top.pixels.size());
+        checkSameSize(top, bottom);
+        prepare(top, result);
+
+        const T *topChannels = channels(top);
+        const T *bottomChannels = channels(bottom);
+        T *resultChannels = channels(result);
+        parallelFor(top.pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                    {
+                        for (std::size_t i = begin * 3; i < end * 3; ++i)
+                            resultChannels[i] = op(topChannels[i], bottomChannels[i]); });
+    }
+
+    /// @brief Apply `op(pixel)` to every pixel of an image, in parallel.
+    template <typename T, typename Op>
+    void transformPixels(const BasicImage<T> &image, BasicImage<T> &result, Op op)
+    {
+        IP_TRACE_COUNT(PixelsProcessed, image.pixels.size());
+        prepare(image, result);
+        parallelFor(image.pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                    {
+                        for (std::size_t i = begin; i < end; ++i)
+                            result.pixels[i] = op(image.pixels[i]); });
+    }
+}
+
+template <typename T>
+BasicImage<T>::BasicImage(const std::string &file) : BasicImage{Image{file}}
+{
+}
+
+template <typename T>
+BasicImage<T>::BasicImage(const Header &header) : header{header}
+{
+    IP_TRACE_SCOPE("BasicImage::allocate");
+    IP_TRACE_COUNT(Allocations, 1);
+    pixels.resize(static_cast<std::size_t>(imageWidth(header)) * imageHeight(header));
+}
+
+template <typename T>
+BasicImage<T>::BasicImage(const Image &image) : BasicImage{image.header}
+{
+    IP_TRACE_SCOPE("BasicImage::widen");
+    const unsigned char *in = reinterpret_cast<const unsigned char *>(image.pixels.data());
+    T *out = channels(*this);
+    parallelFor(pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                {
+                    for (std::size_t i = begin * 3; i < end * 3; ++i)
+                        out[i] = ChannelTraits<T>::fromByte(in[i]); });
+}
+
+template <typename T>
+Image BasicImage<T>::toImage() const
+{
+    Image result{header};
+    toImage(result);
+    return result;
+}
+
+template <typename T>
+void BasicImage<T>::toImage(Image &result) const
+{
+    IP_TRACE_SCOPE("BasicImage::quantize");
+    result.header = header;
+    result.pixels.resize(pixels.size());
+
+    const T *in = channels(*this);
+    unsigned char *out = reinterpret_cast<unsigned char *>(result.pixels.data());
+    parallelFor(pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                {
+                    // Float comparisons keep the compiler from vectorizing the clamp, so float has its own kernel
+                    if constexpr (std::is_same_v<T, float>)
+                        quantizeKernel(in + begin * 3, out + begin * 3, (end - begin) * 3);
+                    else
+                        for (std::size_t i = begin * 3; i < end * 3; ++i)
+                            out[i] = ChannelTraits<T>::toByte(in[i]); });
+}
+
+template <typename T>
+void BasicImage<T>::write(const std::string &file, TgaEncoding encoding) const
+{
+    toImage().write(file, encoding);
+}
+
+template <typename T>
+void multiplyMode(const BasicImage<T> &foreground, const BasicImage<T> &background, BasicImage<T> &result)
+{
+    IP_TRACE_SCOPE("multiplyMode");
+    blend(foreground, background, result, [](T top, T bottom)
+          { return multiplyChannel(top, bottom); });
+}
+
+template <typename T>
+BasicImage<T> multiplyMode(const BasicImage<T> &foreground, const BasicImage<T> &background)
+{
+    BasicImage<T> result{foreground.header};
+    multiplyMode(foreground, background, result);
+    return result;
+}
+
+template <typename T>
+void screenMode(const BasicImage<T> &foreground, const BasicImage<T> &background, BasicImage<T> &result)
+{
+    IP_TRACE_SCOPE("screenMode");
+    blend(foreground, background, result, [](T top, T bottom)
+          { return screenChannel(top, bottom); });
+}
+
+template <typename T>
+BasicImage<T> screenMode(const BasicImage<T> &foreground, const BasicImage<T> &background)
+{
+    BasicImage<T> result{foreground.header};
+    screenMode(foreground, background, result);
+    return result;
+}
+
+template <typename T>
+void overlayMode(const BasicImage<T> &foreground, const BasicImage<T> &background, BasicImage<T> &result)
+{
+    IP_TRACE_SCOPE("overlayMode");
+    blend(foreground, background, result, [](T top, T bottom)
+          { return overlayChannel(top, bottom); });
+}
+
+template <typename T>
+BasicImage<T> overlayMode(const BasicImage<T> &foreground, const BasicImage<T> &background)
+{
+    BasicImage<T> result{foreground.header};
+    overlayMode(foreground, background, result);
+    return result;
+}
+
+template <typename T>
+void subtractMode(const BasicImage<T> &topLayer, const BasicImage<T> &bottomLayer, BasicImage<T> &result)
+{
+    IP_TRACE_SCOPE("subtractMode");
+    blend(topLayer, bottomLayer, result, [](T top, T bottom)
+          { return subtractChannel(top, bottom); });
+}
+
+template <typename T>
+BasicImage<T> subtractMode(const BasicImage<T> &topLayer, const BasicImage<T> &bottomLayer)
+{
+    BasicImage<T> result{topLayer.header};
+    subtractMode(topLayer, bottomLayer, result);
+    return result;
+}
+
+template <typename T>
+void add(const BasicImage<T> &image, BasicImage<T> &result, double r, double g, double b)
+{
+    IP_TRACE_SCOPE("add");
+    // The values are in 8-bit units
+    constexpr double unit = ChannelTraits<T>::max / 255.0;
+    auto red = static_cast<float>(r * unit);
+    auto green = static_cast<float>(g * unit);
+    auto blue = static_cast<float>(b * unit);
+    transformPixels(image, result, [&](const BasicPixel<T> &pixel)
+                    { return BasicPixel<T>(ChannelTraits<T>::clamp(pixel.r + red), ChannelTraits<T>::clamp(pixel.g + green),
+                                           ChannelTraits<T>::clamp(pixel.b + blue)); });
+}
+
+template <typename T>
+BasicImage<T> add(const BasicImage<T> &image, double r, double g, double b)
+{
+    BasicImage<T> result{image.header};
+    add(image, result, r, g, b);
+    return result;
+}
+
+template <typename T>
+void scale(const BasicImage<T> &image, BasicImage<T> &result, double r, double g, double b)
+{
+    IP_TRACE_SCOPE("scale");
+    auto red = static_cast<float>(r);
+    auto green = static_cast<float>(g);
+    auto blue = static_cast<float>(b);
+    transformPixels(image, result, [&](const BasicPixel<T> &pixel)
+                    { return BasicPixel<T>(ChannelTraits<T>::clamp(pixel.r * red), ChannelTraits<T>::clamp(pixel.g * green),
+                                           ChannelTraits<T>::clamp(pixel.b * blue)); });
+}
+
+template <typename T>
+BasicImage<T> scale(const BasicImage<T> &image, double r, double g, double b)
+{
+    BasicImage<T> result{image.header};
+    scale(image, result, r, g, b);
+    return result;
+}
+
+template <typename T>
+void extractRed(const BasicImage<T> &image, BasicImage<T> &result)
+{
+    IP_TRACE_SCOPE("extractRed");
+    transformPixels(image, result, [](const BasicPixel<T> &pixel)
+                    { return BasicPixel<T>(pixel.r, pixel.r, pixel.r); });
+}
+
+template <typename T>
+BasicImage<T> extractRed(const BasicImage<T> &image)
+{
+    BasicImage<T> result{image.header};
+    extractRed(image, result);
+    return result;
+}
+
+template <typename T>
+void extractGreen(const BasicImage<T> &image, BasicImage<T> &result)
+{
+    IP_TRACE_SCOPE("extractGreen");
+    transformPixels(image, result, [](const BasicPixel<T> &pixel)
+                    { return BasicPixel<T>(pixel.g, pixel.g, pixel.g); });
+}
+
+template <typename T>
+BasicImage<T> extractGreen(const BasicImage<T> &image)
+{
+    BasicImage<T> result{image.header};
+    extractGreen(image, result);
+    return result;
+}
+
+template <typename T>
+void extractBlue(const BasicImage<T> &image, BasicImage<T> &result)
+{
+    IP_TRACE_SCOPE("extractBlue");
+    transformPixels(image, result, [](const BasicPixel<T> &pixel)
+                    { return BasicPixel<T>(pixel.b, pixel.b, pixel.b); });
+}
+
+template <typename T>
+BasicImage<T> extractBlue(const BasicImage<T> &image)
+{
+    BasicImage<T> result{image.header};
+    extractBlue(image, result);
+    return result;
+}
+
+template <typename T>
+void combineChannels(const BasicImage<T> &red, const BasicImage<T> &green, const BasicImage<T> &blue,
+                     BasicImage<T> &result)
+{
+    IP_TRACE_SCOPE("combineChannels");
+    IP_TRACE_COUNT(PixelsProcessed, red.pixels.size());
+    checkSameSize(red, green);
+    checkSameSize(red, blue);
+    prepare(red, result);
+
+    parallelFor(red.pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                {
+                    for (std::size_t i = begin; i < end; ++i)
+                        result.pixels[i] = BasicPixel<T>(red.pixels[i].r, green.pixels[i].g, blue.pixels[i].b); });
+}
+
+template <typename T>
+BasicImage<T> combineChannels(const BasicImage<T> &red, const BasicImage<T> &green, const BasicImage<T> &blue)
+{
+    BasicImage<T> result{red.header};
+    combineChannels(red, green, blue, result);
+    return result;
+}
+
+template <typename T>
+void rotate180(const BasicImage<T> &image, BasicImage<T> &result)
+{
+    IP_TRACE_SCOPE("rotate180");
+    IP_TRACE_COUNT(PixelsProcessed, image.pixels.size());
+    std::size_t count = image.pixels.size();
+    if (count == 0)
+        return prepare(image, result);
+
+    std::size_t last = count - 1;
+    if (&image == &result)
+    {
+        // In place: swap mirrored pairs, each band owning the pairs of its lower half
+        parallelFor(count / 2, PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                    {
+                        for (std::size_t i = begin; i < end; ++i)
+                            std::swap(result.pixels[i], result.pixels[last - i]); });
+        return;
+    }
+
+    prepare(image, result);
+    parallelFor(count, PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                {
+                    for (std::size_t i = begin; i < end; ++i)
+                        result.pixels[last - i] = image.pixels[i]; });
+}
+
+template <typename T>
+BasicImage<T> rotate180(const BasicImage<T> &image)
+{
+    BasicImage<T> result{image.header};
+    rotate180(image, result);
+    return result;
+}
+
+// The definitions live here, so every supported channel type is instantiated explicitly
+#define INSTANTIATE_BASIC_IMAGE(T)                                                                                    \
+    template struct BasicImage<T>;                                                                                    \
+    template BasicImage<T> multiplyMode(const BasicImage<T> &, const BasicImage<T> &);                                \
+    template void multiplyMode(const BasicImage<T> &, const BasicImage<T> &, BasicImage<T> &);                        \
+    template BasicImage<T> screenMode(const BasicImage<T> &, const BasicImage<T> &);                                  \
+    template void screenMode(const BasicImage<T> &, const BasicImage<T> &, BasicImage<T> &);                          \
+    template BasicImage<T> overlayMode(const BasicImage<T> &, const BasicImage<T> &);                                 \
+    template void overlayMode(const BasicImage<T> &, const BasicImage<T> &, BasicImage<T> &);                         \
+    template BasicImage<T> subtractMode(const BasicImage<T> &, const BasicImage<T> &);                                \
+    template void subtractMode(const BasicImage<T> &, const BasicImage<T> &, BasicImage<T> &);                        \
+    template BasicImage<T> add(const BasicImage<T> &, double, double, double);                                        \
+    template void add(const BasicImage<T> &, BasicImage<T> &, double, double, double);                                \
+    template BasicImage<T> scale(const BasicImage<T> &, double, double, double);                                      \
+    template void scale(const BasicImage<T> &, BasicImage<T> &, double, double, double);                              \
+    template BasicImage<T> extractRed(const BasicImage<T> &);                                                         \
+    template void extractRed(const BasicImage<T> &, BasicImage<T> &);                                                 \
+    template BasicImage<T> extractGreen(const BasicImage<T> &);                                                       \
+    template void extractGreen(const BasicImage<T> &, BasicImage<T> &);                                               \
+    template BasicImage<T> extractBlue(const BasicImage<T> &);                                                        \
+    template void extractBlue(const BasicImage<T> &, BasicImage<T> &);                                               \
+    template BasicImage<T> combineChannels(const BasicImage<T> &, const BasicImage<T> &, const BasicImage<T> &);      \
+    template void combineChannels(const BasicImage<T> &, const BasicImage<T> &, const BasicImage<T> &,                \
+                                  BasicImage<T> &);                                                                   \
+    template BasicImage<T> rotate180(const BasicImage<T> &);                                                          \
+    template void rotate180(const BasicImage<T> &, BasicImage<T> &);
+
+INSTANTIATE_BASIC_IMAGE(std::uint16_t)
+INSTANTIATE_BASIC_IMAGE(float)
+
+#undef INSTANTIATE_BASIC_IMAGE
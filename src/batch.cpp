@@ -0,0 +1,679 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "blendmodes.h"
+#include "boundedqueue.h"
+#include "bufferpool.h"
+#include "colortransform.h"
+#include "composite.h"
+#include "filter.h"
+#include "imageview.h"
+#include "resample.h"
+#include "statistics.h"
+#include "threadpool.h"
+#include "trace.h"
+#include "transform.h"
+#include "workqueue.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    std::vector<std::string> split(const std::string &text, char separator)
+    {
+        std::vector<std::string> parts;
+        std::stringstream stream{text};
+        std::string part;
+        while (std::getline(stream, part, separator))
+            parts.push_back(part);
+        return parts;
+    }
+
+    double parseNumber(const std::string &text, const std::string &step)
+    {
+        try
+        {
+            std::size_t used;
+            double value = std::stod(text, &used);
+            if (used == text.size())
+                return value;
+        }
+        catch (const std::exception &)
+        {
+        }
+        throw std::runtime_error("ERROR: Invalid number \"" + text + "\" in step \"" + step + "\".");
+    }
+
+    void expectArguments(const std::vector<std::string> &parts, std::size_t minimum, std::size_t maximum, const std::string &step)
+    {
+        if (parts.size() - 1 < minimum || parts.size() - 1 > maximum)
+            throw std::runtime_error("ERROR: Wrong number of arguments in step \"" + step + "\".");
+    }
+
+    /// @brief An image travelling between the stages of a batch run.
+    struct BatchItem
+    {
+        std::size_t index; // Position in the inputs
+        std::unique_ptr<Image> image;
+    };
+
+    void printUsage(std::ostream &out)
+    {
+        out << "Usage:\n"
+            << "  ImageProcessing                 Run the built-in test suite\n"
+            << "  ImageProcessing run -p PIPELINE [options] INPUT...\n"
+            << "  ImageProcessing coordinate --queue-dir DIR [-w N] [--jobs FILE] [-p PIPELINE -o DIR INPUT...]\n"
+            << "                                  Spread the jobs over worker processes (rerun to resume)\n"
+            << "  ImageProcessing work --queue-dir DIR\n"
+            << "                                  Process the shards of a queue (started by coordinate)\n\n"
+            << "Inputs: .tga files, directories (every .tga inside) or @MANIFEST (one path per line).\n"
+            << "Jobs: lines of PIPELINE<TAB>INPUT<TAB>OUTPUT; each input also becomes a job with -p and -o.\n\n"
+            << "Options:\n"
+            << "  -p, --pipeline SPEC   Comma-separated steps, e.g. \"multiply:pattern.tga,add:0:200:0\"\n"
+            << "                        (multiply|screen|overlay|subtract:FILE[:bottom], add|scale:R:G:B,\n"
+            << "                         blend:MODE:FILE[:bottom], over:FILE, extract:red|green|blue, invert,\n"
+            << "                         gamma:G, threshold:LEVEL, swizzle:ORDER, matrix:M11:...:M33,\n"
+            << "                         rotate90|180|270, transpose, flipH, flipV, blur:SIGMA, box:RADIUS,\n"
+            << "                         sharpen:SIGMA:AMOUNT[:THRESHOLD], levels:BLACK:WHITE[:GAMMA],\n"
+            << "                         autolevels[:CLIP[:linked]], equalize,\n"
+            << "                         crop:X:Y:WIDTH:HEIGHT, resize:WIDTH:HEIGHT[:nearest|bilinear|area|lanczos],\n"
+            << "                         thumbnail:WIDTH:HEIGHT, quadrants:SECOND:THIRD:FOURTH)\n"
+            << "  -o, --output DIR      Output directory (default: current directory)\n"
+            << "  -j, --io-threads N    Decoder and encoder threads (default: 2 each)\n"
+            << "  -q, --queue N         Images in flight per stage (default: 8)\n"
+            << "  -t, --threads N       Compute threads (default: all hardware threads)\n"
+            << "      --rle             Write run-length encoded outputs\n"
+            << "      --queue-dir DIR   Queue directory of coordinate and work\n"
+            << "      --jobs FILE       Job manifest to queue\n"
+            << "  -w, --workers N       Worker processes (default: one per hardware thread)\n"
+            << "      --shard N         Jobs per shard (default: 64)\n"
+            << "      --attempts N      Tries per job and worker deaths per shard (default: 3)\n"
+            << "      --trace FILE      Write a Chrome trace of the run (only in builds with IMAGEPROCESSING_TRACING)\n";
+    }
+
+    /// @return The path workers are started from: the running executable where the system tells, else `argv[0]`.
+    std::string executablePath(const char *argv0)
+    {
+        std::error_code error;
+        fs::path self = fs::read_symlink("/proc/self/exe", error);
+        return error ? std::string{argv0} : self.string();
+    }
+
+    std::size_t parseCount(const std::string &option, const std::string &value)
+    {
+        try
+        {
+            std::size_t used;
+            unsigned long count = std::stoul(value, &used);
+            if (used == value.size())
+                return count;
+        }
+        catch (const std::exception &)
+        {
+        }
+        throw std::runtime_error("ERROR: Option " + option + " expects a number.");
+    }
+}
+
+PipelineSpec::PipelineSpec(const std::string &spec) : spec{spec}
+{
+    for (const std::string &step : split(spec, ','))
+    {
+        std::vector<std::string> parts = split(step, ':');
+        if (parts.empty() || parts[0].empty())
+            continue;
+        const std::string &name = parts[0];
+
+        if (name == "multiply" || name == "screen" || name == "overlay" || name == "subtract")
+        {
+            expectArguments(parts, 1, 2, step);
+            if (parts.size() == 3 && parts[2] != "top" && parts[2] != "bottom")
+                throw std::runtime_error("ERROR: Expected \"top\" or \"bottom\" in step \"" + step + "\".");
+            Layer layer = (parts.size() == 3 && parts[2] == "bottom") ? Layer::Bottom : Layer::Top;
+
+            operands.push_back(std::make_unique<Image>(parts[1]));
+            const Image &other = *operands.back();
+            if (name == "multiply")
+                steps.push_back([&other, layer](Pipeline &pipeline)
+                                { pipeline.multiplyMode(other, layer); });
+            else if (name == "screen")
+                steps.push_back([&other, layer](Pipeline &pipeline)
+                                { pipeline.screenMode(other, layer); });
+            else if (name == "overlay")
+                steps.push_back([&other, layer](Pipeline &pipeline)
+                                { pipeline.overlayMode(other, layer); });
+            else
+                steps.push_back([&other, layer](Pipeline &pipeline)
+                                { pipeline.subtractMode(other, layer); });
+        }
+        else if (name == "blend")
+        {
+            // Any registered blend mode, fused like the four above (and using their kernels for those modes)
+            expectArguments(parts, 2, 3, step);
+            if (parts.size() == 4 && parts[3] != "top" && parts[3] != "bottom")
+                throw std::runtime_error("ERROR: Expected \"top\" or \"bottom\" in step \"" + step + "\".");
+            Layer layer = (parts.size() == 4 && parts[3] == "bottom") ? Layer::Bottom : Layer::Top;
+            std::string mode = parts[1];
+            findBlendMode(mode); // Unknown modes fail here rather than on the first file
+
+            operands.push_back(std::make_unique<Image>(parts[2]));
+            const Image &other = *operands.back();
+            steps.push_back([&other, mode, layer](Pipeline &pipeline)
+                            { pipeline.blendMode(mode, other, layer); });
+        }
+        else if (name == "over")
+        {
+            // A transparent layer (alpha taken from the file) placed over the processed image
+            expectArguments(parts, 1, 1, step);
+            layers.push_back(std::make_unique<ImageRGBA>(parts[1]));
+            const ImageRGBA &layer = *layers.back();
+            steps.push_back([&layer](Pipeline &pipeline)
+                            { pipeline.then([&layer](const Image &image)
+                                            { return overMode(layer, image); }); });
+        }
+        else if (name == "add" || name == "scale")
+        {
+            expectArguments(parts, 3, 3, step);
+            double r = parseNumber(parts[1], step);
+            double g = parseNumber(parts[2], step);
+            double b = parseNumber(parts[3], step);
+            if (name == "add")
+                steps.push_back([=](Pipeline &pipeline)
+                                { pipeline.add(r, g, b); });
+            else
+                steps.push_back([=](Pipeline &pipeline)
+                                { pipeline.scale(r, g, b); });
+        }
+        else if (name == "extract")
+        {
+            expectArguments(parts, 1, 1, step);
+            if (parts[1] == "red")
+                steps.push_back([](Pipeline &pipeline)
+                                { pipeline.extractRed(); });
+            else if (parts[1] == "green")
+                steps.push_back([](Pipeline &pipeline)
+                                { pipeline.extractGreen(); });
+            else if (parts[1] == "blue")
+                steps.push_back([](Pipeline &pipeline)
+                                { pipeline.extractBlue(); });
+            else
+                throw std::runtime_error("ERROR: Unknown channel in step \"" + step + "\".");
+        }
+        else if (name == "invert" || name == "gamma" || name == "threshold")
+        {
+            ColorTransform transform;
+            if (name == "invert")
+            {
+                expectArguments(parts, 0, 0, step);
+                transform.invert();
+            }
+            else
+            {
+                expectArguments(parts, 1, 1, step);
+                double value = parseNumber(parts[1], step);
+                if (name == "gamma")
+                    transform.gamma(value);
+                else
+                    transform.threshold(static_cast<int>(value));
+            }
+            steps.push_back([transform](Pipeline &pipeline)
+                            { pipeline.transform(transform); });
+        }
+        else if (name == "swizzle")
+        {
+            // Three letters naming the source of the red, green and blue outputs, e.g. "bgr"
+            expectArguments(parts, 1, 1, step);
+            const std::string &order = parts[1];
+            if (order.size() != 3 || order.find_first_not_of("rgb") != std::string::npos)
+                throw std::runtime_error("ERROR: Expected three of r, g and b in step \"" + step + "\".");
+            Channel sources[3];
+            for (std::size_t i = 0; i < 3; ++i)
+                sources[i] = order[i] == 'r' ? Channel::Red : order[i] == 'g' ? Channel::Green : Channel::Blue;
+            ColorTransform transform;
+            transform.swizzle(sources[0], sources[1], sources[2]);
+            steps.push_back([transform](Pipeline &pipeline)
+                            { pipeline.transform(transform); });
+        }
+        else if (name == "matrix")
+        {
+            expectArguments(parts, 9, 9, step);
+            ColorMatrix matrix;
+            for (std::size_t i = 0; i < 9; ++i)
+                matrix[i / 3][i % 3] = parseNumber(parts[i + 1], step);
+            ColorTransform transform;
+            transform.matrix(matrix);
+            steps.push_back([transform](Pipeline &pipeline)
+                            { pipeline.transform(transform); });
+        }
+        else if (name == "rotate180")
+        {
+            expectArguments(parts, 0, 0, step);
+            steps.push_back([](Pipeline &pipeline)
+                            { pipeline.rotate180(); });
+        }
+        else if (name == "rotate90" || name == "rotate270" || name == "transpose" || name == "flipH" || name == "flipV")
+        {
+            expectArguments(parts, 0, 0, step);
+            Image (*transform)(const Image &) = flipVertical;
+            if (name == "rotate90")
+                transform = rotate90;
+            else if (name == "rotate270")
+                transform = rotate270;
+            else if (name == "transpose")
+                transform = transpose;
+            else if (name == "flipH")
+                transform = flipHorizontal;
+            steps.push_back([transform](Pipeline &pipeline)
+                            { pipeline.then(transform); });
+        }
+        else if (name == "blur" || name == "box")
+        {
+            expectArguments(parts, 1, 1, step);
+            double size = parseNumber(parts[1], step);
+            if (name == "blur")
+                steps.push_back([size](Pipeline &pipeline)
+                                { pipeline.then([size](const Image &image)
+                                                { return gaussianBlur(image, size); }); });
+            else
+                steps.push_back([size](Pipeline &pipeline)
+                                { pipeline.then([size](const Image &image)
+                                                { return boxBlur(image, static_cast<int>(size)); }); });
+        }
+        else if (name == "sharpen")
+        {
+            expectArguments(parts, 2, 3, step);
+            double sigma = parseNumber(parts[1], step);
+            double amount = parseNumber(parts[2], step);
+            int threshold = parts.size() == 4 ? static_cast<int>(parseNumber(parts[3], step)) : 0;
+            steps.push_back([=](Pipeline &pipeline)
+                            { pipeline.then([=](const Image &image)
+                                            { return unsharpMask(image, sigma, amount, threshold); }); });
+        }
+        else if (name == "levels")
+        {
+            // A fixed mapping, fused with the neighbouring point-wise steps
+            expectArguments(parts, 2, 3, step);
+            int black = static_cast<int>(parseNumber(parts[1], step));
+            int white = static_cast<int>(parseNumber(parts[2], step));
+            double gamma = parts.size() == 4 ? parseNumber(parts[3], step) : 1.0;
+            ChannelLuts luts = makeLevelsLuts(black, white, gamma);
+            steps.push_back([luts](Pipeline &pipeline)
+                            { pipeline.lut(luts); });
+        }
+        else if (name == "autolevels")
+        {
+            expectArguments(parts, 0, 2, step);
+            double clip = parts.size() >= 2 ? parseNumber(parts[1], step) : 0.1;
+            if (parts.size() == 3 && parts[2] != "linked")
+                throw std::runtime_error("ERROR: Expected \"linked\" in step \"" + step + "\".");
+            bool linked = parts.size() == 3;
+            steps.push_back([=](Pipeline &pipeline)
+                            { pipeline.then([=](const Image &image)
+                                            { return autoLevels(image, clip, linked); }); });
+        }
+        else if (name == "equalize")
+        {
+            expectArguments(parts, 0, 0, step);
+            steps.push_back([](Pipeline &pipeline)
+                            { pipeline.then([](const Image &image)
+                                            { return equalize(image); }); });
+        }
+        else if (name == "crop")
+        {
+            expectArguments(parts, 4, 4, step);
+            int x = static_cast<int>(parseNumber(parts[1], step));
+            int y = static_cast<int>(parseNumber(parts[2], step));
+            int width = static_cast<int>(parseNumber(parts[3], step));
+            int height = static_cast<int>(parseNumber(parts[4], step));
+            steps.push_back([=](Pipeline &pipeline)
+                            { pipeline.then([=](const Image &image)
+                                            { return crop(image, x, y, width, height); }); });
+        }
+        else if (name == "resize")
+        {
+            expectArguments(parts, 2, 3, step);
+            int width = static_cast<int>(parseNumber(parts[1], step));
+            int height = static_cast<int>(parseNumber(parts[2], step));
+            ResampleFilter filter = ResampleFilter::Lanczos;
+            if (parts.size() == 4)
+            {
+                if (parts[3] == "nearest")
+                    filter = ResampleFilter::Nearest;
+                else if (parts[3] == "bilinear")
+                    filter = ResampleFilter::Bilinear;
+                else if (parts[3] == "area")
+                    filter = ResampleFilter::Area;
+                else if (parts[3] != "lanczos")
+                    throw std::runtime_error("ERROR: Unknown filter in step \"" + step + "\".");
+            }
+            steps.push_back([=](Pipeline &pipeline)
+                            { pipeline.then([=](const Image &image)
+                                            { return resize(image, width, height, filter); }); });
+        }
+        else if (name == "thumbnail")
+        {
+            expectArguments(parts, 2, 2, step);
+            int width = static_cast<int>(parseNumber(parts[1], step));
+            int height = static_cast<int>(parseNumber(parts[2], step));
+            steps.push_back([=](Pipeline &pipeline)
+                            { pipeline.then([=](const Image &image)
+                                            { return thumbnail(image, width, height); }); });
+        }
+        else if (name == "quadrants")
+        {
+            expectArguments(parts, 3, 3, step);
+            operands.push_back(std::make_unique<Image>(parts[1]));
+            operands.push_back(std::make_unique<Image>(parts[2]));
+            operands.push_back(std::make_unique<Image>(parts[3]));
+            const Image &second = *operands[operands.size() - 3];
+            const Image &third = *operands[operands.size() - 2];
+            const Image &fourth = *operands[operands.size() - 1];
+            steps.push_back([&second, &third, &fourth](Pipeline &pipeline)
+                            { pipeline.combineQuadrants(second, third, fourth); });
+        }
+        else
+        {
+            throw std::runtime_error("ERROR: Unknown pipeline step \"" + name + "\".");
+        }
+    }
+}
+
+void PipelineSpec::apply(const Image &input, Image &result) const
+{
+    Pipeline pipeline{input};
+    for (const auto &step : steps)
+        step(pipeline);
+    pipeline.evaluate(result);
+}
+
+std::vector<std::string> expandInputs(const std::vector<std::string> &arguments)
+{
+    std::vector<std::string> files;
+    for (const std::string &argument : arguments)
+    {
+        if (!argument.empty() && argument[0] == '@')
+        {
+            std::ifstream manifest{argument.substr(1)};
+            if (!manifest.is_open())
+                throw std::runtime_error("ERROR: Manifest \"" + argument.substr(1) + "\" not found.");
+
+            std::string line;
+            while (std::getline(manifest, line))
+            {
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                if (!line.empty() && line[0] != '#')
+                    files.push_back(line);
+            }
+        }
+        else if (fs::is_directory(argument))
+        {
+            std::vector<std::string> entries;
+            for (const fs::directory_entry &entry : fs::directory_iterator{argument})
+            {
+                std::string extension = entry.path().extension().string();
+                std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+                if (entry.is_regular_file() && extension == ".tga")
+                    entries.push_back(entry.path().string());
+            }
+            std::sort(entries.begin(), entries.end());
+            files.insert(files.end(), entries.begin(), entries.end());
+        }
+        else
+        {
+            files.push_back(argument);
+        }
+    }
+    return files;
+}
+
+std::string outputPath(const std::string &input, const std::string &outputDirectory)
+{
+    return (fs::path{outputDirectory} / fs::path{input}.filename()).string();
+}
+
+void checkOutputPaths(const std::vector<std::string> &inputs, const std::vector<std::string> &outputs)
+{
+    auto resolved = [](const std::string &path)
+    { return fs::weakly_canonical(fs::absolute(path)).string(); };
+
+    std::set<std::string> sources;
+    for (const std::string &input : inputs)
+        sources.insert(resolved(input));
+
+    std::map<std::string, std::size_t> writers; // Resolved output -> index of the input writing it
+    for (std::size_t i = 0; i < outputs.size(); ++i)
+    {
+        std::string output = resolved(outputs[i]);
+        if (sources.count(output) != 0)
+            throw std::runtime_error("ERROR: Output \"" + outputs[i] + "\" would overwrite an input.");
+        auto [writer, added] = writers.emplace(output, i);
+        if (!added)
+            throw std::runtime_error("ERROR: \"" + inputs[writer->second] + "\" and \"" + inputs[i] +
+                                     "\" would both be written to \"" + outputs[i] + "\".");
+    }
+}
+
+BatchResult runBatch(const BatchOptions &options, std::ostream &log)
+{
+    auto start = std::chrono::steady_clock::now();
+    PipelineSpec spec{options.pipeline};
+    std::vector<std::string> outputs;
+    for (const std::string &input : options.inputs)
+        outputs.push_back(outputPath(input, options.outputDirectory));
+    checkOutputPaths(options.inputs, outputs);
+    fs::create_directories(options.outputDirectory);
+
+    BoundedQueue<BatchItem> decoded{options.queueDepth};
+    BoundedQueue<BatchItem> processed{options.queueDepth};
+    std::atomic<std::size_t> next{0};
+    std::atomic<std::size_t> succeeded{0};
+    std::atomic<std::size_t> failed{0};
+    std::mutex logMutex;
+
+    auto report = [&](std::size_t index, const std::exception &error)
+    {
+        std::lock_guard<std::mutex> lock{logMutex};
+        log << options.inputs[index] << ": " << error.what() << std::endl;
+        ++failed;
+    };
+
+    // Decode stage: claim inputs in order; the last decoder to finish closes the queue
+    unsigned int ioThreads = std::max(1u, options.ioThreads);
+    std::atomic<unsigned int> activeDecoders{ioThreads};
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < ioThreads; ++t)
+        threads.emplace_back([&]
+                             {
+                                 std::size_t index;
+                                 while ((index = next++) < options.inputs.size())
+                                 {
+                                     try
+                                     {
+                                         decoded.push({index, std::make_unique<Image>(options.inputs[index])});
+                                     }
+                                     catch (const std::exception &error)
+                                     {
+                                         report(index, error);
+                                     }
+                                 }
+                                 if (--activeDecoders == 0)
+                                     decoded.close(); });
+
+    // Encode stage
+    for (unsigned int t = 0; t < ioThreads; ++t)
+        threads.emplace_back([&]
+                             {
+                                 while (std::optional<BatchItem> item = processed.pop())
+                                 {
+                                     try
+                                     {
+                                         item->image->write(outputs[item->index], options.encoding);
+                                         ++succeeded;
+                                     }
+                                     catch (const std::exception &error)
+                                     {
+                                         report(item->index, error);
+                                     }
+                                 } });
+
+    // Compute stage runs here, each image spread over the shared thread pool
+    while (std::optional<BatchItem> item = decoded.pop())
+    {
+        try
+        {
+            auto result = std::make_unique<Image>(Header{});
+            spec.apply(*item->image, *result);
+            processed.push({item->index, std::move(result)});
+        }
+        catch (const std::exception &error)
+        {
+            report(item->index, error);
+        }
+    }
+    processed.close();
+
+    for (std::thread &thread : threads)
+        thread.join();
+
+    BatchResult result;
+    result.succeeded = succeeded;
+    result.failed = failed;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    log << result.succeeded << " file(s) written, " << result.failed << " failed in " << result.seconds << " s";
+    if (result.seconds > 0)
+        log << " (" << result.succeeded / result.seconds << " files/s)";
+    log << std::endl;
+
+    BufferPoolStats pool = bufferPoolStats();
+    log << "Buffer pool: " << static_cast<int>(pool.hitRate() * 100 + 0.5) << "% of allocations recycled, peak "
+        << (pool.peakFootprint >> 20) << " MB" << std::endl;
+    return result;
+}
+
+int runCommandLine(int argc, char *argv[])
+{
+    std::vector<std::string> arguments(argv + 1, argv + argc);
+    if (arguments.empty() || arguments[0] == "help" || arguments[0] == "-h" || arguments[0] == "--help")
+    {
+        printUsage(std::cout);
+        return arguments.empty() ? 1 : 0;
+    }
+    const std::string &command = arguments[0];
+    if (command != "run" && command != "coordinate" && command != "work")
+    {
+        std::cerr << "Unknown command \"" << arguments[0] << "\".\n\n";
+        printUsage(std::cerr);
+        return 1;
+    }
+
+    try
+    {
+        BatchOptions options;
+        QueueOptions queue;
+        std::vector<std::string> inputs;
+        std::string traceFile;
+        std::string jobManifest;
+        for (std::size_t i = 1; i < arguments.size(); ++i)
+        {
+            const std::string &argument = arguments[i];
+            auto value = [&]() -> const std::string &
+            {
+                if (i + 1 >= arguments.size())
+                    throw std::runtime_error("ERROR: Option " + argument + " expects a value.");
+                return arguments[++i];
+            };
+
+            if (argument == "-p" || argument == "--pipeline")
+                options.pipeline = value();
+            else if (argument == "-o" || argument == "--output")
+                options.outputDirectory = value();
+            else if (argument == "-j" || argument == "--io-threads")
+                options.ioThreads = static_cast<unsigned int>(parseCount(argument, value()));
+            else if (argument == "-q" || argument == "--queue")
+                options.queueDepth = parseCount(argument, value());
+            else if (argument == "-t" || argument == "--threads")
+            {
+                queue.computeThreads = static_cast<unsigned int>(parseCount(argument, value()));
+                setThreadCount(queue.computeThreads);
+            }
+            else if (argument == "--rle")
+                options.encoding = queue.encoding = TgaEncoding::TrueColorRle;
+            else if (argument == "--queue-dir")
+                queue.queueDirectory = value();
+            else if (argument == "--jobs")
+                jobManifest = value();
+            else if (argument == "-w" || argument == "--workers")
+                queue.workers = static_cast<unsigned int>(parseCount(argument, value()));
+            else if (argument == "--shard")
+                queue.shardSize = parseCount(argument, value());
+            else if (argument == "--attempts")
+                queue.maxAttempts = static_cast<unsigned int>(parseCount(argument, value()));
+            else if (argument == "--trace")
+            {
+                // A build without the hooks would silently write an empty trace
+                if (!TRACING_COMPILED)
+                    throw std::runtime_error("ERROR: Option --trace needs a build configured with "
+                                             "-DIMAGEPROCESSING_TRACING=ON.");
+                traceFile = value();
+            }
+            else if (!argument.empty() && argument[0] == '-')
+                throw std::runtime_error("ERROR: Unknown option " + argument + ".");
+            else
+                inputs.push_back(argument);
+        }
+
+        if (command != "run" && queue.queueDirectory.empty())
+            throw std::runtime_error("ERROR: Option --queue-dir is required.");
+        if (command == "work")
+        {
+            // Failed jobs are in the shard reports; only a worker that could not run exits with an error
+            runWorker(queue, std::cerr);
+            return 0;
+        }
+
+        options.inputs = expandInputs(inputs);
+        if (command == "coordinate")
+        {
+            std::vector<BatchJob> jobs;
+            if (!jobManifest.empty())
+                jobs = readJobManifest(jobManifest);
+            for (const std::string &input : options.inputs)
+                jobs.push_back({options.pipeline, input, outputPath(input, options.outputDirectory)});
+            if (!createQueue(queue.queueDirectory, jobs, queue.shardSize) && !jobs.empty())
+                std::cerr << "Resuming the existing queue; the jobs given are not queued again." << std::endl;
+
+            BatchResult result = runCoordinator(queue, executablePath(argv[0]), std::cerr);
+            return result.failed == 0 ? 0 : 1;
+        }
+        if (options.inputs.empty())
+            throw std::runtime_error("ERROR: No input files.");
+
+        setTracing(!traceFile.empty());
+        BatchResult result = runBatch(options, std::cerr);
+        if (!traceFile.empty())
+        {
+            setTracing(false);
+            writeChromeTrace(traceFile);
+        }
+        return result.failed == 0 ? 0 : 1;
+    }
+    catch (const std::exception &error)
+    {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+}
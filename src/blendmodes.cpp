@@ -0,0 +1,239 @@
+#include "blendmodes.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+#include "kernels.h"
+#include "threadpool.h"
+#include "trace.h"
+
+namespace
+{
+    // Tabulated at compile time; each lives in read-only data
+    constexpr BlendTable MULTIPLY_TABLE = makeBlendTable(multiplyBlend);
+    constexpr BlendTable SCREEN_TABLE = makeBlendTable(screenBlend);
+    constexpr BlendTable OVERLAY_TABLE = makeBlendTable(overlayBlend);
+    constexpr BlendTable SUBTRACT_TABLE = makeBlendTable(subtractBlend);
+    constexpr BlendTable DARKEN_TABLE = makeBlendTable(darkenBlend);
+    constexpr BlendTable LIGHTEN_TABLE = makeBlendTable(lightenBlend);
+    constexpr BlendTable DIFFERENCE_TABLE = makeBlendTable(differenceBlend);
+    constexpr BlendTable SOFT_LIGHT_TABLE = makeBlendTable(softLightBlend);
+
+    static_assert(MULTIPLY_TABLE(255, 128) == 128 && SCREEN_TABLE(0, 77) == 77, "Blend tables must be exact");
+    static_assert(SOFT_LIGHT_TABLE(0, 255) == 255 && SOFT_LIGHT_TABLE(255, 0) == 0, "Soft light must keep black and white");
+
+    /// @brief Registered modes by name. Tables of replaced modes are kept so references stay valid.
+    struct Registry
+    {
+        std::mutex mutex;
+        std::map<std::string, BlendModeEntry> modes{
+            {"multiply", {&MULTIPLY_TABLE, multiplyKernel}},
+            {"screen", {&SCREEN_TABLE, screenKernel}},
+            {"overlay", {&OVERLAY_TABLE, overlayKernel}},
+            {"subtract", {&SUBTRACT_TABLE, subtractKernel}},
+            {"darken", {&DARKEN_TABLE, nullptr}},
+            {"lighten", {&LIGHTEN_TABLE, nullptr}},
+            {"difference", {&DIFFERENCE_TABLE, nullptr}},
+            {"softLight", {&SOFT_LIGHT_TABLE, nullptr}},
+        };
+        std::vector<std::unique_ptr<BlendTable>> owned;
+    };
+
+    Registry &registry()
+    {
+        static Registry instance;
+        return instance;
+    }
+
+    void checkSameSize(const Image &first, const Image &second)
+    {
+        if (first.pixels.size() != second.pixels.size())
+            throw std::runtime_error("ERROR: Images must have the same number of pixels.");
+    }
+
+    /// @brief Blend two regions row by row in parallel bands, through the SIMD kernel when there is one.
+    void blend(const BlendModeEntry &mode, ConstImageView top, ConstImageView bottom, ImageView result)
+    {
+        if (top.width != bottom.width || top.height != bottom.height || top.width != result.width ||
+            top.height != result.height)
+            throw std::runtime_error("ERROR: Views must have the same size.");
+
+        std::size_t count = static_cast<std::size_t>(top.width) * sizeof(Pixel);
+        parallelForRows(top.width, top.height, [&](int y)
+                        {
+                            auto topChannels = reinterpret_cast<const unsigned char *>(top.row(y));
+                            auto bottomChannels = reinterpret_cast<const unsigned char *>(bottom.row(y));
+                            auto resultChannels = reinterpret_cast<unsigned char *>(result.row(y));
+                            if (mode.kernel)
+                                mode.kernel(topChannels, bottomChannels, resultChannels, count);
+                            else
+                                blendTableKernel(*mode.table, topChannels, bottomChannels, resultChannels, count); });
+    }
+
+    /// @brief Blend two images in parallel row bands, through the SIMD kernel when there is one.
+    void blend(const BlendModeEntry &mode, const Image &top, const Image &bottom, Image &result)
+    {
+        checkSameSize(top, bottom);
+        prepareResult(top, result);
+
+        const unsigned char *topChannels = reinterpret_cast<const unsigned char *>(top.pixels.data());
+        const unsigned char *bottomChannels = reinterpret_cast<const unsigned char *>(bottom.pixels.data());
+        unsigned char *resultChannels = reinterpret_cast<unsigned char *>(result.pixels.data());
+        parallelFor(top.pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                    {
+                        std::size_t offset = begin * sizeof(Pixel);
+                        std::size_t count = (end - begin) * sizeof(Pixel);
+                        if (mode.kernel)
+                            mode.kernel(topChannels + offset, bottomChannels + offset, resultChannels + offset, count);
+                        else
+                            blendTableKernel(*mode.table, topChannels + offset, bottomChannels + offset, resultChannels + offset, count); });
+    }
+}
+
+void blendTableKernel(const BlendTable &table, const unsigned char *top, const unsigned char *bottom, unsigned char *out,
+                      std::size_t count)
+{
+    // Look up a group before storing it, so stores cannot stall the next loads (out may alias an input)
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        unsigned char group[8];
+        for (int k = 0; k < 8; ++k)
+            group[k] = table.values[top[i + k] << 8 | bottom[i + k]];
+        std::memcpy(out + i, group, 8);
+    }
+    for (; i < count; ++i)
+        out[i] = table.values[top[i] << 8 | bottom[i]];
+}
+
+void registerBlendMode(const std::string &name, const BlendTable &table)
+{
+    auto copy = std::make_unique<BlendTable>(table);
+    Registry &modes = registry();
+    std::lock_guard<std::mutex> lock{modes.mutex};
+    modes.modes[name] = {copy.get(), nullptr};
+    modes.owned.push_back(std::move(copy));
+}
+
+void registerBlendMode(const std::string &name, unsigned char (*function)(unsigned char top, unsigned char bottom))
+{
+    auto table = std::make_unique<BlendTable>();
+    for (unsigned int i = 0; i < 256 * 256; ++i)
+        table->values[i] = function(static_cast<unsigned char>(i >> 8), static_cast<unsigned char>(i & 0xFF));
+
+    Registry &modes = registry();
+    std::lock_guard<std::mutex> lock{modes.mutex};
+    modes.modes[name] = {table.get(), nullptr};
+    modes.owned.push_back(std::move(table));
+}
+
+BlendModeEntry findBlendMode(const std::string &name)
+{
+    Registry &modes = registry();
+    std::lock_guard<std::mutex> lock{modes.mutex};
+    auto mode = modes.modes.find(name);
+    if (mode == modes.modes.end())
+        throw std::runtime_error("ERROR: Unknown blend mode \"" + name + "\".");
+    return mode->second;
+}
+
+const BlendTable &blendTable(const std::string &name)
+{
+    return *findBlendMode(name).table;
+}
+
+std::vector<std::string> blendModeNames()
+{
+    Registry &modes = registry();
+    std::lock_guard<std::mutex> lock{modes.mutex};
+    std::vector<std::string> names;
+    for (const auto &mode : modes.modes)
+        names.push_back(mode.first);
+    return names;
+}
+
+void blendMode(const std::string &mode, const Image &top, const Image &bottom, Image &result)
+{
+    IP_TRACE_SCOPE("blendMode");
+    IP_TRACE_COUNT(PixelsProcessed, top.pixels.size());
+    blend(findBlendMode(mode), top, bottom, result);
+}
+
+Image blendMode(const std::string &mode, const Image &top, const Image &bottom)
+{
+    Image result{top.header};
+    blendMode(mode, top, bottom, result);
+    return result;
+}
+
+void blendMode(const BlendTable &table, const Image &top, const Image &bottom, Image &result)
+{
+    IP_TRACE_SCOPE("blendMode");
+    IP_TRACE_COUNT(PixelsProcessed, top.pixels.size());
+    blend({&table, nullptr}, top, bottom, result);
+}
+
+Image blendMode(const BlendTable &table, const Image &top, const Image &bottom)
+{
+    Image result{top.header};
+    blendMode(table, top, bottom, result);
+    return result;
+}
+
+void blendMode(const std::string &mode, ConstImageView top, ConstImageView bottom, ImageView result)
+{
+    IP_TRACE_SCOPE("blendMode");
+    IP_TRACE_COUNT(PixelsProcessed, top.size());
+    blend(findBlendMode(mode), top, bottom, result);
+}
+
+void blendMode(const BlendTable &table, ConstImageView top, ConstImageView bottom, ImageView result)
+{
+    IP_TRACE_SCOPE("blendMode");
+    IP_TRACE_COUNT(PixelsProcessed, top.size());
+    blend({&table, nullptr}, top, bottom, result);
+}
+
+void darkenMode(const Image &foreground, const Image &background, Image &result)
+{
+    blendMode(DARKEN_TABLE, foreground, background, result);
+}
+
+Image darkenMode(const Image &foreground, const Image &background)
+{
+    return blendMode(DARKEN_TABLE, foreground, background);
+}
+
+void lightenMode(const Image &foreground, const Image &background, Image &result)
+{
+    blendMode(LIGHTEN_TABLE, foreground, background, result);
+}
+
+Image lightenMode(const Image &foreground, const Image &background)
+{
+    return blendMode(LIGHTEN_TABLE, foreground, background);
+}
+
+void differenceMode(const Image &foreground, const Image &background, Image &result)
+{
+    blendMode(DIFFERENCE_TABLE, foreground, background, result);
+}
+
+Image differenceMode(const Image &foreground, const Image &background)
+{
+    return blendMode(DIFFERENCE_TABLE, foreground, background);
+}
+
+void softLightMode(const Image &foreground, const Image &background, Image &result)
+{
+    blendMode(SOFT_LIGHT_TABLE, foreground, background, result);
+}
+
+Image softLightMode(const Image &foreground, const Image &background)
+{
+    return blendMode(SOFT_LIGHT_TABLE, foreground, background);
+}
@@ -0,0 +1,154 @@
+#include "bufferpool.h"
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    // Released bytes kept for reuse by default: enough for a handful of 4K intermediates
+    constexpr std::size_t DEFAULT_LIMIT = std::size_t{256} << 20;
+
+    // Below this size classes are consecutive multiples of BUFFER_ALIGNMENT
+    constexpr std::size_t SMALL_SIZE = 1024;
+
+    /// @return The size actually allocated for a request of `bytes`.
+    /// @note Above SMALL_SIZE each power of two is split into four classes, so at most a quarter is wasted
+    ///       while images of similar sizes still share buffers.
+    std::size_t sizeClass(std::size_t bytes)
+    {
+        if (bytes <= SMALL_SIZE)
+            return std::max<std::size_t>((bytes + BUFFER_ALIGNMENT - 1) / BUFFER_ALIGNMENT, 1) * BUFFER_ALIGNMENT;
+
+        std::size_t power = SMALL_SIZE;
+        while (power * 2 < bytes)
+            power *= 2;
+        std::size_t step = power / 4;
+        return (bytes + step - 1) / step * step;
+    }
+
+    struct BufferPool
+    {
+        std::mutex mutex;
+        std::unordered_map<std::size_t, std::vector<void *>> cached; // Released buffers by size class
+        std::size_t limit = DEFAULT_LIMIT;
+        BufferPoolStats stats;
+
+        void updatePeaks()
+        {
+            stats.peakBytesInUse = std::max(stats.peakBytesInUse, stats.bytesInUse);
+            stats.peakFootprint = std::max(stats.peakFootprint, stats.bytesInUse + stats.bytesCached);
+        }
+
+        void freeCached()
+        {
+            for (auto &entry : cached)
+                for (void *buffer : entry.second)
+                    ::operator delete(buffer, std::align_val_t{BUFFER_ALIGNMENT});
+            cached.clear();
+            stats.bytesCached = 0;
+        }
+    };
+
+    /// @note Never destroyed, so images with static storage duration can still release their buffers at exit.
+    BufferPool &pool()
+    {
+        static BufferPool *instance = new BufferPool;
+        return *instance;
+    }
+}
+
+double BufferPoolStats::hitRate() const
+{
+    std::size_t total = hits + misses;
+    return total == 0 ? 0.0 : static_cast<double>(hits) / total;
+}
+
+void *acquireBuffer(std::size_t bytes)
+{
+    std::size_t size = sizeClass(bytes);
+    BufferPool &shared = pool();
+    {
+        std::lock_guard<std::mutex> lock{shared.mutex};
+        auto found = shared.cached.find(size);
+        if (found != shared.cached.end() && !found->second.empty())
+        {
+            void *buffer = found->second.back();
+            found->second.pop_back();
+            ++shared.stats.hits;
+            shared.stats.bytesCached -= size;
+            shared.stats.bytesInUse += size;
+            shared.updatePeaks();
+            return buffer;
+        }
+    }
+
+    // Allocate outside the lock; other threads keep recycling meanwhile
+    void *buffer = ::operator new(size, std::align_val_t{BUFFER_ALIGNMENT});
+    std::lock_guard<std::mutex> lock{shared.mutex};
+    ++shared.stats.misses;
+    shared.stats.bytesInUse += size;
+    shared.updatePeaks();
+    return buffer;
+}
+
+void releaseBuffer(void *buffer, std::size_t bytes) noexcept
+{
+    if (!buffer)
+        return;
+
+    std::size_t size = sizeClass(bytes);
+    BufferPool &shared = pool();
+    {
+        std::lock_guard<std::mutex> lock{shared.mutex};
+        shared.stats.bytesInUse -= size;
+        if (shared.stats.bytesCached + size <= shared.limit)
+        {
+            try
+            {
+                shared.cached[size].push_back(buffer);
+                shared.stats.bytesCached += size;
+                return;
+            }
+            catch (const std::bad_alloc &)
+            {
+                // No room to remember the buffer: free it instead
+            }
+        }
+    }
+    ::operator delete(buffer, std::align_val_t{BUFFER_ALIGNMENT});
+}
+
+BufferPoolStats bufferPoolStats()
+{
+    BufferPool &shared = pool();
+    std::lock_guard<std::mutex> lock{shared.mutex};
+    return shared.stats;
+}
+
+void resetBufferPoolStats()
+{
+    BufferPool &shared = pool();
+    std::lock_guard<std::mutex> lock{shared.mutex};
+    shared.stats.hits = 0;
+    shared.stats.misses = 0;
+    shared.stats.peakBytesInUse = shared.stats.bytesInUse;
+    shared.stats.peakFootprint = shared.stats.bytesInUse + shared.stats.bytesCached;
+}
+
+void setBufferPoolLimit(std::size_t bytes)
+{
+    BufferPool &shared = pool();
+    std::lock_guard<std::mutex> lock{shared.mutex};
+    shared.limit = bytes;
+    if (shared.stats.bytesCached > bytes)
+        shared.freeCached();
+}
+
+void trimBufferPool()
+{
+    BufferPool &shared = pool();
+    std::lock_guard<std::mutex> lock{shared.mutex};
+    shared.freeCached();
+}
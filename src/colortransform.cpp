@@ -0,0 +1,300 @@
+#include "colortransform.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "threadpool.h"
+#include "trace.h"
+
+namespace
+{
+    // Pixels carried through every stage at a time (3 KB, so a multi-stage transform stays in L1)
+    constexpr std::size_t CHUNK_PIXELS = 1024;
+
+    // Fractional bits of the matrix coefficients
+    constexpr int WEIGHT_BITS = 16;
+
+    // Largest matrix coefficient magnitude: three maximal products still fit in 32 bits
+    constexpr double MAX_COEFFICIENT = 16.0;
+
+    /// @return The lookup table of a channel (0 = blue, 1 = green, 2 = red).
+    unsigned char *table(ChannelLuts &luts, int channel)
+    {
+        return channel == 0 ? luts.b : channel == 1 ? luts.g : luts.r;
+    }
+
+    const unsigned char *table(const ChannelLuts &luts, int channel)
+    {
+        return channel == 0 ? luts.b : channel == 1 ? luts.g : luts.r;
+    }
+
+    ChannelLuts identityLuts()
+    {
+        ChannelLuts luts;
+        for (int v = 0; v < 256; ++v)
+            luts.b[v] = luts.g[v] = luts.r[v] = static_cast<unsigned char>(v);
+        return luts;
+    }
+
+    ChannelLuts uniformLuts(unsigned char (*mapping)(int, double), double parameter)
+    {
+        ChannelLuts luts;
+        for (int v = 0; v < 256; ++v)
+            luts.b[v] = luts.g[v] = luts.r[v] = mapping(v, parameter);
+        return luts;
+    }
+
+    bool isIdentityTable(const unsigned char *values)
+    {
+        for (int v = 0; v < 256; ++v)
+            if (values[v] != v)
+                return false;
+        return true;
+    }
+
+    /// @brief Gather each output from its source channel through its table.
+    void gatherKernel(const unsigned char *in, unsigned char *out, std::size_t pixelCount, const int *sources,
+                      const ChannelLuts &luts)
+    {
+        const int s0 = sources[0], s1 = sources[1], s2 = sources[2];
+        for (std::size_t i = 0; i < pixelCount; ++i, in += 3, out += 3)
+        {
+            unsigned char b = luts.b[in[s0]];
+            unsigned char g = luts.g[in[s1]];
+            unsigned char r = luts.r[in[s2]];
+            out[0] = b;
+            out[1] = g;
+            out[2] = r;
+        }
+    }
+
+    /// @brief Work out the cached flags of a stage (the input tables only count with a matrix).
+    void classify(bool &plainInputs, bool &plainTables, const int *sources, bool mixes, const ChannelLuts &inputs,
+                  const ChannelLuts &tables)
+    {
+        plainInputs = true;
+        plainTables = true;
+        for (int c = 0; c < 3; ++c)
+        {
+            plainInputs = plainInputs && sources[c] == c && (!mixes || isIdentityTable(table(inputs, c)));
+            plainTables = plainTables && isIdentityTable(table(tables, c));
+        }
+    }
+}
+
+ColorTransform &ColorTransform::add(double r, double g, double b)
+{
+    return lut(makeAddLuts(r, g, b));
+}
+
+ColorTransform &ColorTransform::scale(double r, double g, double b)
+{
+    return lut(makeScaleLuts(r, g, b));
+}
+
+ColorTransform &ColorTransform::gamma(double exponent)
+{
+    if (!(exponent > 0))
+        throw std::runtime_error("ERROR: The gamma must be positive.");
+    return lut(uniformLuts([](int v, double exponent)
+                           { return static_cast<unsigned char>(std::lround(255.0 * std::pow(v / 255.0, 1.0 / exponent))); },
+                           exponent));
+}
+
+ColorTransform &ColorTransform::invert()
+{
+    return lut(uniformLuts([](int v, double)
+                           { return static_cast<unsigned char>(255 - v); },
+                           0.0));
+}
+
+ColorTransform &ColorTransform::threshold(int level)
+{
+    if (level < 0 || level > 256)
+        throw std::runtime_error("ERROR: The threshold must be between 0 and 256.");
+    return lut(uniformLuts([](int v, double level)
+                           { return static_cast<unsigned char>(v >= level ? 255 : 0); },
+                           level));
+}
+
+ColorTransform &ColorTransform::lut(const ChannelLuts &luts)
+{
+    Stage stage;
+    stage.tables = luts;
+    append(stage);
+    return *this;
+}
+
+ColorTransform &ColorTransform::swizzle(Channel r, Channel g, Channel b)
+{
+    Stage stage;
+    stage.sources[0] = static_cast<int>(b);
+    stage.sources[1] = static_cast<int>(g);
+    stage.sources[2] = static_cast<int>(r);
+    stage.tables = identityLuts();
+    append(stage);
+    return *this;
+}
+
+ColorTransform &ColorTransform::extract(Channel channel)
+{
+    return swizzle(channel, channel, channel);
+}
+
+ColorTransform &ColorTransform::matrix(const ColorMatrix &matrix)
+{
+    Stage stage;
+    stage.mixes = true;
+    stage.inputs = identityLuts();
+    stage.tables = identityLuts();
+    for (int c = 0; c < 3; ++c)
+        for (int k = 0; k < 3; ++k)
+        {
+            // The matrix is given in RGB order, the stage works in BGR order
+            double coefficient = matrix[2 - c][2 - k];
+            if (!(std::abs(coefficient) <= MAX_COEFFICIENT))
+                throw std::runtime_error("ERROR: Color matrix coefficients must lie within [-16, 16].");
+            stage.matrix[c * 3 + k] = static_cast<std::int32_t>(std::lround(std::ldexp(coefficient, WEIGHT_BITS)));
+        }
+    append(stage);
+    return *this;
+}
+
+ColorTransform &ColorTransform::then(const ColorTransform &next)
+{
+    // Copy first: `next` may be this transform
+    std::vector<Stage> appended = next.stages;
+    for (const Stage &stage : appended)
+        append(stage);
+    return *this;
+}
+
+void ColorTransform::append(const Stage &stage)
+{
+    if (stages.empty())
+    {
+        stages.push_back(stage);
+    }
+    else if (!stage.mixes)
+    {
+        // Tables after anything: each output now takes what the output it selects took, through both tables
+        Stage &last = stages.back();
+        Stage merged = last;
+        for (int c = 0; c < 3; ++c)
+        {
+            int selected = stage.sources[c];
+            if (last.mixes)
+                std::copy_n(last.matrix + selected * 3, 3, merged.matrix + c * 3);
+            else
+                merged.sources[c] = last.sources[selected];
+
+            const unsigned char *before = table(last.tables, selected);
+            const unsigned char *after = table(stage.tables, c);
+            unsigned char *combined = table(merged.tables, c);
+            for (int v = 0; v < 256; ++v)
+                combined[v] = after[before[v]];
+        }
+        last = merged;
+    }
+    else if (!stages.back().mixes)
+    {
+        // A matrix after tables: each column reads through the table of the output it selects
+        Stage &last = stages.back();
+        Stage merged = stage;
+        for (int k = 0; k < 3; ++k)
+        {
+            int selected = stage.sources[k];
+            merged.sources[k] = last.sources[selected];
+            const unsigned char *before = table(last.tables, selected);
+            const unsigned char *after = table(stage.inputs, k);
+            unsigned char *combined = table(merged.inputs, k);
+            for (int v = 0; v < 256; ++v)
+                combined[v] = after[before[v]];
+        }
+        last = merged;
+    }
+    else
+    {
+        // Two matrices round in between, so they stay separate stages
+        stages.push_back(stage);
+    }
+
+    Stage &last = stages.back();
+    classify(last.plainInputs, last.plainTables, last.sources, last.mixes, last.inputs, last.tables);
+    if (stages.size() == 1 && !last.mixes && last.plainInputs && last.plainTables)
+        stages.clear();
+}
+
+void ColorTransform::apply(const unsigned char *in, unsigned char *out, std::size_t pixelCount) const
+{
+    if (stages.empty())
+    {
+        if (in != out)
+            std::memmove(out, in, pixelCount * 3);
+        return;
+    }
+
+    // Every chunk goes through all stages while it is in cache; only the first stage reads the input
+    unsigned char gathered[CHUNK_PIXELS * 3];
+    for (std::size_t chunk = 0; chunk < pixelCount; chunk += CHUNK_PIXELS)
+    {
+        std::size_t count = std::min(CHUNK_PIXELS, pixelCount - chunk);
+        const unsigned char *value = in + chunk * 3;
+        unsigned char *chunkOut = out + chunk * 3;
+        for (const Stage &stage : stages)
+        {
+            if (!stage.mixes)
+            {
+                if (stage.plainInputs)
+                    lutKernel(value, chunkOut, count, stage.tables);
+                else
+                    gatherKernel(value, chunkOut, count, stage.sources, stage.tables);
+            }
+            else
+            {
+                if (!stage.plainInputs)
+                {
+                    gatherKernel(value, gathered, count, stage.sources, stage.inputs);
+                    value = gathered;
+                }
+                matrixKernel(value, chunkOut, count, stage.matrix);
+                if (!stage.plainTables)
+                    lutKernel(chunkOut, chunkOut, count, stage.tables);
+            }
+            value = chunkOut;
+        }
+    }
+}
+
+void ColorTransform::apply(const Image &image, Image &result) const
+{
+    IP_TRACE_SCOPE("ColorTransform::apply");
+    IP_TRACE_COUNT(PixelsProcessed, image.pixels.size());
+    prepareResult(image, result);
+
+    const unsigned char *in = reinterpret_cast<const unsigned char *>(image.pixels.data());
+    unsigned char *out = reinterpret_cast<unsigned char *>(result.pixels.data());
+    parallelFor(image.pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                { apply(in + begin * sizeof(Pixel), out + begin * sizeof(Pixel), end - begin); });
+}
+
+void ColorTransform::apply(ConstImageView image, ImageView result) const
+{
+    IP_TRACE_SCOPE("ColorTransform::apply");
+    IP_TRACE_COUNT(PixelsProcessed, image.size());
+    if (image.width != result.width || image.height != result.height)
+        throw std::runtime_error("ERROR: Views must have the same size.");
+
+    parallelForRows(image.width, image.height, [&](int y)
+                    { apply(reinterpret_cast<const unsigned char *>(image.row(y)),
+                            reinterpret_cast<unsigned char *>(result.row(y)), image.width); });
+}
+
+Image ColorTransform::apply(const Image &image) const
+{
+    Image result{image.header};
+    apply(image, result);
+    return result;
+}
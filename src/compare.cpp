@@ -0,0 +1,189 @@
+#include "compare.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <mutex>
+
+#include "threadpool.h"
+#include "trace.h"
+
+namespace
+{
+    // Pixels whose channel differences are staged on the stack at a time (12 KB)
+    constexpr std::size_t BLOCK_PIXELS = 4096;
+
+    /// @brief Statistics of one band of pixels, merged into the totals once the band is done.
+    struct Totals
+    {
+        std::size_t mismatched = 0;
+        int maxAbsError = 0;
+        std::uint64_t squaredErrors = 0;
+    };
+
+    bool sameSize(const Image &first, const Image &second)
+    {
+        return imageWidth(first.header) == imageWidth(second.header) &&
+               imageHeight(first.header) == imageHeight(second.header) &&
+               first.pixels.size() == second.pixels.size();
+    }
+
+    /// @return The heatmap color of every possible difference.
+    /// @note Differences are spread over the ramp by their square root so that off-by-one errors still show.
+    const std::array<Pixel, 256> &heatRamp()
+    {
+        static const std::array<Pixel, 256> ramp = []
+        {
+            // Color stops (red, green, blue) at equal steps along the ramp
+            constexpr int stops[5][3] = {{0, 0, 0}, {0, 0, 255}, {255, 0, 0}, {255, 255, 0}, {255, 255, 255}};
+            std::array<Pixel, 256> colors;
+            for (int d = 0; d < 256; ++d)
+            {
+                double position = std::sqrt(d / 255.0) * 4.0;
+                int stop = std::min(static_cast<int>(position), 3);
+                double t = position - stop;
+                int channel[3];
+                for (int c = 0; c < 3; ++c)
+                    channel[c] = static_cast<int>(std::lround(stops[stop][c] + t * (stops[stop + 1][c] - stops[stop][c])));
+                colors[d] = Pixel(static_cast<unsigned char>(channel[0]), static_cast<unsigned char>(channel[1]),
+                                  static_cast<unsigned char>(channel[2]));
+            }
+            return colors;
+        }();
+        return ramp;
+    }
+
+    ImageDifference differentSizes(const Image &actual, const Image &expected)
+    {
+        ImageDifference difference;
+        difference.sameSize = false;
+        difference.mismatchedPixels = std::max(actual.pixels.size(), expected.pixels.size());
+        difference.maxAbsError = 255;
+        difference.meanSquaredError = 255.0 * 255.0;
+        difference.psnr = 0.0;
+        return difference;
+    }
+
+    /// @brief Gather every statistic in one parallel pass, drawing the heatmap along the way if requested.
+    ImageDifference measure(const Image &actual, const Image &expected, Pixel *heatmap)
+    {
+        const unsigned char *first = reinterpret_cast<const unsigned char *>(actual.pixels.data());
+        const unsigned char *second = reinterpret_cast<const unsigned char *>(expected.pixels.data());
+        const std::array<Pixel, 256> &ramp = heatRamp();
+
+        Totals totals;
+        std::mutex mutex;
+        parallelFor(actual.pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                    {
+                        Totals band;
+                        unsigned char differences[BLOCK_PIXELS * 3];
+                        for (std::size_t block = begin; block < end; block += BLOCK_PIXELS)
+                        {
+                            // Byte-wise pass the compiler vectorizes: absolute differences, their squares and maximum.
+                            // A block's squares stay below 2^32 (BLOCK_PIXELS * 3 * 255^2)
+                            std::size_t count = std::min(BLOCK_PIXELS, end - block);
+                            const unsigned char *a = first + block * 3;
+                            const unsigned char *b = second + block * 3;
+                            std::uint32_t squares = 0;
+                            unsigned char largest = 0;
+                            for (std::size_t j = 0; j < count * 3; ++j)
+                            {
+                                unsigned char d = a[j] > b[j] ? a[j] - b[j] : b[j] - a[j];
+                                differences[j] = d;
+                                squares += static_cast<std::uint32_t>(d) * d;
+                                largest = std::max(largest, d);
+                            }
+                            band.squaredErrors += squares;
+                            band.maxAbsError = std::max<int>(band.maxAbsError, largest);
+
+                            if (largest == 0)
+                            {
+                                if (heatmap)
+                                    std::fill(heatmap + block, heatmap + block + count, ramp[0]);
+                                continue;
+                            }
+
+                            // Per-pixel pass, only over blocks that differ
+                            for (std::size_t i = 0; i < count; ++i)
+                            {
+                                const unsigned char *d = differences + i * 3;
+                                unsigned char pixel = std::max(d[0], std::max(d[1], d[2]));
+                                band.mismatched += pixel != 0;
+                                if (heatmap)
+                                    heatmap[block + i] = ramp[pixel];
+                            }
+                        }
+
+                        std::lock_guard<std::mutex> lock{mutex};
+                        totals.mismatched += band.mismatched;
+                        totals.maxAbsError = std::max(totals.maxAbsError, band.maxAbsError);
+                        totals.squaredErrors += band.squaredErrors; });
+
+        ImageDifference difference;
+        difference.mismatchedPixels = totals.mismatched;
+        difference.maxAbsError = totals.maxAbsError;
+        std::size_t samples = actual.pixels.size() * 3;
+        difference.meanSquaredError = samples == 0 ? 0.0 : static_cast<double>(totals.squaredErrors) / samples;
+        difference.psnr = difference.meanSquaredError == 0.0
+                              ? std::numeric_limits<double>::infinity()
+                              : 10.0 * std::log10(255.0 * 255.0 / difference.meanSquaredError);
+        return difference;
+    }
+}
+
+bool imagesEqual(const Image &first, const Image &second)
+{
+    IP_TRACE_SCOPE("imagesEqual");
+    if (!sameSize(first, second))
+        return false;
+
+    const unsigned char *a = reinterpret_cast<const unsigned char *>(first.pixels.data());
+    const unsigned char *b = reinterpret_cast<const unsigned char *>(second.pixels.data());
+    std::atomic<bool> differs{false};
+    parallelFor(first.pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                {
+                    if (differs.load(std::memory_order_relaxed))
+                        return;
+                    if (std::memcmp(a + begin * 3, b + begin * 3, (end - begin) * 3) != 0)
+                        differs.store(true, std::memory_order_relaxed); });
+    return !differs.load();
+}
+
+ImageDifference compareImages(const Image &actual, const Image &expected)
+{
+    IP_TRACE_SCOPE("compareImages");
+    IP_TRACE_COUNT(PixelsProcessed, actual.pixels.size());
+    if (!sameSize(actual, expected))
+        return differentSizes(actual, expected);
+
+    // Matching outputs are the common case of a regression run, and a memory comparison settles them
+    ImageDifference identical;
+    identical.psnr = std::numeric_limits<double>::infinity();
+    return imagesEqual(actual, expected) ? identical : measure(actual, expected, nullptr);
+}
+
+ImageDifference compareImages(const Image &actual, const Image &expected, Image &heatmap)
+{
+    IP_TRACE_SCOPE("compareImages");
+    IP_TRACE_COUNT(PixelsProcessed, actual.pixels.size());
+    if (&heatmap == &actual || &heatmap == &expected)
+    {
+        Image separate{Header{}};
+        ImageDifference difference = compareImages(actual, expected, separate);
+        heatmap = std::move(separate);
+        return difference;
+    }
+
+    heatmap.header = actual.header;
+    heatmap.pixels.resize(actual.pixels.size());
+    if (!sameSize(actual, expected))
+    {
+        std::fill(heatmap.pixels.begin(), heatmap.pixels.end(), heatRamp()[255]);
+        return differentSizes(actual, expected);
+    }
+    return measure(actual, expected, heatmap.pixels.data());
+}
@@ -0,0 +1,189 @@
+#include "composite.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "threadpool.h"
+#include "trace.h"
+
+namespace
+{
+    // Pixels carried through every layer of a stack at a time (4 KB, so the strip stays in L1)
+    constexpr std::size_t CHUNK_PIXELS = 1024;
+
+    const unsigned char *channels(const ImageRGBA &image)
+    {
+        return reinterpret_cast<const unsigned char *>(image.pixels.data());
+    }
+
+    unsigned char *channels(ImageRGBA &image)
+    {
+        return reinterpret_cast<unsigned char *>(image.pixels.data());
+    }
+
+    void checkSameSize(std::size_t first, std::size_t second)
+    {
+        if (first != second)
+            throw std::runtime_error("ERROR: Images must have the same number of pixels.");
+    }
+
+    /// @brief Give `result` the header and pixel count of `source` (reusing its buffer when large enough).
+    void prepare(const ImageRGBA &source, ImageRGBA &result)
+    {
+        if (&source == &result)
+            return;
+        result.header = source.header;
+        result.pixels.resize(source.pixels.size());
+    }
+}
+
+ImageRGBA composite(CompositeMode mode, const ImageRGBA &top, const ImageRGBA &bottom)
+{
+    ImageRGBA result{top.header};
+    composite(mode, top, bottom, result);
+    return result;
+}
+
+void composite(CompositeMode mode, const ImageRGBA &top, const ImageRGBA &bottom, ImageRGBA &result)
+{
+    IP_TRACE_SCOPE("composite");
+    IP_TRACE_COUNT(PixelsProcessed, top.pixels.size());
+    checkSameSize(top.pixels.size(), bottom.pixels.size());
+    prepare(top, result);
+
+    const unsigned char *topChannels = channels(top);
+    const unsigned char *bottomChannels = channels(bottom);
+    unsigned char *resultChannels = channels(result);
+    parallelFor(top.pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                { compositeKernel(mode, topChannels + begin * 4, bottomChannels + begin * 4, resultChannels + begin * 4,
+                                  end - begin); });
+}
+
+ImageRGBA overMode(const ImageRGBA &top, const ImageRGBA &bottom)
+{
+    return composite(CompositeMode::Over, top, bottom);
+}
+
+void overMode(const ImageRGBA &top, const ImageRGBA &bottom, ImageRGBA &result)
+{
+    composite(CompositeMode::Over, top, bottom, result);
+}
+
+ImageRGBA inMode(const ImageRGBA &top, const ImageRGBA &bottom)
+{
+    return composite(CompositeMode::In, top, bottom);
+}
+
+void inMode(const ImageRGBA &top, const ImageRGBA &bottom, ImageRGBA &result)
+{
+    composite(CompositeMode::In, top, bottom, result);
+}
+
+ImageRGBA outMode(const ImageRGBA &top, const ImageRGBA &bottom)
+{
+    return composite(CompositeMode::Out, top, bottom);
+}
+
+void outMode(const ImageRGBA &top, const ImageRGBA &bottom, ImageRGBA &result)
+{
+    composite(CompositeMode::Out, top, bottom, result);
+}
+
+ImageRGBA multiplyMode(const ImageRGBA &top, const ImageRGBA &bottom)
+{
+    return composite(CompositeMode::Multiply, top, bottom);
+}
+
+void multiplyMode(const ImageRGBA &top, const ImageRGBA &bottom, ImageRGBA &result)
+{
+    composite(CompositeMode::Multiply, top, bottom, result);
+}
+
+ImageRGBA screenMode(const ImageRGBA &top, const ImageRGBA &bottom)
+{
+    return composite(CompositeMode::Screen, top, bottom);
+}
+
+void screenMode(const ImageRGBA &top, const ImageRGBA &bottom, ImageRGBA &result)
+{
+    composite(CompositeMode::Screen, top, bottom, result);
+}
+
+ImageRGBA overlayMode(const ImageRGBA &top, const ImageRGBA &bottom)
+{
+    return composite(CompositeMode::Overlay, top, bottom);
+}
+
+void overlayMode(const ImageRGBA &top, const ImageRGBA &bottom, ImageRGBA &result)
+{
+    composite(CompositeMode::Overlay, top, bottom, result);
+}
+
+Image overMode(const ImageRGBA &top, const Image &bottom)
+{
+    Image result{bottom.header};
+    overMode(top, bottom, result);
+    return result;
+}
+
+void overMode(const ImageRGBA &top, const Image &bottom, Image &result)
+{
+    IP_TRACE_SCOPE("overMode");
+    IP_TRACE_COUNT(PixelsProcessed, top.pixels.size());
+    checkSameSize(top.pixels.size(), bottom.pixels.size());
+    prepareResult(bottom, result);
+
+    const unsigned char *in = channels(top);
+    const unsigned char *under = reinterpret_cast<const unsigned char *>(bottom.pixels.data());
+    unsigned char *out = reinterpret_cast<unsigned char *>(result.pixels.data());
+    parallelFor(top.pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                { overOpaqueKernel(in + begin * 4, under + begin * 3, out + begin * 3, end - begin); });
+}
+
+Image flatten(const ImageRGBA &image, const Pixel &background)
+{
+    IP_TRACE_SCOPE("flatten");
+    IP_TRACE_COUNT(PixelsProcessed, image.pixels.size());
+    Image result{tgaHeader(image.header, 3, false)};
+    const unsigned char *in = channels(image);
+    unsigned char *out = reinterpret_cast<unsigned char *>(result.pixels.data());
+
+    // The background is a strip of its color, reused for every chunk of pixels
+    std::vector<Pixel> strip(CHUNK_PIXELS, background);
+    const unsigned char *under = reinterpret_cast<const unsigned char *>(strip.data());
+    parallelFor(image.pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                {
+                    for (std::size_t chunk = begin; chunk < end; chunk += CHUNK_PIXELS)
+                        overOpaqueKernel(in + chunk * 4, under, out + chunk * 3, std::min(CHUNK_PIXELS, end - chunk)); });
+    return result;
+}
+
+ImageRGBA compositeLayers(const ImageRGBA &base, const std::vector<CompositeLayer> &layers)
+{
+    IP_TRACE_SCOPE("compositeLayers");
+    IP_TRACE_COUNT(PixelsProcessed, base.pixels.size() * layers.size());
+    for (const CompositeLayer &layer : layers)
+        checkSameSize(layer.image->pixels.size(), base.pixels.size());
+
+    ImageRGBA result{base.header};
+    const unsigned char *baseChannels = channels(base);
+    unsigned char *resultChannels = channels(result);
+    parallelFor(base.pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                {
+                    for (std::size_t chunk = begin; chunk < end; chunk += CHUNK_PIXELS)
+                    {
+                        // The first layer reads the base, every later one the strip of the result it just wrote
+                        std::size_t count = std::min(CHUNK_PIXELS, end - chunk);
+                        const unsigned char *below = baseChannels + chunk * 4;
+                        unsigned char *out = resultChannels + chunk * 4;
+                        if (layers.empty())
+                            std::memcpy(out, below, count * 4);
+                        for (const CompositeLayer &layer : layers)
+                        {
+                            compositeKernel(layer.mode, channels(*layer.image) + chunk * 4, below, out, count);
+                            below = out;
+                        }
+                    } });
+    return result;
+}
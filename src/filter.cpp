@@ -0,0 +1,344 @@
+#include "filter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "threadpool.h"
+#include "trace.h"
+
+namespace
+{
+    /// @return The row or column read for position `p` of a line of `n` pixels.
+    int edgeIndex(int p, int n, EdgeMode edges)
+    {
+        if (p >= 0 && p < n)
+            return p;
+        if (edges == EdgeMode::Clamp)
+            return p < 0 ? 0 : n - 1;
+
+        // Reflection repeats with a period of 2n (covers radii larger than the image)
+        int period = 2 * n;
+        p %= period;
+        if (p < 0)
+            p += period;
+        return p < n ? p : period - 1 - p;
+    }
+
+    /// @return The number of rows per band; each band re-reads `radius` rows on either side, so keep bands tall.
+    std::size_t bandGrain(int width, int radius)
+    {
+        return std::max(rowGrain(width), static_cast<std::size_t>(4) * radius);
+    }
+
+    /// @return The ring buffer slot holding source position `p` for a window of `size` rows.
+    std::size_t slot(int p, int size)
+    {
+        return static_cast<std::size_t>(((p % size) + size) % size);
+    }
+
+    const unsigned char *channels(const Image &image, int row, int width)
+    {
+        return reinterpret_cast<const unsigned char *>(image.pixels.data() + static_cast<std::size_t>(row) * width);
+    }
+
+    unsigned char *channels(Image &image, int row, int width)
+    {
+        return reinterpret_cast<unsigned char *>(image.pixels.data() + static_cast<std::size_t>(row) * width);
+    }
+
+    unsigned char toByte(float value)
+    {
+        return static_cast<unsigned char>(static_cast<int>(std::min(std::max(value, 0.0f), 255.0f) + 0.5f));
+    }
+
+    /// @brief Convolve one row of interleaved channels with horizontal weights into floats.
+    /// @note The row is first widened into an edge-padded float copy, so the inner loop is a contiguous
+    ///       multiply-add over all channels that the compiler vectorizes.
+    void convolveRow(const unsigned char *row, int width, const std::vector<float> &weights, EdgeMode edges,
+                     std::vector<float> &padded, float *out)
+    {
+        int radius = static_cast<int>(weights.size() / 2);
+        padded.resize(static_cast<std::size_t>(width + 2 * radius) * 3);
+        for (int p = -radius; p < width + radius; ++p)
+        {
+            const unsigned char *pixel = row + static_cast<std::size_t>(edgeIndex(p, width, edges)) * 3;
+            float *destination = &padded[static_cast<std::size_t>(p + radius) * 3];
+            destination[0] = pixel[0];
+            destination[1] = pixel[1];
+            destination[2] = pixel[2];
+        }
+
+        std::size_t count = static_cast<std::size_t>(width) * 3;
+        std::fill(out, out + count, 0.0f);
+        for (std::size_t k = 0; k < weights.size(); ++k)
+        {
+            float weight = weights[k];
+            const float *source = padded.data() + k * 3;
+            for (std::size_t i = 0; i < count; ++i)
+                out[i] += weight * source[i];
+        }
+    }
+
+    /// @brief Running sums of 2 * radius + 1 horizontal neighbours for every channel of one row.
+    void boxRow(const unsigned char *row, int width, int radius, EdgeMode edges, int *out)
+    {
+        auto pixel = [&](int p)
+        { return row + static_cast<std::size_t>(p >= 0 && p < width ? p : edgeIndex(p, width, edges)) * 3; };
+
+        int b = 0, g = 0, r = 0;
+        for (int p = -radius; p <= radius; ++p)
+        {
+            const unsigned char *in = pixel(p);
+            b += in[0];
+            g += in[1];
+            r += in[2];
+        }
+        for (int x = 0; x < width; ++x, out += 3)
+        {
+            out[0] = b;
+            out[1] = g;
+            out[2] = r;
+            const unsigned char *entering = pixel(x + radius + 1);
+            const unsigned char *leaving = pixel(x - radius);
+            b += entering[0] - leaving[0];
+            g += entering[1] - leaving[1];
+            r += entering[2] - leaving[2];
+        }
+    }
+
+    /// @return The radii of three successive box blurs whose combined variance best matches a Gaussian.
+    std::vector<int> boxRadii(double sigma)
+    {
+        constexpr int passes = 3;
+        double idealWidth = std::sqrt(12.0 * sigma * sigma / passes + 1.0);
+        int lower = static_cast<int>(std::floor(idealWidth));
+        if (lower % 2 == 0)
+            --lower;
+        int upper = lower + 2;
+
+        // Number of passes using the narrower box
+        double idealLower = (12.0 * sigma * sigma - passes * lower * lower - 4.0 * passes * lower - 3.0 * passes) / (-4.0 * lower - 4.0);
+        int narrow = static_cast<int>(std::lround(idealLower));
+
+        std::vector<int> radii;
+        for (int i = 0; i < passes; ++i)
+            radii.push_back(((i < narrow ? lower : upper) - 1) / 2);
+        return radii;
+    }
+}
+
+void convolveSeparable(const Image &image, Image &result, const std::vector<float> &horizontal,
+                       const std::vector<float> &vertical, EdgeMode edges)
+{
+    IP_TRACE_SCOPE("convolveSeparable");
+    if (horizontal.size() % 2 == 0 || vertical.size() % 2 == 0)
+        throw std::runtime_error("ERROR: Convolution kernels must have an odd number of weights.");
+
+    // Rows are read around the one being written, so filtering in place needs a copy of the source
+    if (&image == &result)
+    {
+        Image source = image;
+        return convolveSeparable(source, result, horizontal, vertical, edges);
+    }
+    prepareResult(image, result);
+    IP_TRACE_COUNT(PixelsProcessed, image.pixels.size());
+
+    int width = imageWidth(image.header);
+    int height = imageHeight(image.header);
+    int radius = static_cast<int>(vertical.size() / 2);
+    int window = static_cast<int>(vertical.size());
+    std::size_t rowSize = static_cast<std::size_t>(width) * 3;
+
+    parallelFor(height, bandGrain(width, radius), [&](std::size_t begin, std::size_t end)
+                {
+                    // Horizontally filtered rows of the vertical window, kept in a ring as the band slides down
+                    std::vector<float> ring(static_cast<std::size_t>(window) * rowSize);
+                    std::vector<float> padded;
+                    std::vector<float> sum(rowSize);
+                    auto load = [&](int p)
+                    {
+                        convolveRow(channels(image, edgeIndex(p, height, edges), width), width, horizontal, edges, padded,
+                                    &ring[slot(p, window) * rowSize]);
+                    };
+
+                    int first = static_cast<int>(begin);
+                    for (int p = first - radius; p < first + radius; ++p)
+                        load(p);
+
+                    for (int y = first; y < static_cast<int>(end); ++y)
+                    {
+                        load(y + radius);
+
+                        std::fill(sum.begin(), sum.end(), 0.0f);
+                        for (int k = 0; k < window; ++k)
+                        {
+                            float weight = vertical[k];
+                            const float *source = &ring[slot(y - radius + k, window) * rowSize];
+                            for (std::size_t i = 0; i < rowSize; ++i)
+                                sum[i] += weight * source[i];
+                        }
+
+                        unsigned char *out = channels(result, y, width);
+                        for (std::size_t i = 0; i < rowSize; ++i)
+                            out[i] = toByte(sum[i]);
+                    } });
+}
+
+Image convolveSeparable(const Image &image, const std::vector<float> &horizontal, const std::vector<float> &vertical,
+                        EdgeMode edges)
+{
+    Image result{image.header};
+    convolveSeparable(image, result, horizontal, vertical, edges);
+    return result;
+}
+
+std::vector<float> gaussianKernel(double sigma)
+{
+    if (!(sigma > 0))
+        throw std::runtime_error("ERROR: The standard deviation of a Gaussian must be positive.");
+
+    int radius = static_cast<int>(std::ceil(3.0 * sigma));
+    std::vector<double> weights(2 * radius + 1);
+    double total = 0.0;
+    for (int x = -radius; x <= radius; ++x)
+        total += weights[x + radius] = std::exp(-x * x / (2.0 * sigma * sigma));
+
+    std::vector<float> kernel;
+    for (double weight : weights)
+        kernel.push_back(static_cast<float>(weight / total));
+    return kernel;
+}
+
+void boxBlur(const Image &image, Image &result, int radius, EdgeMode edges)
+{
+    IP_TRACE_SCOPE("boxBlur");
+    if (radius < 0)
+        throw std::runtime_error("ERROR: The blur radius cannot be negative.");
+    if (radius == 0)
+    {
+        if (&image != &result)
+            result = image;
+        return;
+    }
+    if (&image == &result)
+    {
+        Image source = image;
+        return boxBlur(source, result, radius, edges);
+    }
+    prepareResult(image, result);
+    IP_TRACE_COUNT(PixelsProcessed, image.pixels.size());
+
+    int width = imageWidth(image.header);
+    int height = imageHeight(image.header);
+    int window = 2 * radius + 1;
+    double reciprocal = 1.0 / (static_cast<double>(window) * window);
+    std::size_t rowSize = static_cast<std::size_t>(width) * 3;
+
+    parallelFor(height, bandGrain(width, radius), [&](std::size_t begin, std::size_t end)
+                {
+                    // Horizontal sums of the rows in the window, plus their running column totals
+                    std::vector<int> ring(static_cast<std::size_t>(window) * rowSize);
+                    std::vector<int> sum(rowSize, 0);
+                    auto load = [&](int p)
+                    {
+                        int *row = &ring[slot(p, window) * rowSize];
+                        boxRow(channels(image, edgeIndex(p, height, edges), width), width, radius, edges, row);
+                        for (std::size_t i = 0; i < rowSize; ++i)
+                            sum[i] += row[i];
+                    };
+
+                    int first = static_cast<int>(begin);
+                    for (int p = first - radius; p <= first + radius; ++p)
+                        load(p);
+
+                    for (int y = first; y < static_cast<int>(end); ++y)
+                    {
+                        // The area is odd, so a sum is never exactly halfway between two multiples of it and
+                        // rounding the product with the reciprocal matches rounded integer division
+                        unsigned char *out = channels(result, y, width);
+                        for (std::size_t i = 0; i < rowSize; ++i)
+                            out[i] = static_cast<unsigned char>(sum[i] * reciprocal + 0.5);
+
+                        // Slide down: the leaving row's slot is exactly the one the entering row takes
+                        if (y + 1 < static_cast<int>(end))
+                        {
+                            const int *leaving = &ring[slot(y - radius, window) * rowSize];
+                            for (std::size_t i = 0; i < rowSize; ++i)
+                                sum[i] -= leaving[i];
+                            load(y + radius + 1);
+                        }
+                    } });
+}
+
+Image boxBlur(const Image &image, int radius, EdgeMode edges)
+{
+    Image result{image.header};
+    boxBlur(image, result, radius, edges);
+    return result;
+}
+
+void gaussianBlur(const Image &image, Image &result, double sigma, EdgeMode edges)
+{
+    IP_TRACE_SCOPE("gaussianBlur");
+    if (sigma < 0)
+        throw std::runtime_error("ERROR: The standard deviation of a Gaussian cannot be negative.");
+    if (sigma == 0)
+    {
+        if (&image != &result)
+            result = image;
+        return;
+    }
+
+    // Three boxes approximate small Gaussians poorly, and the exact kernel is still short there
+    if (sigma < 2.0)
+    {
+        std::vector<float> kernel = gaussianKernel(sigma);
+        return convolveSeparable(image, result, kernel, kernel, edges);
+    }
+
+    std::vector<int> radii = boxRadii(sigma);
+    Image temporary{Header{}};
+    boxBlur(image, result, radii[0], edges);
+    boxBlur(result, temporary, radii[1], edges);
+    boxBlur(temporary, result, radii[2], edges);
+}
+
+Image gaussianBlur(const Image &image, double sigma, EdgeMode edges)
+{
+    Image result{image.header};
+    gaussianBlur(image, result, sigma, edges);
+    return result;
+}
+
+void unsharpMask(const Image &image, Image &result, double sigma, double amount, int threshold)
+{
+    IP_TRACE_SCOPE("unsharpMask");
+    IP_TRACE_COUNT(PixelsProcessed, image.pixels.size());
+    Image blurred = gaussianBlur(image, sigma);
+    prepareResult(image, result);
+
+    // The correction depends only on the difference, which has 511 possible values
+    int delta[511];
+    for (int d = -255; d <= 255; ++d)
+        delta[d + 255] = std::abs(d) < threshold ? 0 : static_cast<int>(std::lround(amount * d));
+
+    const unsigned char *in = reinterpret_cast<const unsigned char *>(image.pixels.data());
+    const unsigned char *smooth = reinterpret_cast<const unsigned char *>(blurred.pixels.data());
+    unsigned char *out = reinterpret_cast<unsigned char *>(result.pixels.data());
+    parallelFor(image.pixels.size() * 3, PIXEL_GRAIN * 3, [&](std::size_t begin, std::size_t end)
+                {
+                    for (std::size_t i = begin; i < end; ++i)
+                    {
+                        int value = in[i] + delta[in[i] - smooth[i] + 255];
+                        out[i] = static_cast<unsigned char>(std::min(std::max(value, 0), 255));
+                    } });
+}
+
+Image unsharpMask(const Image &image, double sigma, double amount, int threshold)
+{
+    Image result{image.header};
+    unsharpMask(image, result, sigma, amount, threshold);
+    return result;
+}
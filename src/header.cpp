@@ -0,0 +1,49 @@
+#include "header.h"
+
+namespace
+{
+    short readShort(const unsigned char *bytes)
+    {
+        return static_cast<short>(bytes[0] | (bytes[1] << 8));
+    }
+
+    void writeShort(short value, unsigned char *bytes)
+    {
+        bytes[0] = static_cast<unsigned char>(value & 0xFF);
+        bytes[1] = static_cast<unsigned char>((value >> 8) & 0xFF);
+    }
+}
+
+Header parseHeader(const unsigned char *bytes)
+{
+    Header header;
+    header.idLength = static_cast<char>(bytes[0]);
+    header.colorMapType = static_cast<char>(bytes[1]);
+    header.dataTypeCode = static_cast<char>(bytes[2]);
+    header.colorMapOrigin = readShort(bytes + 3);
+    header.colorMapLength = readShort(bytes + 5);
+    header.colorMapDepth = static_cast<char>(bytes[7]);
+    header.xOrigin = readShort(bytes + 8);
+    header.yOrigin = readShort(bytes + 10);
+    header.width = readShort(bytes + 12);
+    header.height = readShort(bytes + 14);
+    header.bitsPerPixel = static_cast<char>(bytes[16]);
+    header.imageDescriptor = static_cast<char>(bytes[17]);
+    return header;
+}
+
+void serializeHeader(const Header &header, unsigned char *bytes)
+{
+    bytes[0] = static_cast<unsigned char>(header.idLength);
+    bytes[1] = static_cast<unsigned char>(header.colorMapType);
+    bytes[2] = static_cast<unsigned char>(header.dataTypeCode);
+    writeShort(header.colorMapOrigin, bytes + 3);
+    writeShort(header.colorMapLength, bytes + 5);
+    bytes[7] = static_cast<unsigned char>(header.colorMapDepth);
+    writeShort(header.xOrigin, bytes + 8);
+    writeShort(header.yOrigin, bytes + 10);
+    writeShort(header.width, bytes + 12);
+    writeShort(header.height, bytes + 14);
+    bytes[16] = static_cast<unsigned char>(header.bitsPerPixel);
+    bytes[17] = static_cast<unsigned char>(header.imageDescriptor);
+}
@@ -1,55 +1,95 @@
 #include "image.h"
 
-#include <fstream>
+#include <cstring>
+#include <stdexcept>
 #include <string>
 
+#include "mappedfile.h"
+#include "trace.h"
+
 Image::Image(const std::string &file)
 {
-    std::ifstream imageFile{file, std::ios_base::binary};
-    if (!imageFile.is_open())
-        throw std::runtime_error("ERROR: File \"" + file + "\" not found.");
-
-    // Read in header data (.tga files in little-endian byte order)
-    imageFile.read(&header.idLength, sizeof(header.idLength));
-    imageFile.read(&header.colorMapType, sizeof(header.colorMapType));
-    imageFile.read(&header.dataTypeCode, sizeof(header.dataTypeCode));
-    imageFile.read(reinterpret_cast<char *>(&header.colorMapOrigin), sizeof(header.colorMapOrigin));
-    imageFile.read(reinterpret_cast<char *>(&header.colorMapLength), sizeof(header.colorMapLength));
-    imageFile.read(&header.colorMapDepth, sizeof(header.colorMapDepth));
-    imageFile.read(reinterpret_cast<char *>(&header.xOrigin), sizeof(header.xOrigin));
-    imageFile.read(reinterpret_cast<char *>(&header.yOrigin), sizeof(header.yOrigin));
-    imageFile.read(reinterpret_cast<char *>(&header.width), sizeof(header.width));
-    imageFile.read(reinterpret_cast<char *>(&header.height), sizeof(header.height));
-    imageFile.read(&header.bitsPerPixel, sizeof(header.bitsPerPixel));
-    imageFile.read(&header.imageDescriptor, sizeof(header.imageDescriptor));
-
-    // Read in RGB pixel data
+    IP_TRACE_SCOPE("Image::load");
+    IP_TRACE_COUNT(Allocations, 1);
+    MappedFile mapping{file};
+    IP_TRACE_COUNT(BytesRead, mapping.size());
+    if (mapping.size() < HEADER_SIZE)
+        throw std::runtime_error("ERROR: File \"" + file + "\" is not a valid .tga file.");
+
+    // Read in header data in one go (.tga files in little-endian byte order)
+    Header fileHeader = parseHeader(mapping.data());
+    std::size_t size = static_cast<std::size_t>(imageWidth(fileHeader)) * imageHeight(fileHeader);
+    std::size_t offset = HEADER_SIZE + tgaPayloadOffset(fileHeader);
+
+    // Fast path: uncompressed 24-bit bottom-left pixels already have the in-memory layout
     // Note: The Pixel class has the same order of bytes (BGR) as the .tga file
-    int size = header.height * header.width;
+    if (fileHeader.dataTypeCode == 2 && fileHeader.bitsPerPixel == 24 &&
+        !tgaTopOrigin(fileHeader) && !tgaRightOrigin(fileHeader))
+    {
+        if (offset + size * sizeof(Pixel) > mapping.size())
+            throw std::runtime_error("ERROR: File \"" + file + "\" is truncated.");
+
+        header = tgaHeader(fileHeader, 3, false);
+        pixels.resize(size);
+        std::memcpy(pixels.data(), mapping.data() + offset, size * sizeof(Pixel));
+        return;
+    }
+
+    // Any other format goes through the general decoder and is converted to BGR
+    TgaRaster raster = decodeTga(mapping.data(), mapping.size(), file);
+    header = tgaHeader(raster.header, 3, false);
     pixels.resize(size);
-    imageFile.read(reinterpret_cast<char *>(pixels.data()), size * sizeof(Pixel));
+
+    const unsigned char *in = raster.data.data();
+    for (std::size_t i = 0; i < size; ++i, in += raster.channels)
+    {
+        if (raster.channels == 1)
+            pixels[i].update(in[0], in[0], in[0]);
+        else
+            pixels[i].update(in[2], in[1], in[0]);
+    }
+}
+
+Image::Image(const Header &header) : header{header}
+{
+    IP_TRACE_SCOPE("Image::allocate");
+    IP_TRACE_COUNT(Allocations, 1);
+    pixels.resize(static_cast<std::size_t>(imageWidth(header)) * imageHeight(header));
 }
 
-void Image::write(const std::string &file)
+void Image::write(const std::string &file) const
 {
-    std::ofstream imageFile(file, std::ios_base::binary);
-    if (!imageFile.is_open())
-        throw std::runtime_error("ERROR: File \"" + file + "\" not found.");
-
-    // Write image header information field by field
-    imageFile.write(&header.idLength, sizeof(header.idLength));
-    imageFile.write(&header.colorMapType, sizeof(header.colorMapType));
-    imageFile.write(&header.dataTypeCode, sizeof(header.dataTypeCode));
-    imageFile.write(reinterpret_cast<const char *>(&header.colorMapOrigin), sizeof(header.colorMapOrigin));
-    imageFile.write(reinterpret_cast<const char *>(&header.colorMapLength), sizeof(header.colorMapLength));
-    imageFile.write(&header.colorMapDepth, sizeof(header.colorMapDepth));
-    imageFile.write(reinterpret_cast<const char *>(&header.xOrigin), sizeof(header.xOrigin));
-    imageFile.write(reinterpret_cast<const char *>(&header.yOrigin), sizeof(header.yOrigin));
-    imageFile.write(reinterpret_cast<const char *>(&header.width), sizeof(header.width));
-    imageFile.write(reinterpret_cast<const char *>(&header.height), sizeof(header.height));
-    imageFile.write(&header.bitsPerPixel, sizeof(header.bitsPerPixel));
-    imageFile.write(&header.imageDescriptor, sizeof(header.imageDescriptor));
-
-    // Write pixels
-    imageFile.write(reinterpret_cast<const char *>(pixels.data()), pixels.size() * sizeof(Pixel));
-}
\ No newline at end of file
+    write(file, TgaEncoding::TrueColor);
+}
+
+void Image::write(const std::string &file, TgaEncoding encoding) const
+{
+    IP_TRACE_SCOPE("Image::write");
+    if (pixels.size() != static_cast<std::size_t>(imageWidth(header)) * imageHeight(header))
+        throw std::runtime_error("ERROR: The header of the image does not match its number of pixels.");
+
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(pixels.data());
+    switch (encoding)
+    {
+    case TgaEncoding::TrueColor:
+    case TgaEncoding::TrueColorRle:
+        return writeTga(file, header, data, 3, encoding == TgaEncoding::TrueColorRle);
+    case TgaEncoding::Grayscale:
+    case TgaEncoding::GrayscaleRle:
+    {
+        // Rec. 601 luma weights summing to 256, so gray pixels keep their exact value
+        std::vector<unsigned char> luma(pixels.size());
+        for (std::size_t i = 0; i < pixels.size(); ++i)
+            luma[i] = static_cast<unsigned char>((77 * pixels[i].r + 150 * pixels[i].g + 29 * pixels[i].b + 128) >> 8);
+        return writeTga(file, header, luma.data(), 1, encoding == TgaEncoding::GrayscaleRle);
+    }
+    }
+}
+
+void prepareResult(const Image &source, Image &result)
+{
+    if (&source == &result)
+        return;
+    result.header = source.header;
+    result.pixels.resize(source.pixels.size());
+}
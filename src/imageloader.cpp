@@ -0,0 +1,179 @@
+#include "imageloader.h"
+
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    /// @return The cache key of a path (spelling differences such as `a/./b.tga` name the same entry).
+    std::string cacheKey(const std::string &file)
+    {
+        return std::filesystem::path{file}.lexically_normal().string();
+    }
+}
+
+ImageLoader::ImageLoader(std::size_t cacheLimit, unsigned int ioThreads) : limit{cacheLimit}
+{
+    for (unsigned int i = 0; i < std::max(ioThreads, 1u); ++i)
+        workers.emplace_back([this]
+                             { workerLoop(); });
+}
+
+ImageLoader::~ImageLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+        for (auto &[file, entry] : entries)
+            if (entry.state == State::Queued)
+                entry.promise.set_exception(std::make_exception_ptr(
+                    std::runtime_error("ERROR: The loader was destroyed before \"" + file + "\" was loaded.")));
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+ImageLoader::Entry &ImageLoader::request(const std::string &file, bool &created)
+{
+    auto [found, inserted] = entries.try_emplace(file);
+    created = inserted;
+    if (inserted)
+        found->second.future = found->second.promise.get_future().share();
+    return found->second;
+}
+
+std::shared_future<SharedImage> ImageLoader::load(const std::string &file)
+{
+    std::string key = cacheKey(file);
+    std::lock_guard<std::mutex> lock{mutex};
+    bool created;
+    Entry &entry = request(key, created);
+    if (created)
+        ++counters.misses;
+    else
+        ++counters.hits;
+
+    if (entry.state == State::Ready)
+    {
+        recent.splice(recent.begin(), recent, entry.recent);
+    }
+    else if (entry.state == State::Queued)
+    {
+        // Also queued (again) with the demanded files, which jumps it ahead of the remaining read-ahead
+        demanded.push_back(key);
+        wake.notify_one();
+    }
+    return entry.future;
+}
+
+void ImageLoader::prefetch(const std::string &file)
+{
+    std::string key = cacheKey(file);
+    std::lock_guard<std::mutex> lock{mutex};
+    bool created;
+    request(key, created);
+    if (created)
+    {
+        readAhead.push_back(key);
+        wake.notify_one();
+    }
+}
+
+void ImageLoader::prefetch(const std::vector<std::string> &files)
+{
+    for (const std::string &file : files)
+        prefetch(file);
+}
+
+void ImageLoader::setCacheLimit(std::size_t bytes)
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    limit = bytes;
+    evict();
+}
+
+void ImageLoader::clear()
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    for (const std::string &file : recent)
+        entries.erase(file);
+    recent.clear();
+    counters.imagesCached = 0;
+    counters.bytesCached = 0;
+}
+
+ImageLoaderStats ImageLoader::stats() const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return counters;
+}
+
+void ImageLoader::workerLoop()
+{
+    std::unique_lock<std::mutex> lock{mutex};
+    for (;;)
+    {
+        wake.wait(lock, [this]
+                  { return stopping || !demanded.empty() || !readAhead.empty(); });
+        if (stopping)
+            return;
+
+        // A file may sit in both queues, or have been loaded since it was queued: only Queued entries start
+        std::deque<std::string> &queue = demanded.empty() ? readAhead : demanded;
+        std::string file = std::move(queue.front());
+        queue.pop_front();
+        auto found = entries.find(file);
+        if (found == entries.end() || found->second.state != State::Queued)
+            continue;
+        found->second.state = State::Loading;
+        std::promise<SharedImage> promise = std::move(found->second.promise);
+
+        // Loading entries are never evicted or cleared, so `file` still names this entry afterwards
+        lock.unlock();
+        SharedImage image;
+        std::exception_ptr error;
+        try
+        {
+            image = std::make_shared<const Image>(file);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        lock.lock();
+
+        if (error)
+        {
+            // Not cached, so a later load tries again
+            entries.erase(file);
+            promise.set_exception(error);
+            continue;
+        }
+        Entry &entry = entries.at(file);
+        entry.state = State::Ready;
+        entry.bytes = image->pixels.size() * sizeof(Pixel);
+        recent.push_front(file);
+        entry.recent = recent.begin();
+        ++counters.imagesCached;
+        counters.bytesCached += entry.bytes;
+        promise.set_value(std::move(image));
+        evict();
+    }
+}
+
+void ImageLoader::evict()
+{
+    while (counters.bytesCached > limit && !recent.empty())
+    {
+        auto found = entries.find(recent.back());
+        counters.bytesCached -= found->second.bytes;
+        --counters.imagesCached;
+        ++counters.evictions;
+        entries.erase(found);
+        recent.pop_back();
+    }
+}
@@ -1,240 +1,491 @@
 #include "imageprocessing.h"
 
-Image multiplyMode(const Image &foreground, const Image &background)
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "colortransform.h"
+#include "kernels.h"
+#include "mosaic.h"
+#include "threadpool.h"
+#include "trace.h"
+
+// The kernels treat the pixel vector as a flat run of interleaved BGR bytes
+static_assert(sizeof(Pixel) == 3, "Pixel must be tightly packed BGR bytes");
+
+namespace
 {
-    Image result = foreground;
+    const unsigned char *channels(const Image &image)
+    {
+        return reinterpret_cast<const unsigned char *>(image.pixels.data());
+    }
 
-    for (int i = 0; i < foreground.pixels.size(); ++i)
+    unsigned char *channels(Image &image)
     {
-        const Pixel &currTop = foreground.pixels[i];
-        const Pixel &currBottom = background.pixels[i];
-
-        // Pixel-wise multiplication (cast to double to prevent overflow)
-        double r_mult = static_cast<double>(currTop.r) * currBottom.r;
-        double g_mult = static_cast<double>(currTop.g) * currBottom.g;
-        double b_mult = static_cast<double>(currTop.b) * currBottom.b;
-
-        // Normalize values (add 0.5 to fix rounding issues)
-        result.pixels[i].update(
-            static_cast<unsigned char>(r_mult / 0xFF + 0.5),
-            static_cast<unsigned char>(g_mult / 0xFF + 0.5),
-            static_cast<unsigned char>(b_mult / 0xFF + 0.5));
+        return reinterpret_cast<unsigned char *>(image.pixels.data());
     }
 
-    return result;
-}
+    void checkSameSize(const Image &first, const Image &second)
+    {
+        if (first.pixels.size() != second.pixels.size())
+            throw std::runtime_error("ERROR: Images must have the same number of pixels.");
+    }
 
-Image screenMode(const Image &foreground, const Image &background)
-{
-    Image result = foreground;
+    void checkSameSize(ConstImageView first, ConstImageView second)
+    {
+        if (first.width != second.width || first.height != second.height)
+            throw std::runtime_error("ERROR: Views must have the same size.");
+    }
+
+    /// @brief Run a blend kernel over the rows of two regions in parallel.
+    void blend(void (*kernel)(const unsigned char *, const unsigned char *, unsigned char *, std::size_t),
+               ConstImageView top, ConstImageView bottom, ImageView result)
+    {
+        checkSameSize(top, bottom);
+        checkSameSize(top, result);
+        std::size_t count = static_cast<std::size_t>(top.width) * sizeof(Pixel);
+        parallelForRows(top.width, top.height, [&](int y)
+                        { kernel(reinterpret_cast<const unsigned char *>(top.row(y)),
+                                 reinterpret_cast<const unsigned char *>(bottom.row(y)),
+                                 reinterpret_cast<unsigned char *>(result.row(y)), count); });
+    }
 
-    for (int i = 0; i < foreground.pixels.size(); ++i)
+    /// @brief Run a blend kernel over row bands of the two images in parallel.
+    void blend(void (*kernel)(const unsigned char *, const unsigned char *, unsigned char *, std::size_t),
+               const Image &top, const Image &bottom, Image &result)
     {
-        const Pixel &currTop = foreground.pixels[i];
-        const Pixel &currBottom = background.pixels[i];
-
-        // Pixel-wise negative multiplication (cast to double to prevent overflow)
-        double r_mult = static_cast<double>(0xFF - currTop.r) * (0xFF - currBottom.r);
-        double g_mult = static_cast<double>(0xFF - currTop.g) * (0xFF - currBottom.g);
-        double b_mult = static_cast<double>(0xFF - currTop.b) * (0xFF - currBottom.b);
-
-        // Normalize values (add 0.5 to fix rounding issues)
-        result.pixels[i].update(
-            static_cast<unsigned char>(0xFF - r_mult / 0xFF + 0.5),
-            static_cast<unsigned char>(0xFF - g_mult / 0xFF + 0.5),
-            static_cast<unsigned char>(0xFF - b_mult / 0xFF + 0.5));
+        const unsigned char *topChannels = channels(top);
+        const unsigned char *bottomChannels = channels(bottom);
+        unsigned char *resultChannels = channels(result);
+        parallelFor(top.pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                    {
+                        std::size_t offset = begin * sizeof(Pixel);
+                        kernel(topChannels + offset, bottomChannels + offset, resultChannels + offset,
+                               (end - begin) * sizeof(Pixel)); });
     }
+}
+
+void multiplyMode(const Image &foreground, const Image &background, Image &result)
+{
+    IP_TRACE_SCOPE("multiplyMode");
+    IP_TRACE_COUNT(PixelsProcessed, foreground.pixels.size());
+    checkSameSize(foreground, background);
+    prepareResult(foreground, result);
+    blend(multiplyKernel, foreground, background, result);
+}
 
+Image multiplyMode(const Image &foreground, const Image &background)
+{
+    Image result{foreground.header};
+    multiplyMode(foreground, background, result);
     return result;
 }
 
-Image overlayMode(const Image &foreground, const Image &background)
+Image multiplyMode(Image &&foreground, const Image &background)
 {
-    Image result = foreground;
+    multiplyMode(foreground, background, foreground);
+    return std::move(foreground);
+}
 
-    // Lambda function for pixel-wise multiplication
-    auto multiply = [](unsigned char a, double b)
-    {
-        return (2 * a * b) / 0xFF + 0.5;
-    };
+Image multiplyMode(const Image &foreground, Image &&background)
+{
+    multiplyMode(foreground, background, background);
+    return std::move(background);
+}
 
-    // Lambda function for pixel-wise screen
-    auto screen = [](unsigned char a, double b)
-    {
-        return 0xFF - (2 * (0xFF - a) * (0xFF - b) / 0xFF) + 0.5;
-    };
+Image multiplyMode(Image &&foreground, Image &&background)
+{
+    return multiplyMode(std::move(foreground), static_cast<const Image &>(background));
+}
 
-    for (int i = 0; i < foreground.pixels.size(); ++i)
-    {
-        const Pixel &currTop = foreground.pixels[i];
-        const Pixel &currBottom = background.pixels[i];
+void screenMode(const Image &foreground, const Image &background, Image &result)
+{
+    IP_TRACE_SCOPE("screenMode");
+    IP_TRACE_COUNT(PixelsProcessed, foreground.pixels.size());
+    checkSameSize(foreground, background);
+    prepareResult(foreground, result);
+    blend(screenKernel, foreground, background, result);
+}
+
+Image screenMode(const Image &foreground, const Image &background)
+{
+    Image result{foreground.header};
+    screenMode(foreground, background, result);
+    return result;
+}
+
+Image screenMode(Image &&foreground, const Image &background)
+{
+    screenMode(foreground, background, foreground);
+    return std::move(foreground);
+}
 
-        // Get background color components to determine mode applied (cast to double to prevent overflow)
-        double r_back = static_cast<double>(currBottom.r);
-        double g_back = static_cast<double>(currBottom.g);
-        double b_back = static_cast<double>(currBottom.b);
+Image screenMode(const Image &foreground, Image &&background)
+{
+    screenMode(foreground, background, background);
+    return std::move(background);
+}
 
-        // Pixel-wise multiplication/screen and normalization
-        double r_overlay = (r_back / 0xFF <= 0.5f) ? multiply(currTop.r, r_back) : screen(currTop.r, r_back);
-        double g_overlay = (g_back / 0xFF <= 0.5f) ? multiply(currTop.g, g_back) : screen(currTop.g, g_back);
-        double b_overlay = (b_back / 0xFF <= 0.5f) ? multiply(currTop.b, b_back) : screen(currTop.b, b_back);
+Image screenMode(Image &&foreground, Image &&background)
+{
+    return screenMode(std::move(foreground), static_cast<const Image &>(background));
+}
 
-        result.pixels[i].update(r_overlay, g_overlay, b_overlay);
-    }
+void overlayMode(const Image &foreground, const Image &background, Image &result)
+{
+    IP_TRACE_SCOPE("overlayMode");
+    IP_TRACE_COUNT(PixelsProcessed, foreground.pixels.size());
+    checkSameSize(foreground, background);
+    prepareResult(foreground, result);
+    blend(overlayKernel, foreground, background, result);
+}
 
+Image overlayMode(const Image &foreground, const Image &background)
+{
+    Image result{foreground.header};
+    overlayMode(foreground, background, result);
     return result;
 }
 
-Image subtractMode(const Image &topLayer, const Image &bottomLayer)
+Image overlayMode(Image &&foreground, const Image &background)
 {
-    Image result = topLayer;
+    overlayMode(foreground, background, foreground);
+    return std::move(foreground);
+}
 
-    for (int i = 0; i < topLayer.pixels.size(); ++i)
-    {
-        const Pixel &currTop = topLayer.pixels[i];
-        const Pixel &currBottom = bottomLayer.pixels[i];
+Image overlayMode(const Image &foreground, Image &&background)
+{
+    overlayMode(foreground, background, background);
+    return std::move(background);
+}
 
-        // Pixel-wise subtraction (clamp to 0 to prevent underflow)
-        unsigned char r_sub = (currBottom.r < currTop.r) ? 0 : currBottom.r - currTop.r;
-        unsigned char g_sub = (currBottom.g < currTop.g) ? 0 : currBottom.g - currTop.g;
-        unsigned char b_sub = (currBottom.b < currTop.b) ? 0 : currBottom.b - currTop.b;
+Image overlayMode(Image &&foreground, Image &&background)
+{
+    return overlayMode(std::move(foreground), static_cast<const Image &>(background));
+}
 
-        result.pixels[i].update(r_sub, g_sub, b_sub);
-    }
+void subtractMode(const Image &topLayer, const Image &bottomLayer, Image &result)
+{
+    IP_TRACE_SCOPE("subtractMode");
+    IP_TRACE_COUNT(PixelsProcessed, topLayer.pixels.size());
+    checkSameSize(topLayer, bottomLayer);
+    prepareResult(topLayer, result);
+    blend(subtractKernel, topLayer, bottomLayer, result);
+}
 
+Image subtractMode(const Image &topLayer, const Image &bottomLayer)
+{
+    Image result{topLayer.header};
+    subtractMode(topLayer, bottomLayer, result);
     return result;
 }
 
-Image add(const Image &image, double r, double g, double b)
+Image subtractMode(Image &&topLayer, const Image &bottomLayer)
 {
-    Image result = image;
+    subtractMode(topLayer, bottomLayer, topLayer);
+    return std::move(topLayer);
+}
 
-    for (int i = 0; i < image.pixels.size(); ++i)
-    {
-        const Pixel &currTop = image.pixels[i];
+Image subtractMode(const Image &topLayer, Image &&bottomLayer)
+{
+    subtractMode(topLayer, bottomLayer, bottomLayer);
+    return std::move(bottomLayer);
+}
 
-        // Pixel-wise addition (clamp to 255 to prevent overflow)
-        unsigned char r_add = (0xFF - r < currTop.r) ? 0xFF : r + currTop.r;
-        unsigned char g_add = (0xFF - g < currTop.g) ? 0xFF : g + currTop.g;
-        unsigned char b_add = (0xFF - b < currTop.b) ? 0xFF : b + currTop.b;
+Image subtractMode(Image &&topLayer, Image &&bottomLayer)
+{
+    return subtractMode(std::move(topLayer), static_cast<const Image &>(bottomLayer));
+}
 
-        result.pixels[i].update(r_add, g_add, b_add);
-    }
+void add(const Image &image, Image &result, double r, double g, double b)
+{
+    IP_TRACE_SCOPE("add");
+    ColorTransform{}.add(r, g, b).apply(image, result);
+}
 
+Image add(const Image &image, double r, double g, double b)
+{
+    Image result{image.header};
+    add(image, result, r, g, b);
     return result;
 }
 
+Image add(Image &&image, double r, double g, double b)
+{
+    add(image, image, r, g, b);
+    return std::move(image);
+}
+
+void scale(const Image &image, Image &result, double r, double g, double b)
+{
+    IP_TRACE_SCOPE("scale");
+    ColorTransform{}.scale(r, g, b).apply(image, result);
+}
+
 Image scale(const Image &image, double r, double g, double b)
 {
-    Image result = image;
+    Image result{image.header};
+    scale(image, result, r, g, b);
+    return result;
+}
 
-    for (int i = 0; i < image.pixels.size(); ++i)
-    {
-        const Pixel &currTop = image.pixels[i];
+Image scale(Image &&image, double r, double g, double b)
+{
+    scale(image, image, r, g, b);
+    return std::move(image);
+}
 
-        // Pixel-wise scaling (clamp to 255 to prevent overflow)
-        unsigned char r_scale = (currTop.r * r > 0xFF) ? 0xFF : currTop.r * r;
-        unsigned char g_scale = (currTop.g * g > 0xFF) ? 0xFF : currTop.g * g;
-        unsigned char b_scale = (currTop.b * b > 0xFF) ? 0xFF : currTop.b * b;
+void extractRed(const Image &image, Image &result)
+{
+    IP_TRACE_SCOPE("extractRed");
+    ColorTransform{}.extract(Channel::Red).apply(image, result);
+}
 
-        result.pixels[i].update(r_scale, g_scale, b_scale);
-    }
+Image extractRed(const Image &image)
+{
+    Image result{image.header};
+    extractRed(image, result);
+    return result;
+}
+
+Image extractRed(Image &&image)
+{
+    extractRed(image, image);
+    return std::move(image);
+}
 
+void extractGreen(const Image &image, Image &result)
+{
+    IP_TRACE_SCOPE("extractGreen");
+    ColorTransform{}.extract(Channel::Green).apply(image, result);
+}
+
+Image extractGreen(const Image &image)
+{
+    Image result{image.header};
+    extractGreen(image, result);
     return result;
 }
 
-Image extractRed(const Image &image)
+Image extractGreen(Image &&image)
 {
-    Image result = image;
+    extractGreen(image, image);
+    return std::move(image);
+}
 
-    for (int i = 0; i < image.pixels.size(); ++i)
-    {
-        const Pixel &currTop = image.pixels[i];
-        result.pixels[i].update(currTop.r, currTop.r, currTop.r);
-    }
+void extractBlue(const Image &image, Image &result)
+{
+    IP_TRACE_SCOPE("extractBlue");
+    ColorTransform{}.extract(Channel::Blue).apply(image, result);
+}
 
+Image extractBlue(const Image &image)
+{
+    Image result{image.header};
+    extractBlue(image, result);
     return result;
 }
 
-Image extractGreen(const Image &image)
+Image extractBlue(Image &&image)
 {
-    Image result = image;
+    extractBlue(image, image);
+    return std::move(image);
+}
 
-    for (int i = 0; i < image.pixels.size(); ++i)
-    {
-        const Pixel &currTop = image.pixels[i];
-        result.pixels[i].update(currTop.g, currTop.g, currTop.g);
-    }
+void combineChannels(const Image &red, const Image &green, const Image &blue, Image &result)
+{
+    IP_TRACE_SCOPE("combineChannels");
+    IP_TRACE_COUNT(PixelsProcessed, red.pixels.size());
+    checkSameSize(red, green);
+    checkSameSize(red, blue);
+    prepareResult(red, result);
+
+    parallelFor(red.pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                {
+                    for (std::size_t i = begin; i < end; ++i)
+                        result.pixels[i].update(red.pixels[i].r, green.pixels[i].g, blue.pixels[i].b); });
+}
 
+Image combineChannels(const Image &red, const Image &green, const Image &blue)
+{
+    Image result{red.header};
+    combineChannels(red, green, blue, result);
     return result;
 }
 
-Image extractBlue(const Image &image)
+Image combineChannels(Image &&red, const Image &green, const Image &blue)
 {
-    Image result = image;
+    combineChannels(red, green, blue, red);
+    return std::move(red);
+}
 
-    for (int i = 0; i < image.pixels.size(); ++i)
+void rotate180(const Image &image, Image &result)
+{
+    IP_TRACE_SCOPE("rotate180");
+    IP_TRACE_COUNT(PixelsProcessed, image.pixels.size());
+    std::size_t count = image.pixels.size();
+    if (count == 0)
+        return prepareResult(image, result);
+
+    std::size_t last = count - 1;
+    if (&image == &result)
     {
-        const Pixel &currTop = image.pixels[i];
-        result.pixels[i].update(currTop.b, currTop.b, currTop.b);
+        // In place: swap mirrored pairs, each band owning the pairs of its lower half
+        parallelFor(count / 2, PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                    {
+                        for (std::size_t i = begin; i < end; ++i)
+                            std::swap(result.pixels[i], result.pixels[last - i]); });
+        return;
     }
 
+    prepareResult(image, result);
+    parallelFor(count, PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                {
+                    // Store pixels backwards (bottom right corner [begin] becomes top left corner [end])
+                    for (std::size_t i = begin; i < end; ++i)
+                        result.pixels[last - i] = image.pixels[i]; });
+}
+
+Image rotate180(const Image &image)
+{
+    Image result{image.header};
+    rotate180(image, result);
     return result;
 }
 
-Image combineChannels(const Image &red, const Image &green, const Image &blue)
+Image rotate180(Image &&image)
 {
-    Image result = red;
+    rotate180(image, image);
+    return std::move(image);
+}
 
-    for (int i = 0; i < red.pixels.size(); ++i)
-        result.pixels[i].update(red.pixels[i].r, green.pixels[i].g, blue.pixels[i].b);
+void combineQuadrants(const Image &first, const Image &second, const Image &third, const Image &fourth, Image &result)
+{
+    IP_TRACE_SCOPE("combineQuadrants");
+    if (&result == &first || &result == &second || &result == &third || &result == &fourth)
+        throw std::runtime_error("ERROR: combineQuadrants cannot write into one of its inputs.");
+
+    // A 2x2 grid in reading order: first and second on top, fourth and third below
+    MosaicLayout layout = gridLayout({&first, &second, &fourth, &third}, 2);
+    Header canvas = mosaicHeader(layout.width, layout.height);
+    result.header = first.header;
+    result.header.width = canvas.width;
+    result.header.height = canvas.height;
+    result.pixels.resize(static_cast<std::size_t>(layout.width) * layout.height);
+
+    // Quadrants of different sizes leave gaps, which must not show a previous image
+    std::size_t covered = first.pixels.size() + second.pixels.size() + third.pixels.size() + fourth.pixels.size();
+    if (covered != result.pixels.size())
+        std::fill(result.pixels.begin(), result.pixels.end(), Pixel{});
+
+    composeMosaic(layout.tiles, result);
+    IP_TRACE_COUNT(PixelsProcessed, result.pixels.size());
+}
 
+Image combineQuadrants(const Image &first, const Image &second, const Image &third, const Image &fourth)
+{
+    Image result{Header{}};
+    combineQuadrants(first, second, third, fourth, result);
     return result;
 }
 
-Image rotate180(const Image &image)
+void multiplyMode(ConstImageView foreground, ConstImageView background, ImageView result)
 {
-    Image result = image;
+    IP_TRACE_SCOPE("multiplyMode");
+    IP_TRACE_COUNT(PixelsProcessed, foreground.size());
+    blend(multiplyKernel, foreground, background, result);
+}
 
-    for (int i = image.pixels.size() - 1; i >= 0; i--)
-    {
-        const Pixel &currTop = image.pixels[i];
+void screenMode(ConstImageView foreground, ConstImageView background, ImageView result)
+{
+    IP_TRACE_SCOPE("screenMode");
+    IP_TRACE_COUNT(PixelsProcessed, foreground.size());
+    blend(screenKernel, foreground, background, result);
+}
 
-        // Store pixels backwards (bottom right corner [begin] becomes top left corner [end])
-        result.pixels[result.pixels.size() - 1 - i] = currTop;
-    }
+void overlayMode(ConstImageView foreground, ConstImageView background, ImageView result)
+{
+    IP_TRACE_SCOPE("overlayMode");
+    IP_TRACE_COUNT(PixelsProcessed, foreground.size());
+    blend(overlayKernel, foreground, background, result);
+}
 
-    return result;
+void subtractMode(ConstImageView topLayer, ConstImageView bottomLayer, ImageView result)
+{
+    IP_TRACE_SCOPE("subtractMode");
+    IP_TRACE_COUNT(PixelsProcessed, topLayer.size());
+    blend(subtractKernel, topLayer, bottomLayer, result);
 }
 
-Image combineQuadrants(const Image &first, const Image &second, const Image &third, const Image &fourth)
+void add(ConstImageView image, ImageView result, double r, double g, double b)
+{
+    IP_TRACE_SCOPE("add");
+    ColorTransform{}.add(r, g, b).apply(image, result);
+}
+
+void scale(ConstImageView image, ImageView result, double r, double g, double b)
+{
+    IP_TRACE_SCOPE("scale");
+    ColorTransform{}.scale(r, g, b).apply(image, result);
+}
+
+void extractRed(ConstImageView image, ImageView result)
 {
-    Image result = first;
-    result.header.width *= 2;
-    result.header.height *= 2;
-    result.pixels.clear();
-    result.pixels.reserve(result.header.width * result.header.height);
+    IP_TRACE_SCOPE("extractRed");
+    ColorTransform{}.extract(Channel::Red).apply(image, result);
+}
 
-    int halfWidth = result.header.width / 2;
-    int halfHeight = result.header.height / 2;
-    for (int i = 0; i < result.header.width; ++i)
+void extractGreen(ConstImageView image, ImageView result)
+{
+    IP_TRACE_SCOPE("extractGreen");
+    ColorTransform{}.extract(Channel::Green).apply(image, result);
+}
+
+void extractBlue(ConstImageView image, ImageView result)
+{
+    IP_TRACE_SCOPE("extractBlue");
+    ColorTransform{}.extract(Channel::Blue).apply(image, result);
+}
+
+void combineChannels(ConstImageView red, ConstImageView green, ConstImageView blue, ImageView result)
+{
+    IP_TRACE_SCOPE("combineChannels");
+    IP_TRACE_COUNT(PixelsProcessed, red.size());
+    checkSameSize(red, green);
+    checkSameSize(red, blue);
+    checkSameSize(red, result);
+    parallelForRows(red.width, red.height, [&](int y)
+                    {
+                        const Pixel *r = red.row(y);
+                        const Pixel *g = green.row(y);
+                        const Pixel *b = blue.row(y);
+                        Pixel *out = result.row(y);
+                        for (int x = 0; x < red.width; ++x)
+                            out[x].update(r[x].r, g[x].g, b[x].b); });
+}
+
+void rotate180(ConstImageView image, ImageView result)
+{
+    IP_TRACE_SCOPE("rotate180");
+    IP_TRACE_COUNT(PixelsProcessed, image.size());
+    checkSameSize(image, result);
+    int width = image.width;
+    int height = image.height;
+    if (image.data == result.data && image.stride == result.stride)
     {
-        for (int j = 0; j < result.header.height; ++j)
-        {
-            // Fourth quadrant
-            if (i < halfWidth && j < halfHeight)
-                result.pixels.push_back(fourth.pixels[j + i * (halfWidth)]);
-            // First quadrant (column must be subtracted for correct access)
-            else if (i >= halfWidth && j < halfHeight)
-                result.pixels.push_back(first.pixels[j + (i - halfWidth) * (halfWidth)]);
-            // Second quadrant (row and column must be subtracted for correct access)
-            else if (i >= halfWidth && j >= halfHeight)
-                result.pixels.push_back(second.pixels[(j - halfHeight) + (i - halfWidth) * (halfWidth)]);
-            // Third quadrant (row must be subtracted for correct access)
-            else
-                result.pixels.push_back(third.pixels[(j - halfHeight) + i * (halfWidth)]);
-        }
+        // In place: swap each row of the lower half with its mirror, reversed; a middle row is reversed alone
+        parallelForRows(width, (height + 1) / 2, [&](int y)
+                        {
+                            Pixel *lower = result.row(y);
+                            Pixel *upper = result.row(height - 1 - y);
+                            if (lower == upper)
+                                std::reverse(lower, lower + width);
+                            else
+                                for (int x = 0; x < width; ++x)
+                                    std::swap(lower[x], upper[width - 1 - x]); });
+        return;
     }
 
-    return result;
+    parallelForRows(width, height, [&](int y)
+                    { std::reverse_copy(image.row(y), image.row(y) + width, result.row(height - 1 - y)); });
 }
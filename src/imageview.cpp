@@ -0,0 +1,127 @@
+#include "imageview.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "mosaic.h"
+#include "threadpool.h"
+#include "trace.h"
+
+namespace
+{
+    void checkRegion(int parentWidth, int parentHeight, int x, int y, int width, int height)
+    {
+        if (x < 0 || y < 0 || width < 0 || height < 0 || x > parentWidth - width || y > parentHeight - height)
+            throw std::runtime_error("ERROR: The region " + std::to_string(width) + "x" + std::to_string(height) + " at (" +
+                                     std::to_string(x) + ", " + std::to_string(y) + ") lies outside the " +
+                                     std::to_string(parentWidth) + "x" + std::to_string(parentHeight) + " image.");
+    }
+
+    template <typename View>
+    View region(const View &parent, int x, int y, int width, int height)
+    {
+        checkRegion(parent.width, parent.height, x, y, width, height);
+        View result = parent;
+        result.data = parent.data + y * parent.stride + x;
+        result.width = width;
+        result.height = height;
+        return result;
+    }
+}
+
+ImageView view(Image &image)
+{
+    int width = imageWidth(image.header);
+    return ImageView{image.pixels.data(), width, imageHeight(image.header), width};
+}
+
+ConstImageView view(const Image &image)
+{
+    int width = imageWidth(image.header);
+    return ConstImageView{image.pixels.data(), width, imageHeight(image.header), width};
+}
+
+ImageView view(MappedImage &image)
+{
+    int width = imageWidth(image.header);
+    return ImageView{image.mutablePixels(), width, imageHeight(image.header), width};
+}
+
+ConstImageView view(const MappedImage &image)
+{
+    int width = imageWidth(image.header);
+    return ConstImageView{image.pixels(), width, imageHeight(image.header), width};
+}
+
+ImageView view(Image &image, int x, int y, int width, int height)
+{
+    return region(view(image), x, y, width, height);
+}
+
+ConstImageView view(const Image &image, int x, int y, int width, int height)
+{
+    return region(view(image), x, y, width, height);
+}
+
+ImageView view(MappedImage &image, int x, int y, int width, int height)
+{
+    return region(view(image), x, y, width, height);
+}
+
+ConstImageView view(const MappedImage &image, int x, int y, int width, int height)
+{
+    return region(view(image), x, y, width, height);
+}
+
+ImageView view(const ImageView &parent, int x, int y, int width, int height)
+{
+    return region(parent, x, y, width, height);
+}
+
+ConstImageView view(const ConstImageView &parent, int x, int y, int width, int height)
+{
+    return region(parent, x, y, width, height);
+}
+
+Image crop(ConstImageView region)
+{
+    IP_TRACE_SCOPE("crop");
+    Image result{mosaicHeader(region.width, region.height)};
+    paste(region, view(result));
+    return result;
+}
+
+Image crop(const Image &image, int x, int y, int width, int height)
+{
+    return crop(view(image, x, y, width, height));
+}
+
+void paste(ConstImageView source, ImageView target)
+{
+    IP_TRACE_SCOPE("paste");
+    IP_TRACE_COUNT(PixelsProcessed, source.size());
+    if (source.width != target.width || source.height != target.height)
+        throw std::runtime_error("ERROR: Views must have the same size.");
+    if (source.size() == 0 || (source.data == target.data && source.stride == target.stride))
+        return;
+
+    // Views covering the same rows may overlap (a horizontal move within an image): memmove handles that
+    std::size_t bytes = static_cast<std::size_t>(source.width) * sizeof(Pixel);
+    if (source.contiguous() && target.contiguous())
+    {
+        std::memmove(target.data, source.data, bytes * source.height);
+        return;
+    }
+    parallelForRows(source.width, source.height, [&](int y)
+                    { std::memmove(target.row(y), source.row(y), bytes); });
+}
+
+void fill(ImageView target, const Pixel &color)
+{
+    IP_TRACE_SCOPE("fill");
+    IP_TRACE_COUNT(PixelsProcessed, target.size());
+    parallelForRows(target.width, target.height, [&](int y)
+                    { std::fill(target.row(y), target.row(y) + target.width, color); });
+}
@@ -0,0 +1,747 @@
+#include "kernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "basicimage.h"
+#include "blendmodes.h"
+#include "composite.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define KERNELS_X86 1
+#include <immintrin.h>
+#define KERNELS_TARGET(isa) __attribute__((target(isa)))
+#else
+#define KERNELS_X86 0
+#endif
+
+namespace
+{
+    template <unsigned char (*Op)(unsigned char, unsigned char)>
+    void scalarKernel(const unsigned char *top, const unsigned char *bottom, unsigned char *out, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            out[i] = Op(top[i], bottom[i]);
+    }
+
+    void scalarMatrixKernel(const unsigned char *in, unsigned char *out, std::size_t pixelCount, const std::int32_t *matrix)
+    {
+        for (std::size_t i = 0; i < pixelCount; ++i, in += 3, out += 3)
+        {
+            const std::int32_t b = in[0], g = in[1], r = in[2];
+            for (int c = 0; c < 3; ++c)
+            {
+                const std::int32_t *row = matrix + c * 3;
+                std::int32_t sum = row[0] * b + row[1] * g + row[2] * r + (1 << 15);
+                out[c] = static_cast<unsigned char>(std::min(std::max(sum, 0) >> 16, 255));
+            }
+        }
+    }
+
+    using CompositeOp = unsigned char (*)(unsigned char, unsigned char, unsigned char, unsigned char);
+
+    template <CompositeOp Op>
+    void scalarCompositeKernel(const unsigned char *top, const unsigned char *bottom, unsigned char *out,
+                               std::size_t pixelCount)
+    {
+        for (std::size_t i = 0; i < pixelCount; ++i, top += 4, bottom += 4, out += 4)
+        {
+            // The alphas are read first: `out` may alias either input
+            const unsigned char topAlpha = top[3], bottomAlpha = bottom[3];
+            for (int c = 0; c < 4; ++c)
+                out[c] = Op(top[c], bottom[c], topAlpha, bottomAlpha);
+        }
+    }
+
+    void scalarOverOpaqueKernel(const unsigned char *top, const unsigned char *bottom, unsigned char *out,
+                                std::size_t pixelCount)
+    {
+        for (std::size_t i = 0; i < pixelCount; ++i, top += 4, bottom += 3, out += 3)
+        {
+            const unsigned char alpha = top[3];
+            for (int c = 0; c < 3; ++c)
+                out[c] = overComposite(top[c], bottom[c], alpha, 0xFF);
+        }
+    }
+
+    void scalarQuantizeKernel(const float *in, unsigned char *out, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            out[i] = ChannelTraits<float>::toByte(in[i]);
+    }
+
+#if KERNELS_X86
+    /* SSE2 (16 channels per iteration) */
+
+    // Rounded division by 255 on eight 16-bit lanes (same identity as div255)
+    KERNELS_TARGET("sse2")
+    inline __m128i div255Epi16(__m128i x)
+    {
+        x = _mm_add_epi16(x, _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+    }
+
+    // Rounded product / 255 of sixteen byte pairs, optionally doubled before the division
+    template <bool Doubled>
+    KERNELS_TARGET("sse2")
+    inline __m128i mulDiv255Sse2(__m128i a, __m128i b)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+        __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+        if (Doubled)
+        {
+            lo = _mm_add_epi16(lo, lo);
+            hi = _mm_add_epi16(hi, hi);
+        }
+        return _mm_packus_epi16(div255Epi16(lo), div255Epi16(hi));
+    }
+
+    struct MultiplySse2
+    {
+        KERNELS_TARGET("sse2")
+        static __m128i apply(__m128i top, __m128i bottom) { return mulDiv255Sse2<false>(top, bottom); }
+    };
+
+    struct ScreenSse2
+    {
+        KERNELS_TARGET("sse2")
+        static __m128i apply(__m128i top, __m128i bottom)
+        {
+            const __m128i ones = _mm_set1_epi8(-1);
+            return _mm_xor_si128(mulDiv255Sse2<false>(_mm_xor_si128(top, ones), _mm_xor_si128(bottom, ones)), ones);
+        }
+    };
+
+    struct OverlaySse2
+    {
+        KERNELS_TARGET("sse2")
+        static __m128i apply(__m128i top, __m128i bottom)
+        {
+            // Both branches are computed; lanes that overflow 16 bits are discarded by the select
+            const __m128i ones = _mm_set1_epi8(-1);
+            __m128i multiplied = mulDiv255Sse2<true>(top, bottom);
+            __m128i screened = _mm_xor_si128(mulDiv255Sse2<true>(_mm_xor_si128(top, ones), _mm_xor_si128(bottom, ones)), ones);
+            __m128i bright = _mm_cmplt_epi8(bottom, _mm_setzero_si128()); // bottom >= 0x80
+            return _mm_or_si128(_mm_and_si128(bright, screened), _mm_andnot_si128(bright, multiplied));
+        }
+    };
+
+    struct SubtractSse2
+    {
+        KERNELS_TARGET("sse2")
+        static __m128i apply(__m128i top, __m128i bottom) { return _mm_subs_epu8(bottom, top); }
+    };
+
+    template <typename Vec, unsigned char (*Op)(unsigned char, unsigned char)>
+    KERNELS_TARGET("sse2")
+    void sse2Kernel(const unsigned char *top, const unsigned char *bottom, unsigned char *out, std::size_t count)
+    {
+        std::size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(top + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), Vec::apply(a, b));
+        }
+        scalarKernel<Op>(top + i, bottom + i, out + i, count - i);
+    }
+
+    /* SSE2 compositing of premultiplied BGRA pixels, on 16-bit lanes (s, d: top and bottom channels; sa, da:
+       their alphas, repeated over each pixel's four lanes) */
+
+    struct OverSse2
+    {
+        KERNELS_TARGET("sse2")
+        static __m128i apply(__m128i s, __m128i d, __m128i sa, __m128i)
+        {
+            return _mm_add_epi16(s, div255Epi16(_mm_mullo_epi16(d, _mm_sub_epi16(_mm_set1_epi16(0xFF), sa))));
+        }
+    };
+
+    struct InSse2
+    {
+        KERNELS_TARGET("sse2")
+        static __m128i apply(__m128i s, __m128i, __m128i, __m128i da) { return div255Epi16(_mm_mullo_epi16(s, da)); }
+    };
+
+    struct OutSse2
+    {
+        KERNELS_TARGET("sse2")
+        static __m128i apply(__m128i s, __m128i, __m128i, __m128i da)
+        {
+            return div255Epi16(_mm_mullo_epi16(s, _mm_sub_epi16(_mm_set1_epi16(0xFF), da)));
+        }
+    };
+
+    // `s * (255 - da) + d * (255 - sa)`: the parts of each layer the other one does not cover
+    KERNELS_TARGET("sse2")
+    inline __m128i uncoveredSse2(__m128i s, __m128i d, __m128i sa, __m128i da)
+    {
+        const __m128i full = _mm_set1_epi16(0xFF);
+        return _mm_add_epi16(_mm_mullo_epi16(s, _mm_sub_epi16(full, da)), _mm_mullo_epi16(d, _mm_sub_epi16(full, sa)));
+    }
+
+    struct MultiplyCompositeSse2
+    {
+        KERNELS_TARGET("sse2")
+        static __m128i apply(__m128i s, __m128i d, __m128i sa, __m128i da)
+        {
+            return div255Epi16(_mm_add_epi16(uncoveredSse2(s, d, sa, da), _mm_mullo_epi16(s, d)));
+        }
+    };
+
+    struct ScreenCompositeSse2
+    {
+        KERNELS_TARGET("sse2")
+        static __m128i apply(__m128i s, __m128i d, __m128i, __m128i)
+        {
+            // 255 * (s + d) may wrap around 16 bits; the difference does not
+            return div255Epi16(_mm_sub_epi16(_mm_mullo_epi16(_mm_add_epi16(s, d), _mm_set1_epi16(0xFF)), _mm_mullo_epi16(s, d)));
+        }
+    };
+
+    struct OverlayCompositeSse2
+    {
+        KERNELS_TARGET("sse2")
+        static __m128i apply(__m128i s, __m128i d, __m128i sa, __m128i da)
+        {
+            __m128i multiplied = _mm_slli_epi16(_mm_mullo_epi16(s, d), 1);
+            __m128i screened = _mm_sub_epi16(_mm_mullo_epi16(sa, da),
+                                             _mm_slli_epi16(_mm_mullo_epi16(_mm_sub_epi16(da, d), _mm_sub_epi16(sa, s)), 1));
+            __m128i bright = _mm_cmpgt_epi16(_mm_slli_epi16(d, 1), da); // 2 * d > da
+            __m128i blended = _mm_or_si128(_mm_and_si128(bright, screened), _mm_andnot_si128(bright, multiplied));
+            return div255Epi16(_mm_add_epi16(uncoveredSse2(s, d, sa, da), blended));
+        }
+    };
+
+    // Repeat the alpha of each of the two pixels in eight 16-bit lanes over the pixel's four lanes
+    KERNELS_TARGET("sse2")
+    inline __m128i alphaSse2(__m128i x)
+    {
+        return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    }
+
+    template <typename Vec, CompositeOp Op>
+    KERNELS_TARGET("sse2")
+    void sse2CompositeKernel(const unsigned char *top, const unsigned char *bottom, unsigned char *out,
+                             std::size_t pixelCount)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        std::size_t i = 0;
+        for (; i + 4 <= pixelCount; i += 4)
+        {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(top + i * 4));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom + i * 4));
+            __m128i s = _mm_unpacklo_epi8(a, zero), d = _mm_unpacklo_epi8(b, zero);
+            __m128i lo = Vec::apply(s, d, alphaSse2(s), alphaSse2(d));
+            s = _mm_unpackhi_epi8(a, zero);
+            d = _mm_unpackhi_epi8(b, zero);
+            __m128i hi = Vec::apply(s, d, alphaSse2(s), alphaSse2(d));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * 4), _mm_packus_epi16(lo, hi));
+        }
+        scalarCompositeKernel<Op>(top + i * 4, bottom + i * 4, out + i * 4, pixelCount - i);
+    }
+
+    // Four channels clamped to 0...1 (max returns its second operand for NaN) and scaled to rounded integers
+    KERNELS_TARGET("sse2")
+    inline __m128i quantizeSse2(__m128 value)
+    {
+        value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+        return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+    }
+
+    KERNELS_TARGET("sse2")
+    void sse2QuantizeKernel(const float *in, unsigned char *out, std::size_t count)
+    {
+        std::size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            __m128i lo = _mm_packs_epi32(quantizeSse2(_mm_loadu_ps(in + i)), quantizeSse2(_mm_loadu_ps(in + i + 4)));
+            __m128i hi = _mm_packs_epi32(quantizeSse2(_mm_loadu_ps(in + i + 8)), quantizeSse2(_mm_loadu_ps(in + i + 12)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(lo, hi));
+        }
+        scalarQuantizeKernel(in + i, out + i, count - i);
+    }
+
+    /* AVX2 (32 channels per iteration) */
+
+    KERNELS_TARGET("avx2")
+    inline __m256i div255Epi16(__m256i x)
+    {
+        x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+        return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+    }
+
+    // Unpack and pack both work within 128-bit lanes, so the byte order is preserved
+    template <bool Doubled>
+    KERNELS_TARGET("avx2")
+    inline __m256i mulDiv255Avx2(__m256i a, __m256i b)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i lo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero));
+        __m256i hi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero));
+        if (Doubled)
+        {
+            lo = _mm256_add_epi16(lo, lo);
+            hi = _mm256_add_epi16(hi, hi);
+        }
+        return _mm256_packus_epi16(div255Epi16(lo), div255Epi16(hi));
+    }
+
+    struct MultiplyAvx2
+    {
+        KERNELS_TARGET("avx2")
+        static __m256i apply(__m256i top, __m256i bottom) { return mulDiv255Avx2<false>(top, bottom); }
+    };
+
+    struct ScreenAvx2
+    {
+        KERNELS_TARGET("avx2")
+        static __m256i apply(__m256i top, __m256i bottom)
+        {
+            const __m256i ones = _mm256_set1_epi8(-1);
+            return _mm256_xor_si256(mulDiv255Avx2<false>(_mm256_xor_si256(top, ones), _mm256_xor_si256(bottom, ones)), ones);
+        }
+    };
+
+    struct OverlayAvx2
+    {
+        KERNELS_TARGET("avx2")
+        static __m256i apply(__m256i top, __m256i bottom)
+        {
+            const __m256i ones = _mm256_set1_epi8(-1);
+            __m256i multiplied = mulDiv255Avx2<true>(top, bottom);
+            __m256i screened = _mm256_xor_si256(mulDiv255Avx2<true>(_mm256_xor_si256(top, ones), _mm256_xor_si256(bottom, ones)), ones);
+            __m256i bright = _mm256_cmpgt_epi8(_mm256_setzero_si256(), bottom); // bottom >= 0x80
+            return _mm256_blendv_epi8(multiplied, screened, bright);
+        }
+    };
+
+    struct SubtractAvx2
+    {
+        KERNELS_TARGET("avx2")
+        static __m256i apply(__m256i top, __m256i bottom) { return _mm256_subs_epu8(bottom, top); }
+    };
+
+    template <typename Vec, unsigned char (*Op)(unsigned char, unsigned char)>
+    KERNELS_TARGET("avx2")
+    void avx2Kernel(const unsigned char *top, const unsigned char *bottom, unsigned char *out, std::size_t count)
+    {
+        std::size_t i = 0;
+        for (; i + 32 <= count; i += 32)
+        {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(top + i));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bottom + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), Vec::apply(a, b));
+        }
+        scalarKernel<Op>(top + i, bottom + i, out + i, count - i);
+    }
+
+    /* AVX2 compositing (see the SSE2 versions) */
+
+    struct OverAvx2
+    {
+        KERNELS_TARGET("avx2")
+        static __m256i apply(__m256i s, __m256i d, __m256i sa, __m256i)
+        {
+            return _mm256_add_epi16(s, div255Epi16(_mm256_mullo_epi16(d, _mm256_sub_epi16(_mm256_set1_epi16(0xFF), sa))));
+        }
+    };
+
+    struct InAvx2
+    {
+        KERNELS_TARGET("avx2")
+        static __m256i apply(__m256i s, __m256i, __m256i, __m256i da) { return div255Epi16(_mm256_mullo_epi16(s, da)); }
+    };
+
+    struct OutAvx2
+    {
+        KERNELS_TARGET("avx2")
+        static __m256i apply(__m256i s, __m256i, __m256i, __m256i da)
+        {
+            return div255Epi16(_mm256_mullo_epi16(s, _mm256_sub_epi16(_mm256_set1_epi16(0xFF), da)));
+        }
+    };
+
+    KERNELS_TARGET("avx2")
+    inline __m256i uncoveredAvx2(__m256i s, __m256i d, __m256i sa, __m256i da)
+    {
+        const __m256i full = _mm256_set1_epi16(0xFF);
+        return _mm256_add_epi16(_mm256_mullo_epi16(s, _mm256_sub_epi16(full, da)),
+                                _mm256_mullo_epi16(d, _mm256_sub_epi16(full, sa)));
+    }
+
+    struct MultiplyCompositeAvx2
+    {
+        KERNELS_TARGET("avx2")
+        static __m256i apply(__m256i s, __m256i d, __m256i sa, __m256i da)
+        {
+            return div255Epi16(_mm256_add_epi16(uncoveredAvx2(s, d, sa, da), _mm256_mullo_epi16(s, d)));
+        }
+    };
+
+    struct ScreenCompositeAvx2
+    {
+        KERNELS_TARGET("avx2")
+        static __m256i apply(__m256i s, __m256i d, __m256i, __m256i)
+        {
+            return div255Epi16(_mm256_sub_epi16(_mm256_mullo_epi16(_mm256_add_epi16(s, d), _mm256_set1_epi16(0xFF)),
+                                                _mm256_mullo_epi16(s, d)));
+        }
+    };
+
+    struct OverlayCompositeAvx2
+    {
+        KERNELS_TARGET("avx2")
+        static __m256i apply(__m256i s, __m256i d, __m256i sa, __m256i da)
+        {
+            __m256i multiplied = _mm256_slli_epi16(_mm256_mullo_epi16(s, d), 1);
+            __m256i screened = _mm256_sub_epi16(
+                _mm256_mullo_epi16(sa, da),
+                _mm256_slli_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(da, d), _mm256_sub_epi16(sa, s)), 1));
+            __m256i bright = _mm256_cmpgt_epi16(_mm256_slli_epi16(d, 1), da);
+            return div255Epi16(_mm256_add_epi16(uncoveredAvx2(s, d, sa, da), _mm256_blendv_epi8(multiplied, screened, bright)));
+        }
+    };
+
+    KERNELS_TARGET("avx2")
+    inline __m256i alphaAvx2(__m256i x)
+    {
+        return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    }
+
+    template <typename Vec, CompositeOp Op>
+    KERNELS_TARGET("avx2")
+    void avx2CompositeKernel(const unsigned char *top, const unsigned char *bottom, unsigned char *out,
+                             std::size_t pixelCount)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        std::size_t i = 0;
+        for (; i + 8 <= pixelCount; i += 8)
+        {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(top + i * 4));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bottom + i * 4));
+            __m256i s = _mm256_unpacklo_epi8(a, zero), d = _mm256_unpacklo_epi8(b, zero);
+            __m256i lo = Vec::apply(s, d, alphaAvx2(s), alphaAvx2(d));
+            s = _mm256_unpackhi_epi8(a, zero);
+            d = _mm256_unpackhi_epi8(b, zero);
+            __m256i hi = Vec::apply(s, d, alphaAvx2(s), alphaAvx2(d));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i * 4), _mm256_packus_epi16(lo, hi));
+        }
+        scalarCompositeKernel<Op>(top + i * 4, bottom + i * 4, out + i * 4, pixelCount - i);
+    }
+
+    KERNELS_TARGET("avx2")
+    void avx2OverOpaqueKernel(const unsigned char *top, const unsigned char *bottom, unsigned char *out,
+                              std::size_t pixelCount)
+    {
+        // Each 128-bit half widens four BGR pixels (12 bytes) to opaque BGRA, and packs four back
+        const __m256i widen = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                               0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                              0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        const __m256i opaque = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+        const __m256i zero = _mm256_setzero_si256();
+
+        // Eight pixels per iteration. The loads run 4 bytes past them, the stores stay within them, so
+        // `out` may alias `bottom`
+        std::size_t i = 0;
+        for (; i + 10 <= pixelCount; i += 8)
+        {
+            const unsigned char *source = bottom + i * 3;
+            unsigned char *target = out + i * 3;
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(top + i * 4));
+            __m256i b = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(source))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + 12)), 1);
+            b = _mm256_or_si256(_mm256_shuffle_epi8(b, widen), opaque);
+
+            __m256i s = _mm256_unpacklo_epi8(a, zero), d = _mm256_unpacklo_epi8(b, zero);
+            __m256i lo = OverAvx2::apply(s, d, alphaAvx2(s), alphaAvx2(d));
+            s = _mm256_unpackhi_epi8(a, zero);
+            d = _mm256_unpackhi_epi8(b, zero);
+            __m256i hi = OverAvx2::apply(s, d, alphaAvx2(s), alphaAvx2(d));
+
+            __m256i packed = _mm256_shuffle_epi8(_mm256_packus_epi16(lo, hi), pack);
+            __m128i high = _mm256_extracti128_si256(packed, 1);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(target), _mm256_castsi256_si128(packed));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(target + 12), high);
+            std::int32_t last = _mm_extract_epi32(high, 2);
+            std::memcpy(target + 20, &last, 4);
+        }
+        scalarOverOpaqueKernel(top + i * 4, bottom + i * 3, out + i * 3, pixelCount - i);
+    }
+
+    KERNELS_TARGET("avx2")
+    inline __m256i quantizeAvx2(__m256 value)
+    {
+        value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+        return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(value, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+    }
+
+    KERNELS_TARGET("avx2")
+    void avx2QuantizeKernel(const float *in, unsigned char *out, std::size_t count)
+    {
+        // The packs interleave the 128-bit halves; one permute puts the 32 bytes back in order
+        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        std::size_t i = 0;
+        for (; i + 32 <= count; i += 32)
+        {
+            __m256i lo = _mm256_packs_epi32(quantizeAvx2(_mm256_loadu_ps(in + i)),
+                                            quantizeAvx2(_mm256_loadu_ps(in + i + 8)));
+            __m256i hi = _mm256_packs_epi32(quantizeAvx2(_mm256_loadu_ps(in + i + 16)),
+                                            quantizeAvx2(_mm256_loadu_ps(in + i + 24)));
+            __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(lo, hi), order);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), bytes);
+        }
+        scalarQuantizeKernel(in + i, out + i, count - i);
+    }
+
+    // One output channel of eight pixels, rounded and clamped to 0...255 in 32-bit lanes
+    KERNELS_TARGET("avx2")
+    inline __m256i mixAvx2(__m256i b, __m256i g, __m256i r, const std::int32_t *row)
+    {
+        __m256i sum = _mm256_add_epi32(_mm256_mullo_epi32(b, _mm256_set1_epi32(row[0])),
+                                       _mm256_mullo_epi32(g, _mm256_set1_epi32(row[1])));
+        sum = _mm256_add_epi32(sum, _mm256_add_epi32(_mm256_mullo_epi32(r, _mm256_set1_epi32(row[2])),
+                                                     _mm256_set1_epi32(1 << 15)));
+        sum = _mm256_srai_epi32(_mm256_max_epi32(sum, _mm256_setzero_si256()), 16);
+        return _mm256_min_epi32(sum, _mm256_set1_epi32(255));
+    }
+
+    KERNELS_TARGET("avx2")
+    void avx2MatrixKernel(const unsigned char *in, unsigned char *out, std::size_t pixelCount, const std::int32_t *matrix)
+    {
+        // Each 128-bit half holds four pixels (12 bytes): spread one channel into 32-bit lanes, and pack back
+        const __m256i blue = _mm256_setr_epi8(0, -1, -1, -1, 3, -1, -1, -1, 6, -1, -1, -1, 9, -1, -1, -1,
+                                              0, -1, -1, -1, 3, -1, -1, -1, 6, -1, -1, -1, 9, -1, -1, -1);
+        const __m256i green = _mm256_setr_epi8(1, -1, -1, -1, 4, -1, -1, -1, 7, -1, -1, -1, 10, -1, -1, -1,
+                                               1, -1, -1, -1, 4, -1, -1, -1, 7, -1, -1, -1, 10, -1, -1, -1);
+        const __m256i red = _mm256_setr_epi8(2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1,
+                                             2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1);
+        const __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                              0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+        // Eight pixels per iteration. The loads run 4 bytes past them, the stores stay within them, so
+        // `out` may alias `in`
+        std::size_t i = 0;
+        for (; i + 10 <= pixelCount; i += 8)
+        {
+            const unsigned char *source = in + i * 3;
+            unsigned char *target = out + i * 3;
+            __m256i pixels = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(source))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + 12)), 1);
+            __m256i b = _mm256_shuffle_epi8(pixels, blue);
+            __m256i g = _mm256_shuffle_epi8(pixels, green);
+            __m256i r = _mm256_shuffle_epi8(pixels, red);
+
+            __m256i mixed = _mm256_or_si256(mixAvx2(b, g, r, matrix),
+                                            _mm256_or_si256(_mm256_slli_epi32(mixAvx2(b, g, r, matrix + 3), 8),
+                                                            _mm256_slli_epi32(mixAvx2(b, g, r, matrix + 6), 16)));
+            mixed = _mm256_shuffle_epi8(mixed, pack);
+            __m128i high = _mm256_extracti128_si256(mixed, 1);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(target), _mm256_castsi256_si128(mixed));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(target + 12), high);
+            std::int32_t last = _mm_extract_epi32(high, 2);
+            std::memcpy(target + 20, &last, 4);
+        }
+        scalarMatrixKernel(in + i * 3, out + i * 3, pixelCount - i, matrix);
+    }
+#endif
+
+    using Kernel = void (*)(const unsigned char *, const unsigned char *, unsigned char *, std::size_t);
+
+    /// @brief One entry per blend mode, indexed by SimdLevel.
+    struct KernelTable
+    {
+        Kernel multiply[3];
+        Kernel screen[3];
+        Kernel overlay[3];
+        Kernel subtract[3];
+    };
+
+#if KERNELS_X86
+    const KernelTable kernelTable = {
+        {scalarKernel<multiplyBlend>, sse2Kernel<MultiplySse2, multiplyBlend>, avx2Kernel<MultiplyAvx2, multiplyBlend>},
+        {scalarKernel<screenBlend>, sse2Kernel<ScreenSse2, screenBlend>, avx2Kernel<ScreenAvx2, screenBlend>},
+        {scalarKernel<overlayBlend>, sse2Kernel<OverlaySse2, overlayBlend>, avx2Kernel<OverlayAvx2, overlayBlend>},
+        {scalarKernel<subtractBlend>, sse2Kernel<SubtractSse2, subtractBlend>, avx2Kernel<SubtractAvx2, subtractBlend>},
+    };
+#else
+    const KernelTable kernelTable = {
+        {scalarKernel<multiplyBlend>, scalarKernel<multiplyBlend>, scalarKernel<multiplyBlend>},
+        {scalarKernel<screenBlend>, scalarKernel<screenBlend>, scalarKernel<screenBlend>},
+        {scalarKernel<overlayBlend>, scalarKernel<overlayBlend>, scalarKernel<overlayBlend>},
+        {scalarKernel<subtractBlend>, scalarKernel<subtractBlend>, scalarKernel<subtractBlend>},
+    };
+#endif
+
+    // One row per CompositeMode, one entry per SimdLevel
+#if KERNELS_X86
+    const Kernel compositeTable[6][3] = {
+        {scalarCompositeKernel<overComposite>, sse2CompositeKernel<OverSse2, overComposite>,
+         avx2CompositeKernel<OverAvx2, overComposite>},
+        {scalarCompositeKernel<inComposite>, sse2CompositeKernel<InSse2, inComposite>,
+         avx2CompositeKernel<InAvx2, inComposite>},
+        {scalarCompositeKernel<outComposite>, sse2CompositeKernel<OutSse2, outComposite>,
+         avx2CompositeKernel<OutAvx2, outComposite>},
+        {scalarCompositeKernel<multiplyComposite>, sse2CompositeKernel<MultiplyCompositeSse2, multiplyComposite>,
+         avx2CompositeKernel<MultiplyCompositeAvx2, multiplyComposite>},
+        {scalarCompositeKernel<screenComposite>, sse2CompositeKernel<ScreenCompositeSse2, screenComposite>,
+         avx2CompositeKernel<ScreenCompositeAvx2, screenComposite>},
+        {scalarCompositeKernel<overlayComposite>, sse2CompositeKernel<OverlayCompositeSse2, overlayComposite>,
+         avx2CompositeKernel<OverlayCompositeAvx2, overlayComposite>},
+    };
+#else
+    const Kernel compositeTable[6][3] = {
+        {scalarCompositeKernel<overComposite>, scalarCompositeKernel<overComposite>, scalarCompositeKernel<overComposite>},
+        {scalarCompositeKernel<inComposite>, scalarCompositeKernel<inComposite>, scalarCompositeKernel<inComposite>},
+        {scalarCompositeKernel<outComposite>, scalarCompositeKernel<outComposite>, scalarCompositeKernel<outComposite>},
+        {scalarCompositeKernel<multiplyComposite>, scalarCompositeKernel<multiplyComposite>,
+         scalarCompositeKernel<multiplyComposite>},
+        {scalarCompositeKernel<screenComposite>, scalarCompositeKernel<screenComposite>,
+         scalarCompositeKernel<screenComposite>},
+        {scalarCompositeKernel<overlayComposite>, scalarCompositeKernel<overlayComposite>,
+         scalarCompositeKernel<overlayComposite>},
+    };
+#endif
+
+    std::atomic<int> &currentLevel()
+    {
+        static std::atomic<int> level{static_cast<int>(detectSimdLevel())};
+        return level;
+    }
+}
+
+SimdLevel detectSimdLevel()
+{
+#if KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return SimdLevel::SSE2;
+#endif
+    return SimdLevel::Scalar;
+}
+
+SimdLevel activeSimdLevel()
+{
+    return static_cast<SimdLevel>(currentLevel().load(std::memory_order_relaxed));
+}
+
+void setSimdLevel(SimdLevel level)
+{
+    SimdLevel supported = detectSimdLevel();
+    if (static_cast<int>(level) > static_cast<int>(supported))
+        level = supported;
+    currentLevel().store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+void multiplyKernel(const unsigned char *top, const unsigned char *bottom, unsigned char *out, std::size_t count)
+{
+    kernelTable.multiply[currentLevel().load(std::memory_order_relaxed)](top, bottom, out, count);
+}
+
+void screenKernel(const unsigned char *top, const unsigned char *bottom, unsigned char *out, std::size_t count)
+{
+    kernelTable.screen[currentLevel().load(std::memory_order_relaxed)](top, bottom, out, count);
+}
+
+void overlayKernel(const unsigned char *top, const unsigned char *bottom, unsigned char *out, std::size_t count)
+{
+    kernelTable.overlay[currentLevel().load(std::memory_order_relaxed)](top, bottom, out, count);
+}
+
+void subtractKernel(const unsigned char *top, const unsigned char *bottom, unsigned char *out, std::size_t count)
+{
+    kernelTable.subtract[currentLevel().load(std::memory_order_relaxed)](top, bottom, out, count);
+}
+
+ChannelLuts makeAddLuts(double r, double g, double b)
+{
+    ChannelLuts luts;
+    for (int v = 0; v < 256; ++v)
+    {
+        // Same clamping expression as the per-pixel addition, evaluated once per byte value
+        luts.r[v] = (0xFF - r < v) ? 0xFF : static_cast<unsigned char>(r + v);
+        luts.g[v] = (0xFF - g < v) ? 0xFF : static_cast<unsigned char>(g + v);
+        luts.b[v] = (0xFF - b < v) ? 0xFF : static_cast<unsigned char>(b + v);
+    }
+    return luts;
+}
+
+ChannelLuts makeScaleLuts(double r, double g, double b)
+{
+    ChannelLuts luts;
+    for (int v = 0; v < 256; ++v)
+    {
+        luts.r[v] = (v * r > 0xFF) ? 0xFF : static_cast<unsigned char>(v * r);
+        luts.g[v] = (v * g > 0xFF) ? 0xFF : static_cast<unsigned char>(v * g);
+        luts.b[v] = (v * b > 0xFF) ? 0xFF : static_cast<unsigned char>(v * b);
+    }
+    return luts;
+}
+
+void lutKernel(const unsigned char *in, unsigned char *out, std::size_t pixelCount, const ChannelLuts &luts)
+{
+    for (std::size_t i = 0; i < pixelCount; ++i, in += 3, out += 3)
+    {
+        unsigned char b = luts.b[in[0]];
+        unsigned char g = luts.g[in[1]];
+        unsigned char r = luts.r[in[2]];
+        out[0] = b;
+        out[1] = g;
+        out[2] = r;
+    }
+}
+
+void matrixKernel(const unsigned char *in, unsigned char *out, std::size_t pixelCount, const std::int32_t *matrix)
+{
+#if KERNELS_X86
+    if (currentLevel().load(std::memory_order_relaxed) == static_cast<int>(SimdLevel::AVX2))
+        return avx2MatrixKernel(in, out, pixelCount, matrix);
+#endif
+    scalarMatrixKernel(in, out, pixelCount, matrix);
+}
+
+void extractKernel(const unsigned char *in, unsigned char *out, std::size_t pixelCount, int channel)
+{
+    for (std::size_t i = 0; i < pixelCount; ++i, in += 3, out += 3)
+    {
+        unsigned char value = in[channel];
+        out[0] = value;
+        out[1] = value;
+        out[2] = value;
+    }
+}
+
+void compositeKernel(CompositeMode mode, const unsigned char *top, const unsigned char *bottom, unsigned char *out,
+                     std::size_t pixelCount)
+{
+    compositeTable[static_cast<int>(mode)][currentLevel().load(std::memory_order_relaxed)](top, bottom, out, pixelCount);
+}
+
+void overOpaqueKernel(const unsigned char *top, const unsigned char *bottom, unsigned char *out, std::size_t pixelCount)
+{
+#if KERNELS_X86
+    if (currentLevel().load(std::memory_order_relaxed) == static_cast<int>(SimdLevel::AVX2))
+        return avx2OverOpaqueKernel(top, bottom, out, pixelCount);
+#endif
+    scalarOverOpaqueKernel(top, bottom, out, pixelCount);
+}
+
+void quantizeKernel(const float *in, unsigned char *out, std::size_t count)
+{
+#if KERNELS_X86
+    int level = currentLevel().load(std::memory_order_relaxed);
+    if (level == static_cast<int>(SimdLevel::AVX2))
+        return avx2QuantizeKernel(in, out, count);
+    if (level == static_cast<int>(SimdLevel::SSE2))
+        return sse2QuantizeKernel(in, out, count);
+#endif
+    scalarQuantizeKernel(in, out, count);
+}
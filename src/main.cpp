@@ -1,132 +1,245 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
+#include "basicimage.h"
+#include "batch.h"
+#include "blendmodes.h"
+#include "compare.h"
+#include "composite.h"
+#include "filter.h"
 #include "image.h"
+#include "imageloader.h"
 #include "imageprocessing.h"
+#include "imageview.h"
+#include "mappedimage.h"
+#include "pipeline.h"
+#include "planarimage.h"
+#include "resample.h"
+#include "statistics.h"
+#include "streamprocessing.h"
+#include "tga.h"
+#include "transform.h"
+#include "workqueue.h"
 
 #define FILE_EXT ".tga"               // Image file extension
 #define INPUT_PATH "../data/input/"   // Relative path to input files
 #define TEST_PATH "../data/tests/"    // Relative path to test files
 #define OUTPUT_PATH "../data/output/" // Relative path to output directory
 
-/// @return `true` if the images are identical (all pixel values are the same); `false` otherwise
-bool testCase(Image &test, Image &example);
+/// @return `true` if the images are identical (same size and pixel values); `false` otherwise
+/// @note A failing test reports how far the output is from the example and writes a heatmap of the differences.
+bool testCase(const Image &test, const Image &example, const std::string &name);
 
-int main()
+/// @return `true` if the images are the same size and no channel differs by more than `tolerance`
+bool nearlyEqual(const Image &test, const Image &example, int tolerance, const std::string &name);
+
+/// @return The image blended channel by channel with a scalar formula
+Image blendReference(unsigned char (*blend)(unsigned char, unsigned char), const Image &top, const Image &bottom);
+
+/// @return `true` if every file in tests/formats (each data type, depth and origin) decodes to its reference
+bool checkTgaFormats();
+
+/// @return `true` if an image reads back unchanged in every encoding it can be written with
+/// @param image A gray image (all channels equal), so the grayscale encodings keep it exactly
+bool checkTgaRoundTrips(const Image &image);
+
+/// @return `true` if run-length packets are split at 128 pixels and decode back to the row
+bool checkRleRows();
+
+/// @return `true` if Test 6 run from one mapped file into another matches its example
+bool checkMappedImages(const Image &example);
+
+/// @return `true` if the streaming operations write Tests 1, 6 and 9 with chunks that do not divide the image
+bool checkStreaming(const Image &example1, const Image &example6, const Image &example9);
+
+/// @return `true` if every planar operation gives the pixels of its interleaved counterpart
+bool checkPlanarImages(const Image &layer, const Image &pattern, const Image &car, const Image &circles,
+                       const Image &text);
+
+/// @return `true` if 16-bit and float images convert back exactly and blend within 1 of the 8-bit results
+bool checkHighBitDepths(const Image &layer, const Image &pattern, const Image &text, const Image &example3);
+
+/// @return `true` if the histograms and means match a direct count and the identity adjustments change nothing
+bool checkStatistics(const Image &image);
+
+/// @return `true` if every named blend mode, built-in or registered, matches its scalar formula
+bool checkBlendModes(const Image &top, const Image &bottom);
+
+/// @return `true` if the filters keep flat images and identity kernels unchanged and box blurs average exactly
+bool checkFilters(const Image &image);
+
+/// @return `true` if resampling keeps same-size and flat images unchanged and mipmaps and thumbnails are sized right
+bool checkResampling(const Image &image);
+
+/// @return `true` if the rotations, transposes and flips undo each other and turn clockwise
+bool checkTransforms(const Image &image);
+
+/// @return `true` if opaque layers composite to the bytes of the RGB blends and translucent ones to the formulas
+bool checkCompositing(const Image &top, const Image &bottom, const Image &mask);
+
+/// @return `true` if a queue worker writes Tests 6 and 10, returns a stale claim and skips finished outputs
+bool checkWorkQueue(const Image &example6, const Image &example10);
+
+int main(int argc, char *argv[])
 {
+    // Any argument selects the command-line driver instead of the test suite
+    if (argc > 1)
+        return runCommandLine(argc, argv);
+
+    // Every input and test file is read ahead on a background thread: the test files decode while the
+    // operations run
+    ImageLoader loader;
+    auto inputFile = [](const std::string &name)
+    { return INPUT_PATH + name + FILE_EXT; };
+    auto testFile = [](const std::string &name)
+    { return TEST_PATH + name + FILE_EXT; };
+    for (const char *name : {"layer1", "layer2", "layer_blue", "layer_green", "layer_red", "pattern1", "pattern2",
+                             "text1", "text2", "car", "circles"})
+        loader.prefetch(inputFile(name));
+    for (const char *name : {"test1", "test2", "test3", "test4", "test5", "test6", "test7", "test8_b", "test8_g",
+                             "test8_r", "test9", "test10", "test11"})
+        loader.prefetch(testFile(name));
+
     std::cout << "Loading Input Files... ";
-    Image layer1{INPUT_PATH + std::string{"layer1"} + FILE_EXT};
-    Image layer2{INPUT_PATH + std::string{"layer2"} + FILE_EXT};
-    Image blue{INPUT_PATH + std::string{"layer_blue"} + FILE_EXT};
-    Image green{INPUT_PATH + std::string{"layer_green"} + FILE_EXT};
-    Image red{INPUT_PATH + std::string{"layer_red"} + FILE_EXT};
-    Image pattern1{INPUT_PATH + std::string{"pattern1"} + FILE_EXT};
-    Image pattern2{INPUT_PATH + std::string{"pattern2"} + FILE_EXT};
-    Image text1{INPUT_PATH + std::string{"text1"} + FILE_EXT};
-    Image text2{INPUT_PATH + std::string{"text2"} + FILE_EXT};
-    Image car{INPUT_PATH + std::string{"car"} + FILE_EXT};
-    Image circles{INPUT_PATH + std::string{"circles"} + FILE_EXT};
+    SharedImage layer1 = loader.load(inputFile("layer1")).get();
+    SharedImage layer2 = loader.load(inputFile("layer2")).get();
+    SharedImage blue = loader.load(inputFile("layer_blue")).get();
+    SharedImage green = loader.load(inputFile("layer_green")).get();
+    SharedImage red = loader.load(inputFile("layer_red")).get();
+    SharedImage pattern1 = loader.load(inputFile("pattern1")).get();
+    SharedImage pattern2 = loader.load(inputFile("pattern2")).get();
+    SharedImage text1 = loader.load(inputFile("text1")).get();
+    SharedImage text2 = loader.load(inputFile("text2")).get();
+    SharedImage car = loader.load(inputFile("car")).get();
+    SharedImage circles = loader.load(inputFile("circles")).get();
     std::cout << "Done." << std::endl;
 
     std::cout << "Performing Operations... ";
-    std::vector<Image *> outputs;
+    std::vector<std::pair<Image *, std::string>> outputs; // Each output next to its file name
 
     // Test 1: Multiply layer1.tga (top) and pattern1.tga (bottom)
-    Image output1 = multiplyMode(layer1, pattern1);
+    Image output1 = multiplyMode(*layer1, *pattern1);
     output1.write(OUTPUT_PATH + std::string{"output1"} + FILE_EXT);
-    outputs.push_back(&output1);
+    outputs.push_back({&output1, "output1"});
 
     // Test 2: Subtract layer2.tga (top) with car.tga (bottom)
-    Image output2 = subtractMode(layer2, car);
+    Image output2 = subtractMode(*layer2, *car);
     output2.write(OUTPUT_PATH + std::string{"output2"} + FILE_EXT);
-    outputs.push_back(&output2);
+    outputs.push_back({&output2, "output2"});
 
     // Test 3: Multiply layer1.tga (top) and pattern2.tga (bottom)
     //         Screen result with text.tga (top)
-    Image suboutput3 = multiplyMode(layer1, pattern2);
-    Image output3 = screenMode(text1, suboutput3);
+    //         (evaluated as one fused pass without an intermediate image)
+    Image output3 = Pipeline{*layer1}.multiplyMode(*pattern2).screenMode(*text1, Layer::Bottom).evaluate();
     output3.write(OUTPUT_PATH + std::string{"output3"} + FILE_EXT);
-    outputs.push_back(&output3);
+    outputs.push_back({&output3, "output3"});
 
     // Test 4: Multiply layer2.tga (top) and circles.tga (bottom)
     //         Subtract result with pattern2.tga (top)
-    Image suboutput4 = multiplyMode(layer2, circles);
-    Image output4 = subtractMode(pattern2, suboutput4);
+    //         (evaluated as one fused pass without an intermediate image)
+    Image output4 = Pipeline{*layer2}.multiplyMode(*circles).subtractMode(*pattern2, Layer::Bottom).evaluate();
     output4.write(OUTPUT_PATH + std::string{"output4"} + FILE_EXT);
-    outputs.push_back(&output4);
+    outputs.push_back({&output4, "output4"});
 
     // Test 5: Overlay layer1.tga (top) and pattern1.tga (bottom)
-    Image output5 = overlayMode(layer1, pattern1);
+    Image output5 = overlayMode(*layer1, *pattern1);
     output5.write(OUTPUT_PATH + std::string{"output5"} + FILE_EXT);
-    outputs.push_back(&output5);
+    outputs.push_back({&output5, "output5"});
 
     // Test 6: Load car.tga and add 200 to the green channel
-    Image output6 = add(car, 0, 200, 0);
+    Image output6 = add(*car, 0, 200, 0);
     output6.write(OUTPUT_PATH + std::string{"output6"} + FILE_EXT);
-    outputs.push_back(&output6);
+    outputs.push_back({&output6, "output6"});
 
     // Test 7: Load car.tga and scale the red channel by 4, the blue channel by 0
-    Image output7 = scale(car, 4, 1, 0);
+    Image output7 = scale(*car, 4, 1, 0);
     output7.write(OUTPUT_PATH + std::string{"output7"} + FILE_EXT);
-    outputs.push_back(&output7);
+    outputs.push_back({&output7, "output7"});
 
     // Test 8: Load car.tga and write each channel to a separate file
-    Image output8_r = extractRed(car);
-    Image output8_g = extractGreen(car);
-    Image output8_b = extractBlue(car);
+    Image output8_r = extractRed(*car);
+    Image output8_g = extractGreen(*car);
+    Image output8_b = extractBlue(*car);
     output8_r.write(OUTPUT_PATH + std::string{"output8_r"} + FILE_EXT);
     output8_g.write(OUTPUT_PATH + std::string{"output8_g"} + FILE_EXT);
     output8_b.write(OUTPUT_PATH + std::string{"output8_b"} + FILE_EXT);
-    outputs.push_back(&output8_r);
-    outputs.push_back(&output8_g);
-    outputs.push_back(&output8_b);
+    outputs.push_back({&output8_r, "output8_r"});
+    outputs.push_back({&output8_g, "output8_g"});
+    outputs.push_back({&output8_b, "output8_b"});
 
     // Test 9: Combine layer red.tga, green.tga, blue.tga
-    Image output9 = combineChannels(red, green, blue);
+    Image output9 = combineChannels(*red, *green, *blue);
     output9.write(OUTPUT_PATH + std::string{"output9"} + FILE_EXT);
-    outputs.push_back(&output9);
+    outputs.push_back({&output9, "output9"});
 
     // Test 10: Rotate text2.tga
-    Image output10 = rotate180(text2);
+    Image output10 = rotate180(*text2);
     output10.write(OUTPUT_PATH + std::string{"output10"} + FILE_EXT);
-    outputs.push_back(&output10);
+    outputs.push_back({&output10, "output10"});
 
     // Test 11: Create a new file that is the combination of car.tga, circles.tga, pattern1.tga, text.tga
     //          Each source image will be in a quadrant of the final image
-    Image output11 = combineQuadrants(car, circles, pattern1, text1);
+    Image output11 = combineQuadrants(*car, *circles, *pattern1, *text1);
     output11.write(OUTPUT_PATH + std::string{"output11"} + FILE_EXT);
-    outputs.push_back(&output11);
+    outputs.push_back({&output11, "output11"});
 
     std::cout << "Done." << std::endl;
 
     std::cout << "Loading Test Files... ";
-    Image test1{TEST_PATH + std::string{"test1"} + FILE_EXT};
-    Image test2{TEST_PATH + std::string{"test2"} + FILE_EXT};
-    Image test3{TEST_PATH + std::string{"test3"} + FILE_EXT};
-    Image test4{TEST_PATH + std::string{"test4"} + FILE_EXT};
-    Image test5{TEST_PATH + std::string{"test5"} + FILE_EXT};
-    Image test6{TEST_PATH + std::string{"test6"} + FILE_EXT};
-    Image test7{TEST_PATH + std::string{"test7"} + FILE_EXT};
-    Image test8_b{TEST_PATH + std::string{"test8_b"} + FILE_EXT};
-    Image test8_g{TEST_PATH + std::string{"test8_g"} + FILE_EXT};
-    Image test8_r{TEST_PATH + std::string{"test8_r"} + FILE_EXT};
-    Image test9{TEST_PATH + std::string{"test9"} + FILE_EXT};
-    Image test10{TEST_PATH + std::string{"test10"} + FILE_EXT};
-    Image test11{TEST_PATH + std::string{"test11"} + FILE_EXT};
+    SharedImage test1 = loader.load(testFile("test1")).get();
+    SharedImage test2 = loader.load(testFile("test2")).get();
+    SharedImage test3 = loader.load(testFile("test3")).get();
+    SharedImage test4 = loader.load(testFile("test4")).get();
+    SharedImage test5 = loader.load(testFile("test5")).get();
+    SharedImage test6 = loader.load(testFile("test6")).get();
+    SharedImage test7 = loader.load(testFile("test7")).get();
+    SharedImage test8_b = loader.load(testFile("test8_b")).get();
+    SharedImage test8_g = loader.load(testFile("test8_g")).get();
+    SharedImage test8_r = loader.load(testFile("test8_r")).get();
+    SharedImage test9 = loader.load(testFile("test9")).get();
+    SharedImage test10 = loader.load(testFile("test10")).get();
+    SharedImage test11 = loader.load(testFile("test11")).get();
 
     std::cout << "Done." << std::endl;
 
     /* ANALYZE TEST CASES */
     std::cout << "Performing Tests... ";
-    std::vector<Image *> tests = {&test1, &test2, &test3, &test4, &test5, &test6, &test7,
-                                  &test8_r, &test8_g, &test8_b, &test9, &test10, &test11};
+    std::vector<SharedImage> tests = {test1, test2, test3, test4, test5, test6, test7,
+                                      test8_r, test8_g, test8_b, test9, test10, test11};
 
     std::string results;
     for (int i = 0; i < outputs.size(); ++i)
     {
-        bool passed = testCase(*outputs[i], *tests[i]);
+        bool passed = testCase(*outputs[i].first, *tests[i], outputs[i].second);
         results += (passed) ? "." : "F";
     }
 
+    std::cout << "Done." << std::endl;
+
+    /* CHECK FILE FORMATS AND LIBRARY BEHAVIOR */
+    std::cout << "Performing Checks... ";
+    results += checkTgaFormats() ? "." : "F";
+    results += checkTgaRoundTrips(output8_r) ? "." : "F";
+    results += checkRleRows() ? "." : "F";
+    results += checkMappedImages(*test6) ? "." : "F";
+    results += checkStreaming(*test1, *test6, *test9) ? "." : "F";
+    results += checkPlanarImages(*layer1, *pattern1, *car, *circles, *text1) ? "." : "F";
+    results += checkHighBitDepths(*layer1, *pattern2, *text1, *test3) ? "." : "F";
+    results += checkStatistics(*car) ? "." : "F";
+    results += checkBlendModes(*layer1, *pattern1) ? "." : "F";
+    results += checkFilters(*car) ? "." : "F";
+    results += checkResampling(*car) ? "." : "F";
+    results += checkTransforms(*car) ? "." : "F";
+    results += checkCompositing(*layer1, *pattern1, *circles) ? "." : "F";
+    results += checkWorkQueue(*test6, *test10) ? "." : "F";
+
     std::cout << "Done." << std::endl;
     std::cout << "----------------------------------------" << std::endl;
 
@@ -142,18 +255,541 @@ int main()
     return 0;
 }
 
-bool testCase(Image &test, Image &example)
+bool testCase(const Image &test, const Image &example, const std::string &name)
 {
-    for (int i = 0; i < test.pixels.size(); ++i)
+    if (imagesEqual(test, example))
+        return true;
+
+    Image heatmap{Header{}};
+    ImageDifference difference = compareImages(test, example, heatmap);
+    std::cout << "Error! " << name << " ";
+    if (!difference.sameSize)
     {
-        if (test.pixels[i] != example.pixels[i])
-        {
-            Pixel testPixel = test.pixels[i];
-            Pixel examplePixel = example.pixels[i];
-            std::cout << "Error! RGB pixels (" << testPixel.r << ", " << testPixel.g << ", " << testPixel.b << ") != (";
-            std::cout << examplePixel.r << ", " << examplePixel.g << ", " << examplePixel.b << ")" << std::endl;
+        std::cout << "is " << imageWidth(test.header) << "x" << imageHeight(test.header) << " instead of "
+                  << imageWidth(example.header) << "x" << imageHeight(example.header) << std::endl;
+        return false;
+    }
+    std::cout << "differs in " << difference.mismatchedPixels << " pixel(s): max error " << difference.maxAbsError
+              << ", PSNR " << difference.psnr << " dB" << std::endl;
+    heatmap.write(OUTPUT_PATH + name + "_diff" + FILE_EXT);
+    return false;
+}
+bool checkTgaFormats()
+{
+    auto formatFile = [](const std::string &name)
+    { return TEST_PATH "formats/" + name + FILE_EXT; };
+
+    // The color fixtures hold the same 5x3 image (colors exact in 5 bits); run-length packets cross rows
+    bool passed = true;
+    Image reference{formatFile("reference")};
+    for (const char *name : {"truecolor24_rle", "truecolor24_top", "truecolor24_right", "truecolor32", "truecolor16",
+                             "truecolor15_rle", "colormap8", "colormap8_rle"})
+        passed = testCase(Image{formatFile(name)}, reference, name) && passed;
+
+    Image grayReference{formatFile("gray_reference")};
+    for (const char *name : {"gray8", "gray8_rle"})
+        passed = testCase(Image{formatFile(name)}, grayReference, name) && passed;
+
+    // The raw decoder keeps the alpha channel of 32-bit files and the single channel of grayscale files
+    const unsigned char alpha[] = {255, 0, 128, 64, 255, 1, 2, 3, 4, 5, 200, 100, 50, 25, 0};
+    TgaRaster color = readTga(formatFile("truecolor32"));
+    bool alphaKept = color.channels == 4 && color.data.size() == sizeof(alpha) * 4;
+    for (std::size_t i = 0; alphaKept && i < sizeof(alpha); ++i)
+        alphaKept = color.data[i * 4 + 3] == alpha[i];
+    if (!alphaKept)
+    {
+        std::cout << "Error! truecolor32 does not keep its alpha channel" << std::endl;
+        passed = false;
+    }
+
+    TgaRaster gray = readTga(formatFile("gray8_rle"));
+    if (gray.channels != 1 || gray.data.size() != grayReference.pixels.size() || gray.data[0] != 10 || gray.data[14] != 50)
+    {
+        std::cout << "Error! gray8_rle does not decode to one channel" << std::endl;
+        passed = false;
+    }
+    return passed;
+}
+
+bool checkTgaRoundTrips(const Image &image)
+{
+    bool passed = true;
+    const std::pair<TgaEncoding, const char *> encodings[] = {{TgaEncoding::TrueColor, "truecolor"},
+                                                              {TgaEncoding::TrueColorRle, "truecolor_rle"},
+                                                              {TgaEncoding::Grayscale, "gray"},
+                                                              {TgaEncoding::GrayscaleRle, "gray_rle"}};
+    for (const auto &encoding : encodings)
+    {
+        std::string name = std::string{"roundtrip_"} + encoding.second;
+        image.write(OUTPUT_PATH + name + FILE_EXT, encoding.first);
+        passed = testCase(Image{OUTPUT_PATH + name + FILE_EXT}, image, name) && passed;
+    }
+    return passed;
+}
+
+bool checkRleRows()
+{
+    // 130 equal pixels, 140 alternating ones, then 30 equal ones: runs and raw packets both overflow 128
+    const int width = 300;
+    std::vector<unsigned char> row(width * 3);
+    for (int x = 0; x < width; ++x)
+    {
+        unsigned char value = x < 130 ? 7 : x < 270 ? static_cast<unsigned char>(x % 2 ? 100 : 200) : 50;
+        std::memset(row.data() + x * 3, value, 3);
+        row[x * 3 + 2] = static_cast<unsigned char>(x < 130 || x >= 270 ? 0 : x);
+    }
+
+    std::vector<unsigned char> encoded;
+    encodeRleRow(row.data(), width, 3, encoded);
+
+    // Runs of 128 and 2, raw packets of 128 and 12, then a run of 30
+    const std::size_t expectedSize = (1 + 3) + (1 + 3) + (1 + 128 * 3) + (1 + 12 * 3) + (1 + 3);
+    bool passed = encoded.size() == expectedSize && encoded[0] == 0xFF && encoded[4] == 0x81 && encoded[8] == 0x7F &&
+                  encoded[8 + 1 + 128 * 3] == 11 && encoded[expectedSize - 4] == 0x80 + 29;
+
+    Header header{};
+    header.width = width;
+    header.height = 1;
+    TgaDecoder decoder{tgaHeader(header, 3, true)};
+    std::vector<unsigned char> decoded(row.size());
+    const unsigned char *in = encoded.data();
+    passed = decoder.decode(in, encoded.data() + encoded.size(), decoded.data(), width) == width &&
+             in == encoded.data() + encoded.size() && decoded == row && passed;
+    if (!passed)
+        std::cout << "Error! encodeRleRow does not split or restore a 300-pixel row" << std::endl;
+    return passed;
+}
+
+bool checkMappedImages(const Image &example)
+{
+    // The operation reads the mapped input and writes the mapped output, with no Image in between
+    std::string file = OUTPUT_PATH + std::string{"mapped6"} + FILE_EXT;
+    {
+        const MappedImage car{INPUT_PATH + std::string{"car"} + FILE_EXT};
+        MappedImage output{file, car.header};
+        add(view(car), view(output), 0, 200, 0);
+        if (!testCase(output.toImage(), example, "mapped6"))
             return false;
+    }
+    bool passed = testCase(Image{file}, example, "mapped6_file");
+
+    // A header describing an image ID and a color map (as a mapped file may keep) still gives a readable file
+    Header withId = example.header;
+    withId.idLength = 5;
+    withId.colorMapType = 1;
+    withId.colorMapLength = 4;
+    withId.colorMapDepth = 24;
+    std::string copy = OUTPUT_PATH + std::string{"mapped6_id"} + FILE_EXT;
+    {
+        MappedImage output{copy, withId};
+        paste(view(example), view(output));
+    }
+    return testCase(Image{copy}, example, "mapped6_id") && passed;
+}
+
+bool checkStreaming(const Image &example1, const Image &example6, const Image &example9)
+{
+    // Odd chunk heights leave a partial chunk at the top of every image
+    auto input = [](const char *name)
+    { return INPUT_PATH + std::string{name} + FILE_EXT; };
+    std::string file = OUTPUT_PATH + std::string{"streamed"} + FILE_EXT;
+
+    streamMultiplyMode(input("layer1"), input("pattern1"), file, 5);
+    bool passed = testCase(Image{file}, example1, "streamed1");
+    streamAdd(input("car"), file, 0, 200, 0, 7);
+    passed = testCase(Image{file}, example6, "streamed6") && passed;
+    streamCombineChannels(input("layer_red"), input("layer_green"), input("layer_blue"), file, 3);
+    passed = testCase(Image{file}, example9, "streamed9") && passed;
+    return passed;
+}
+
+bool checkPlanarImages(const Image &layer, const Image &pattern, const Image &car, const Image &circles,
+                       const Image &text)
+{
+    PlanarImage planarLayer{layer};
+    PlanarImage planarPattern{pattern};
+    PlanarImage planarCar{car};
+    bool passed = testCase(planarCar.toImage(), car, "planarCopy");
+    passed = testCase(multiplyMode(planarLayer, planarPattern).toImage(), multiplyMode(layer, pattern),
+                      "planarMultiply") && passed;
+    passed = testCase(screenMode(planarLayer, planarPattern).toImage(), screenMode(layer, pattern), "planarScreen") &&
+             passed;
+    passed = testCase(overlayMode(planarLayer, planarPattern).toImage(), overlayMode(layer, pattern),
+                      "planarOverlay") && passed;
+    passed = testCase(subtractMode(planarLayer, planarCar).toImage(), subtractMode(layer, car), "planarSubtract") &&
+             passed;
+    passed = testCase(add(planarCar, 0, 200, 0).toImage(), add(car, 0, 200, 0), "planarAdd") && passed;
+    passed = testCase(scale(planarCar, 4, 1, 0).toImage(), scale(car, 4, 1, 0), "planarScale") && passed;
+
+    PlanarImage red = extractRed(planarCar);
+    PlanarImage green = extractGreen(planarCar);
+    PlanarImage blue = extractBlue(planarCar);
+    passed = testCase(red.toImage(), extractRed(car), "planarRed") && passed;
+    passed = testCase(green.toImage(), extractGreen(car), "planarGreen") && passed;
+    passed = testCase(blue.toImage(), extractBlue(car), "planarBlue") && passed;
+    passed = testCase(combineChannels(red, green, blue).toImage(), car, "planarCombine") && passed;
+    passed = testCase(rotate180(planarCar).toImage(), rotate180(car), "planarRotate") && passed;
+    passed = testCase(combineQuadrants(planarCar, PlanarImage{circles}, planarPattern, PlanarImage{text}).toImage(),
+                      combineQuadrants(car, circles, pattern, text), "planarQuadrants") && passed;
+
+    // Quadrants of 32767 pixels still fit in a .tga header (65534 pixels); wider ones are rejected
+    Header header{};
+    header.width = 0x7FFF;
+    header.height = 1;
+    PlanarImage widest{header};
+    passed = combineQuadrants(widest, widest, widest, widest).width() == 0xFFFE && passed;
+    header.width = static_cast<short>(0x8000);
+    PlanarImage tooWide{header};
+    try
+    {
+        combineQuadrants(tooWide, tooWide, tooWide, tooWide);
+        std::cout << "Error! combineQuadrants accepted quadrants of 32768 pixels" << std::endl;
+        passed = false;
+    }
+    catch (const std::runtime_error &)
+    {
+    }
+    return passed;
+}
+
+bool nearlyEqual(const Image &test, const Image &example, int tolerance, const std::string &name)
+{
+    ImageDifference difference = compareImages(test, example);
+    if (difference.sameSize && difference.maxAbsError <= tolerance)
+        return true;
+    std::cout << "Error! " << name << " differs by up to " << difference.maxAbsError << std::endl;
+    return false;
+}
+
+template <typename T>
+bool checkHighBitDepth(const Image &layer, const Image &pattern, const Image &text, const Image &example3,
+                       const std::string &name)
+{
+    BasicImage<T> wideLayer{layer};
+    BasicImage<T> widePattern{pattern};
+    bool passed = testCase(wideLayer.toImage(), layer, name + "RoundTrip");
+    passed = nearlyEqual(multiplyMode(wideLayer, widePattern).toImage(), multiplyMode(layer, pattern), 1,
+                         name + "Multiply") && passed;
+    passed = nearlyEqual(overlayMode(wideLayer, widePattern).toImage(), overlayMode(layer, pattern), 1,
+                         name + "Overlay") && passed;
+
+    // Test 3 as a chain, rounded once at the end
+    BasicImage<T> chained = screenMode(BasicImage<T>{text}, multiplyMode(wideLayer, widePattern));
+    return nearlyEqual(chained.toImage(), example3, 1, name + "Chain") && passed;
+}
+
+bool checkHighBitDepths(const Image &layer, const Image &pattern, const Image &text, const Image &example3)
+{
+    bool passed = checkHighBitDepth<std::uint16_t>(layer, pattern, text, example3, "image16");
+    return checkHighBitDepth<float>(layer, pattern, text, example3, "imageFloat") && passed;
+}
+
+bool checkStatistics(const Image &image)
+{
+    bool passed = true;
+
+    // Every pixel lands in each histogram once, and the means match a direct sum
+    ImageStatistics statistics = imageStatistics(image);
+    const std::pair<const ChannelStatistics *, unsigned char Pixel::*> channels[] = {
+        {&statistics.red, &Pixel::r}, {&statistics.green, &Pixel::g}, {&statistics.blue, &Pixel::b}};
+    for (const auto &channel : channels)
+    {
+        std::uint64_t counted = 0;
+        for (std::uint64_t count : channel.first->histogram)
+            counted += count;
+        double sum = 0.0;
+        int min = 255, max = 0;
+        for (const Pixel &pixel : image.pixels)
+        {
+            int value = pixel.*channel.second;
+            sum += value;
+            min = std::min(min, value);
+            max = std::max(max, value);
+        }
+        double mean = sum / image.pixels.size();
+        if (counted != image.pixels.size() || channel.first->count != image.pixels.size() ||
+            std::abs(channel.first->mean - mean) > 1e-9 || channel.first->min != min || channel.first->max != max)
+        {
+            std::cout << "Error! imageStatistics counted " << counted << " value(s) with mean " << channel.first->mean
+                      << " instead of " << image.pixels.size() << " with mean " << mean << std::endl;
+            passed = false;
+        }
+    }
+
+    // The full range is the identity, and a flat image has no spread to stretch (linked, its channels must agree)
+    passed = testCase(levels(image, 0, 255), image, "levelsIdentity") && passed;
+    Image flat{image.header};
+    fill(view(flat), Pixel{40, 140, 220});
+    passed = testCase(autoLevels(flat), flat, "autoLevelsFlat") && passed;
+    fill(view(flat), Pixel{90, 90, 90});
+    passed = testCase(autoLevels(flat, 1.0, true), flat, "autoLevelsFlatLinked") && passed;
+    return passed;
+}
+
+Image blendReference(unsigned char (*blend)(unsigned char, unsigned char), const Image &top, const Image &bottom)
+{
+    Image result{top.header};
+    for (std::size_t i = 0; i < top.pixels.size(); ++i)
+        result.pixels[i] = Pixel{blend(top.pixels[i].r, bottom.pixels[i].r), blend(top.pixels[i].g, bottom.pixels[i].g),
+                                 blend(top.pixels[i].b, bottom.pixels[i].b)};
+    return result;
+}
+
+bool checkBlendModes(const Image &top, const Image &bottom)
+{
+    bool passed = true;
+    const std::pair<const char *, unsigned char (*)(unsigned char, unsigned char)> modes[] = {
+        {"multiply", multiplyBlend},
+        {"screen", screenBlend},
+        {"overlay", overlayBlend},
+        {"subtract", subtractBlend},
+        {"darken", darkenBlend},
+        {"lighten", lightenBlend},
+        {"difference", differenceBlend},
+        {"softLight", softLightBlend}};
+    for (const auto &mode : modes)
+        passed = testCase(blendMode(mode.first, top, bottom), blendReference(mode.second, top, bottom), mode.first) &&
+                 passed;
+
+    // The named shortcuts run the same tables
+    passed = testCase(darkenMode(top, bottom), blendReference(darkenBlend, top, bottom), "darkenMode") && passed;
+    passed = testCase(lightenMode(top, bottom), blendReference(lightenBlend, top, bottom), "lightenMode") && passed;
+    passed = testCase(differenceMode(top, bottom), blendReference(differenceBlend, top, bottom), "differenceMode") &&
+             passed;
+    passed = testCase(softLightMode(top, bottom), blendReference(softLightBlend, top, bottom), "softLightMode") &&
+             passed;
+
+    // A registered mode is found by name, from a function or from a table
+    auto average = [](unsigned char a, unsigned char b)
+    { return static_cast<unsigned char>((a + b + 1) / 2); };
+    registerBlendMode("checkAverage", average);
+    registerBlendMode("checkDarken", blendTable("darken"));
+    passed = testCase(blendMode("checkAverage", top, bottom), blendReference(average, top, bottom), "checkAverage") &&
+             passed;
+    passed = testCase(blendMode("checkDarken", top, bottom), blendReference(darkenBlend, top, bottom), "checkDarken") &&
+             passed;
+    std::vector<std::string> names = blendModeNames();
+    if (std::find(names.begin(), names.end(), "checkAverage") == names.end())
+    {
+        std::cout << "Error! blendModeNames does not list a registered mode" << std::endl;
+        passed = false;
+    }
+    return passed;
+}
+
+bool checkFilters(const Image &image)
+{
+    bool passed = true;
+
+    // A radius or sigma of 0 and a one-tap kernel copy the image; filtering in place gives the same output
+    passed = testCase(boxBlur(image, 0), image, "box0") && passed;
+    passed = testCase(gaussianBlur(image, 0), image, "gaussian0") && passed;
+    passed = testCase(convolveSeparable(image, {0, 1, 0}, {1}, EdgeMode::Reflect), image, "identityKernel") && passed;
+    Image inPlace = image;
+    boxBlur(inPlace, inPlace, 3);
+    passed = testCase(inPlace, boxBlur(image, 3), "box3InPlace") && passed;
+
+    // A flat image stays flat under every blur, whatever the edge mode
+    Image flat{image.header};
+    fill(view(flat), Pixel{90, 160, 230});
+    passed = testCase(boxBlur(flat, 7, EdgeMode::Reflect), flat, "flatBox") && passed;
+    passed = testCase(gaussianBlur(flat, 1.5), flat, "flatGaussian") && passed;
+    passed = testCase(gaussianBlur(flat, 6, EdgeMode::Reflect), flat, "flatGaussianBoxes") && passed;
+    passed = testCase(unsharpMask(flat, 2, 1.5), flat, "flatUnsharp") && passed;
+
+    // A box blur is the exact mean of the clamped neighbourhood: 0 0 90 | 0 90 255 | 90 255 255
+    Header header{};
+    header.dataTypeCode = 2;
+    header.bitsPerPixel = 24;
+    header.width = 3;
+    header.height = 1;
+    Image row{header};
+    row.pixels = {Pixel{0, 0, 0}, Pixel{90, 90, 90}, Pixel{255, 255, 255}};
+    Image expected{header};
+    expected.pixels = {Pixel{30, 30, 30}, Pixel{115, 115, 115}, Pixel{200, 200, 200}};
+    passed = testCase(boxBlur(row, 1), expected, "boxMean") && passed;
+    return passed;
+}
+
+bool checkResampling(const Image &image)
+{
+    bool passed = true;
+    int width = imageWidth(image.header);
+    int height = imageHeight(image.header);
+
+    // Resizing to the same size keeps the image with every filter
+    const std::pair<ResampleFilter, const char *> filters[] = {{ResampleFilter::Nearest, "resizeNearest"},
+                                                               {ResampleFilter::Bilinear, "resizeBilinear"},
+                                                               {ResampleFilter::Area, "resizeArea"},
+                                                               {ResampleFilter::Lanczos, "resizeLanczos"}};
+    for (const auto &filter : filters)
+        passed = testCase(resize(image, width, height, filter.first), image, filter.second) && passed;
+
+    // A flat image stays flat at any size
+    Image flat{image.header};
+    fill(view(flat), Pixel{200, 40, 120});
+    Image smallFlat = resize(flat, 37, 21);
+    Image expectedFlat{smallFlat.header};
+    fill(view(expectedFlat), Pixel{200, 40, 120});
+    passed = testCase(smallFlat, expectedFlat, "flatLanczos") && passed;
+    passed = testCase(resize(flat, width / 2, height / 2, ResampleFilter::Bilinear), downscale2x(flat), "flatHalf") &&
+             passed;
+
+    // Area shrinking by two averages the same blocks as downscale2x, and mipmaps chain downscale2x down to 1x1
+    Image half = downscale2x(image);
+    passed = testCase(resize(image, width / 2, height / 2, ResampleFilter::Area), half, "areaHalf") && passed;
+    std::vector<Image> levels = buildMipmaps(image);
+    passed = testCase(levels.front(), half, "mipmap1") && passed;
+    passed = testCase(levels[1], downscale2x(half), "mipmap2") && passed;
+    if (imageWidth(levels.back().header) != 1 || imageHeight(levels.back().header) != 1 ||
+        buildMipmaps(image, 3).size() != 3)
+    {
+        std::cout << "Error! buildMipmaps does not stop at 1x1 or at the requested level" << std::endl;
+        passed = false;
+    }
+
+    // Thumbnails keep the aspect ratio; images that already fit are copied
+    Image small = thumbnail(image, 100, 50);
+    if (imageWidth(small.header) != width * 50 / height || imageHeight(small.header) != 50)
+    {
+        std::cout << "Error! thumbnail is " << imageWidth(small.header) << "x" << imageHeight(small.header) << std::endl;
+        passed = false;
+    }
+    passed = testCase(thumbnail(image, width, height * 2), image, "thumbnailFits") && passed;
+    return passed;
+}
+
+bool checkWorkQueue(const Image &example6, const Image &example10)
+{
+    namespace fs = std::filesystem;
+    fs::path root = OUTPUT_PATH + std::string{"queue"};
+    fs::remove_all(root);
+    fs::create_directories(root / "out");
+
+    QueueOptions options;
+    options.queueDirectory = (root / "jobs").string();
+    options.shardSize = 1;
+    std::string output6 = (root / "out" / "output6.tga").string();
+    std::string output10 = (root / "out" / "output10.tga").string();
+    std::vector<BatchJob> jobs = {{"add:0:200:0", INPUT_PATH + std::string{"car"} + FILE_EXT, output6},
+                                  {"rotate180", INPUT_PATH + std::string{"text2"} + FILE_EXT, output10}};
+    bool passed = createQueue(options.queueDirectory, jobs, options.shardSize) &&
+                  !createQueue(options.queueDirectory, jobs, options.shardSize);
+
+    // A claim whose worker holds no lease (it died) goes back to the queue as its next attempt
+    fs::path queue{options.queueDirectory};
+    std::error_code error;
+    fs::rename(queue / "pending" / "00000000.0", queue / "claimed" / "00000000.0.999999", error);
+    passed = !error && requeueClaims(options.queueDirectory, options.maxAttempts) == 1 &&
+             fs::exists(queue / "pending" / "00000000.1") && passed;
+
+    std::ostringstream log;
+    BatchResult result = runWorker(options, log);
+    QueueProgress progress = queueProgress(options.queueDirectory);
+    passed = result.succeeded == 2 && result.failed == 0 && progress.done == 2 && progress.pending == 0 &&
+             progress.claimed == 0 && progress.written == 2 && passed;
+    if (!passed)
+        std::cout << "Error! The queue did not process its shards: " << log.str() << std::endl;
+    passed = testCase(Image{output6}, example6, "queue6") && passed;
+    passed = testCase(Image{output10}, example10, "queue10") && passed;
+
+    // A new queue for the same outputs skips them
+    options.queueDirectory = (root / "rerun").string();
+    createQueue(options.queueDirectory, jobs, options.shardSize);
+    result = runWorker(options, log);
+    if (result.skipped != 2 || result.succeeded != 0)
+    {
+        std::cout << "Error! A rerun queue wrote " << result.succeeded << " existing output(s)" << std::endl;
+        passed = false;
+    }
+    return passed;
+}
+
+bool checkTransforms(const Image &image)
+{
+    bool passed = true;
+
+    // The square image and an odd-sized crop of it (partial tiles along both edges)
+    Image odd = crop(image, 5, 9, 301, 173);
+    const Image *sources[] = {&image, &odd};
+    for (const Image *source : sources)
+    {
+        std::string size = std::to_string(imageWidth(source->header)) + "x" + std::to_string(imageHeight(source->header));
+        passed = testCase(rotate90(rotate90(rotate90(rotate90(*source)))), *source, "rotate90x4_" + size) && passed;
+        passed = testCase(rotate270(rotate90(*source)), *source, "rotate270_" + size) && passed;
+        passed = testCase(transpose(transpose(*source)), *source, "transpose_" + size) && passed;
+        passed = testCase(flipHorizontal(flipVertical(*source)), rotate180(*source), "flips_" + size) && passed;
+    }
+
+    // Clockwise: the left pixel of a 2x1 image ends up on top (rows are stored bottom-up)
+    Header header{};
+    header.dataTypeCode = 2;
+    header.bitsPerPixel = 24;
+    header.width = 2;
+    header.height = 1;
+    Image pair{header};
+    pair.pixels = {Pixel{255, 0, 0}, Pixel{0, 0, 255}};
+    header.width = 1;
+    header.height = 2;
+    Image turned{header};
+    turned.pixels = {Pixel{0, 0, 255}, Pixel{255, 0, 0}};
+    passed = testCase(rotate90(pair), turned, "rotate90Clockwise") && passed;
+    return passed;
+}
+
+bool checkCompositing(const Image &top, const Image &bottom, const Image &mask)
+{
+    bool passed = true;
+
+    // Between opaque layers the alpha-aware modes give exactly the bytes of the RGB blends
+    ImageRGBA opaqueTop{top};
+    ImageRGBA opaqueBottom{bottom};
+    passed = testCase(flatten(multiplyMode(opaqueTop, opaqueBottom)), multiplyMode(top, bottom), "opaqueMultiply") &&
+             passed;
+    passed = testCase(flatten(screenMode(opaqueTop, opaqueBottom)), screenMode(top, bottom), "opaqueScreen") && passed;
+    passed = testCase(flatten(overlayMode(opaqueTop, opaqueBottom)), overlayMode(top, bottom), "opaqueOverlay") &&
+             passed;
+    passed = testCase(overMode(opaqueTop, bottom), top, "opaqueOver") && passed;
+
+    // A layer whose coverage follows the mask matches the scalar formulas in every mode, alpha included
+    ImageRGBA layer = withAlpha(top, mask);
+    const std::pair<CompositeMode, unsigned char (*)(unsigned char, unsigned char, unsigned char, unsigned char)>
+        modes[] = {{CompositeMode::Over, overComposite},
+                   {CompositeMode::In, inComposite},
+                   {CompositeMode::Out, outComposite},
+                   {CompositeMode::Multiply, multiplyComposite},
+                   {CompositeMode::Screen, screenComposite},
+                   {CompositeMode::Overlay, overlayComposite}};
+    for (std::size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m)
+    {
+        ImageRGBA result = composite(modes[m].first, layer, opaqueBottom);
+        std::size_t mismatched = 0;
+        for (std::size_t i = 0; i < layer.pixels.size(); ++i)
+        {
+            const PixelRGBA &t = layer.pixels[i];
+            const PixelRGBA &b = opaqueBottom.pixels[i];
+            auto op = modes[m].second;
+            PixelRGBA expected{op(t.r, b.r, t.a, b.a), op(t.g, b.g, t.a, b.a), op(t.b, b.b, t.a, b.a),
+                               op(t.a, b.a, t.a, b.a)};
+            mismatched += result.pixels[i] != expected;
+        }
+        if (mismatched)
+        {
+            std::cout << "Error! composite mode " << m << " differs from its formula in " << mismatched << " pixel(s)"
+                      << std::endl;
+            passed = false;
         }
     }
-    return true;
-}
\ No newline at end of file
+
+    // Over an opaque RGB image, through the opaque-bottom kernel
+    Image expected{bottom.header};
+    for (std::size_t i = 0; i < layer.pixels.size(); ++i)
+    {
+        const PixelRGBA &t = layer.pixels[i];
+        const Pixel &b = bottom.pixels[i];
+        expected.pixels[i] = Pixel{overComposite(t.r, b.r, t.a, 0xFF), overComposite(t.g, b.g, t.a, 0xFF),
+                                   overComposite(t.b, b.b, t.a, 0xFF)};
+    }
+    passed = testCase(overMode(layer, bottom), expected, "translucentOver") && passed;
+    return passed;
+}
@@ -0,0 +1,140 @@
+#include "mappedfile.h"
+
+#include <stdexcept>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAPPEDFILE_POSIX 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define MAPPEDFILE_POSIX 0
+#include <fstream>
+#endif
+
+MappedFile::MappedFile(const std::string &file, MapMode mode) : path{file}, mapMode{mode}
+{
+#if MAPPEDFILE_POSIX
+    int fd = ::open(file.c_str(), mode == MapMode::ReadWrite ? O_RDWR : O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("ERROR: File \"" + file + "\" not found.");
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0)
+    {
+        ::close(fd);
+        throw std::runtime_error("ERROR: Could not query the size of \"" + file + "\".");
+    }
+
+    length = static_cast<std::size_t>(info.st_size);
+    if (length > 0)
+    {
+        int protection = (mode == MapMode::ReadOnly) ? PROT_READ : PROT_READ | PROT_WRITE;
+        int flags = (mode == MapMode::ReadWrite) ? MAP_SHARED : MAP_PRIVATE;
+        void *mapping = ::mmap(nullptr, length, protection, flags, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            ::close(fd);
+            throw std::runtime_error("ERROR: Could not map \"" + file + "\".");
+        }
+        bytes = static_cast<unsigned char *>(mapping);
+
+        // Pixel data is consumed front to back
+        ::madvise(mapping, length, MADV_SEQUENTIAL);
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    ::close(fd);
+#else
+    std::ifstream stream{file, std::ios_base::binary | std::ios_base::ate};
+    if (!stream.is_open())
+        throw std::runtime_error("ERROR: File \"" + file + "\" not found.");
+
+    fallback.resize(static_cast<std::size_t>(stream.tellg()));
+    stream.seekg(0);
+    stream.read(reinterpret_cast<char *>(fallback.data()), fallback.size());
+    bytes = fallback.data();
+    length = fallback.size();
+#endif
+}
+
+MappedFile::MappedFile(const std::string &file, std::size_t size) : path{file}, length{size}, mapMode{MapMode::ReadWrite}
+{
+#if MAPPEDFILE_POSIX
+    int fd = ::open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::runtime_error("ERROR: File \"" + file + "\" could not be created.");
+
+    // Pre-size the file so the whole mapping is backed by it
+    if (::ftruncate(fd, static_cast<off_t>(size)) != 0)
+    {
+        ::close(fd);
+        throw std::runtime_error("ERROR: Could not resize \"" + file + "\".");
+    }
+
+    if (size > 0)
+    {
+        void *mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            ::close(fd);
+            throw std::runtime_error("ERROR: Could not map \"" + file + "\".");
+        }
+        bytes = static_cast<unsigned char *>(mapping);
+    }
+    ::close(fd);
+#else
+    fallback.resize(size);
+    bytes = fallback.data();
+#endif
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : path{std::move(other.path)}, bytes{other.bytes}, length{other.length}, mapMode{other.mapMode},
+      fallback{std::move(other.fallback)}
+{
+    other.bytes = nullptr;
+    other.length = 0;
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        path = std::move(other.path);
+        bytes = other.bytes;
+        length = other.length;
+        mapMode = other.mapMode;
+        fallback = std::move(other.fallback);
+        other.bytes = nullptr;
+        other.length = 0;
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    release();
+}
+
+void MappedFile::release()
+{
+    if (bytes == nullptr)
+        return;
+
+#if MAPPEDFILE_POSIX
+    ::munmap(bytes, length);
+#else
+    if (mapMode == MapMode::ReadWrite)
+    {
+        std::ofstream stream{path, std::ios_base::binary};
+        stream.write(reinterpret_cast<const char *>(fallback.data()), fallback.size());
+    }
+    fallback.clear();
+#endif
+    bytes = nullptr;
+    length = 0;
+}
@@ -0,0 +1,67 @@
+#include "mappedimage.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "tga.h"
+
+namespace
+{
+    std::size_t pixelCount(const Header &header)
+    {
+        return static_cast<std::size_t>(imageWidth(header)) * imageHeight(header);
+    }
+}
+
+MappedImage::MappedImage(const std::string &file, MapMode mode) : file{file, mode}
+{
+    if (this->file.size() < HEADER_SIZE)
+        throw std::runtime_error("ERROR: File \"" + file + "\" is not a valid .tga file.");
+
+    header = parseHeader(this->file.data());
+    if (header.dataTypeCode != 2 || header.bitsPerPixel != 24 || tgaTopOrigin(header) || tgaRightOrigin(header))
+        throw std::runtime_error("ERROR: File \"" + file + "\" is not an uncompressed, bottom-left 24-bit .tga file and cannot be mapped.");
+
+    // Skip the optional image ID and color map to reach the pixel payload
+    std::size_t offset = HEADER_SIZE + tgaPayloadOffset(header);
+
+    count = pixelCount(header);
+    if (offset + count * sizeof(Pixel) > this->file.size())
+        throw std::runtime_error("ERROR: File \"" + file + "\" is truncated.");
+
+    // Pixel is a packed BGR byte triple, so the payload can be used in place
+    data = reinterpret_cast<Pixel *>(this->file.data() + offset);
+}
+
+MappedImage::MappedImage(const std::string &file, const Header &header)
+    : header{tgaHeader(header, 3, false)}, file{file, HEADER_SIZE + pixelCount(header) * sizeof(Pixel)},
+      count{pixelCount(header)}
+{
+    // The pixels follow the header directly, so the file cannot keep an image ID or color map of `header`
+    serializeHeader(this->header, this->file.data());
+    data = reinterpret_cast<Pixel *>(this->file.data() + HEADER_SIZE);
+}
+
+Pixel *MappedImage::mutablePixels()
+{
+    if (file.mode() == MapMode::ReadOnly)
+        throw std::runtime_error("ERROR: The pixels of a read-only mapped image cannot be modified.");
+    return data;
+}
+
+Image MappedImage::toImage() const
+{
+    // The owning image carries no image ID or color map
+    Image image{tgaHeader(header, 3, false)};
+    std::memcpy(image.pixels.data(), data, count * sizeof(Pixel));
+    return image;
+}
+
+void writeMapped(const Image &image, const std::string &file)
+{
+    if (pixelCount(image.header) != image.pixels.size())
+        throw std::runtime_error("ERROR: The header of the image does not match its number of pixels.");
+
+    MappedImage output{file, image.header};
+    std::memcpy(output.mutablePixels(), image.pixels.data(), image.pixels.size() * sizeof(Pixel));
+}
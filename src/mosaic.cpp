@@ -0,0 +1,143 @@
+#include "mosaic.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "threadpool.h"
+#include "trace.h"
+
+namespace
+{
+    /// @brief The part of a tile that lands on the canvas.
+    struct ClippedTile
+    {
+        const Pixel *source; // First visible pixel of the tile's first visible row
+        Pixel *destination;  // Where that pixel goes on the canvas
+        int sourceWidth;     // Row length of the tile image
+        int columns;         // Visible pixels per row
+        int rows;            // Visible rows
+    };
+}
+
+Header mosaicHeader(int width, int height)
+{
+    if (width < 0 || height < 0 || width > 0xFFFF || height > 0xFFFF)
+        throw std::runtime_error("ERROR: A .tga image cannot be larger than 65535x65535 pixels.");
+
+    Header header{};
+    header.dataTypeCode = 2;
+    header.bitsPerPixel = 24;
+    header.width = static_cast<short>(width);
+    header.height = static_cast<short>(height);
+    return header;
+}
+
+MosaicLayout gridLayout(const std::vector<const Image *> &images, int columns, int spacing)
+{
+    if (columns < 1)
+        throw std::runtime_error("ERROR: A grid needs at least one column.");
+    if (spacing < 0)
+        throw std::runtime_error("ERROR: Grid spacing cannot be negative.");
+
+    int rows = static_cast<int>((images.size() + columns - 1) / columns);
+    std::vector<int> columnWidths(columns, 0);
+    std::vector<int> rowHeights(rows, 0);
+    for (std::size_t i = 0; i < images.size(); ++i)
+    {
+        int &columnWidth = columnWidths[i % columns];
+        int &rowHeight = rowHeights[i / columns];
+        columnWidth = std::max(columnWidth, imageWidth(images[i]->header));
+        rowHeight = std::max(rowHeight, imageHeight(images[i]->header));
+    }
+
+    // Cell edges: x from the left, top from the top of the canvas
+    std::vector<int> left(columns + 1, 0);
+    std::vector<int> top(rows + 1, 0);
+    for (int c = 0; c < columns; ++c)
+        left[c + 1] = left[c] + columnWidths[c] + spacing;
+    for (int r = 0; r < rows; ++r)
+        top[r + 1] = top[r] + rowHeights[r] + spacing;
+
+    MosaicLayout layout;
+    layout.width = images.empty() ? 0 : left[std::min<std::size_t>(columns, images.size())] - spacing;
+    layout.height = images.empty() ? 0 : top[rows] - spacing;
+    for (std::size_t i = 0; i < images.size(); ++i)
+    {
+        int column = static_cast<int>(i % columns);
+        int row = static_cast<int>(i / columns);
+        int y = layout.height - top[row] - imageHeight(images[i]->header);
+        layout.tiles.push_back({images[i], left[column], y});
+    }
+    return layout;
+}
+
+void composeMosaic(const std::vector<MosaicTile> &tiles, Image &result)
+{
+    IP_TRACE_SCOPE("composeMosaic");
+    int width = imageWidth(result.header);
+    int height = imageHeight(result.header);
+    if (result.pixels.size() != static_cast<std::size_t>(width) * height)
+        throw std::runtime_error("ERROR: The mosaic canvas does not match its header.");
+
+    // Clip every tile, and number the visible rows of all tiles consecutively so bands can span tiles
+    std::vector<ClippedTile> clipped;
+    std::vector<std::size_t> firstRow{0};
+    for (const MosaicTile &tile : tiles)
+    {
+        if (tile.image == &result)
+            throw std::runtime_error("ERROR: A mosaic cannot contain its own canvas.");
+
+        int tileWidth = imageWidth(tile.image->header);
+        int tileHeight = imageHeight(tile.image->header);
+        int left = std::max(tile.x, 0);
+        int bottom = std::max(tile.y, 0);
+        int right = std::min(tile.x + tileWidth, width);
+        int top = std::min(tile.y + tileHeight, height);
+        if (left >= right || bottom >= top)
+            continue;
+
+        const Pixel *source = tile.image->pixels.data() + static_cast<std::size_t>(bottom - tile.y) * tileWidth + (left - tile.x);
+        Pixel *destination = result.pixels.data() + static_cast<std::size_t>(bottom) * width + left;
+        clipped.push_back({source, destination, tileWidth, right - left, top - bottom});
+        firstRow.push_back(firstRow.back() + (top - bottom));
+    }
+    if (clipped.empty())
+        return;
+
+    // Bands of rows weighted by the widest visible tile, so a band holds roughly PIXEL_GRAIN pixels
+    int widest = 0;
+    for (const ClippedTile &tile : clipped)
+        widest = std::max(widest, tile.columns);
+    std::size_t grain = PIXEL_GRAIN / widest + 1;
+
+    parallelFor(firstRow.back(), grain, [&](std::size_t begin, std::size_t end)
+                {
+                    std::size_t index = std::upper_bound(firstRow.begin(), firstRow.end(), begin) - firstRow.begin() - 1;
+                    for (std::size_t row = begin; row < end; ++index)
+                    {
+                        const ClippedTile &tile = clipped[index];
+                        std::size_t stop = std::min(end, firstRow[index + 1]);
+                        for (; row < stop; ++row)
+                        {
+                            std::size_t y = row - firstRow[index];
+                            std::memcpy(tile.destination + y * width, tile.source + y * tile.sourceWidth, tile.columns * sizeof(Pixel));
+                        }
+                    } });
+}
+
+Image composeMosaic(const MosaicLayout &layout, const Pixel &background)
+{
+    Image result{mosaicHeader(layout.width, layout.height)};
+    if (background.r || background.g || background.b)
+        parallelFor(result.pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                    { std::fill(result.pixels.begin() + begin, result.pixels.begin() + end, background); });
+
+    composeMosaic(layout.tiles, result);
+    return result;
+}
+
+Image contactSheet(const std::vector<const Image *> &images, int columns, int spacing, const Pixel &background)
+{
+    return composeMosaic(gridLayout(images, columns, spacing), background);
+}
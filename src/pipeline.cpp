@@ -0,0 +1,217 @@
+#include "pipeline.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "blendmodes.h"
+#include "imageprocessing.h"
+#include "threadpool.h"
+#include "trace.h"
+
+namespace
+{
+    // Pixels per fused chunk (3 KB per buffer, so every step of the chain stays in L1)
+    constexpr std::size_t CHUNK_PIXELS = 1024;
+}
+
+Pipeline::Pipeline(const Image &source) : source{&source} {}
+
+Pipeline &Pipeline::blendStep(void (*kernel)(const unsigned char *, const unsigned char *, unsigned char *, std::size_t),
+                              const Image &other, Layer current, const BlendTable *table)
+{
+    Step step{Step::Kind::Blend};
+    step.blend = kernel;
+    step.table = table;
+    step.other = &other;
+    step.current = current;
+    steps.push_back(std::move(step));
+    return *this;
+}
+
+Pipeline &Pipeline::multiplyMode(const Image &other, Layer current)
+{
+    return blendStep(multiplyKernel, other, current);
+}
+
+Pipeline &Pipeline::screenMode(const Image &other, Layer current)
+{
+    return blendStep(screenKernel, other, current);
+}
+
+Pipeline &Pipeline::overlayMode(const Image &other, Layer current)
+{
+    return blendStep(overlayKernel, other, current);
+}
+
+Pipeline &Pipeline::subtractMode(const Image &other, Layer current)
+{
+    return blendStep(subtractKernel, other, current);
+}
+
+Pipeline &Pipeline::blendMode(const std::string &mode, const Image &other, Layer current)
+{
+    BlendModeEntry entry = findBlendMode(mode);
+    return blendStep(entry.kernel, other, current, entry.table);
+}
+
+Pipeline &Pipeline::add(double r, double g, double b)
+{
+    return transform(ColorTransform{}.add(r, g, b));
+}
+
+Pipeline &Pipeline::scale(double r, double g, double b)
+{
+    return transform(ColorTransform{}.scale(r, g, b));
+}
+
+Pipeline &Pipeline::lut(const ChannelLuts &luts)
+{
+    return transform(ColorTransform{}.lut(luts));
+}
+
+Pipeline &Pipeline::extractRed()
+{
+    return transform(ColorTransform{}.extract(Channel::Red));
+}
+
+Pipeline &Pipeline::extractGreen()
+{
+    return transform(ColorTransform{}.extract(Channel::Green));
+}
+
+Pipeline &Pipeline::extractBlue()
+{
+    return transform(ColorTransform{}.extract(Channel::Blue));
+}
+
+Pipeline &Pipeline::transform(const ColorTransform &transform)
+{
+    // Compose with a color step right before, so the chunk goes through one compiled transform
+    if (!steps.empty() && steps.back().kind == Step::Kind::Color)
+    {
+        auto combined = std::make_shared<ColorTransform>(*steps.back().color);
+        combined->then(transform);
+        steps.back().color = std::move(combined);
+        return *this;
+    }
+
+    Step step{Step::Kind::Color};
+    step.color = std::make_shared<const ColorTransform>(transform);
+    steps.push_back(std::move(step));
+    return *this;
+}
+
+Pipeline &Pipeline::rotate180()
+{
+    return then([](const Image &image)
+                { return ::rotate180(image); });
+}
+
+Pipeline &Pipeline::combineQuadrants(const Image &second, const Image &third, const Image &fourth)
+{
+    return then([&second, &third, &fourth](const Image &image)
+                { return ::combineQuadrants(image, second, third, fourth); });
+}
+
+Pipeline &Pipeline::then(std::function<Image(const Image &)> operation)
+{
+    Step step{Step::Kind::Materialize};
+    step.operation = std::move(operation);
+    steps.push_back(std::move(step));
+    return *this;
+}
+
+Image Pipeline::evaluate() const
+{
+    Image result{Header{}};
+    evaluate(result);
+    return result;
+}
+
+void Pipeline::evaluate(Image &result) const
+{
+    IP_TRACE_SCOPE("Pipeline::evaluate");
+    // Split the steps into fused point-wise runs separated by materializing operations
+    std::size_t tail = steps.size();
+    while (tail > 0 && steps[tail - 1].kind != Step::Kind::Materialize)
+        --tail;
+
+    std::unique_ptr<Image> current;
+    std::size_t first = 0;
+    for (std::size_t i = 0; i < tail; ++i)
+    {
+        if (steps[i].kind != Step::Kind::Materialize)
+            continue;
+
+        if (i > first)
+        {
+            const Image &input = current ? *current : *source;
+            auto fused = std::make_unique<Image>(input.header);
+            fuse(input, first, i, *fused);
+            current = std::move(fused);
+        }
+        current = std::make_unique<Image>(steps[i].operation(current ? *current : *source));
+        first = i + 1;
+    }
+
+    // The last point-wise run (possibly empty) writes into the caller's image
+    if (current && first == steps.size())
+        result = std::move(*current);
+    else
+        fuse(current ? *current : *source, first, steps.size(), result);
+}
+
+void Pipeline::fuse(const Image &input, std::size_t first, std::size_t last, Image &result) const
+{
+    IP_TRACE_SCOPE("Pipeline::fuse");
+    IP_TRACE_COUNT(PixelsProcessed, input.pixels.size());
+    for (std::size_t i = first; i < last; ++i)
+        if (steps[i].kind == Step::Kind::Blend && steps[i].other->pixels.size() != input.pixels.size())
+            throw std::runtime_error("ERROR: Images must have the same number of pixels.");
+
+    prepareResult(input, result);
+
+    const unsigned char *in = reinterpret_cast<const unsigned char *>(input.pixels.data());
+    unsigned char *out = reinterpret_cast<unsigned char *>(result.pixels.data());
+
+    parallelFor(input.pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                {
+                    for (std::size_t chunk = begin; chunk < end; chunk += CHUNK_PIXELS)
+                    {
+                        std::size_t count = std::min(CHUNK_PIXELS, end - chunk);
+                        std::size_t offset = chunk * sizeof(Pixel);
+                        std::size_t bytes = count * sizeof(Pixel);
+
+                        // The first step reads the input; every later step works in place on the output chunk
+                        const unsigned char *value = in + offset;
+                        unsigned char *chunkOut = out + offset;
+                        if (first == last && value != chunkOut)
+                            std::memcpy(chunkOut, value, bytes);
+
+                        for (std::size_t i = first; i < last; ++i)
+                        {
+                            const Step &step = steps[i];
+                            switch (step.kind)
+                            {
+                            case Step::Kind::Blend:
+                            {
+                                const unsigned char *other = reinterpret_cast<const unsigned char *>(step.other->pixels.data()) + offset;
+                                const unsigned char *top = step.current == Layer::Top ? value : other;
+                                const unsigned char *bottom = step.current == Layer::Top ? other : value;
+                                if (step.blend)
+                                    step.blend(top, bottom, chunkOut, bytes);
+                                else
+                                    blendTableKernel(*step.table, top, bottom, chunkOut, bytes);
+                                break;
+                            }
+                            case Step::Kind::Color:
+                                step.color->apply(value, chunkOut, count);
+                                break;
+                            case Step::Kind::Materialize:
+                                break;
+                            }
+                            value = chunkOut;
+                        }
+                    } });
+}
@@ -9,7 +9,7 @@ void Pixel::update(unsigned char red, unsigned char green, unsigned char blue)
     b = blue;
 }
 
-bool Pixel::operator!=(const Pixel &rhs)
+bool Pixel::operator!=(const Pixel &rhs) const
 {
     return (r != rhs.r || g != rhs.g || b != rhs.b);
 }
\ No newline at end of file
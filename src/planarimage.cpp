@@ -0,0 +1,429 @@
+#include "planarimage.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#include "kernels.h"
+#include "threadpool.h"
+
+namespace
+{
+    using BlendKernel = void (*)(const unsigned char *, const unsigned char *, unsigned char *, std::size_t);
+
+    void checkSameSize(const PlanarImage &first, const PlanarImage &second)
+    {
+        if (first.width() != second.width() || first.height() != second.height())
+            throw std::runtime_error("ERROR: Images must have the same dimensions.");
+    }
+
+    /// @return The header of four `quadrant`-sized images side by side (twice its width and height).
+    Header quadrantsHeader(const PlanarImage &quadrant)
+    {
+        if (quadrant.width() > 0xFFFF / 2 || quadrant.height() > 0xFFFF / 2)
+            throw std::runtime_error("ERROR: A .tga image cannot be larger than 65535x65535 pixels.");
+
+        Header header = quadrant.header();
+        header.width = static_cast<short>(quadrant.width() * 2);
+        header.height = static_cast<short>(quadrant.height() * 2);
+        return header;
+    }
+
+    /// @brief Give `result` the size of `source` (reusing its allocation when large enough).
+    void prepare(const PlanarImage &source, PlanarImage &result)
+    {
+        if (&source != &result)
+            result.reshape(source.header());
+    }
+
+    /// @brief Run a blend kernel over all three planes at once; planes are contiguous, so this is one flat span.
+    void blend(BlendKernel kernel, const PlanarImage &top, const PlanarImage &bottom, PlanarImage &result)
+    {
+        checkSameSize(top, bottom);
+        prepare(top, result);
+
+        const unsigned char *topBytes = top.data();
+        const unsigned char *bottomBytes = bottom.data();
+        unsigned char *resultBytes = result.data();
+        parallelFor(3 * top.planeSize(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                    { kernel(topBytes + begin, bottomBytes + begin, resultBytes + begin, end - begin); });
+    }
+
+    /// @brief Map every plane through its own lookup table.
+    void transform(const PlanarImage &image, PlanarImage &result, const ChannelLuts &luts)
+    {
+        prepare(image, result);
+
+        const unsigned char *tables[3] = {luts.b, luts.g, luts.r};
+        std::size_t planeSize = image.planeSize();
+        const unsigned char *in = image.data();
+        unsigned char *out = result.data();
+        parallelFor(3 * planeSize, PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                    {
+                        // A band may straddle a plane boundary; switch tables there
+                        while (begin < end)
+                        {
+                            std::size_t channel = begin / planeSize;
+                            std::size_t stop = std::min(end, (channel + 1) * planeSize);
+                            const unsigned char *table = tables[channel];
+
+                            // Look up a group before storing it, so stores cannot stall the next loads (out may alias in)
+                            std::size_t i = begin;
+                            for (; i + 8 <= stop; i += 8)
+                            {
+                                unsigned char group[8];
+                                for (int k = 0; k < 8; ++k)
+                                    group[k] = table[in[i + k]];
+                                std::memcpy(out + i, group, 8);
+                            }
+                            for (; i < stop; ++i)
+                                out[i] = table[in[i]];
+                            begin = stop;
+                        } });
+    }
+
+    /// @brief Copy one plane of the image into all three planes of the result.
+    void extract(const PlanarImage &image, PlanarImage &result, int channel)
+    {
+        prepare(image, result);
+
+        const unsigned char *source = image.plane(channel);
+        parallelFor(image.planeSize(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                    {
+                        for (int c = 0; c < 3; ++c)
+                            if (result.plane(c) != source)
+                                std::memcpy(result.plane(c) + begin, source + begin, end - begin); });
+    }
+}
+
+PlanarImage::PlanarImage(const Header &header)
+{
+    reshape(header);
+}
+
+PlanarImage::PlanarImage(const Image &image)
+{
+    deinterleave(image, *this);
+}
+
+PlanarImage::PlanarImage(const PlanarImage &other)
+{
+    *this = other;
+}
+
+PlanarImage &PlanarImage::operator=(const PlanarImage &other)
+{
+    if (this != &other)
+    {
+        reshape(other.imageHeader);
+        if (planeSize() > 0)
+            std::memcpy(data(), other.data(), 3 * planeSize());
+    }
+    return *this;
+}
+
+PlanarImage::PlanarImage(PlanarImage &&other) noexcept
+    : imageHeader{std::exchange(other.imageHeader, Header{})}, rowStride{std::exchange(other.rowStride, 0)},
+      capacity{std::exchange(other.capacity, 0)}, storage{std::move(other.storage)}
+{
+}
+
+PlanarImage &PlanarImage::operator=(PlanarImage &&other) noexcept
+{
+    if (this != &other)
+    {
+        imageHeader = std::exchange(other.imageHeader, Header{});
+        rowStride = std::exchange(other.rowStride, 0);
+        capacity = std::exchange(other.capacity, 0);
+        storage = std::move(other.storage);
+    }
+    return *this;
+}
+
+void PlanarImage::AlignedDelete::operator()(unsigned char *bytes) const
+{
+    ::operator delete[](bytes, std::align_val_t{PLANE_ALIGNMENT});
+}
+
+void PlanarImage::reshape(const Header &header)
+{
+    imageHeader = header;
+    rowStride = (static_cast<std::size_t>(width()) + PLANE_ALIGNMENT - 1) / PLANE_ALIGNMENT * PLANE_ALIGNMENT;
+
+    std::size_t needed = 3 * planeSize();
+    if (needed > capacity)
+    {
+        storage.reset(static_cast<unsigned char *>(::operator new[](needed, std::align_val_t{PLANE_ALIGNMENT})));
+        std::memset(storage.get(), 0, needed);
+        capacity = needed;
+    }
+}
+
+Image PlanarImage::toImage() const
+{
+    Image image{imageHeader};
+    interleave(*this, image);
+    return image;
+}
+
+void deinterleave(const Image &image, PlanarImage &result)
+{
+    result.reshape(image.header);
+    int width = result.width();
+    if (image.pixels.size() != static_cast<std::size_t>(width) * result.height())
+        throw std::runtime_error("ERROR: The header does not match the number of pixels.");
+
+    parallelFor(result.height(), rowGrain(width), [&](std::size_t begin, std::size_t end)
+                {
+                    for (int y = static_cast<int>(begin); y < static_cast<int>(end); ++y)
+                    {
+                        const Pixel *in = image.pixels.data() + static_cast<std::size_t>(y) * width;
+                        unsigned char *blue = result.row(0, y);
+                        unsigned char *green = result.row(1, y);
+                        unsigned char *red = result.row(2, y);
+                        for (int x = 0; x < width; ++x)
+                        {
+                            blue[x] = in[x].b;
+                            green[x] = in[x].g;
+                            red[x] = in[x].r;
+                        }
+                    } });
+}
+
+void interleave(const PlanarImage &image, Image &result)
+{
+    int width = image.width();
+    result.header = image.header();
+    result.pixels.resize(static_cast<std::size_t>(width) * image.height());
+
+    parallelFor(image.height(), rowGrain(width), [&](std::size_t begin, std::size_t end)
+                {
+                    for (int y = static_cast<int>(begin); y < static_cast<int>(end); ++y)
+                    {
+                        Pixel *out = result.pixels.data() + static_cast<std::size_t>(y) * width;
+                        const unsigned char *blue = image.row(0, y);
+                        const unsigned char *green = image.row(1, y);
+                        const unsigned char *red = image.row(2, y);
+                        for (int x = 0; x < width; ++x)
+                        {
+                            out[x].b = blue[x];
+                            out[x].g = green[x];
+                            out[x].r = red[x];
+                        }
+                    } });
+}
+
+void multiplyMode(const PlanarImage &foreground, const PlanarImage &background, PlanarImage &result)
+{
+    blend(multiplyKernel, foreground, background, result);
+}
+
+PlanarImage multiplyMode(const PlanarImage &foreground, const PlanarImage &background)
+{
+    PlanarImage result{foreground.header()};
+    multiplyMode(foreground, background, result);
+    return result;
+}
+
+void screenMode(const PlanarImage &foreground, const PlanarImage &background, PlanarImage &result)
+{
+    blend(screenKernel, foreground, background, result);
+}
+
+PlanarImage screenMode(const PlanarImage &foreground, const PlanarImage &background)
+{
+    PlanarImage result{foreground.header()};
+    screenMode(foreground, background, result);
+    return result;
+}
+
+void overlayMode(const PlanarImage &foreground, const PlanarImage &background, PlanarImage &result)
+{
+    blend(overlayKernel, foreground, background, result);
+}
+
+PlanarImage overlayMode(const PlanarImage &foreground, const PlanarImage &background)
+{
+    PlanarImage result{foreground.header()};
+    overlayMode(foreground, background, result);
+    return result;
+}
+
+void subtractMode(const PlanarImage &topLayer, const PlanarImage &bottomLayer, PlanarImage &result)
+{
+    blend(subtractKernel, topLayer, bottomLayer, result);
+}
+
+PlanarImage subtractMode(const PlanarImage &topLayer, const PlanarImage &bottomLayer)
+{
+    PlanarImage result{topLayer.header()};
+    subtractMode(topLayer, bottomLayer, result);
+    return result;
+}
+
+void add(const PlanarImage &image, PlanarImage &result, double r, double g, double b)
+{
+    transform(image, result, makeAddLuts(r, g, b));
+}
+
+PlanarImage add(const PlanarImage &image, double r, double g, double b)
+{
+    PlanarImage result{image.header()};
+    add(image, result, r, g, b);
+    return result;
+}
+
+void scale(const PlanarImage &image, PlanarImage &result, double r, double g, double b)
+{
+    transform(image, result, makeScaleLuts(r, g, b));
+}
+
+PlanarImage scale(const PlanarImage &image, double r, double g, double b)
+{
+    PlanarImage result{image.header()};
+    scale(image, result, r, g, b);
+    return result;
+}
+
+void extractRed(const PlanarImage &image, PlanarImage &result)
+{
+    extract(image, result, 2);
+}
+
+PlanarImage extractRed(const PlanarImage &image)
+{
+    PlanarImage result{image.header()};
+    extractRed(image, result);
+    return result;
+}
+
+void extractGreen(const PlanarImage &image, PlanarImage &result)
+{
+    extract(image, result, 1);
+}
+
+PlanarImage extractGreen(const PlanarImage &image)
+{
+    PlanarImage result{image.header()};
+    extractGreen(image, result);
+    return result;
+}
+
+void extractBlue(const PlanarImage &image, PlanarImage &result)
+{
+    extract(image, result, 0);
+}
+
+PlanarImage extractBlue(const PlanarImage &image)
+{
+    PlanarImage result{image.header()};
+    extractBlue(image, result);
+    return result;
+}
+
+void combineChannels(const PlanarImage &red, const PlanarImage &green, const PlanarImage &blue, PlanarImage &result)
+{
+    checkSameSize(red, green);
+    checkSameSize(red, blue);
+    prepare(red, result);
+
+    const unsigned char *sources[3] = {blue.plane(0), green.plane(1), red.plane(2)};
+    parallelFor(red.planeSize(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                {
+                    for (int c = 0; c < 3; ++c)
+                        if (result.plane(c) != sources[c])
+                            std::memcpy(result.plane(c) + begin, sources[c] + begin, end - begin); });
+}
+
+PlanarImage combineChannels(const PlanarImage &red, const PlanarImage &green, const PlanarImage &blue)
+{
+    PlanarImage result{red.header()};
+    combineChannels(red, green, blue, result);
+    return result;
+}
+
+void rotate180(const PlanarImage &image, PlanarImage &result)
+{
+    int width = image.width();
+    int height = image.height();
+
+    if (&image == &result)
+    {
+        // In place: swap mirrored rows reversed, each band owning the rows of its lower half
+        parallelFor((height + 1) / 2, rowGrain(width), [&](std::size_t begin, std::size_t end)
+                    {
+                        for (int y = static_cast<int>(begin); y < static_cast<int>(end); ++y)
+                        {
+                            for (int c = 0; c < 3; ++c)
+                            {
+                                unsigned char *low = result.row(c, y);
+                                unsigned char *high = result.row(c, height - 1 - y);
+                                if (low == high)
+                                {
+                                    std::reverse(low, low + width);
+                                    continue;
+                                }
+                                std::reverse(high, high + width);
+                                std::swap_ranges(low, low + width, high);
+                                std::reverse(high, high + width);
+                            }
+                        } });
+        return;
+    }
+
+    prepare(image, result);
+    parallelFor(height, rowGrain(width), [&](std::size_t begin, std::size_t end)
+                {
+                    for (int y = static_cast<int>(begin); y < static_cast<int>(end); ++y)
+                        for (int c = 0; c < 3; ++c)
+                        {
+                            const unsigned char *in = image.row(c, height - 1 - y);
+                            std::reverse_copy(in, in + width, result.row(c, y));
+                        } });
+}
+
+PlanarImage rotate180(const PlanarImage &image)
+{
+    PlanarImage result{image.header()};
+    rotate180(image, result);
+    return result;
+}
+
+void combineQuadrants(const PlanarImage &first, const PlanarImage &second, const PlanarImage &third, const PlanarImage &fourth,
+                      PlanarImage &result)
+{
+    if (&result == &first || &result == &second || &result == &third || &result == &fourth)
+        throw std::runtime_error("ERROR: combineQuadrants cannot write into one of its inputs.");
+    checkSameSize(first, second);
+    checkSameSize(first, third);
+    checkSameSize(first, fourth);
+
+    result.reshape(quadrantsHeader(first));
+
+    int halfWidth = first.width();
+    int halfHeight = first.height();
+    parallelFor(result.height(), rowGrain(result.width()), [&](std::size_t begin, std::size_t end)
+                {
+                    for (int y = static_cast<int>(begin); y < static_cast<int>(end); ++y)
+                    {
+                        // Rows are bottom-up: the lower half holds the fourth and third quadrants
+                        bool top = y >= halfHeight;
+                        const PlanarImage &left = top ? first : fourth;
+                        const PlanarImage &right = top ? second : third;
+                        int source = top ? y - halfHeight : y;
+                        for (int c = 0; c < 3; ++c)
+                        {
+                            std::memcpy(result.row(c, y), left.row(c, source), halfWidth);
+                            std::memcpy(result.row(c, y) + halfWidth, right.row(c, source), halfWidth);
+                        }
+                    } });
+}
+
+PlanarImage combineQuadrants(const PlanarImage &first, const PlanarImage &second, const PlanarImage &third, const PlanarImage &fourth)
+{
+    PlanarImage result{quadrantsHeader(first)};
+    combineQuadrants(first, second, third, fourth, result);
+    return result;
+}
@@ -0,0 +1,504 @@
+#include "resample.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "threadpool.h"
+#include "trace.h"
+
+namespace
+{
+    // Fixed-point weights carry this many fraction bits; the largest sum (255 times the total absolute weight
+    // of a Lanczos kernel) stays far inside an int
+    constexpr int WEIGHT_BITS = 14;
+    constexpr int WEIGHT_ONE = 1 << WEIGHT_BITS;
+
+    // Mipmap levels produced per pass over the source: a band of 2^4 source rows yields one row of the fourth
+    // level and stays in cache while the levels in between are built from it
+    constexpr int MIPMAP_GROUP = 4;
+
+    constexpr double PI = 3.14159265358979323846;
+
+    /// @brief The weights resampling a line of `in` pixels to `out` pixels.
+    /// @note Output pixel i reads source pixels first[i] ... first[i] + taps - 1; weights beyond a pixel's
+    ///       own range are zero, so every pixel runs the same number of taps.
+    struct Weights
+    {
+        std::vector<int> first;
+        std::vector<int> values;
+        int taps = 0;
+    };
+
+    /// @return The header of `header` with a new size.
+    Header resizedHeader(const Header &header, int width, int height)
+    {
+        if (width < 1 || height < 1 || width > 0xFFFF || height > 0xFFFF)
+            throw std::runtime_error("ERROR: A resized image must be between 1x1 and 65535x65535 pixels.");
+
+        Header resized = header;
+        resized.width = static_cast<short>(width);
+        resized.height = static_cast<short>(height);
+        return resized;
+    }
+
+    /// @brief Give `result` a new size, reusing its buffer when large enough.
+    void prepare(const Image &source, Image &result, int width, int height)
+    {
+        result.header = resizedHeader(source.header, width, height);
+        result.pixels.resize(static_cast<std::size_t>(width) * height);
+    }
+
+    const unsigned char *channels(const Image &image, int row, int width)
+    {
+        return reinterpret_cast<const unsigned char *>(image.pixels.data() + static_cast<std::size_t>(row) * width);
+    }
+
+    unsigned char *channels(Image &image, int row, int width)
+    {
+        return reinterpret_cast<unsigned char *>(image.pixels.data() + static_cast<std::size_t>(row) * width);
+    }
+
+    unsigned char toByte(int sum)
+    {
+        return static_cast<unsigned char>(std::min(std::max((sum + WEIGHT_ONE / 2) >> WEIGHT_BITS, 0), 255));
+    }
+
+    double sinc(double x)
+    {
+        if (x == 0.0)
+            return 1.0;
+        x *= PI;
+        return std::sin(x) / x;
+    }
+
+    /// @return The weight of a source pixel `x` pixels (in filter units) from the output pixel's center.
+    double filterWeight(ResampleFilter filter, double x)
+    {
+        x = std::abs(x);
+        if (filter == ResampleFilter::Bilinear)
+            return x < 1.0 ? 1.0 - x : 0.0;
+        return x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+    }
+
+    /// @brief Compute the fixed-point weights resampling `in` pixels to `out` with a filter other than Nearest.
+    /// @note When shrinking, the filter is stretched by the reduction factor so it averages rather than skips
+    ///       source pixels. Each pixel's weights are rounded to sum to exactly WEIGHT_ONE, so flat areas stay flat,
+    ///       and zero weights at either end are trimmed so no tap is wasted.
+    Weights computeWeights(int in, int out, ResampleFilter filter)
+    {
+        double scale = static_cast<double>(in) / out;
+        double stretch = std::max(scale, 1.0);
+        double support = filter == ResampleFilter::Area ? scale / 2.0
+                                                        : stretch * (filter == ResampleFilter::Bilinear ? 1.0 : 3.0);
+
+        // Rounded weights of every output pixel, and the first source pixel each applies to
+        std::vector<std::vector<int>> rounded(out);
+        std::vector<int> first(out);
+        int taps = 1;
+        for (int i = 0; i < out; ++i)
+        {
+            double center = (i + 0.5) * scale;
+            int begin = std::max(static_cast<int>(std::floor(center - support)), 0);
+            int end = std::max(std::min(static_cast<int>(std::ceil(center + support)), in), begin + 1);
+
+            std::vector<double> exact;
+            double total = 0.0;
+            for (int j = begin; j < end; ++j)
+            {
+                double weight;
+                if (filter == ResampleFilter::Area)
+                    weight = std::max(std::min(j + 1.0, center + support) - std::max(static_cast<double>(j), center - support), 0.0);
+                else
+                    weight = filterWeight(filter, (j + 0.5 - center) / stretch);
+                exact.push_back(weight);
+                total += weight;
+            }
+
+            std::vector<int> &fixed = rounded[i];
+            int sum = 0;
+            std::size_t largest = 0;
+            for (std::size_t k = 0; k < exact.size(); ++k)
+            {
+                fixed.push_back(static_cast<int>(std::lround(exact[k] / total * WEIGHT_ONE)));
+                sum += fixed[k];
+                if (fixed[k] > fixed[largest])
+                    largest = k;
+            }
+            fixed[largest] += WEIGHT_ONE - sum;
+
+            while (fixed.size() > 1 && fixed.back() == 0)
+                fixed.pop_back();
+            std::size_t leading = 0;
+            while (leading + 1 < fixed.size() && fixed[leading] == 0)
+                ++leading;
+            fixed.erase(fixed.begin(), fixed.begin() + leading);
+            first[i] = begin + static_cast<int>(leading);
+            taps = std::max(taps, static_cast<int>(fixed.size()));
+        }
+
+        // Pad to a common tap count, moving windows that would run past the end of the line back
+        Weights weights;
+        weights.taps = taps;
+        weights.first.resize(out);
+        weights.values.assign(static_cast<std::size_t>(out) * taps, 0);
+        for (int i = 0; i < out; ++i)
+        {
+            int begin = std::min(first[i], in - taps);
+            weights.first[i] = begin;
+            std::copy(rounded[i].begin(), rounded[i].end(), &weights.values[static_cast<std::size_t>(i) * taps + (first[i] - begin)]);
+        }
+        return weights;
+    }
+
+    /// @brief Resample every row of `image` to `width` pixels.
+    void resampleRows(const Image &image, Image &result, int width, ResampleFilter filter)
+    {
+        int inWidth = imageWidth(image.header);
+        int height = imageHeight(image.header);
+        Weights weights = computeWeights(inWidth, width, filter);
+        prepare(image, result, width, height);
+
+        parallelFor(height, rowGrain(inWidth), [&](std::size_t begin, std::size_t end)
+                    {
+                        // Byte stores may alias anything, so keep the tables in locals rather than reloading them
+                        const int taps = weights.taps;
+                        const int *values = weights.values.data();
+                        const int *firsts = weights.first.data();
+                        for (std::size_t y = begin; y < end; ++y)
+                        {
+                            const unsigned char *in = channels(image, static_cast<int>(y), inWidth);
+                            unsigned char *out = channels(result, static_cast<int>(y), width);
+                            for (int x = 0; x < width; ++x, out += 3)
+                            {
+                                const int *weight = values + static_cast<std::size_t>(x) * taps;
+                                const unsigned char *pixel = in + static_cast<std::size_t>(firsts[x]) * 3;
+                                int b = 0, g = 0, r = 0;
+                                for (int k = 0; k < taps; ++k, pixel += 3)
+                                {
+                                    b += weight[k] * pixel[0];
+                                    g += weight[k] * pixel[1];
+                                    r += weight[k] * pixel[2];
+                                }
+                                out[0] = toByte(b);
+                                out[1] = toByte(g);
+                                out[2] = toByte(r);
+                            }
+                        } });
+    }
+
+    /// @brief Resample every column of `image` to `height` pixels.
+    /// @note Whole source rows are accumulated into a row of sums, a contiguous loop the compiler vectorizes.
+    void resampleColumns(const Image &image, Image &result, int height, ResampleFilter filter)
+    {
+        int width = imageWidth(image.header);
+        Weights weights = computeWeights(imageHeight(image.header), height, filter);
+        prepare(image, result, width, height);
+        std::size_t rowSize = static_cast<std::size_t>(width) * 3;
+
+        parallelFor(height, rowGrain(width * weights.taps), [&](std::size_t begin, std::size_t end)
+                    {
+                        std::vector<int> sum(rowSize);
+                        for (std::size_t y = begin; y < end; ++y)
+                        {
+                            std::fill(sum.begin(), sum.end(), 0);
+                            const int *weight = &weights.values[y * weights.taps];
+                            for (int k = 0; k < weights.taps; ++k)
+                            {
+                                // A local copy of the weight lets the compiler keep it in a register
+                                int w = weight[k];
+                                if (w == 0)
+                                    continue;
+                                const unsigned char *in = channels(image, weights.first[y] + k, width);
+                                int *total = sum.data();
+                                for (std::size_t i = 0; i < rowSize; ++i)
+                                    total[i] += w * in[i];
+                            }
+
+                            unsigned char *out = channels(result, static_cast<int>(y), width);
+                            for (std::size_t i = 0; i < rowSize; ++i)
+                                out[i] = toByte(sum[i]);
+                        } });
+    }
+
+    void resizeNearest(const Image &image, Image &result, int width, int height)
+    {
+        int inWidth = imageWidth(image.header);
+        int inHeight = imageHeight(image.header);
+        prepare(image, result, width, height);
+
+        // Source column of every output column, and source row of every output row
+        auto mapping = [](int in, int out)
+        {
+            std::vector<int> index(out);
+            double scale = static_cast<double>(in) / out;
+            for (int i = 0; i < out; ++i)
+                index[i] = std::min(static_cast<int>((i + 0.5) * scale), in - 1);
+            return index;
+        };
+        std::vector<int> columns = mapping(inWidth, width);
+        std::vector<int> rows = mapping(inHeight, height);
+
+        parallelFor(height, rowGrain(width), [&](std::size_t begin, std::size_t end)
+                    {
+                        for (std::size_t y = begin; y < end; ++y)
+                        {
+                            const Pixel *in = image.pixels.data() + static_cast<std::size_t>(rows[y]) * inWidth;
+                            Pixel *out = result.pixels.data() + y * width;
+                            for (int x = 0; x < width; ++x)
+                                out[x] = in[columns[x]];
+                        } });
+    }
+
+    /// @return log2 of `factor` if it is a power of two, otherwise -1.
+    int powerOfTwo(int factor)
+    {
+        int shift = 0;
+        while ((1 << shift) < factor)
+            ++shift;
+        return (1 << shift) == factor ? shift : -1;
+    }
+
+    /// @brief Average blocks of 2^shiftX x 2^shiftY pixels; blocks cut short by the right or top edge average
+    ///        the pixels they have.
+    void boxReduce(const Image &image, Image &result, int shiftX, int shiftY)
+    {
+        int inWidth = imageWidth(image.header);
+        int inHeight = imageHeight(image.header);
+        int blockWidth = 1 << shiftX;
+        int blockHeight = 1 << shiftY;
+        int width = (inWidth + blockWidth - 1) >> shiftX;
+        int height = (inHeight + blockHeight - 1) >> shiftY;
+        prepare(image, result, width, height);
+
+        parallelFor(height, rowGrain(inWidth * blockHeight), [&](std::size_t begin, std::size_t end)
+                    {
+                        std::vector<int> sum(static_cast<std::size_t>(width) * 3);
+                        for (std::size_t y = begin; y < end; ++y)
+                        {
+                            int firstRow = static_cast<int>(y) << shiftY;
+                            int rows = std::min(blockHeight, inHeight - firstRow);
+                            std::fill(sum.begin(), sum.end(), 0);
+                            for (int row = firstRow; row < firstRow + rows; ++row)
+                            {
+                                const unsigned char *in = channels(image, row, inWidth);
+                                for (int x = 0; x < inWidth; ++x, in += 3)
+                                {
+                                    int *block = &sum[static_cast<std::size_t>(x >> shiftX) * 3];
+                                    block[0] += in[0];
+                                    block[1] += in[1];
+                                    block[2] += in[2];
+                                }
+                            }
+
+                            unsigned char *out = channels(result, static_cast<int>(y), width);
+                            int shift = shiftX + shiftY;
+                            for (int x = 0; x < width; ++x)
+                            {
+                                int count = std::min(blockWidth, inWidth - (x << shiftX)) * rows;
+                                for (int c = 0; c < 3; ++c)
+                                {
+                                    int total = sum[static_cast<std::size_t>(x) * 3 + c];
+                                    out[x * 3 + c] = static_cast<unsigned char>(count == (1 << shift) ? (total + (count >> 1)) >> shift
+                                                                                                   : (total + count / 2) / count);
+                                }
+                            }
+                        } });
+    }
+
+    /// @return The size of a dimension after halving (a dimension of 1 stays 1).
+    int halved(int size)
+    {
+        return std::max(size / 2, 1);
+    }
+
+    /// @brief Write one row of a half-size image from two source rows.
+    /// @note When the source is a single pixel wide, each pixel pairs with itself, which makes the 2x2 average
+    ///       the average of the two rows (likewise when both row pointers are the same).
+    void halveRow(const unsigned char *low, const unsigned char *high, int inWidth, unsigned char *out)
+    {
+        if (inWidth == 1)
+        {
+            for (int c = 0; c < 3; ++c)
+                out[c] = static_cast<unsigned char>((2 * low[c] + 2 * high[c] + 2) >> 2);
+            return;
+        }
+
+        int width = inWidth / 2;
+        for (int x = 0; x < width; ++x, low += 6, high += 6, out += 3)
+            for (int c = 0; c < 3; ++c)
+                out[c] = static_cast<unsigned char>((low[c] + low[c + 3] + high[c] + high[c + 3] + 2) >> 2);
+    }
+
+    /// @brief Write row `y` of `result`, the half-size image of `image`.
+    void halveImageRow(const Image &image, Image &result, int y)
+    {
+        int inWidth = imageWidth(image.header);
+        int inHeight = imageHeight(image.header);
+        int low = inHeight > 1 ? 2 * y : 0;
+        int high = inHeight > 1 ? 2 * y + 1 : 0;
+        halveRow(channels(image, low, inWidth), channels(image, high, inWidth), inWidth,
+                 channels(result, y, imageWidth(result.header)));
+    }
+}
+
+void resize(const Image &image, Image &result, int width, int height, ResampleFilter filter)
+{
+    IP_TRACE_SCOPE("resize");
+    int inWidth = imageWidth(image.header);
+    int inHeight = imageHeight(image.header);
+    resizedHeader(image.header, width, height);
+    if (inWidth == width && inHeight == height)
+    {
+        if (&image != &result)
+            result = image;
+        return;
+    }
+    if (&image == &result)
+        throw std::runtime_error("ERROR: Resizing cannot be done in place.");
+    if (image.pixels.empty())
+        throw std::runtime_error("ERROR: Cannot resize an empty image.");
+
+    if (filter == ResampleFilter::Nearest)
+        return resizeNearest(image, result, width, height);
+
+    // Power-of-two area reductions are plain block averages, exact and without weight tables
+    if (filter == ResampleFilter::Area && inWidth % width == 0 && inHeight % height == 0)
+    {
+        int shiftX = powerOfTwo(inWidth / width);
+        int shiftY = powerOfTwo(inHeight / height);
+        if (shiftX >= 0 && shiftY >= 0)
+            return boxReduce(image, result, shiftX, shiftY);
+    }
+
+    if (inHeight == height)
+        return resampleRows(image, result, width, filter);
+    if (inWidth == width)
+        return resampleColumns(image, result, height, filter);
+
+    // Run the cheaper order: each pass costs its output size times its number of taps
+    double tapsX = computeWeights(inWidth, width, filter).taps;
+    double tapsY = computeWeights(inHeight, height, filter).taps;
+    double rowsFirst = tapsX * width * inHeight + tapsY * width * height;
+    double columnsFirst = tapsY * inWidth * height + tapsX * width * height;
+
+    Image temporary{Header{}};
+    if (rowsFirst <= columnsFirst)
+    {
+        resampleRows(image, temporary, width, filter);
+        resampleColumns(temporary, result, height, filter);
+    }
+    else
+    {
+        resampleColumns(image, temporary, height, filter);
+        resampleRows(temporary, result, width, filter);
+    }
+}
+
+Image resize(const Image &image, int width, int height, ResampleFilter filter)
+{
+    Image result{Header{}};
+    resize(image, result, width, height, filter);
+    return result;
+}
+
+void downscale2x(const Image &image, Image &result)
+{
+    IP_TRACE_SCOPE("downscale2x");
+    if (&image == &result)
+        throw std::runtime_error("ERROR: Downscaling cannot be done in place.");
+    if (image.pixels.empty())
+        throw std::runtime_error("ERROR: Cannot downscale an empty image.");
+
+    int width = halved(imageWidth(image.header));
+    int height = halved(imageHeight(image.header));
+    prepare(image, result, width, height);
+    parallelFor(height, rowGrain(width * 4), [&](std::size_t begin, std::size_t end)
+                {
+                    for (std::size_t y = begin; y < end; ++y)
+                        halveImageRow(image, result, static_cast<int>(y)); });
+}
+
+Image downscale2x(const Image &image)
+{
+    Image result{Header{}};
+    downscale2x(image, result);
+    return result;
+}
+
+std::vector<Image> buildMipmaps(const Image &image, int levels)
+{
+    IP_TRACE_SCOPE("buildMipmaps");
+    if (levels < 0)
+        throw std::runtime_error("ERROR: The number of mipmap levels cannot be negative.");
+    if (image.pixels.empty())
+        throw std::runtime_error("ERROR: Cannot build mipmaps of an empty image.");
+
+    // Allocate every level up front
+    int available = 0;
+    for (int w = imageWidth(image.header), h = imageHeight(image.header); w > 1 || h > 1; w = halved(w), h = halved(h))
+        ++available;
+    if (levels == 0 || levels > available)
+        levels = available;
+
+    std::vector<Image> pyramid;
+    pyramid.reserve(levels);
+    for (int level = 0; level < levels; ++level)
+    {
+        const Image &parent = level == 0 ? image : pyramid.back();
+        pyramid.emplace_back(resizedHeader(image.header, halved(imageWidth(parent.header)), halved(imageHeight(parent.header))));
+    }
+
+    // Build MIPMAP_GROUP levels per pass. Row j of a level only reads rows 2j and 2j + 1 of its parent, so an
+    // aligned chunk of rows of the group's first level owns every row it leads to further down the group
+    for (int base = 0; base < levels; base += MIPMAP_GROUP)
+    {
+        int group = std::min(MIPMAP_GROUP, levels - base);
+        const Image &source = base == 0 ? image : pyramid[base - 1];
+        std::size_t chunkRows = std::size_t{1} << (group - 1);
+        std::size_t chunks = (imageHeight(pyramid[base].header) + chunkRows - 1) / chunkRows;
+        std::size_t sourcePixels = chunkRows * 2 * imageWidth(source.header);
+
+        parallelFor(chunks, PIXEL_GRAIN / sourcePixels + 1, [&](std::size_t begin, std::size_t end)
+                    {
+                        for (int k = 0; k < group; ++k)
+                        {
+                            const Image &parent = base + k == 0 ? image : pyramid[base + k - 1];
+                            Image &level = pyramid[base + k];
+                            int first = static_cast<int>((begin * chunkRows) >> k);
+                            int last = std::min(static_cast<int>((end * chunkRows) >> k), imageHeight(level.header));
+                            for (int y = first; y < last; ++y)
+                                halveImageRow(parent, level, y);
+                        } });
+    }
+    return pyramid;
+}
+
+Image thumbnail(const Image &image, int maxWidth, int maxHeight, ResampleFilter filter)
+{
+    IP_TRACE_SCOPE("thumbnail");
+    if (maxWidth < 1 || maxHeight < 1)
+        throw std::runtime_error("ERROR: A thumbnail must be at least 1x1 pixels.");
+
+    int inWidth = imageWidth(image.header);
+    int inHeight = imageHeight(image.header);
+    if (inWidth <= maxWidth && inHeight <= maxHeight)
+        return image;
+
+    double scale = std::min(static_cast<double>(maxWidth) / inWidth, static_cast<double>(maxHeight) / inHeight);
+    int width = std::max(static_cast<int>(std::lround(inWidth * scale)), 1);
+    int height = std::max(static_cast<int>(std::lround(inHeight * scale)), 1);
+
+    // Average power-of-two blocks while at least twice the remaining reduction is left for the filter
+    int shiftX = 0, shiftY = 0;
+    while ((inWidth >> (shiftX + 1)) >= 2 * width)
+        ++shiftX;
+    while ((inHeight >> (shiftY + 1)) >= 2 * height)
+        ++shiftY;
+    if (shiftX == 0 && shiftY == 0)
+        return resize(image, width, height, filter);
+
+    Image reduced{Header{}};
+    boxReduce(image, reduced, shiftX, shiftY);
+    return resize(reduced, width, height, filter);
+}
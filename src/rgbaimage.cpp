@@ -0,0 +1,115 @@
+#include "rgbaimage.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "blendmodes.h"
+#include "threadpool.h"
+#include "trace.h"
+
+// The kernels treat the pixel vector as a flat run of interleaved BGRA bytes
+static_assert(sizeof(PixelRGBA) == 4, "PixelRGBA must be tightly packed BGRA bytes");
+
+namespace
+{
+    // Straight channel of every (alpha, premultiplied channel) pair, rounded and clamped (64 KB)
+    constexpr BlendTable UNPREMULTIPLY_TABLE = makeBlendTable([](unsigned char alpha, unsigned char value)
+                                                              { return static_cast<unsigned char>(
+                                                                    alpha == 0 ? 0 : std::min((value * 0xFF + alpha / 2) / alpha, 0xFF)); });
+
+    static_assert(UNPREMULTIPLY_TABLE(128, 64) == 128 && UNPREMULTIPLY_TABLE(255, 77) == 77, "Unpremultiply must be exact");
+
+    /// @brief Premultiply `count` straight pixels of `channels` bytes each (3 are opaque, 1 is gray).
+    void premultiplyPixels(const unsigned char *in, int channels, PixelRGBA *out, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i, in += channels)
+        {
+            if (channels == 4)
+                out[i] = premultiply(in[2], in[1], in[0], in[3]);
+            else if (channels == 3)
+                out[i] = PixelRGBA(in[2], in[1], in[0], 0xFF);
+            else
+                out[i] = PixelRGBA(in[0], in[0], in[0], 0xFF);
+        }
+    }
+}
+
+PixelRGBA premultiply(unsigned char red, unsigned char green, unsigned char blue, unsigned char alpha)
+{
+    return PixelRGBA(div255(red * alpha), div255(green * alpha), div255(blue * alpha), alpha);
+}
+
+ImageRGBA::ImageRGBA(const std::string &file)
+{
+    IP_TRACE_SCOPE("ImageRGBA::load");
+    IP_TRACE_COUNT(Allocations, 1);
+    TgaRaster raster = readTga(file);
+    header = tgaHeader(raster.header, 4, false);
+    pixels.resize(static_cast<std::size_t>(imageWidth(header)) * imageHeight(header));
+
+    const unsigned char *in = raster.data.data();
+    PixelRGBA *out = pixels.data();
+    int channels = raster.channels;
+    parallelFor(pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                { premultiplyPixels(in + begin * channels, channels, out + begin, end - begin); });
+}
+
+ImageRGBA::ImageRGBA(const Header &header) : header{tgaHeader(header, 4, false)}
+{
+    IP_TRACE_SCOPE("ImageRGBA::allocate");
+    IP_TRACE_COUNT(Allocations, 1);
+    pixels.resize(static_cast<std::size_t>(imageWidth(header)) * imageHeight(header));
+}
+
+ImageRGBA::ImageRGBA(const Image &image) : ImageRGBA{image.header}
+{
+    const unsigned char *in = reinterpret_cast<const unsigned char *>(image.pixels.data());
+    PixelRGBA *out = pixels.data();
+    parallelFor(pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                { premultiplyPixels(in + begin * sizeof(Pixel), 3, out + begin, end - begin); });
+}
+
+void ImageRGBA::write(const std::string &file, bool rle) const
+{
+    IP_TRACE_SCOPE("ImageRGBA::write");
+    if (pixels.size() != static_cast<std::size_t>(imageWidth(header)) * imageHeight(header))
+        throw std::runtime_error("ERROR: The header of the image does not match its number of pixels.");
+
+    // Files hold straight alpha
+    std::vector<unsigned char> data(pixels.size() * sizeof(PixelRGBA));
+    const PixelRGBA *in = pixels.data();
+    unsigned char *out = data.data();
+    parallelFor(pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                {
+                    for (std::size_t i = begin; i < end; ++i)
+                    {
+                        const unsigned char *row = UNPREMULTIPLY_TABLE.values + (in[i].a << 8);
+                        out[i * 4] = row[in[i].b];
+                        out[i * 4 + 1] = row[in[i].g];
+                        out[i * 4 + 2] = row[in[i].r];
+                        out[i * 4 + 3] = in[i].a;
+                    } });
+    writeTga(file, header, data.data(), 4, rle);
+}
+
+ImageRGBA withAlpha(const Image &color, const Image &mask)
+{
+    IP_TRACE_SCOPE("withAlpha");
+    if (color.pixels.size() != mask.pixels.size())
+        throw std::runtime_error("ERROR: Images must have the same number of pixels.");
+
+    ImageRGBA result{color.header};
+    const Pixel *in = color.pixels.data();
+    const Pixel *coverage = mask.pixels.data();
+    PixelRGBA *out = result.pixels.data();
+    parallelFor(result.pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                {
+                    for (std::size_t i = begin; i < end; ++i)
+                    {
+                        // Rec. 601 luma weights summing to 256, as for grayscale files
+                        const Pixel &m = coverage[i];
+                        auto alpha = static_cast<unsigned char>((77 * m.r + 150 * m.g + 29 * m.b + 128) >> 8);
+                        out[i] = premultiply(in[i].r, in[i].g, in[i].b, alpha);
+                    } });
+    return result;
+}
@@ -0,0 +1,229 @@
+#include "statistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <stdexcept>
+
+#include "threadpool.h"
+#include "trace.h"
+
+namespace
+{
+    /// @brief Map the image through per-channel lookup tables in parallel.
+    void applyLuts(const Image &image, Image &result, const ChannelLuts &luts)
+    {
+        prepareResult(image, result);
+        const unsigned char *in = reinterpret_cast<const unsigned char *>(image.pixels.data());
+        unsigned char *out = reinterpret_cast<unsigned char *>(result.pixels.data());
+        parallelFor(image.pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                    { lutKernel(in + begin * sizeof(Pixel), out + begin * sizeof(Pixel), end - begin, luts); });
+    }
+
+    /// @brief Fill in everything but the histogram from the histogram.
+    void summarize(ChannelStatistics &channel)
+    {
+        const auto &histogram = channel.histogram;
+        channel.count = 0;
+        double sum = 0.0;
+        double squares = 0.0;
+        for (int v = 0; v < 256; ++v)
+        {
+            channel.count += histogram[v];
+            sum += static_cast<double>(histogram[v]) * v;
+            squares += static_cast<double>(histogram[v]) * v * v;
+        }
+        if (channel.count == 0)
+            return;
+
+        channel.min = static_cast<int>(std::find_if(histogram.begin(), histogram.end(), [](std::uint64_t n)
+                                                    { return n != 0; }) -
+                                       histogram.begin());
+        channel.max = 255 - static_cast<int>(std::find_if(histogram.rbegin(), histogram.rend(), [](std::uint64_t n)
+                                                          { return n != 0; }) -
+                                             histogram.rbegin());
+        channel.mean = sum / channel.count;
+        channel.standardDeviation = std::sqrt(std::max(squares / channel.count - channel.mean * channel.mean, 0.0));
+    }
+
+    /// @brief Write the levels mapping of one channel into `table`.
+    void levelsTable(unsigned char *table, int black, int white, double gamma)
+    {
+        for (int v = 0; v < 256; ++v)
+        {
+            double t = std::min(std::max(static_cast<double>(v - black) / (white - black), 0.0), 1.0);
+            table[v] = static_cast<unsigned char>(std::lround(255.0 * std::pow(t, 1.0 / gamma)));
+        }
+    }
+
+    /// @brief Write the contrast stretch of one channel into `table` (the identity when there is no spread).
+    void stretchTable(unsigned char *table, const ChannelStatistics &channel, double clip)
+    {
+        int black = channel.percentile(clip);
+        int white = channel.percentile(100.0 - clip);
+        if (white <= black)
+        {
+            for (int v = 0; v < 256; ++v)
+                table[v] = static_cast<unsigned char>(v);
+            return;
+        }
+        levelsTable(table, black, white, 1.0);
+    }
+
+    /// @brief Write the equalization of one channel into `table`: each value goes to its rank in the image.
+    void equalizeTable(unsigned char *table, const ChannelStatistics &channel)
+    {
+        // Pixels at the darkest value present, which maps to 0
+        std::uint64_t lowest = channel.count == 0 ? 0 : channel.histogram[channel.min];
+        std::uint64_t range = channel.count - lowest;
+        std::uint64_t cumulative = 0;
+        for (int v = 0; v < 256; ++v)
+        {
+            cumulative += channel.histogram[v];
+            if (range == 0)
+                table[v] = static_cast<unsigned char>(v);
+            else if (cumulative <= lowest)
+                table[v] = 0;
+            else
+                table[v] = static_cast<unsigned char>((255 * (cumulative - lowest) + range / 2) / range);
+        }
+    }
+}
+
+int ChannelStatistics::percentile(double percent) const
+{
+    if (count == 0)
+        return 0;
+
+    // The rank of the value sought, counted from 1
+    double clamped = std::min(std::max(percent, 0.0), 100.0);
+    std::uint64_t rank = std::max<std::uint64_t>(static_cast<std::uint64_t>(std::ceil(clamped / 100.0 * count)), 1);
+    std::uint64_t cumulative = 0;
+    for (int v = 0; v < 256; ++v)
+    {
+        cumulative += histogram[v];
+        if (cumulative >= rank)
+            return v;
+    }
+    return max;
+}
+
+ImageStatistics imageStatistics(const Image &image)
+{
+    IP_TRACE_SCOPE("imageStatistics");
+    IP_TRACE_COUNT(PixelsProcessed, image.pixels.size());
+
+    ImageStatistics statistics;
+    std::mutex mutex;
+    const unsigned char *in = reinterpret_cast<const unsigned char *>(image.pixels.data());
+    parallelFor(image.pixels.size(), PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                {
+                    // Two copies of the band's histograms, for even and odd pixels: runs of equal values (common
+                    // in real images) then alternate between two counters instead of waiting on one
+                    std::uint32_t counts[2][4][256] = {};
+                    for (std::size_t i = begin; i < end; ++i)
+                    {
+                        const unsigned char *pixel = in + i * 3;
+                        std::uint32_t (*copy)[256] = counts[i & 1];
+                        ++copy[0][pixel[0]];
+                        ++copy[1][pixel[1]];
+                        ++copy[2][pixel[2]];
+                        ++copy[3][(77 * pixel[2] + 150 * pixel[1] + 29 * pixel[0] + 128) >> 8];
+                    }
+
+                    std::lock_guard<std::mutex> lock{mutex};
+                    ChannelStatistics *channels[4] = {&statistics.blue, &statistics.green, &statistics.red, &statistics.luma};
+                    for (int c = 0; c < 4; ++c)
+                        for (int v = 0; v < 256; ++v)
+                            channels[c]->histogram[v] += counts[0][c][v] + counts[1][c][v]; });
+
+    summarize(statistics.red);
+    summarize(statistics.green);
+    summarize(statistics.blue);
+    summarize(statistics.luma);
+    return statistics;
+}
+
+ChannelLuts makeLevelsLuts(int black, int white, double gamma)
+{
+    if (black < 0 || white > 255 || white <= black)
+        throw std::runtime_error("ERROR: Levels need 0 <= black < white <= 255.");
+    if (!(gamma > 0))
+        throw std::runtime_error("ERROR: The levels gamma must be positive.");
+
+    ChannelLuts luts;
+    levelsTable(luts.r, black, white, gamma);
+    std::copy(luts.r, luts.r + 256, luts.g);
+    std::copy(luts.r, luts.r + 256, luts.b);
+    return luts;
+}
+
+void levels(const Image &image, Image &result, int black, int white, double gamma)
+{
+    IP_TRACE_SCOPE("levels");
+    IP_TRACE_COUNT(PixelsProcessed, image.pixels.size());
+    applyLuts(image, result, makeLevelsLuts(black, white, gamma));
+}
+
+Image levels(const Image &image, int black, int white, double gamma)
+{
+    Image result{image.header};
+    levels(image, result, black, white, gamma);
+    return result;
+}
+
+void autoLevels(const Image &image, Image &result, double clip, bool linked)
+{
+    IP_TRACE_SCOPE("autoLevels");
+    if (!(clip >= 0 && clip <= 50))
+        throw std::runtime_error("ERROR: The auto-levels clip must be between 0 and 50 percent.");
+
+    ImageStatistics statistics = imageStatistics(image);
+    ChannelLuts luts;
+    if (linked)
+    {
+        ChannelStatistics combined;
+        for (int v = 0; v < 256; ++v)
+            combined.histogram[v] = statistics.red.histogram[v] + statistics.green.histogram[v] + statistics.blue.histogram[v];
+        summarize(combined);
+        stretchTable(luts.r, combined, clip);
+        std::copy(luts.r, luts.r + 256, luts.g);
+        std::copy(luts.r, luts.r + 256, luts.b);
+    }
+    else
+    {
+        stretchTable(luts.r, statistics.red, clip);
+        stretchTable(luts.g, statistics.green, clip);
+        stretchTable(luts.b, statistics.blue, clip);
+    }
+
+    IP_TRACE_COUNT(PixelsProcessed, image.pixels.size());
+    applyLuts(image, result, luts);
+}
+
+Image autoLevels(const Image &image, double clip, bool linked)
+{
+    Image result{image.header};
+    autoLevels(image, result, clip, linked);
+    return result;
+}
+
+void equalize(const Image &image, Image &result)
+{
+    IP_TRACE_SCOPE("equalize");
+    ImageStatistics statistics = imageStatistics(image);
+    ChannelLuts luts;
+    equalizeTable(luts.r, statistics.red);
+    equalizeTable(luts.g, statistics.green);
+    equalizeTable(luts.b, statistics.blue);
+
+    IP_TRACE_COUNT(PixelsProcessed, image.pixels.size());
+    applyLuts(image, result, luts);
+}
+
+Image equalize(const Image &image)
+{
+    Image result{image.header};
+    equalize(image, result);
+    return result;
+}
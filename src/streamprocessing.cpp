@@ -0,0 +1,168 @@
+#include "streamprocessing.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "image.h"
+#include "kernels.h"
+#include "tgastream.h"
+#include "threadpool.h"
+
+namespace
+{
+    using BlendKernel = void (*)(const unsigned char *, const unsigned char *, unsigned char *, std::size_t);
+
+    void checkSameSize(const TgaReader &first, const TgaReader &second)
+    {
+        if (first.width() != second.width() || first.height() != second.height())
+            throw std::runtime_error("ERROR: Images must have the same dimensions.");
+
+        // Scanlines are streamed in file order, so both files must store them in the same order
+        if (first.topOrigin() != second.topOrigin())
+            throw std::runtime_error("ERROR: Streamed images must share the same vertical origin.");
+    }
+
+    PixelBuffer chunkBuffer(const TgaReader &reader, int rows)
+    {
+        if (rows <= 0)
+            throw std::runtime_error("ERROR: The number of scanlines per chunk must be positive.");
+        return PixelBuffer(static_cast<std::size_t>(reader.width()) * std::min(rows, std::max(reader.height(), 1)));
+    }
+
+    unsigned char *bytes(PixelBuffer &pixels)
+    {
+        return reinterpret_cast<unsigned char *>(pixels.data());
+    }
+
+    /// @brief Stream two files through a blend kernel; the top chunk buffer doubles as the output buffer.
+    void streamBlend(BlendKernel kernel, const std::string &top, const std::string &bottom, const std::string &output, int rows)
+    {
+        TgaReader topReader{top};
+        TgaReader bottomReader{bottom};
+        checkSameSize(topReader, bottomReader);
+
+        PixelBuffer topChunk = chunkBuffer(topReader, rows);
+        PixelBuffer bottomChunk = chunkBuffer(bottomReader, rows);
+        TgaWriter writer{output, topReader.header()};
+
+        int read;
+        while ((read = topReader.readRows(topChunk.data(), rows)) > 0)
+        {
+            bottomReader.readRows(bottomChunk.data(), read);
+
+            unsigned char *topBytes = bytes(topChunk);
+            unsigned char *bottomBytes = bytes(bottomChunk);
+            parallelFor(static_cast<std::size_t>(topReader.width()) * read, PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                        {
+                            std::size_t offset = begin * sizeof(Pixel);
+                            kernel(topBytes + offset, bottomBytes + offset, topBytes + offset, (end - begin) * sizeof(Pixel)); });
+
+            writer.writeRows(topChunk.data(), read);
+        }
+        writer.close();
+    }
+
+    /// @brief Stream one file through a single-input kernel, in place on the chunk buffer.
+    template <typename Kernel>
+    void streamMap(const std::string &input, const std::string &output, int rows, Kernel kernel)
+    {
+        TgaReader reader{input};
+        PixelBuffer chunk = chunkBuffer(reader, rows);
+        TgaWriter writer{output, reader.header()};
+
+        int read;
+        while ((read = reader.readRows(chunk.data(), rows)) > 0)
+        {
+            unsigned char *chunkBytes = bytes(chunk);
+            parallelFor(static_cast<std::size_t>(reader.width()) * read, PIXEL_GRAIN, [&](std::size_t begin, std::size_t end)
+                        {
+                            unsigned char *start = chunkBytes + begin * sizeof(Pixel);
+                            kernel(start, start, end - begin); });
+
+            writer.writeRows(chunk.data(), read);
+        }
+        writer.close();
+    }
+}
+
+void streamMultiplyMode(const std::string &foreground, const std::string &background, const std::string &output, int rows)
+{
+    streamBlend(multiplyKernel, foreground, background, output, rows);
+}
+
+void streamScreenMode(const std::string &foreground, const std::string &background, const std::string &output, int rows)
+{
+    streamBlend(screenKernel, foreground, background, output, rows);
+}
+
+void streamOverlayMode(const std::string &foreground, const std::string &background, const std::string &output, int rows)
+{
+    streamBlend(overlayKernel, foreground, background, output, rows);
+}
+
+void streamSubtractMode(const std::string &topLayer, const std::string &bottomLayer, const std::string &output, int rows)
+{
+    streamBlend(subtractKernel, topLayer, bottomLayer, output, rows);
+}
+
+void streamAdd(const std::string &input, const std::string &output, double r, double g, double b, int rows)
+{
+    ChannelLuts luts = makeAddLuts(r, g, b);
+    streamMap(input, output, rows, [&](const unsigned char *in, unsigned char *out, std::size_t count)
+              { lutKernel(in, out, count, luts); });
+}
+
+void streamScale(const std::string &input, const std::string &output, double r, double g, double b, int rows)
+{
+    ChannelLuts luts = makeScaleLuts(r, g, b);
+    streamMap(input, output, rows, [&](const unsigned char *in, unsigned char *out, std::size_t count)
+              { lutKernel(in, out, count, luts); });
+}
+
+void streamExtractRed(const std::string &input, const std::string &output, int rows)
+{
+    streamMap(input, output, rows, [](const unsigned char *in, unsigned char *out, std::size_t count)
+              { extractKernel(in, out, count, 2); });
+}
+
+void streamExtractGreen(const std::string &input, const std::string &output, int rows)
+{
+    streamMap(input, output, rows, [](const unsigned char *in, unsigned char *out, std::size_t count)
+              { extractKernel(in, out, count, 1); });
+}
+
+void streamExtractBlue(const std::string &input, const std::string &output, int rows)
+{
+    streamMap(input, output, rows, [](const unsigned char *in, unsigned char *out, std::size_t count)
+              { extractKernel(in, out, count, 0); });
+}
+
+void streamCombineChannels(const std::string &red, const std::string &green, const std::string &blue,
+                           const std::string &output, int rows)
+{
+    TgaReader redReader{red};
+    TgaReader greenReader{green};
+    TgaReader blueReader{blue};
+    checkSameSize(redReader, greenReader);
+    checkSameSize(redReader, blueReader);
+
+    PixelBuffer redChunk = chunkBuffer(redReader, rows);
+    PixelBuffer greenChunk = chunkBuffer(greenReader, rows);
+    PixelBuffer blueChunk = chunkBuffer(blueReader, rows);
+    TgaWriter writer{output, redReader.header()};
+
+    int read;
+    while ((read = redReader.readRows(redChunk.data(), rows)) > 0)
+    {
+        greenReader.readRows(greenChunk.data(), read);
+        blueReader.readRows(blueChunk.data(), read);
+
+        std::size_t count = static_cast<std::size_t>(redReader.width()) * read;
+        for (std::size_t i = 0; i < count; ++i)
+            redChunk[i].update(redChunk[i].r, greenChunk[i].g, blueChunk[i].b);
+
+        writer.writeRows(redChunk.data(), read);
+    }
+    writer.close();
+}
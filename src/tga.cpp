@@ -0,0 +1,350 @@
+#include "tga.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include "mappedfile.h"
+#include "trace.h"
+
+namespace
+{
+    // Image descriptor bits
+    constexpr char RIGHT_ORIGIN = 0x10;
+    constexpr char TOP_ORIGIN = 0x20;
+
+    // Run-length packet header: high bit set for a run, low seven bits hold the pixel count minus one
+    constexpr unsigned char RUN_PACKET = 0x80;
+    constexpr int MAX_PACKET = 128;
+
+    /// @brief Expand one 15/16/24/32-bit true color value to 3 (BGR) or 4 (BGRA) bytes.
+    void convertColor(const unsigned char *in, int bits, unsigned char *out, int channels)
+    {
+        if (bits == 15 || bits == 16)
+        {
+            // A1 R5 G5 B5, little-endian
+            unsigned int value = in[0] | (in[1] << 8);
+            unsigned int b = value & 0x1F;
+            unsigned int g = (value >> 5) & 0x1F;
+            unsigned int r = (value >> 10) & 0x1F;
+            out[0] = static_cast<unsigned char>((b << 3) | (b >> 2));
+            out[1] = static_cast<unsigned char>((g << 3) | (g >> 2));
+            out[2] = static_cast<unsigned char>((r << 3) | (r >> 2));
+            if (channels == 4)
+                out[3] = (bits == 16 && !(value & 0x8000)) ? 0 : 0xFF;
+            return;
+        }
+
+        out[0] = in[0];
+        out[1] = in[1];
+        out[2] = in[2];
+        if (channels == 4)
+            out[3] = (bits == 32) ? in[3] : 0xFF;
+    }
+
+    bool isColorMapped(char type) { return type == 1 || type == 9; }
+    bool isTrueColor(char type) { return type == 2 || type == 10; }
+    bool isGrayscale(char type) { return type == 3 || type == 11; }
+
+    /// @brief Reverse the order of `count` pixels of `size` (at most 4) bytes in place.
+    void reversePixels(unsigned char *data, std::size_t count, int size)
+    {
+        unsigned char swap[4];
+        for (std::size_t i = 0, j = count - 1; count > 1 && i < j; ++i, --j)
+        {
+            std::memcpy(swap, data + i * size, size);
+            std::memcpy(data + i * size, data + j * size, size);
+            std::memcpy(data + j * size, swap, size);
+        }
+    }
+}
+
+TgaDecoder::TgaDecoder(const Header &header, const unsigned char *colorMap)
+    : compressed{header.dataTypeCode >= 9}, bitsPerPixel{static_cast<unsigned char>(header.bitsPerPixel)},
+      indexed{isColorMapped(header.dataTypeCode)}
+{
+    if (isColorMapped(header.dataTypeCode))
+    {
+        int depth = static_cast<unsigned char>(header.colorMapDepth);
+        if (header.colorMapType != 1 || (bitsPerPixel != 8 && bitsPerPixel != 16) ||
+            (depth != 15 && depth != 16 && depth != 24 && depth != 32))
+            throw std::runtime_error("ERROR: Unsupported color-mapped .tga format.");
+
+        // Convert the whole color map once so that indexed pixels become a table lookup
+        outputChannels = (depth == 32) ? 4 : 3;
+        int entrySize = (depth + 7) / 8;
+        int origin = static_cast<unsigned short>(header.colorMapOrigin);
+        int length = static_cast<unsigned short>(header.colorMapLength);
+        palette.assign(static_cast<std::size_t>(origin + length) * outputChannels, 0);
+        for (int i = 0; i < length; ++i)
+            convertColor(colorMap + i * entrySize, depth, &palette[(origin + i) * outputChannels], outputChannels);
+    }
+    else if (isTrueColor(header.dataTypeCode))
+    {
+        if (bitsPerPixel != 15 && bitsPerPixel != 16 && bitsPerPixel != 24 && bitsPerPixel != 32)
+            throw std::runtime_error("ERROR: Unsupported true color .tga depth.");
+        outputChannels = (bitsPerPixel == 32) ? 4 : 3;
+    }
+    else if (isGrayscale(header.dataTypeCode))
+    {
+        if (bitsPerPixel != 8)
+            throw std::runtime_error("ERROR: Unsupported grayscale .tga depth.");
+        outputChannels = 1;
+    }
+    else
+    {
+        throw std::runtime_error("ERROR: Unsupported .tga data type " + std::to_string(header.dataTypeCode) + ".");
+    }
+
+    filePixelSize = (bitsPerPixel + 7) / 8;
+
+    // An uncompressed payload behaves like one endless raw packet
+    if (!compressed)
+        rawLeft = std::numeric_limits<std::size_t>::max();
+}
+
+void TgaDecoder::convert(const unsigned char *in, unsigned char *out, std::size_t count) const
+{
+    if (indexed)
+    {
+        std::size_t entries = palette.size() / outputChannels;
+        for (std::size_t i = 0; i < count; ++i, in += filePixelSize, out += outputChannels)
+        {
+            std::size_t index = (filePixelSize == 1) ? in[0] : (in[0] | (in[1] << 8));
+            if (index < entries)
+                std::memcpy(out, &palette[index * outputChannels], outputChannels);
+            else
+                std::memset(out, 0, outputChannels);
+        }
+    }
+    else if (filePixelSize == outputChannels)
+    {
+        // 8-bit gray, 24-bit BGR and 32-bit BGRA are stored exactly as decoded
+        std::memcpy(out, in, count * filePixelSize);
+    }
+    else
+    {
+        for (std::size_t i = 0; i < count; ++i, in += filePixelSize, out += outputChannels)
+            convertColor(in, bitsPerPixel, out, outputChannels);
+    }
+}
+
+std::size_t TgaDecoder::decode(const unsigned char *&in, const unsigned char *inEnd, unsigned char *out, std::size_t pixels)
+{
+    std::size_t produced = 0;
+    while (produced < pixels)
+    {
+        if (runLeft > 0)
+        {
+            std::size_t count = std::min(runLeft, pixels - produced);
+            if (outputChannels == 1)
+            {
+                std::memset(out, runValue[0], count);
+                out += count;
+            }
+            else
+            {
+                for (std::size_t i = 0; i < count; ++i, out += outputChannels)
+                    std::memcpy(out, runValue, outputChannels);
+            }
+            runLeft -= count;
+            produced += count;
+        }
+        else if (rawLeft > 0)
+        {
+            std::size_t available = static_cast<std::size_t>(inEnd - in) / filePixelSize;
+            std::size_t count = std::min({rawLeft, pixels - produced, available});
+            if (count == 0)
+                break;
+            convert(in, out, count);
+            in += count * filePixelSize;
+            out += count * outputChannels;
+            if (compressed)
+                rawLeft -= count;
+            produced += count;
+        }
+        else
+        {
+            // Start the next packet (a run needs its pixel value to be available as well)
+            if (in == inEnd)
+                break;
+            unsigned char packet = *in;
+            std::size_t count = (packet & 0x7F) + 1;
+            if (packet & RUN_PACKET)
+            {
+                if (inEnd - in < 1 + filePixelSize)
+                    break;
+                convert(in + 1, runValue, 1);
+                in += 1 + filePixelSize;
+                runLeft = count;
+            }
+            else
+            {
+                ++in;
+                rawLeft = count;
+            }
+        }
+    }
+    return produced;
+}
+
+std::size_t tgaPayloadOffset(const Header &header)
+{
+    std::size_t offset = static_cast<unsigned char>(header.idLength);
+    if (header.colorMapType != 0)
+        offset += static_cast<std::size_t>(static_cast<unsigned short>(header.colorMapLength)) *
+                  ((static_cast<unsigned char>(header.colorMapDepth) + 7) / 8);
+    return offset;
+}
+
+bool tgaTopOrigin(const Header &header)
+{
+    return (header.imageDescriptor & TOP_ORIGIN) != 0;
+}
+
+bool tgaRightOrigin(const Header &header)
+{
+    return (header.imageDescriptor & RIGHT_ORIGIN) != 0;
+}
+
+Header tgaHeader(const Header &base, int channels, bool rle)
+{
+    Header header = base;
+    header.idLength = 0;
+    header.colorMapType = 0;
+    header.colorMapOrigin = 0;
+    header.colorMapLength = 0;
+    header.colorMapDepth = 0;
+    header.dataTypeCode = static_cast<char>((channels == 1 ? 3 : 2) + (rle ? 8 : 0));
+    header.bitsPerPixel = static_cast<char>(channels * 8);
+
+    // Bottom-left origin; the low bits hold the number of alpha bits per pixel
+    header.imageDescriptor = static_cast<char>(channels == 4 ? 8 : 0);
+    return header;
+}
+
+TgaRaster decodeTga(const unsigned char *bytes, std::size_t size, const std::string &name)
+{
+    if (size < HEADER_SIZE)
+        throw std::runtime_error("ERROR: File \"" + name + "\" is not a valid .tga file.");
+
+    Header header = parseHeader(bytes);
+    std::size_t offset = HEADER_SIZE + tgaPayloadOffset(header);
+    if (offset > size)
+        throw std::runtime_error("ERROR: File \"" + name + "\" is truncated.");
+
+    const unsigned char *colorMap = bytes + HEADER_SIZE + static_cast<unsigned char>(header.idLength);
+    TgaDecoder decoder{header, colorMap};
+
+    TgaRaster raster;
+    raster.channels = decoder.channels();
+    raster.header = tgaHeader(header, raster.channels, false);
+
+    int width = imageWidth(header);
+    int height = imageHeight(header);
+    std::size_t pixels = static_cast<std::size_t>(width) * height;
+    raster.data.resize(pixels * raster.channels);
+
+    const unsigned char *in = bytes + offset;
+    if (decoder.decode(in, bytes + size, raster.data.data(), pixels) != pixels)
+        throw std::runtime_error("ERROR: File \"" + name + "\" is truncated.");
+
+    // Normalize to bottom-up rows stored left to right
+    std::size_t rowSize = static_cast<std::size_t>(width) * raster.channels;
+    if (tgaRightOrigin(header))
+        for (int y = 0; y < height; ++y)
+            reversePixels(raster.data.data() + y * rowSize, width, raster.channels);
+    if (tgaTopOrigin(header))
+    {
+        std::vector<unsigned char> swap(rowSize);
+        for (int top = 0, bottom = height - 1; top < bottom; ++top, --bottom)
+        {
+            unsigned char *a = raster.data.data() + top * rowSize;
+            unsigned char *b = raster.data.data() + bottom * rowSize;
+            std::memcpy(swap.data(), a, rowSize);
+            std::memcpy(a, b, rowSize);
+            std::memcpy(b, swap.data(), rowSize);
+        }
+    }
+
+    return raster;
+}
+
+TgaRaster readTga(const std::string &file)
+{
+    MappedFile mapping{file};
+    return decodeTga(mapping.data(), mapping.size(), file);
+}
+
+void encodeRleRow(const unsigned char *row, int width, int channels, std::vector<unsigned char> &out)
+{
+    auto same = [&](int a, int b)
+    { return std::memcmp(row + a * channels, row + b * channels, channels) == 0; };
+
+    int x = 0;
+    while (x < width)
+    {
+        // Measure the run of identical pixels starting here
+        int run = 1;
+        while (x + run < width && run < MAX_PACKET && same(x, x + run))
+            ++run;
+
+        if (run >= 2)
+        {
+            out.push_back(static_cast<unsigned char>(RUN_PACKET | (run - 1)));
+            out.insert(out.end(), row + x * channels, row + (x + 1) * channels);
+            x += run;
+            continue;
+        }
+
+        // Gather literal pixels until the next run of two or more begins
+        int start = x;
+        int count = 0;
+        while (x < width && count < MAX_PACKET && !(x + 1 < width && same(x, x + 1)))
+        {
+            ++x;
+            ++count;
+        }
+        out.push_back(static_cast<unsigned char>(count - 1));
+        out.insert(out.end(), row + start * channels, row + x * channels);
+    }
+}
+
+void writeTga(const std::string &file, const Header &header, const unsigned char *data, int channels, bool rle)
+{
+    std::ofstream imageFile{file, std::ios_base::binary};
+    if (!imageFile.is_open())
+        throw std::runtime_error("ERROR: File \"" + file + "\" not found.");
+
+    Header fileHeader = tgaHeader(header, channels, rle);
+    unsigned char headerBytes[HEADER_SIZE];
+    serializeHeader(fileHeader, headerBytes);
+    imageFile.write(reinterpret_cast<const char *>(headerBytes), HEADER_SIZE);
+    IP_TRACE_COUNT(BytesWritten, HEADER_SIZE);
+
+    int width = imageWidth(header);
+    int height = imageHeight(header);
+    std::size_t rowSize = static_cast<std::size_t>(width) * channels;
+    if (!rle)
+    {
+        imageFile.write(reinterpret_cast<const char *>(data), rowSize * height);
+        IP_TRACE_COUNT(BytesWritten, rowSize * height);
+        return;
+    }
+
+    // Encode row by row, flushing the packets in batches to keep the staging buffer small
+    std::vector<unsigned char> packets;
+    packets.reserve(rowSize + rowSize / MAX_PACKET + 1);
+    for (int y = 0; y < height; ++y)
+    {
+        encodeRleRow(data + y * rowSize, width, channels, packets);
+        if (packets.size() >= (1u << 16) || y == height - 1)
+        {
+            imageFile.write(reinterpret_cast<const char *>(packets.data()), packets.size());
+            IP_TRACE_COUNT(BytesWritten, packets.size());
+            packets.clear();
+        }
+    }
+}
@@ -0,0 +1,161 @@
+#include "tgastream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "trace.h"
+
+namespace
+{
+    // Payload bytes read from the file at a time
+    constexpr std::size_t INPUT_BUFFER_SIZE = 1 << 16;
+
+    // Image descriptor bit of a top-left origin
+    constexpr char TOP_ORIGIN = 0x20;
+}
+
+TgaReader::TgaReader(const std::string &file) : path{file}, stream{file, std::ios_base::binary}
+{
+    if (!stream.is_open())
+        throw std::runtime_error("ERROR: File \"" + file + "\" not found.");
+
+    unsigned char headerBytes[HEADER_SIZE];
+    stream.read(reinterpret_cast<char *>(headerBytes), HEADER_SIZE);
+    IP_TRACE_COUNT(BytesRead, HEADER_SIZE);
+    if (!stream)
+        throw std::runtime_error("ERROR: File \"" + file + "\" is not a valid .tga file.");
+    Header fileHeader = parseHeader(headerBytes);
+
+    // Skip the optional image ID and keep the color map for the decoder
+    stream.seekg(static_cast<unsigned char>(fileHeader.idLength), std::ios_base::cur);
+    std::vector<unsigned char> colorMap(tgaPayloadOffset(fileHeader) - static_cast<unsigned char>(fileHeader.idLength));
+    stream.read(reinterpret_cast<char *>(colorMap.data()), colorMap.size());
+    if (!stream)
+        throw std::runtime_error("ERROR: File \"" + file + "\" is truncated.");
+    decoder = std::make_unique<TgaDecoder>(fileHeader, colorMap.data());
+
+    // Rows are handed out left to right but in file order, so the top-origin bit is preserved
+    imageHeader = tgaHeader(fileHeader, 3, false);
+    if (tgaTopOrigin(fileHeader))
+        imageHeader.imageDescriptor |= TOP_ORIGIN;
+    rightOrigin = tgaRightOrigin(fileHeader);
+}
+
+int TgaReader::width() const
+{
+    return imageWidth(imageHeader);
+}
+
+int TgaReader::height() const
+{
+    return imageHeight(imageHeader);
+}
+
+void TgaReader::decode(unsigned char *out, std::size_t count)
+{
+    while (count > 0)
+    {
+        const unsigned char *in = input.data() + inputBegin;
+        std::size_t produced = decoder->decode(in, input.data() + input.size(), out, count);
+        inputBegin = in - input.data();
+        out += produced * decoder->channels();
+        count -= produced;
+        if (count == 0)
+            break;
+
+        // Keep the unconsumed tail (e.g. a partial packet) and append the next block of the file
+        input.erase(input.begin(), input.begin() + inputBegin);
+        inputBegin = 0;
+        std::size_t kept = input.size();
+        input.resize(kept + INPUT_BUFFER_SIZE);
+        stream.read(reinterpret_cast<char *>(input.data() + kept), INPUT_BUFFER_SIZE);
+        input.resize(kept + static_cast<std::size_t>(stream.gcount()));
+        IP_TRACE_COUNT(BytesRead, stream.gcount());
+        if (input.size() == kept)
+            throw std::runtime_error("ERROR: File \"" + path + "\" is truncated.");
+    }
+}
+
+int TgaReader::readRows(Pixel *destination, int rows)
+{
+    IP_TRACE_SCOPE("TgaReader::readRows");
+    rows = std::min(rows, rowsRemaining());
+    if (rows <= 0)
+        return 0;
+
+    std::size_t count = static_cast<std::size_t>(width()) * rows;
+    if (decoder->channels() == 3)
+    {
+        // BGR decodes straight into the caller's pixels
+        decode(reinterpret_cast<unsigned char *>(destination), count);
+    }
+    else
+    {
+        decoded.resize(count * decoder->channels());
+        decode(decoded.data(), count);
+
+        const unsigned char *in = decoded.data();
+        for (std::size_t i = 0; i < count; ++i, in += decoder->channels())
+        {
+            if (decoder->channels() == 1)
+                destination[i].update(in[0], in[0], in[0]);
+            else
+                destination[i].update(in[2], in[1], in[0]);
+        }
+    }
+
+    if (rightOrigin)
+        for (int y = 0; y < rows; ++y)
+            std::reverse(destination + static_cast<std::size_t>(y) * width(), destination + static_cast<std::size_t>(y + 1) * width());
+
+    rowsRead += rows;
+    return rows;
+}
+
+TgaWriter::TgaWriter(const std::string &file, const Header &header, bool rle)
+    : path{file}, stream{file, std::ios_base::binary}, imageHeader{tgaHeader(header, 3, rle)}, rle{rle}
+{
+    if (!stream.is_open())
+        throw std::runtime_error("ERROR: File \"" + file + "\" not found.");
+
+    if (tgaTopOrigin(header))
+        imageHeader.imageDescriptor |= TOP_ORIGIN;
+
+    unsigned char headerBytes[HEADER_SIZE];
+    serializeHeader(imageHeader, headerBytes);
+    stream.write(reinterpret_cast<const char *>(headerBytes), HEADER_SIZE);
+}
+
+void TgaWriter::writeRows(const Pixel *source, int rows)
+{
+    IP_TRACE_SCOPE("TgaWriter::writeRows");
+    if (rowsWritten + rows > imageHeight(imageHeader))
+        throw std::runtime_error("ERROR: Too many scanlines written to \"" + path + "\".");
+
+    int width = imageWidth(imageHeader);
+    std::size_t bytes = static_cast<std::size_t>(width) * rows * sizeof(Pixel);
+    if (!rle)
+    {
+        stream.write(reinterpret_cast<const char *>(source), bytes);
+        IP_TRACE_COUNT(BytesWritten, bytes);
+    }
+    else
+    {
+        packets.clear();
+        for (int y = 0; y < rows; ++y)
+            encodeRleRow(reinterpret_cast<const unsigned char *>(source + static_cast<std::size_t>(y) * width), width, 3, packets);
+        stream.write(reinterpret_cast<const char *>(packets.data()), packets.size());
+        IP_TRACE_COUNT(BytesWritten, packets.size());
+    }
+    rowsWritten += rows;
+}
+
+void TgaWriter::close()
+{
+    stream.close();
+    if (stream.fail())
+        throw std::runtime_error("ERROR: Could not write \"" + path + "\".");
+    if (rowsWritten != imageHeight(imageHeader))
+        throw std::runtime_error("ERROR: Missing scanlines in \"" + path + "\".");
+}
@@ -0,0 +1,197 @@
+#include "threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    // Set on pool workers and on any thread currently running a parallelFor, so nested calls run serially
+    thread_local bool insideParallelRegion = false;
+
+    /// @brief Persistent workers that cooperatively drain one banded job at a time.
+    class ThreadPool
+    {
+    public:
+        ThreadPool() : size{std::max(1u, std::thread::hardware_concurrency())} { start(); }
+
+        ~ThreadPool() { stop(); }
+
+        unsigned int threads() const { return size; }
+
+        void resize(unsigned int count)
+        {
+            std::lock_guard<std::mutex> submitLock{submitMutex};
+            stop();
+            size = count;
+            start();
+        }
+
+        void run(std::size_t count, std::size_t bandSize, void (*body)(void *, std::size_t, std::size_t), void *context)
+        {
+            std::lock_guard<std::mutex> submitLock{submitMutex};
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                jobBody = body;
+                jobContext = context;
+                jobCount = count;
+                jobBandSize = bandSize;
+                nextBand.store(0);
+                activeWorkers = static_cast<unsigned int>(workers.size());
+                ++generation;
+            }
+            wake.notify_all();
+
+            // The submitting thread takes part in the work as well
+            drain();
+
+            // Always wait for the workers, even after a failure: they still use the caller's context
+            std::unique_lock<std::mutex> lock{mutex};
+            done.wait(lock, [this]
+                      { return activeWorkers == 0; });
+            if (error)
+                std::rethrow_exception(std::exchange(error, nullptr));
+        }
+
+    private:
+        void start()
+        {
+            // Workers must know the current generation before run() can bump it, or they would take the next
+            // job for one already seen and never report back
+            unsigned long long current;
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                quit = false;
+                current = generation;
+            }
+            for (unsigned int i = 1; i < size; ++i)
+                workers.emplace_back([this, current]
+                                     { workerLoop(current); });
+        }
+
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                quit = true;
+            }
+            wake.notify_all();
+            for (std::thread &worker : workers)
+                worker.join();
+            workers.clear();
+        }
+
+        void workerLoop(unsigned long long seen)
+        {
+            insideParallelRegion = true;
+            while (true)
+            {
+                {
+                    std::unique_lock<std::mutex> lock{mutex};
+                    wake.wait(lock, [&]
+                              { return quit || generation != seen; });
+                    if (quit)
+                        return;
+                    seen = generation;
+                }
+
+                drain();
+
+                std::lock_guard<std::mutex> lock{mutex};
+                if (--activeWorkers == 0)
+                    done.notify_one();
+            }
+        }
+
+        void drain()
+        {
+            while (true)
+            {
+                std::size_t begin = nextBand.fetch_add(jobBandSize);
+                if (begin >= jobCount)
+                    return;
+                try
+                {
+                    jobBody(jobContext, begin, std::min(begin + jobBandSize, jobCount));
+                }
+                catch (...)
+                {
+                    // Keep the first failure for the submitting thread and skip the remaining bands
+                    nextBand.store(jobCount);
+                    std::lock_guard<std::mutex> lock{mutex};
+                    if (!error)
+                        error = std::current_exception();
+                    return;
+                }
+            }
+        }
+
+        unsigned int size;
+        std::vector<std::thread> workers;
+
+        std::mutex submitMutex; // Serializes jobs (one banded job in flight at a time)
+        std::mutex mutex;       // Guards the job description and worker bookkeeping
+        std::condition_variable wake;
+        std::condition_variable done;
+        bool quit = false;
+        unsigned long long generation = 0;
+        unsigned int activeWorkers = 0;
+        std::exception_ptr error; // First exception thrown by a band of the current job
+
+        void (*jobBody)(void *, std::size_t, std::size_t) = nullptr;
+        void *jobContext = nullptr;
+        std::size_t jobCount = 0;
+        std::size_t jobBandSize = 0;
+        std::atomic<std::size_t> nextBand{0};
+    };
+
+    ThreadPool &pool()
+    {
+        static ThreadPool instance;
+        return instance;
+    }
+}
+
+void setThreadCount(unsigned int count)
+{
+    if (count == 0)
+        count = std::max(1u, std::thread::hardware_concurrency());
+    pool().resize(count);
+}
+
+unsigned int threadCount()
+{
+    return pool().threads();
+}
+
+void parallelForBands(std::size_t count, std::size_t grain,
+                      void (*body)(void *, std::size_t, std::size_t), void *context)
+{
+    if (count == 0)
+        return;
+
+    grain = std::max<std::size_t>(grain, 1);
+    ThreadPool &threads = pool();
+    if (insideParallelRegion || threads.threads() == 1 || count <= grain)
+    {
+        body(context, 0, count);
+        return;
+    }
+
+    // Several bands per thread so uneven bands still balance, but never below the grain size
+    std::size_t bands = std::min<std::size_t>(count / grain, threads.threads() * 4);
+    std::size_t bandSize = (count + bands - 1) / bands;
+
+    // Cleared again even if a band throws, so later calls from this thread still run in parallel
+    struct ParallelRegion
+    {
+        ParallelRegion() { insideParallelRegion = true; }
+        ~ParallelRegion() { insideParallelRegion = false; }
+    } region;
+    threads.run(count, bandSize, body, context);
+}
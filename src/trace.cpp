@@ -0,0 +1,178 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    constexpr std::size_t COUNTERS = 4;
+    constexpr const char *COUNTER_NAMES[COUNTERS] = {"bytesRead", "bytesWritten", "pixelsProcessed", "allocations"};
+
+    struct TraceEvent
+    {
+        const char *name;
+        std::uint64_t start;    // Nanoseconds since the trace epoch
+        std::uint64_t duration; // Nanoseconds
+    };
+
+    /// @brief The events of one thread; its lock is only contended while a trace is cleared or exported.
+    struct ThreadTrace
+    {
+        std::mutex mutex;
+        std::vector<TraceEvent> events;
+        int id;
+    };
+
+    /// @brief State shared by all threads.
+    struct TraceState
+    {
+        std::atomic<bool> enabled{false};
+        std::atomic<std::uint64_t> counters[COUNTERS] = {};
+        std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+        std::mutex mutex;                                 // Guards threads
+        std::vector<std::shared_ptr<ThreadTrace>> threads; // Kept after their thread exits so events survive
+    };
+
+    TraceState &state()
+    {
+        static TraceState instance;
+        return instance;
+    }
+
+    std::uint64_t now()
+    {
+        auto elapsed = std::chrono::steady_clock::now() - state().epoch;
+        // Never 0, which marks a scope that started with tracing off
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) + 1;
+    }
+
+    /// @return The event buffer of the calling thread, registered on first use.
+    ThreadTrace &threadTrace()
+    {
+        thread_local std::shared_ptr<ThreadTrace> trace = []
+        {
+            TraceState &shared = state();
+            std::lock_guard<std::mutex> lock{shared.mutex};
+            auto created = std::make_shared<ThreadTrace>();
+            created->id = static_cast<int>(shared.threads.size()) + 1;
+            shared.threads.push_back(created);
+            return created;
+        }();
+        return *trace;
+    }
+
+    void writeString(std::ostream &out, const char *text)
+    {
+        out << '"';
+        for (; *text; ++text)
+        {
+            if (*text == '"' || *text == '\\')
+                out << '\\';
+            out << *text;
+        }
+        out << '"';
+    }
+
+    /// @brief Write nanoseconds as the microseconds the trace format expects.
+    void writeMicroseconds(std::ostream &out, std::uint64_t nanoseconds)
+    {
+        out << nanoseconds / 1000 << '.' << static_cast<char>('0' + nanoseconds / 100 % 10)
+            << static_cast<char>('0' + nanoseconds / 10 % 10) << static_cast<char>('0' + nanoseconds % 10);
+    }
+}
+
+TraceScope::TraceScope(const char *name) : name{name}, start{tracingEnabled() ? now() : 0} {}
+
+TraceScope::~TraceScope()
+{
+    if (start == 0 || !tracingEnabled())
+        return;
+
+    std::uint64_t end = now();
+    ThreadTrace &trace = threadTrace();
+    std::lock_guard<std::mutex> lock{trace.mutex};
+    trace.events.push_back({name, start - 1, end - start});
+}
+
+void setTracing(bool enabled)
+{
+    state().enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool tracingEnabled()
+{
+    return state().enabled.load(std::memory_order_relaxed);
+}
+
+void clearTrace()
+{
+    TraceState &shared = state();
+    std::lock_guard<std::mutex> lock{shared.mutex};
+    for (const auto &trace : shared.threads)
+    {
+        std::lock_guard<std::mutex> threadLock{trace->mutex};
+        trace->events.clear();
+    }
+    for (auto &counter : shared.counters)
+        counter.store(0, std::memory_order_relaxed);
+}
+
+void traceCount(TraceCounter counter, std::uint64_t amount)
+{
+    if (tracingEnabled())
+        state().counters[static_cast<std::size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+}
+
+std::uint64_t traceCounter(TraceCounter counter)
+{
+    return state().counters[static_cast<std::size_t>(counter)].load(std::memory_order_relaxed);
+}
+
+void writeChromeTrace(std::ostream &out)
+{
+    TraceState &shared = state();
+    std::lock_guard<std::mutex> lock{shared.mutex};
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    std::uint64_t last = 0;
+    for (const auto &trace : shared.threads)
+    {
+        std::lock_guard<std::mutex> threadLock{trace->mutex};
+        for (const TraceEvent &event : trace->events)
+        {
+            out << (first ? "\n" : ",\n") << "{\"name\":";
+            writeString(out, event.name);
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << trace->id << ",\"ts\":";
+            writeMicroseconds(out, event.start);
+            out << ",\"dur\":";
+            writeMicroseconds(out, event.duration);
+            out << '}';
+            first = false;
+            last = std::max(last, event.start + event.duration);
+        }
+    }
+
+    // The counters as they stand at the end of the trace
+    out << (first ? "\n" : ",\n") << "{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":";
+    writeMicroseconds(out, last);
+    out << ",\"args\":{";
+    for (std::size_t i = 0; i < COUNTERS; ++i)
+        out << (i ? "," : "") << '"' << COUNTER_NAMES[i] << "\":" << shared.counters[i].load(std::memory_order_relaxed);
+    out << "}}\n]}\n";
+}
+
+void writeChromeTrace(const std::string &file)
+{
+    std::ofstream out{file};
+    if (!out)
+        throw std::runtime_error("ERROR: Could not open file \"" + file + "\" for writing.");
+    writeChromeTrace(out);
+}
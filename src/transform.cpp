@@ -0,0 +1,172 @@
+#include "transform.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include "threadpool.h"
+#include "trace.h"
+
+namespace
+{
+    // Side of the square tiles used by the axis-swapping transforms: a 64-pixel tile row is exactly three
+    // cache lines, and a source tile plus a destination tile (24 KB) stay in L1
+    constexpr int TILE = 64;
+
+    /// @brief Write `out(x, y) = in(column, row)` with the source row taken from x and the source column from y,
+    ///        each optionally mirrored; this covers transpose and both quarter turns.
+    /// @note The output is walked in TILE x TILE blocks, so each block reads a TILE x TILE block of the source
+    ///       instead of striding down a whole column per output row.
+    void swapAxes(const Image &image, Image &result, bool mirrorRows, bool mirrorColumns)
+    {
+        if (&image == &result)
+            throw std::runtime_error("ERROR: Rotating by 90 degrees or transposing cannot be done in place.");
+
+        int width = imageWidth(image.header);
+        int height = imageHeight(image.header);
+        result.header = image.header;
+        result.header.width = image.header.height;
+        result.header.height = image.header.width;
+        result.pixels.resize(image.pixels.size());
+
+        // The output is height pixels wide and width pixels tall
+        const Pixel *in = image.pixels.data();
+        Pixel *out = result.pixels.data();
+        int tileRows = (width + TILE - 1) / TILE;
+        parallelFor(tileRows, PIXEL_GRAIN / (static_cast<std::size_t>(height) * TILE + 1) + 1, [&](std::size_t begin, std::size_t end)
+                    {
+                        for (int tileY = static_cast<int>(begin) * TILE; tileY < static_cast<int>(end) * TILE && tileY < width; tileY += TILE)
+                        {
+                            int yEnd = std::min(tileY + TILE, width);
+                            for (int tileX = 0; tileX < height; tileX += TILE)
+                            {
+                                int xEnd = std::min(tileX + TILE, height);
+                                for (int y = tileY; y < yEnd; ++y)
+                                {
+                                    int column = mirrorColumns ? width - 1 - y : y;
+                                    Pixel *row = out + static_cast<std::size_t>(y) * height;
+                                    for (int x = tileX; x < xEnd; ++x)
+                                    {
+                                        int sourceRow = mirrorRows ? height - 1 - x : x;
+                                        row[x] = in[static_cast<std::size_t>(sourceRow) * width + column];
+                                    }
+                                }
+                            }
+                        } });
+    }
+}
+
+void flipHorizontal(const Image &image, Image &result)
+{
+    IP_TRACE_SCOPE("flipHorizontal");
+    IP_TRACE_COUNT(PixelsProcessed, image.pixels.size());
+    int width = imageWidth(image.header);
+    int height = imageHeight(image.header);
+    bool inPlace = &image == &result;
+    prepareResult(image, result);
+
+    parallelFor(height, rowGrain(width), [&](std::size_t begin, std::size_t end)
+                {
+                    for (std::size_t y = begin; y < end; ++y)
+                    {
+                        Pixel *out = result.pixels.data() + y * width;
+                        if (inPlace)
+                        {
+                            std::reverse(out, out + width);
+                        }
+                        else
+                        {
+                            const Pixel *in = image.pixels.data() + y * width;
+                            std::reverse_copy(in, in + width, out);
+                        }
+                    } });
+}
+
+Image flipHorizontal(const Image &image)
+{
+    Image result{image.header};
+    flipHorizontal(image, result);
+    return result;
+}
+
+void flipVertical(const Image &image, Image &result)
+{
+    IP_TRACE_SCOPE("flipVertical");
+    IP_TRACE_COUNT(PixelsProcessed, image.pixels.size());
+    int width = imageWidth(image.header);
+    int height = imageHeight(image.header);
+    std::size_t rowBytes = static_cast<std::size_t>(width) * sizeof(Pixel);
+
+    if (&image == &result)
+    {
+        // In place: swap mirrored rows, each band owning the rows of the lower half
+        parallelFor(height / 2, rowGrain(width), [&](std::size_t begin, std::size_t end)
+                    {
+                        for (std::size_t y = begin; y < end; ++y)
+                        {
+                            Pixel *low = result.pixels.data() + y * width;
+                            Pixel *high = result.pixels.data() + (height - 1 - y) * width;
+                            std::swap_ranges(low, low + width, high);
+                        } });
+        return;
+    }
+
+    prepareResult(image, result);
+    parallelFor(height, rowGrain(width), [&](std::size_t begin, std::size_t end)
+                {
+                    for (std::size_t y = begin; y < end; ++y)
+                        std::memcpy(result.pixels.data() + y * width, image.pixels.data() + (height - 1 - y) * width, rowBytes); });
+}
+
+Image flipVertical(const Image &image)
+{
+    Image result{image.header};
+    flipVertical(image, result);
+    return result;
+}
+
+void rotate90(const Image &image, Image &result)
+{
+    IP_TRACE_SCOPE("rotate90");
+    IP_TRACE_COUNT(PixelsProcessed, image.pixels.size());
+    // Clockwise: out(x, y) = in(width - 1 - y, x)
+    swapAxes(image, result, false, true);
+}
+
+Image rotate90(const Image &image)
+{
+    Image result{Header{}};
+    rotate90(image, result);
+    return result;
+}
+
+void rotate270(const Image &image, Image &result)
+{
+    IP_TRACE_SCOPE("rotate270");
+    IP_TRACE_COUNT(PixelsProcessed, image.pixels.size());
+    // Counterclockwise: out(x, y) = in(y, height - 1 - x)
+    swapAxes(image, result, true, false);
+}
+
+Image rotate270(const Image &image)
+{
+    Image result{Header{}};
+    rotate270(image, result);
+    return result;
+}
+
+void transpose(const Image &image, Image &result)
+{
+    IP_TRACE_SCOPE("transpose");
+    IP_TRACE_COUNT(PixelsProcessed, image.pixels.size());
+    // out(x, y) = in(y, x)
+    swapAxes(image, result, false, false);
+}
+
+Image transpose(const Image &image)
+{
+    Image result{Header{}};
+    transpose(image, result);
+    return result;
+}
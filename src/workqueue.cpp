@@ -0,0 +1,525 @@
+#include "workqueue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "imageloader.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define WORKQUEUE_POSIX 1
+#include <cstring>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/file.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char **environ;
+#else
+#define WORKQUEUE_POSIX 0
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // Written once every shard of a new queue is in place; a directory without it holds no queue yet
+    constexpr const char *QUEUE_MARKER = "queue.info";
+
+    /// @brief A shard file name split into its parts (`SHARD.ATTEMPT[.PID]`).
+    struct ShardName
+    {
+        std::string shard;
+        unsigned int attempt = 0;
+        long pid = 0;
+    };
+
+    bool parseShardName(const std::string &name, ShardName &parsed)
+    {
+        std::vector<std::string> parts;
+        std::stringstream stream{name};
+        std::string part;
+        while (std::getline(stream, part, '.'))
+            parts.push_back(part);
+        if (parts.size() < 2 || parts.size() > 3 || parts[0].empty())
+            return false;
+        try
+        {
+            parsed.shard = parts[0];
+            parsed.attempt = static_cast<unsigned int>(std::stoul(parts[1]));
+            parsed.pid = parts.size() == 3 ? std::stol(parts[2]) : 0;
+            return true;
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+    }
+
+    /// @return The names of the files in a queue directory, sorted (temporary files start with a dot).
+    std::vector<std::string> listShards(const fs::path &directory)
+    {
+        std::vector<std::string> names;
+        std::error_code error;
+        for (const fs::directory_entry &entry : fs::directory_iterator{directory, error})
+        {
+            std::string name = entry.path().filename().string();
+            if (!name.empty() && name[0] != '.')
+                names.push_back(name);
+        }
+        std::sort(names.begin(), names.end());
+        return names;
+    }
+
+    /// @brief Write a file under a temporary name in the same directory, then rename it into place.
+    void writeAtomically(const fs::path &path, const std::string &contents)
+    {
+        fs::path temporary = path.parent_path() / ("." + path.filename().string() + ".tmp");
+        {
+            std::ofstream file{temporary, std::ios::binary | std::ios::trunc};
+            file << contents;
+            if (!file.flush())
+                throw std::runtime_error("ERROR: Could not write \"" + temporary.string() + "\".");
+        }
+        fs::rename(temporary, path);
+    }
+
+    long currentProcess()
+    {
+#if WORKQUEUE_POSIX
+        return static_cast<long>(::getpid());
+#else
+        return 1;
+#endif
+    }
+
+    /// @brief An exclusive lock on a shard file: the lease of the process working on the shard.
+    /// @note The lock (flock) belongs to the open file, so it follows the shard through renames and the kernel
+    ///       releases it when its holder exits, however it dies. A claim whose file can be locked has no live
+    ///       owner, whatever process now has the PID in its name. Without POSIX, where the coordinator is the
+    ///       only worker, every lock succeeds.
+    class ShardLease
+    {
+    public:
+        /// @brief Tries to lock a shard file without waiting.
+        explicit ShardLease(const fs::path &path)
+        {
+#if WORKQUEUE_POSIX
+            descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (descriptor >= 0 && ::flock(descriptor, LOCK_EX | LOCK_NB) != 0)
+                release();
+#else
+            held = fs::exists(path);
+#endif
+        }
+
+        ~ShardLease() { release(); }
+
+        ShardLease(const ShardLease &) = delete;
+        ShardLease &operator=(const ShardLease &) = delete;
+
+        /// @return Whether the lock was obtained.
+        explicit operator bool() const
+        {
+#if WORKQUEUE_POSIX
+            return descriptor >= 0;
+#else
+            return held;
+#endif
+        }
+
+    private:
+        void release()
+        {
+#if WORKQUEUE_POSIX
+            if (descriptor >= 0)
+                ::close(descriptor);
+            descriptor = -1;
+#endif
+        }
+
+#if WORKQUEUE_POSIX
+        int descriptor = -1;
+#else
+        bool held = false;
+#endif
+    };
+
+    /// @return The number of jobs of the failed shards whose output was never written.
+    std::size_t abandonedJobs(const fs::path &root)
+    {
+        std::size_t count = 0;
+        for (const std::string &name : listShards(root / "failed"))
+            for (const BatchJob &job : readJobManifest((root / "failed" / name).string()))
+                if (!fs::exists(job.output))
+                    ++count;
+        return count;
+    }
+
+    /// @brief Run one job, trying it up to `attempts` times.
+    /// @return An empty string on success; otherwise the last error.
+    std::string runJob(const BatchJob &job, std::shared_future<SharedImage> input, ImageLoader &loader,
+                       std::map<std::string, std::unique_ptr<PipelineSpec>> &specs, const QueueOptions &options)
+    {
+        std::string error;
+        for (unsigned int attempt = 0; attempt < std::max(options.maxAttempts, 1u); ++attempt)
+        {
+            try
+            {
+                // A retry decodes the file again (failed loads are not cached)
+                if (attempt > 0)
+                    input = loader.load(job.input);
+                std::unique_ptr<PipelineSpec> &spec = specs[job.pipeline];
+                if (!spec)
+                    spec = std::make_unique<PipelineSpec>(job.pipeline);
+
+                Image result{Header{}};
+                spec->apply(*input.get(), result);
+
+                // Written under a temporary name, so an existing output is always complete
+                fs::path output{job.output};
+                if (output.has_parent_path())
+                    fs::create_directories(output.parent_path());
+                fs::path partial = output;
+                partial += ".partial";
+                result.write(partial.string(), options.encoding);
+                fs::rename(partial, output);
+                return "";
+            }
+            catch (const std::exception &exception)
+            {
+                error = exception.what();
+            }
+        }
+        return error;
+    }
+}
+
+std::vector<BatchJob> readJobManifest(const std::string &file)
+{
+    std::ifstream manifest{file};
+    if (!manifest.is_open())
+        throw std::runtime_error("ERROR: Manifest \"" + file + "\" not found.");
+
+    std::vector<BatchJob> jobs;
+    std::string line;
+    for (std::size_t number = 1; std::getline(manifest, line); ++number)
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::size_t first = line.find('\t');
+        std::size_t second = first == std::string::npos ? first : line.find('\t', first + 1);
+        if (second == std::string::npos || line.find('\t', second + 1) != std::string::npos)
+            throw std::runtime_error("ERROR: Line " + std::to_string(number) + " of \"" + file +
+                                     "\" is not PIPELINE<TAB>INPUT<TAB>OUTPUT.");
+        jobs.push_back({line.substr(0, first), line.substr(first + 1, second - first - 1), line.substr(second + 1)});
+    }
+    return jobs;
+}
+
+bool createQueue(const std::string &queueDirectory, const std::vector<BatchJob> &jobs, std::size_t shardSize)
+{
+    fs::path root{queueDirectory};
+    if (fs::exists(root / QUEUE_MARKER))
+        return false;
+    if (jobs.empty())
+        throw std::runtime_error("ERROR: No jobs to queue.");
+    if (shardSize == 0)
+        throw std::runtime_error("ERROR: Shards must hold at least one job.");
+
+    // Workers only start on a finished queue, so an unfinished one has never been worked on
+    for (const char *state : {"incoming", "pending", "claimed", "done", "failed"})
+        fs::remove_all(root / state);
+
+    // Every distinct pipeline is parsed once here, so a typo fails the run before any worker starts. Colliding
+    // outputs fail too: a worker would otherwise skip the second job of a pair, since its output exists
+    std::set<std::string> pipelines;
+    std::vector<std::string> inputs;
+    std::vector<std::string> outputs;
+    for (const BatchJob &job : jobs)
+    {
+        for (const std::string *field : {&job.pipeline, &job.input, &job.output})
+            if (field->find_first_of("\t\r\n") != std::string::npos)
+                throw std::runtime_error("ERROR: Job fields cannot contain tabs or line breaks: \"" + *field + "\".");
+        if (pipelines.insert(job.pipeline).second)
+            PipelineSpec{job.pipeline};
+        inputs.push_back(job.input);
+        outputs.push_back(job.output);
+    }
+    checkOutputPaths(inputs, outputs);
+
+    // The shards are written to `incoming/`, which becomes `pending/` in a single rename
+    fs::create_directories(root / "incoming");
+    std::size_t shards = (jobs.size() + shardSize - 1) / shardSize;
+    for (std::size_t shard = 0; shard < shards; ++shard)
+    {
+        std::string contents;
+        for (std::size_t i = shard * shardSize; i < std::min(jobs.size(), (shard + 1) * shardSize); ++i)
+            contents += jobs[i].pipeline + '\t' + jobs[i].input + '\t' + jobs[i].output + '\n';
+
+        std::string name = std::to_string(shard);
+        name.insert(0, name.size() < 8 ? 8 - name.size() : 0, '0');
+        writeAtomically(root / "incoming" / (name + ".0"), contents);
+    }
+    fs::rename(root / "incoming", root / "pending");
+    for (const char *state : {"claimed", "done", "failed"})
+        fs::create_directories(root / state);
+    writeAtomically(root / QUEUE_MARKER,
+                    "jobs " + std::to_string(jobs.size()) + "\nshards " + std::to_string(shards) + "\n");
+    return true;
+}
+
+QueueProgress queueProgress(const std::string &queueDirectory)
+{
+    fs::path root{queueDirectory};
+    QueueProgress progress;
+    progress.pending = listShards(root / "pending").size();
+    progress.claimed = listShards(root / "claimed").size();
+    progress.failed = listShards(root / "failed").size();
+
+    std::vector<std::string> done = listShards(root / "done");
+    progress.done = done.size();
+    for (const std::string &name : done)
+    {
+        // The first line of a report: `written W skipped S failed F`
+        std::ifstream report{root / "done" / name};
+        std::string label;
+        std::size_t written = 0, skipped = 0, failed = 0;
+        if (report >> label >> written >> label >> skipped >> label >> failed)
+        {
+            progress.written += written;
+            progress.skipped += skipped;
+            progress.errors += failed;
+        }
+    }
+    return progress;
+}
+
+std::size_t requeueClaims(const std::string &queueDirectory, unsigned int maxAttempts, long pid)
+{
+    fs::path root{queueDirectory};
+    std::size_t requeued = 0;
+    for (const std::string &name : listShards(root / "claimed"))
+    {
+        ShardName claim;
+        if (!parseShardName(name, claim) || claim.pid == 0 || (pid != 0 && claim.pid != pid))
+            continue;
+        ShardLease lease{root / "claimed" / name};
+        if (!lease)
+            continue; // Its worker is alive
+
+        // The attempt counts the workers that died holding the shard
+        unsigned int attempt = claim.attempt + 1;
+        if (attempt >= std::max(maxAttempts, 1u))
+        {
+            fs::rename(root / "claimed" / name, root / "failed" / claim.shard);
+            continue;
+        }
+        fs::rename(root / "claimed" / name, root / "pending" / (claim.shard + "." + std::to_string(attempt)));
+        ++requeued;
+    }
+    return requeued;
+}
+
+BatchResult runWorker(const QueueOptions &options, std::ostream &log)
+{
+    auto start = std::chrono::steady_clock::now();
+    fs::path root{options.queueDirectory};
+    if (!fs::exists(root / QUEUE_MARKER))
+        throw std::runtime_error("ERROR: \"" + options.queueDirectory + "\" does not hold a queue.");
+
+    // Decodes the next input while the current one is processed; the futures hold the images, not the cache
+    ImageLoader loader{0};
+    std::map<std::string, std::unique_ptr<PipelineSpec>> specs;
+    std::string pid = std::to_string(currentProcess());
+    BatchResult result;
+    for (;;)
+    {
+        // Claim the first pending shard no other process holds: lock it, then rename it while locked. The lock
+        // is kept until the shard is done, so a shard renamed away or locked by someone else is skipped
+        std::string name;
+        fs::path claimed;
+        std::unique_ptr<ShardLease> lease;
+        for (const std::string &candidate : listShards(root / "pending"))
+        {
+            lease = std::make_unique<ShardLease>(root / "pending" / candidate);
+            if (!*lease)
+                continue;
+            std::error_code error;
+            claimed = root / "claimed" / (candidate + "." + pid);
+            fs::rename(root / "pending" / candidate, claimed, error);
+            if (!error)
+            {
+                name = candidate;
+                break;
+            }
+        }
+        if (name.empty())
+            break;
+
+        ShardName shard;
+        parseShardName(name, shard);
+        std::vector<BatchJob> jobs = readJobManifest(claimed.string());
+        std::vector<std::size_t> todo;
+        std::size_t written = 0, skipped = 0;
+        for (std::size_t i = 0; i < jobs.size(); ++i)
+        {
+            if (fs::exists(jobs[i].output))
+                ++skipped;
+            else
+                todo.push_back(i);
+        }
+
+        std::string failures;
+        std::shared_future<SharedImage> next = todo.empty() ? std::shared_future<SharedImage>{}
+                                                            : loader.load(jobs[todo[0]].input);
+        for (std::size_t t = 0; t < todo.size(); ++t)
+        {
+            const BatchJob &job = jobs[todo[t]];
+            std::shared_future<SharedImage> input = next;
+            if (t + 1 < todo.size())
+                next = loader.load(jobs[todo[t + 1]].input);
+
+            std::string error = runJob(job, input, loader, specs, options);
+            if (error.empty())
+            {
+                ++written;
+                continue;
+            }
+            log << job.input << ": " << error << std::endl;
+            failures += job.input + '\t' + error + '\n';
+        }
+
+        std::size_t failed = todo.size() - written;
+        writeAtomically(root / "done" / shard.shard, "written " + std::to_string(written) + " skipped " +
+                                                         std::to_string(skipped) + " failed " +
+                                                         std::to_string(failed) + "\n" + failures);
+        fs::remove(claimed);
+        lease.reset();
+        result.succeeded += written;
+        result.skipped += skipped;
+        result.failed += failed;
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+BatchResult runCoordinator(const QueueOptions &options, const std::string &executable, std::ostream &log)
+{
+    auto start = std::chrono::steady_clock::now();
+    fs::path root{options.queueDirectory};
+    if (!fs::exists(root / QUEUE_MARKER))
+        throw std::runtime_error("ERROR: \"" + options.queueDirectory + "\" does not hold a queue.");
+
+    std::size_t returned = requeueClaims(options.queueDirectory, options.maxAttempts);
+    QueueProgress progress = queueProgress(options.queueDirectory);
+    log << "Queue " << options.queueDirectory << ": " << progress.pending << " of " << progress.total()
+        << " shard(s) to process";
+    if (returned > 0)
+        log << " (" << returned << " returned from interrupted workers)";
+    log << std::endl;
+
+#if WORKQUEUE_POSIX
+    unsigned int workers = options.workers > 0 ? options.workers : std::max(std::thread::hardware_concurrency(), 1u);
+    auto spawn = [&]() -> pid_t
+    {
+        std::vector<std::string> arguments{executable, "work", "--queue-dir", options.queueDirectory,
+                                           "-t", std::to_string(std::max(options.computeThreads, 1u)),
+                                           "--attempts", std::to_string(options.maxAttempts)};
+        if (options.encoding == TgaEncoding::TrueColorRle)
+            arguments.push_back("--rle");
+        std::vector<char *> argv;
+        for (std::string &argument : arguments)
+            argv.push_back(argument.data());
+        argv.push_back(nullptr);
+
+        pid_t pid;
+        int error = ::posix_spawnp(&pid, executable.c_str(), nullptr, nullptr, argv.data(), environ);
+        if (error != 0)
+            throw std::runtime_error("ERROR: Could not start worker \"" + executable + "\": " + std::strerror(error) + ".");
+        return pid;
+    };
+
+    std::vector<pid_t> running;
+    // Poll the workers and the queue until no shard is pending or claimed. Shards may also be held by workers of
+    // an interrupted coordinator that are still running; they go back to pending when those die
+    std::size_t reported = progress.done + progress.failed;
+    std::vector<std::string> awaited;
+    for (;;)
+    {
+        for (std::size_t i = 0; i < running.size();)
+        {
+            int status;
+            if (::waitpid(running[i], &status, WNOHANG) != running[i])
+            {
+                ++i;
+                continue;
+            }
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            {
+                std::size_t requeued = requeueClaims(options.queueDirectory, options.maxAttempts, running[i]);
+                log << "Worker " << running[i] << " failed";
+                if (WIFSIGNALED(status))
+                    log << " (signal " << WTERMSIG(status) << ")";
+                log << "; " << requeued << " shard(s) returned to the queue" << std::endl;
+            }
+            running.erase(running.begin() + static_cast<std::ptrdiff_t>(i));
+        }
+        requeueClaims(options.queueDirectory, options.maxAttempts);
+
+        progress = queueProgress(options.queueDirectory);
+        while (running.size() < std::min<std::size_t>(workers, progress.pending))
+            running.push_back(spawn());
+        if (progress.done + progress.failed != reported)
+        {
+            reported = progress.done + progress.failed;
+            log << "Progress: " << reported << "/" << progress.total() << " shard(s), " << progress.written
+                << " file(s) written, " << progress.skipped << " skipped, " << progress.errors << " failed"
+                << std::endl;
+        }
+        if (running.empty() && progress.pending == 0 && progress.claimed == 0)
+            break;
+        if (running.empty() && progress.pending == 0)
+        {
+            std::vector<std::string> claims = listShards(root / "claimed");
+            if (claims != awaited)
+            {
+                awaited = claims;
+                log << "Waiting for " << claims.size() << " shard(s) held by other workers:";
+                for (const std::string &claim : claims)
+                    log << ' ' << claim;
+                log << std::endl;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+#else
+    // Without process spawning the coordinator works through the queue itself
+    (void)executable;
+    runWorker(options, log);
+#endif
+
+    progress = queueProgress(options.queueDirectory);
+    BatchResult result;
+    result.succeeded = progress.written;
+    result.skipped = progress.skipped;
+    result.failed = progress.errors + abandonedJobs(root);
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    log << result.succeeded << " file(s) written, " << result.skipped << " skipped, " << result.failed
+        << " failed in " << result.seconds << " s";
+    if (progress.failed > 0)
+        log << " (" << progress.failed << " shard(s) given up, see " << (root / "failed").string() << ")";
+    log << std::endl;
+    return result;
+}